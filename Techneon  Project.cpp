@@ -1,611 +1,1094 @@
-#include <iostream>
-#include <iomanip>
-#include <string>
-#include <sstream>
-#include <cmath>
-#include <limits>
-#include <vector>
-
-using namespace std;
-
-const string GREEN_COLOR = "\033[32m";
-const string RED_COLOR = "\033[31m";
-const string YELLOW_COLOR = "\033[33m";
-const string CYAN_COLOR = "\033[36m";
-const string BLUE_COLOR = "\033[34m";
-const string RESET_COLOR = "\033[0m";
-
-struct HistoryEntry {
-    string type, input, result;
-    HistoryEntry(string t, string i, string r) : type(t), input(i), result(r) {}
-};
-
-class Converter {
-protected:
-    double value;
-public:
-    Converter(double val = 0.0) : value(val) {}
-    virtual ~Converter() = default;
-    virtual double convert() const = 0;
-    virtual string getType() const = 0;
-    void displayResult(const string& input, const string& unitInfo) const {
-        const int COL_WIDTH = 15;
-        double result = convert();
-        cout << fixed << setprecision(2);
-        ostringstream oss;
-        oss << fixed << setprecision(2) << result;
-        string resultStr = oss.str();
-
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-        cout << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + "Input" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + unitInfo + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << GREEN_COLOR + resultStr + RESET_COLOR << "|\n";
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-    }
-};
-
-class TemperatureConverter : public Converter {
-private:
-    char fromUnit, toUnit;
-public:
-    TemperatureConverter(double temp, char from, char to)
-        : Converter(temp), fromUnit(toupper(from)), toUnit(toupper(to)) {}
-
-    double convert() const override {
-        // Step-by-step temperature conversion process
-        // Step 1: Check if converting from Celsius to Fahrenheit
-        if (fromUnit == 'C' && toUnit == 'F') {
-            // Step 2: Apply the formula: °F = (°C * 9/5) + 32
-            //         - Multiply the Celsius value by 9/5
-            //         - Add 32 to the result
-            return value * 9.0 / 5.0 + 32.0;
-        }
-        // Step 3: Check if converting from Fahrenheit to Celsius
-        if (fromUnit == 'F' && toUnit == 'C') {
-            // Step 4: Apply the formula: °C = (°F - 32) * 5/9
-            //         - Subtract 32 from the Fahrenheit value
-            //         - Multiply the result by 5/9
-            return (value - 32.0) * 5.0 / 9.0;
-        }
-        // Step 5: If units are the same, return the original value
-        if (fromUnit == toUnit) {
-            return value;
-        }
-        // Step 6: If units are invalid, throw an error
-        throw runtime_error("Invalid temperature units (use C or F)");
-    }
-    string getType() const override { return "Temperature"; }
-};
-
-class NumberBaseConverter : public Converter {
-private:
-    string inputValue;
-    char fromBase, toBase;
-
-    string convertToBase(long long num, int base) const {
-        // Step-by-step process to convert a decimal number to the target base
-        // Step 1: Handle the special case where the number is 0
-        if (num == 0) return "0";
-        // Step 2: Define the digits for the target base (0-9, A-F for hex)
-        string digits = "0123456789ABCDEF";
-        string result;
-        // Step 3: Convert the number to the target base using division
-        //         - Repeatedly divide the number by the base
-        //         - Prepend the remainder (as a digit) to the result
-        //         - Continue until the number becomes 0
-        while (num > 0) {
-            result = digits[num % base] + result;
-            num /= base;
-        }
-        // Step 4: Return the converted string
-        return result;
-    }
-
-public:
-    NumberBaseConverter(string val, char from, char to)
-        : Converter(0), inputValue(val), fromBase(toupper(from)), toBase(toupper(to)) {
-        try {
-            // Step-by-step process to parse the input string
-            // Step 1: Check the source base and convert the string to a decimal number
-            if (fromBase == 'B') {
-                // Step 2: For binary, use base 2 to parse the string
-                value = static_cast<double>(stoi(val, nullptr, 2));
-            }
-            else if (fromBase == 'D') {
-                // Step 3: For decimal, parse directly as a double
-                value = stod(val);
-            }
-            else if (fromBase == 'O') {
-                // Step 4: For octal, use base 8 to parse the string
-                value = static_cast<double>(stoi(val, nullptr, 8));
-            }
-            else if (fromBase == 'H') {
-                // Step 5: For hexadecimal, use base 16 to parse the string
-                value = static_cast<double>(stoi(val, nullptr, 16));
-            }
-            else {
-                // Step 6: If the source base is invalid, throw an error
-                throw runtime_error("Invalid source base (use B, D, O, H)");
-            }
-        } catch (const invalid_argument& e) {
-            throw runtime_error("Invalid number format for the specified base");
-        } catch (const out_of_range& e) {
-            throw runtime_error("Number out of range for conversion");
-        }
-    }
-
-    double convert() const override {
-        // Step-by-step process to convert the decimal value to the target base
-        // Step 1: Convert the double value to a long long integer (ignoring decimal part)
-        long long intValue = static_cast<long long>(value);
-        // Step 2: Check the target base and convert accordingly
-        if (toBase == 'B') {
-            // Step 3: For binary, convert to base 2 and parse the result as a double
-            return stod(convertToBase(intValue, 2));
-        }
-        if (toBase == 'D') {
-            // Step 4: For decimal, return the value as is
-            return value;
-        }
-        if (toBase == 'O') {
-            // Step 5: For octal, convert to base 8 and parse the result as a double
-            return stod(convertToBase(intValue, 8));
-        }
-        if (toBase == 'H') {
-            // Step 6: For hexadecimal, convert to base 16 and parse the result as a double
-            return stod(convertToBase(intValue, 16));
-        }
-        // Step 7: If the target base is invalid, throw an error
-        throw runtime_error("Invalid target base (use B, D, O, H)");
-    }
-
-    string getResultString() const {
-        // Step-by-step process to get the result as a string
-        // Step 1: Convert the double value to a long long integer
-        long long intValue = static_cast<long long>(value);
-        // Step 2: Check the target base and convert to a string
-        if (toBase == 'B') {
-            // Step 3: For binary, convert to base 2
-            return convertToBase(intValue, 2);
-        }
-        if (toBase == 'D') {
-            // Step 4: For decimal, convert to string directly
-            return to_string(intValue);
-        }
-        if (toBase == 'O') {
-            // Step 5: For octal, convert to base 8
-            return convertToBase(intValue, 8);
-        }
-        if (toBase == 'H') {
-            // Step 6: For hexadecimal, convert to base 16
-            return convertToBase(intValue, 16);
-        }
-        // Step 7: If the target base is invalid, throw an error
-        throw runtime_error("Invalid target base");
-    }
-
-    void displayResult(const string& input, const string& unitInfo) const {
-        const int COL_WIDTH = 15;
-        string result = getResultString();
-
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-        cout << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + "Input" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + unitInfo + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << GREEN_COLOR + result + RESET_COLOR << "|\n";
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-    }
-
-    string getType() const override { return "Number Base"; }
-};
-
-class LogarithmicCalculator : public Converter {
-private:
-    char logType;
-public:
-    LogarithmicCalculator(double val, char type) : Converter(val), logType(toupper(type)) {}
-
-    double convert() const override {
-        // Step-by-step logarithmic calculation process
-        // Step 1: Check if the input value is positive (log is undefined for non-positive numbers)
-        if (value <= 0) {
-            throw runtime_error("Logarithm undefined for non-positive numbers");
-        }
-        // Step 2: Check the type of logarithm to compute
-        if (logType == 'L') {
-            // Step 3: For base 10 logarithm, use log10() function
-            return log10(value);
-        }
-        if (logType == 'N') {
-            // Step 4: For natural logarithm (base e), use log() function
-            return log(value);
-        }
-        if (logType == 'B') {
-            // Step 5: For base 2 logarithm, use log2() function
-            return log2(value);
-        }
-        // Step 6: If the log type is invalid, throw an error
-        throw runtime_error("Invalid log type (use L, N, B)");
-    }
-    string getType() const override { return "Logarithm"; }
-};
-
-class CurrencyConverter : public Converter {
-private:
-    char fromCurrency, toCurrency;
-    static constexpr double INR_TO_USD = 0.012;
-    static constexpr double USD_TO_INR = 83.33;
-    static constexpr double USD_TO_EUR = 0.92;
-    static constexpr double USD_TO_GBP = 0.79;
-    static constexpr double EUR_TO_USD = 1.09;
-    static constexpr double GBP_TO_USD = 1.27;
-public:
-    CurrencyConverter(double amount, char from, char to)
-        : Converter(amount), fromCurrency(toupper(from)), toCurrency(toupper(to)) {}
-
-    double convert() const override {
-        // Step-by-step currency conversion process
-        // Step 1: Check if converting from INR to USD
-        if (fromCurrency == 'I' && toCurrency == 'U') {
-            // Step 2: Multiply the amount by the INR to USD rate
-            return value * INR_TO_USD;
-        }
-        // Step 3: Check if converting from USD to INR
-        if (fromCurrency == 'U' && toCurrency == 'I') {
-            // Step 4: Multiply the amount by the USD to INR rate
-            return value * USD_TO_INR;
-        }
-        // Step 5: Check if converting from USD to EUR
-        if (fromCurrency == 'U' && toCurrency == 'E') {
-            // Step 6: Multiply the amount by the USD to EUR rate
-            return value * USD_TO_EUR;
-        }
-        // Step 7: Check if converting from USD to GBP
-        if (fromCurrency == 'U' && toCurrency == 'G') {
-            // Step 8: Multiply the amount by the USD to GBP rate
-            return value * USD_TO_GBP;
-        }
-        // Step 9: Check if converting from EUR to USD
-        if (fromCurrency == 'E' && toCurrency == 'U') {
-            // Step 10: Multiply the amount by the EUR to USD rate
-            return value * EUR_TO_USD;
-        }
-        // Step 11: Check if converting from GBP to USD
-        if (fromCurrency == 'G' && toCurrency == 'U') {
-            // Step 12: Multiply the amount by the GBP to USD rate
-            return value * GBP_TO_USD;
-        }
-        // Step 13: If the currencies are the same, return the original value
-        if (fromCurrency == toCurrency) {
-            return value;
-        }
-        // Step 14: If the currency pair is invalid, throw an error
-        throw runtime_error("Invalid or unsupported currency (use I, U, E, G)");
-    }
-    string getType() const override { return "Currency"; }
-};
-
-class LengthConverter : public Converter {
-private:
-    char fromUnit, toUnit;
-    static constexpr double M_TO_FT = 3.28084;
-    static constexpr double FT_TO_M = 0.3048;
-public:
-    LengthConverter(double length, char from, char to)
-        : Converter(length), fromUnit(toupper(from)), toUnit(toupper(to)) {}
-
-    double convert() const override {
-        // Step-by-step length conversion process
-        // Step 1: Check if converting from meters to feet
-        if (fromUnit == 'M' && toUnit == 'F') {
-            // Step 2: Multiply the length by the meters to feet conversion factor
-            return value * M_TO_FT;
-        }
-        // Step 3: Check if converting from feet to meters
-        if (fromUnit == 'F' && toUnit == 'M') {
-            // Step 4: Multiply the length by the feet to meters conversion factor
-            return value * FT_TO_M;
-        }
-        // Step 5: If units are the same, return the original value
-        if (fromUnit == toUnit) {
-            return value;
-        }
-        // Step 6: If units are invalid, throw an error
-        throw runtime_error("Invalid length units (use M or F)");
-    }
-    string getType() const override { return "Length"; }
-};
-
-class Calculator {
-private:
-    double num1, num2;
-    char operation;
-public:
-    Calculator(double n1, char op, double n2 = 0.0) : num1(n1), num2(n2), operation(toupper(op)) {}
-
-    double calculate() const {
-        // Step-by-step calculation process based on the operation
-        switch (operation) {
-            case '+':
-                // Step 1: For addition, add num1 and num2
-                return num1 + num2;
-            case '-':
-                // Step 2: For subtraction, subtract num2 from num1
-                return num1 - num2;
-            case '*':
-                // Step 3: For multiplication, multiply num1 by num2
-                return num1 * num2;
-            case '/':
-                // Step 4: For division, check if num2 is zero
-                if (num2 == 0) {
-                    // Step 5: If num2 is zero, throw an error
-                    throw runtime_error("Division by zero");
-                }
-                // Step 6: Divide num1 by num2
-                return num1 / num2;
-            case '^':
-                // Step 7: For exponentiation, raise num1 to the power of num2
-                return pow(num1, num2);
-            case 'S':
-                // Step 8: For sine, convert num1 from degrees to radians
-                //         - Multiply num1 by π/180
-                // Step 9: Compute the sine of the angle
-                return sin(num1 * M_PI / 180.0);
-            case 'C':
-                // Step 10: For cosine, convert num1 from degrees to radians
-                //          - Multiply num1 by π/180
-                // Step 11: Compute the cosine of the angle
-                return cos(num1 * M_PI / 180.0);
-            case 'T':
-                // Step 12: For tangent, convert num1 from degrees to radians
-                //          - Multiply num1 by π/180
-                // Step 13: Check if cosine is zero (tan is undefined at 90°, 270°, etc.)
-                if (cos(num1 * M_PI / 180.0) == 0) {
-                    // Step 14: If cosine is zero, throw an error
-                    throw runtime_error("Tan undefined");
-                }
-                // Step 15: Compute the tangent of the angle
-                return tan(num1 * M_PI / 180.0);
-            default:
-                // Step 16: If the operation is invalid, throw an error
-                throw runtime_error("Invalid operation (use +, -, *, /, ^, S, C, T)");
-        }
-    }
-
-    void displayResult() const {
-        try {
-            const int COL_WIDTH = 15;
-            double result = calculate();
-            cout << fixed << setprecision(2);
-            ostringstream oss;
-            oss << fixed << setprecision(2) << num1 << " " << operation << (operation == 'S' || operation == 'C' || operation == 'T' ? "" : " " + to_string(num2));
-            string inputStr = oss.str();
-            oss.str(""); oss << fixed << setprecision(2) << result;
-            string resultStr = oss.str();
-
-            cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-            cout << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + "Input" + RESET_COLOR
-                 << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + inputStr + RESET_COLOR
-                 << "|" << setw(COL_WIDTH) << left << GREEN_COLOR + resultStr + RESET_COLOR << "|\n";
-            cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-        } catch (const runtime_error& e) {
-            const int COL_WIDTH = 45;
-            cout << "+" << string(COL_WIDTH, '-') << "+\n";
-            cout << "|" << setw(COL_WIDTH) << left << RED_COLOR + string("Error: ") + e.what() + RESET_COLOR << "|\n";
-            cout << "+" << string(COL_WIDTH, '-') << "+\n";
-        }
-    }
-};
-
-class Program {
-private:
-    vector<HistoryEntry> history;
-
-    void showWelcome() const {
-        const int COL_WIDTH = 40;
-        cout << "+" << string(COL_WIDTH, '-') << "+\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Welcome to the Professional Converter!" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Advanced conversion and calculation tool" + RESET_COLOR << "|\n";
-        cout << "+" << string(COL_WIDTH, '-') << "+\n";
-    }
-
-    void clearInputBuffer() const {
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    }
-
-    double getDoubleInput(const string& prompt) const {
-        double input;
-        cout << YELLOW_COLOR << prompt << RESET_COLOR;
-        while (!(cin >> input)) {
-            cout << RED_COLOR << "Invalid input. " << RESET_COLOR << YELLOW_COLOR << prompt << RESET_COLOR;
-            clearInputBuffer();
-        }
-        return input;
-    }
-
-    char getCharInput(const string& prompt) const {
-        char input;
-        cout << YELLOW_COLOR << prompt << RESET_COLOR;
-        cin >> input;
-        clearInputBuffer();
-        return input;
-    }
-
-    string getStringInput(const string& prompt) const {
-        string input;
-        cout << YELLOW_COLOR << prompt << RESET_COLOR;
-        cin >> input;
-        clearInputBuffer();
-        return input;
-    }
-
-    void displayMenu() const {
-        const int COL_WIDTH = 25;
-        cout << "\n+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Option" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Description" + RESET_COLOR << "|\n";
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "1" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Calculator" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "2" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Temperature (C/F)" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "3" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Number Base (B/D/O/H)" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "4" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Logarithm (L/N/B)" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "5" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Currency (I/U/E/G)" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "6" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Length (M/F)" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "7" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "View History" + RESET_COLOR << "|\n";
-        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "8" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Quit" + RESET_COLOR << "|\n";
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-    }
-
-    void displayHistory() const {
-        const int COL_WIDTH = 15;
-        if (history.empty()) {
-            cout << YELLOW_COLOR << "No history available." << RESET_COLOR << endl;
-            return;
-        }
-        cout << "\n+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-        cout << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + "Type" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + "Input" + RESET_COLOR
-             << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + "Result" + RESET_COLOR << "|\n";
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-        for (const auto& entry : history) {
-            cout << "|" << setw(COL_WIDTH) << left << entry.type
-                 << "|" << setw(COL_WIDTH) << left << entry.input
-                 << "|" << setw(COL_WIDTH) << left << GREEN_COLOR + entry.result + RESET_COLOR << "|\n";
-        }
-        cout << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
-    }
-
-public:
-    void run() {
-        showWelcome();
-
-        while (true) {
-            displayMenu();
-            int choice = static_cast<int>(getDoubleInput("Enter choice (1-8): "));
-            clearInputBuffer();
-
-            try {
-                switch (choice) {
-                    case 1: {
-                        double num1 = getDoubleInput("Enter first number: ");
-                        char op = getCharInput("Enter operation (+, -, *, /, ^, S(sin), C(cos), T(tan)): ");
-                        if (op != 'S' && op != 'C' && op != 'T') {
-                            double num2 = getDoubleInput("Enter second number: ");
-                            Calculator calc(num1, op, num2);
-                            calc.displayResult();
-                            ostringstream oss;
-                            oss << fixed << setprecision(2) << num1 << " " << op << " " << num2;
-                            string inputStr = oss.str();
-                            oss.str(""); oss << fixed << setprecision(2) << calc.calculate();
-                            history.emplace_back("Calculator", inputStr, oss.str());
-                        } else {
-                            Calculator calc(num1, op);
-                            calc.displayResult();
-                            ostringstream oss;
-                            oss << fixed << setprecision(2) << num1 << " " << op;
-                            string inputStr = oss.str();
-                            oss.str(""); oss << fixed << setprecision(2) << calc.calculate();
-                            history.emplace_back("Calculator", inputStr, oss.str());
-                        }
-                        break;
-                    }
-                    case 2: {
-                        double temp = getDoubleInput("Enter temperature: ");
-                        char from = getCharInput("Enter from unit (C or F): ");
-                        char to = getCharInput("Enter to unit (C or F): ");
-                        TemperatureConverter tempConv(temp, from, to);
-                        ostringstream oss;
-                        oss << fixed << setprecision(2) << temp;
-                        string inputStr = oss.str();
-                        tempConv.displayResult(inputStr, string(1, toupper(from)) + " to " + string(1, toupper(to)));
-                        oss.str(""); oss << fixed << setprecision(2) << tempConv.convert();
-                        history.emplace_back(tempConv.getType(), inputStr + " " + string(1, toupper(from)) + " to " + string(1, toupper(to)), oss.str());
-                        break;
-                    }
-                    case 3: {
-                        string number = getStringInput("Enter number: ");
-                        char from = getCharInput("Enter from base (B(binary), D(decimal), O(octal), H(hex)): ");
-                        char to = getCharInput("Enter to base (B, D, O, H): ");
-                        NumberBaseConverter baseConv(number, from, to);
-                        baseConv.displayResult(number, string(1, toupper(from)) + " to " + string(1, toupper(to)));
-                        history.emplace_back(baseConv.getType(), number + " " + string(1, toupper(from)) + " to " + string(1, toupper(to)), baseConv.getResultString());
-                        break;
-                    }
-                    case 4: {
-                        double num = getDoubleInput("Enter number: ");
-                        char type = getCharInput("Enter log type (L=log10, N=ln, B=log2): ");
-                        LogarithmicCalculator logCalc(num, type);
-                        ostringstream oss;
-                        oss << fixed << setprecision(2) << num;
-                        string inputStr = oss.str();
-                        string logStr = (type == 'L' ? "log10" : type == 'N' ? "ln" : "log2");
-                        logCalc.displayResult(inputStr, logStr);
-                        oss.str(""); oss << fixed << setprecision(2) << logCalc.convert();
-                        history.emplace_back(logCalc.getType(), logStr + "(" + inputStr + ")", oss.str());
-                        break;
-                    }
-                    case 5: {
-                        double amount = getDoubleInput("Enter amount: ");
-                        char from = getCharInput("Enter from currency (I, U, E, or G): ");
-                        char to = getCharInput("Enter to currency (I, U, E, or G): ");
-                        CurrencyConverter currConv(amount, from, to);
-                        ostringstream oss;
-                        oss << fixed << setprecision(2) << amount;
-                        string inputStr = oss.str();
-                        currConv.displayResult(inputStr, string(1, toupper(from)) + " to " + string(1, toupper(to)));
-                        oss.str(""); oss << fixed << setprecision(2) << currConv.convert();
-                        history.emplace_back(currConv.getType(), inputStr + " " + string(1, toupper(from)) + " to " + string(1, toupper(to)), oss.str());
-                        break;
-                    }
-                    case 6: {
-                        double length = getDoubleInput("Enter length: ");
-                        char from = getCharInput("Enter from unit (M or F): ");
-                        char to = getCharInput("Enter to unit (M or F): ");
-                        LengthConverter lenConv(length, from, to);
-                        ostringstream oss;
-                        oss << fixed << setprecision(2) << length;
-                        string inputStr = oss.str();
-                        lenConv.displayResult(inputStr, string(1, toupper(from)) + " to " + string(1, toupper(to)));
-                        oss.str(""); oss << fixed << setprecision(2) << lenConv.convert();
-                        history.emplace_back(lenConv.getType(), inputStr + " " + string(1, toupper(from)) + " to " + string(1, toupper(to)), oss.str());
-                        break;
-                    }
-                    case 7:
-                        displayHistory();
-                        break;
-                    case 8: {
-                        const int COL_WIDTH = 40;
-                        cout << "+" << string(COL_WIDTH, '-') << "+\n";
-                        cout << "|" << setw(COL_WIDTH) << left << CYAN_COLOR + "Thank you for using Professional Converter!" + RESET_COLOR << "|\n";
-                        cout << "+" << string(COL_WIDTH, '-') << "+\n";
-                        return;
-                    }
-                    default:
-                        const int COL_WIDTH = 40;
-                        cout << "+" << string(COL_WIDTH, '-') << "+\n";
-                        cout << "|" << setw(COL_WIDTH) << left << RED_COLOR + "Invalid choice. Please select 1-8." + RESET_COLOR << "|\n";
-                        cout << "+" << string(COL_WIDTH, '-') << "+\n";
-                }
-            } catch (const runtime_error& e) {
-                const int COL_WIDTH = 45;
-                cout << "+" << string(COL_WIDTH, '-') << "+\n";
-                cout << "|" << setw(COL_WIDTH) << left << RED_COLOR + string("Error: ") + e.what() + RESET_COLOR << "|\n";
-                cout << "+" << string(COL_WIDTH, '-') << "+\n";
-            }
-        }
-    }
-};
-
-int main() {
-    Program program;
-    program.run();
-    return 0;
-}
+#include "techneon/engine.hpp"
+#include "techneon/metrics.hpp"
+#include "techneon/format.hpp"
+#include "techneon/batch.hpp"
+#include "techneon/stats.hpp"
+#include "techneon/columns.hpp"
+#include "techneon/money.hpp"
+#include "techneon/sheet.hpp"
+#include "techneon/matrix.hpp"
+#include "techneon/solvers.hpp"
+#include "techneon/server.hpp"
+#include "techneon/history.hpp"
+#include "techneon/replay.hpp"
+#include <termios.h>
+#include <sys/ioctl.h>
+
+using namespace std;
+using namespace techneon;
+
+class Program {
+private:
+    using ResultTable = TableLayout<15, 15, 15>;
+    using MenuTable = TableLayout<25, 25>;
+    using BannerTable = TableLayout<40>;
+    using ErrorTable = TableLayout<45>;
+    using StatsTable = TableLayout<20, 12, 10, 10, 10, 10, 8>;
+    using SheetTable = TableLayout<15, 30, 15>;
+    using MatrixTable = TableLayout<15, 15, 15>;
+    using HistoryTable = TableLayout<12, 15, 15, 15>;
+
+    HistoryStore history;
+    unique_ptr<Sheet> sheet;   // created the first time the sheet is opened
+    unique_ptr<MatrixSession> matrices;   // likewise for matrix mode
+    unique_ptr<AdaptiveIntegrator> integrator;   // and its thread pool for the solvers
+    int64_t computeStarted = 0, computeFinished = 0;   // the last menu computation, for --trace
+    // Tables and result lines are built here and flushed once per screen; prompts still use cout,
+    // which writes through the same stdout buffer
+    BufferedWriter out{stdout, 1 << 16};
+
+    void showWelcome() {
+        BannerTable::rule(out);
+        BannerTable::row(out, {CYAN_COLOR, "Welcome to the Professional Converter!"});
+        BannerTable::row(out, {CYAN_COLOR, "Advanced conversion and calculation tool"});
+        BannerTable::rule(out);
+        out.flush();
+    }
+
+    void clearInputBuffer() const {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+
+    // Reads one whole field, so "12abc" is rejected instead of leaving "abc" for the next prompt
+    double getDoubleInput(const string& prompt) const {
+        string token;
+        double input = 0.0;
+        cout << YELLOW_COLOR << prompt << RESET_COLOR;
+        while (!(cin >> token) || NumberParser::parseDouble(token, input) != ParseStatus::Ok) {
+            cout << RED_COLOR << "Invalid input. " << RESET_COLOR << YELLOW_COLOR << prompt << RESET_COLOR;
+            clearInputBuffer();
+        }
+        return input;
+    }
+
+    char getCharInput(const string& prompt) const {
+        char input;
+        cout << YELLOW_COLOR << prompt << RESET_COLOR;
+        cin >> input;
+        clearInputBuffer();
+        return input;
+    }
+
+    string getLineInput(const string& prompt) const {
+        string input;
+        cout << YELLOW_COLOR << prompt << RESET_COLOR;
+        getline(cin, input);
+        return input;
+    }
+
+    static TextBuffer<8> codePair(char from, char to) {
+        TextBuffer<8> codes;
+        codes.append(from).append(" to ").append(to);
+        return codes;
+    }
+
+    // One result: a table with caption, detail and result, or a line in the --format style.
+    // Number base results are the digits; every other result is record.result.
+    void showResult(const HistoryRecord& record, string_view caption, string_view detail, string_view digits = {}) {
+        Metrics::Span span(Metrics::Phase::Display, record.operation());
+        bool numeric = record.kind != OpKind::NumberBase;
+        if (OutputFormat::style() == OutputFormat::Style::Plain) {
+            TextBuffer<320> number;
+            ResultTable::rule(out);
+            ResultTable::row(out, {BLUE_COLOR, caption}, {BLUE_COLOR, detail},
+                             {GREEN_COLOR, numeric ? number.appendFixed(record.result).view() : digits});
+            ResultTable::rule(out);
+        } else {
+            HistoryRecord::Text input;
+            record.formatInput(input);
+            if (numeric) OutputFormat::result(out, HistoryRecord::typeName(record.kind), input, record.result);
+            else OutputFormat::result(out, HistoryRecord::typeName(record.kind), input, digits);
+            out.put('\n');
+        }
+        out.flush();
+    }
+
+    // Runs a menu computation under a metrics span, noting when it ran for the trace
+    template <typename Fn>
+    double measured(OpKind kind, int from, int to, Fn&& compute) {
+        Metrics::Span span(Metrics::Phase::Compute, kind, from, to);
+        if (!TraceCapture::active()) return compute();
+        computeStarted = TraceCapture::monotonic();
+        double result = compute();
+        computeFinished = TraceCapture::monotonic();
+        return result;
+    }
+
+    // Adds a finished operation to the history and, with --trace, to the capture. The record's label
+    // may be shortened, so text inputs are passed whole; digits is the result of a number base
+    // conversion and values the variables of an expression.
+    void remember(const HistoryRecord& record, string_view text = {}, string_view digits = {}, size_t values = 0) {
+        history.append(record);
+        if (!TraceCapture::active() || values > 2) return;   // only two variable values fit a trace entry
+        Operation op = record.operation();
+        op.text = text;
+        OperationResult result;
+        result.isText = record.kind == OpKind::NumberBase;
+        result.number = record.result;
+        result.text = digits;
+        if (record.kind == OpKind::Expression) op.op = static_cast<char>(values);
+        TraceCapture::record(computeStarted, op, result, computeFinished);
+    }
+
+    void showError(string_view message) {
+        if (OutputFormat::style() == OutputFormat::Style::Plain) {
+            TextBuffer<512> text;
+            text.append("Error: ").append(message);
+            ErrorTable::rule(out);
+            ErrorTable::row(out, {RED_COLOR, text});
+            ErrorTable::rule(out);
+        } else {
+            OutputFormat::error(out, {}, {}, message);
+            out.put('\n');
+        }
+        out.flush();
+    }
+
+    void showBanner(const string& color, string_view text) {
+        BannerTable::rule(out);
+        BannerTable::row(out, {color, text});
+        BannerTable::rule(out);
+        out.flush();
+    }
+
+    void displayUnitList() const {
+        const UnitRegistry& registry = UnitRegistry::instance();
+        for (const string& dimension : registry.dimensionNames()) {
+            cout << CYAN_COLOR << setw(12) << left << dimension << RESET_COLOR << registry.unitsOf(dimension) << "\n";
+        }
+    }
+
+    string getStringInput(const string& prompt) const {
+        string input;
+        cout << YELLOW_COLOR << prompt << RESET_COLOR;
+        cin >> input;
+        clearInputBuffer();
+        return input;
+    }
+
+    void displayMenu() {
+        static constexpr const char* OPTIONS[][2] = {
+            {"1", "Calculator"}, {"2", "Temperature (C/F)"}, {"3", "Number Base (B/D/O/H)"},
+            {"4", "Logarithm (L/N/B)"}, {"5", "Currency (I/U/E/G)"}, {"6", "Length (M/F)"},
+            {"7", "Expression"}, {"8", "Units (any)"}, {"9", "View History"}, {"10", "Statistics"},
+            {"11", "Sheet"}, {"12", "Matrix"}, {"13", "Solve / integrate"}, {"14", "Quit"}};
+        out.put('\n');
+        MenuTable::rule(out);
+        MenuTable::row(out, {CYAN_COLOR, "Option"}, {CYAN_COLOR, "Description"});
+        MenuTable::rule(out);
+        for (const auto& option : OPTIONS) {
+            MenuTable::row(out, {CYAN_COLOR, option[0]}, {CYAN_COLOR, option[1]});
+        }
+        MenuTable::rule(out);
+        out.flush();
+    }
+
+    // Latency per operation phase, kind and unit pair since the session started, in microseconds
+    void displayStatistics() {
+        if (!Metrics::enabled()) {
+            showBanner(YELLOW_COLOR, "Statistics off; start with --metrics");
+            return;
+        }
+        vector<Metrics::Summary> series = Metrics::snapshot();
+        if (series.empty()) {
+            showBanner(YELLOW_COLOR, "Nothing measured yet.");
+            return;
+        }
+        out.put('\n');
+        StatsTable::rule(out);
+        StatsTable::row(out, {BLUE_COLOR, "Operation"}, {BLUE_COLOR, "Pair"}, {BLUE_COLOR, "Count"}, {BLUE_COLOR, "p50 us"},
+                        {BLUE_COLOR, "p99 us"}, {BLUE_COLOR, "Max us"}, {BLUE_COLOR, "Errors"});
+        StatsTable::rule(out);
+        for (const Metrics::Summary& s : series) {
+            TextBuffer<64> name, count, p50, p99, peak, errors;
+            name.append(Metrics::phaseName(s.phase)).append(' ').append(opKindName(s.kind));
+            StatsTable::row(out, {{}, name}, {{}, s.pair}, {{}, count.appendInt(static_cast<long long>(s.count))},
+                            {GREEN_COLOR, p50.appendFixed(s.quantile(0.5) / 1e3)}, {GREEN_COLOR, p99.appendFixed(s.quantile(0.99) / 1e3)},
+                            {GREEN_COLOR, peak.appendFixed(s.peak / 1e3)},
+                            {s.errors ? RED_COLOR : string_view(), errors.appendInt(static_cast<long long>(s.errors))});
+        }
+        StatsTable::rule(out);
+        out.flush();
+    }
+
+    // Keys of the history view. On a terminal they are read one at a time in raw mode; from a pipe,
+    // one command per line ("t calc", "g 1200"), and an empty line or the end of input goes back.
+    enum class Key { None, Older, Newer, PageOlder, PageNewer, Oldest, Newest, Type, Range, All, Jump, Quit };
+
+    static Key keyOf(string_view text) {
+        static constexpr pair<string_view, Key> KEYS[] = {
+            {"\x1b[A", Key::Older}, {"\x1b[B", Key::Newer}, {"\x1b[5~", Key::PageOlder}, {"\x1b[6~", Key::PageNewer},
+            {"\x1b[H", Key::Oldest}, {"\x1b[1~", Key::Oldest}, {"\x1bOH", Key::Oldest}, {"\x1b[F", Key::Newest},
+            {"\x1b[4~", Key::Newest}, {"\x1bOF", Key::Newest}, {"\x1b", Key::Quit}, {"k", Key::Older}, {"j", Key::Newer},
+            {"b", Key::PageOlder}, {"f", Key::PageNewer}, {" ", Key::PageNewer}, {"<", Key::Oldest}, {">", Key::Newest},
+            {"t", Key::Type}, {"r", Key::Range}, {"a", Key::All}, {"g", Key::Jump}, {"#", Key::Jump}, {"q", Key::Quit}};
+        for (auto [name, key] : KEYS) {
+            if (text == name) return key;
+        }
+        return Key::None;
+    }
+
+    // One key, with the terminal in raw mode just for the read; argument gets the rest of a piped line
+    Key readKey(bool terminal, string& argument) const {
+        argument.clear();
+        if (terminal) {
+            termios saved, raw;
+            tcgetattr(STDIN_FILENO, &saved);
+            raw = saved;
+            raw.c_lflag &= ~(ICANON | ECHO);
+            raw.c_cc[VMIN] = 1;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+            char bytes[8];
+            ssize_t got = read(STDIN_FILENO, bytes, sizeof(bytes));
+            tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+            if (got <= 0) return Key::Quit;
+            return keyOf(string_view(bytes, static_cast<size_t>(got)));
+        }
+        string line;
+        if (!getline(cin, line)) return Key::Quit;
+        size_t first = line.find_first_not_of(" \t");
+        if (first == string::npos) return Key::Quit;
+        size_t split = line.find_first_of(" \t", first);
+        if (split != string::npos) {
+            size_t rest = line.find_first_not_of(" \t", split);
+            if (rest != string::npos) argument = line.substr(rest);
+        }
+        return keyOf(string_view(line).substr(first, split == string::npos ? string::npos : split - first));
+    }
+
+    // The argument of a piped command, or a prompt for it on a terminal
+    string commandArgument(const string& argument, const string& prompt) const {
+        return argument.empty() ? getLineInput(prompt) : argument;
+    }
+
+    static OpKind historyType(const string& name) {
+        for (int k = 0; k <= static_cast<int>(OpKind::Unit); ++k) {
+            string candidate = HistoryRecord::typeName(static_cast<OpKind>(k));
+            if (candidate.size() >= name.size() && !name.empty() &&
+                equal(name.begin(), name.end(), candidate.begin(), [](char x, char y) { return tolower(x) == tolower(y); })) {
+                return static_cast<OpKind>(k);
+            }
+        }
+        throw runtime_error("Unknown history type '" + name + "'");
+    }
+
+    // One frame: the visible rows only, formatted into the buffer and written with one flush
+    void drawHistory(const HistoryCursor& cursor, bool terminal, string_view notice) {
+        if (terminal) out.write("\x1b[H\x1b[2J");
+        const HistoryStore::Query& q = cursor.query();
+        TextBuffer<160> title;
+        title.append("History: ").appendInt(static_cast<long long>(history.size())).append(" operations");
+        if (!q.anyKind) title.append(", type ").append(HistoryRecord::typeName(q.kind));
+        if (q.fromTime != numeric_limits<int64_t>::min()) title.append(", time range");
+        out.write(CYAN_COLOR);
+        out.write(title.view());
+        out.write(RESET_COLOR);
+        out.put('\n');
+        HistoryTable::rule(out);
+        HistoryTable::row(out, {BLUE_COLOR, "#"}, {BLUE_COLOR, "Type"}, {BLUE_COLOR, "Input"}, {BLUE_COLOR, "Result"});
+        HistoryTable::rule(out);
+        for (const HistoryStore::Entry& entry : cursor.entries()) {
+            TextBuffer<24> index;
+            HistoryRecord::Text input;
+            entry.record.formatInput(input);
+            string result = entry.record.resultText();
+            HistoryTable::row(out, {{}, index.appendInt(static_cast<long long>(entry.index))},
+                              {{}, HistoryRecord::typeName(entry.record.kind)}, {{}, input}, {GREEN_COLOR, result});
+        }
+        if (cursor.entries().empty()) HistoryTable::row(out, {}, {YELLOW_COLOR, "No matches."}, {}, {});
+        HistoryTable::rule(out);
+        if (!notice.empty()) {
+            out.write(RED_COLOR);
+            out.write(notice);
+            out.write(RESET_COLOR);
+            out.put('\n');
+        }
+        out.write(YELLOW_COLOR);
+        out.write(terminal ? "Up/Down row, PgUp/PgDn page, Home/End, t type, r range, a all, g go to #, q back"
+                           : "k/j row, b/f page, < >, t type, r range, a all, g #, empty line back");
+        out.write(RESET_COLOR);
+        out.put('\n');
+        out.flush();
+    }
+
+    // Paged view of the history. Only the rows on screen are read and formatted, so it opens and
+    // moves in about the same time with a hundred records or a hundred million.
+    void displayHistory() {
+        if (history.empty()) {
+            cout << YELLOW_COLOR << "No history available." << RESET_COLOR << endl;
+            return;
+        }
+        bool terminal = isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+        size_t rows = 20;
+        winsize window;
+        if (terminal && ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_row > 12) rows = window.ws_row - 8;
+        HistoryCursor cursor(history, rows);
+        string notice, argument;
+        while (true) {
+            drawHistory(cursor, terminal, notice);
+            notice.clear();
+            Key key = readKey(terminal, argument);
+            try {
+                switch (key) {
+                    case Key::Quit: return;
+                    case Key::None: notice = "Unknown key"; break;
+                    case Key::Older: cursor.older(1); break;
+                    case Key::Newer: cursor.newer(1); break;
+                    case Key::PageOlder: cursor.older(cursor.pageRows()); break;
+                    case Key::PageNewer: cursor.newer(cursor.pageRows()); break;
+                    case Key::Oldest: cursor.oldest(); break;
+                    case Key::Newest: cursor.newest(); break;
+                    case Key::All: cursor.select(HistoryStore::Query()); break;
+                    case Key::Type: {
+                        HistoryStore::Query q;
+                        q.anyKind = false;
+                        q.kind = historyType(commandArgument(argument, "Type (Calculator, Temperature, Number Base, Logarithm, "
+                                                                       "Currency, Length, Expression, Radix, Unit): "));
+                        cursor.select(q);
+                        break;
+                    }
+                    case Key::Range: {
+                        // "r 30 5": from 30 to 5 minutes ago
+                        istringstream fields(commandArgument(argument, "From and to how many minutes ago (e.g. 30 5): "));
+                        double from, to;
+                        if (!(fields >> from >> to)) throw runtime_error("Expected two numbers of minutes");
+                        int64_t now = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+                        HistoryStore::Query q = cursor.query();
+                        q.fromTime = now - static_cast<int64_t>(max(from, to) * 60e6);
+                        q.toTime = now - static_cast<int64_t>(min(from, to) * 60e6);
+                        cursor.select(q);
+                        break;
+                    }
+                    case Key::Jump: {
+                        string text = commandArgument(argument, "Go to entry #: ");
+                        double index;
+                        if (NumberParser::parseDouble(text, index) != ParseStatus::Ok || index < 0) throw runtime_error("Invalid entry number " + text);
+                        cursor.jump(static_cast<uint64_t>(index));
+                        break;
+                    }
+                }
+            } catch (const runtime_error& e) {
+                notice = e.what();
+            }
+        }
+    }
+
+    void displaySheet() {
+        bool any = false;
+        out.put('\n');
+        SheetTable::rule(out);
+        SheetTable::row(out, {BLUE_COLOR, "Name"}, {BLUE_COLOR, "Definition"}, {BLUE_COLOR, "Value"});
+        SheetTable::rule(out);
+        sheet->forEach([&](int id) {
+            TextBuffer<320> value;
+            bool ok = sheet->state(id) == Sheet::State::Value;
+            if (ok) value.appendFixed(sheet->value(id));
+            else value.append(sheet->state(id) == Sheet::State::Undefined ? "undefined" : "#error");
+            SheetTable::row(out, {{}, sheet->name(id)}, {{}, sheet->definition(id)}, {ok ? GREEN_COLOR : RED_COLOR, value});
+            any = true;
+        });
+        SheetTable::rule(out);
+        out.flush();
+        if (!any) showBanner(YELLOW_COLOR, "The sheet is empty.");
+    }
+
+    // One line per edit: "name = 42", "name = 2 * rate + 1" or "name = temp base C F". Cells that
+    // depend on the edited one are brought up to date before the next prompt.
+    void runSheet() {
+        if (!sheet) sheet = make_unique<Sheet>();
+        cout << CYAN_COLOR << "name = number, formula or operation line; 'show' lists cells, 'del name' removes one, "
+             << "an empty line goes back." << RESET_COLOR << "\n";
+        while (true) {
+            string line = getLineInput("sheet> ");
+            size_t first = line.find_first_not_of(" \t");
+            if (!cin || first == string::npos) return;
+            line.erase(0, first);
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            try {
+                if (line == "show") {
+                    displaySheet();
+                    continue;
+                }
+                string name;
+                if (line.compare(0, 4, "del ") == 0) {
+                    name = line.substr(line.find_first_not_of(" \t", 4));
+                    sheet->erase(name);
+                } else {
+                    size_t equals = line.find('=');
+                    if (equals == string::npos) throw runtime_error("Expected name = value, formula or operation");
+                    name = line.substr(0, equals);
+                    name.erase(name.find_last_not_of(" \t") + 1);
+                    sheet->assign(name, string_view(line).substr(equals + 1));
+                }
+                int id = sheet->find(name);
+                TextBuffer<512> text;
+                text.append(name).append(" = ");
+                if (sheet->state(id) == Sheet::State::Value) text.appendFixed(sheet->value(id));
+                else text.append(sheet->error(id));
+                const Sheet::UpdateStats& update = sheet->lastUpdate();
+                TextBuffer<128> detail;
+                detail.appendInt(static_cast<long long>(update.recomputed)).append(" of ")
+                      .appendInt(static_cast<long long>(update.affected)).append(" cells recomputed in ")
+                      .appendFixed(update.seconds * 1e3).append(" ms");
+                showBanner(sheet->state(id) == Sheet::State::Value ? GREEN_COLOR : RED_COLOR, text);
+                cout << CYAN_COLOR << detail.view() << RESET_COLOR << "\n";
+            } catch (const runtime_error& e) {
+                showError(e.what());
+            }
+        }
+    }
+
+    // The top-left corner of a matrix, at most 8 x 8, in the two-decimal style of the result tables
+    void displayMatrix(const string& name, const Matrix& m, double seconds) {
+        static constexpr size_t SHOWN = 8;
+        TextBuffer<128> title;
+        title.append(name).append(" = ").appendInt(static_cast<long long>(m.rows)).append(" x ").appendInt(static_cast<long long>(m.cols));
+        TextBuffer<64> time;
+        time.appendFixed(seconds * 1e3).append(" ms");
+        MatrixTable::rule(out);
+        MatrixTable::row(out, {BLUE_COLOR, "Matrix"}, {BLUE_COLOR, title}, {BLUE_COLOR, time});
+        MatrixTable::rule(out);
+        for (size_t r = 0; r < min(m.rows, SHOWN); ++r) {
+            TextBuffer<320> line;
+            line.append("  ");
+            for (size_t c = 0; c < min(m.cols, SHOWN); ++c) {
+                TextBuffer<64> value;
+                value.appendFixed(m.at(r, c));
+                for (size_t pad = value.view().size(); pad < 12; ++pad) line.append(' ');
+                line.append(value.view());
+            }
+            if (m.cols > SHOWN) line.append("  ...");
+            out.write(GREEN_COLOR);
+            out.write(line.view());
+            out.write(RESET_COLOR);
+            out.put('\n');
+        }
+        if (m.rows > SHOWN) out.write("  ...\n");
+        out.flush();
+    }
+
+    // One statement per line: "c = a @ b", "x = solve(a, [1; 2])" or a bare expression
+    void runMatrix() {
+        if (!matrices) matrices = make_unique<MatrixSession>();
+        cout << CYAN_COLOR << "name = expression over [1 2; 3 4] literals; @ multiplies matrices, + - * / ^ work elementwise, "
+             << "dot, transpose (or '), solve, eye, zeros, ones, rand, sin, cos, tan; 'show' lists matrices, 'del name' "
+             << "removes one, an empty line goes back." << RESET_COLOR << "\n";
+        while (true) {
+            string line = getLineInput("matrix> ");
+            size_t first = line.find_first_not_of(" \t");
+            if (!cin || first == string::npos) return;
+            line.erase(0, first);
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            try {
+                if (line == "show") {
+                    bool any = false;
+                    matrices->forEach([&](const string& name, const Matrix& m) {
+                        cout << CYAN_COLOR << setw(16) << left << name << RESET_COLOR << m.rows << " x " << m.cols << "\n";
+                        any = true;
+                    });
+                    if (!any) showBanner(YELLOW_COLOR, "No matrices yet.");
+                    continue;
+                }
+                if (line.compare(0, 4, "del ") == 0) {
+                    matrices->erase(line.substr(line.find_first_not_of(" \t", 4)));
+                    continue;
+                }
+                MatrixSession::Result result = matrices->run(line);
+                displayMatrix(result.name, result.value, result.seconds);
+            } catch (const runtime_error& e) {
+                showError(e.what());
+            }
+        }
+    }
+
+    // Roots (bracketed or from a starting point) and integrals of a one-variable expression, with the
+    // evaluation count and time so the tolerance can be traded against speed
+    void runSolver() {
+        string text = getLineInput("Enter expression in x (e.g. x^3 - 2*x - 5): ");
+        char method = static_cast<char>(toupper(getCharInput("Root in [a, b] (R), Newton from x0 (N) or Integral (I): ")));
+        if (method != 'R' && method != 'N' && method != 'I') throw runtime_error("Expected R, N or I");
+        double a = getDoubleInput(method == 'N' ? "Enter x0: " : "Enter a: ");
+        double b = method == 'N' ? 0.0 : getDoubleInput("Enter b: ");
+        double tolerance = getDoubleInput("Enter tolerance (e.g. 1e-10): ");
+        clearInputBuffer();
+
+        TextBuffer<128> answer, detail;
+        size_t evaluations;
+        double seconds;
+        bool converged;
+        if (method == 'I') {
+            if (!integrator) integrator = make_unique<AdaptiveIntegrator>();
+            AdaptiveIntegrator::Result result = integrator->integrate(text, a, b, tolerance, tolerance);
+            answer.append("Integral = ").appendGeneral(result.integral);
+            detail.append("error estimate ").appendGeneral(result.error, 3).append(", ")
+                  .appendInt(static_cast<long long>(result.pieces)).append(" pieces in ")
+                  .appendInt(static_cast<long long>(result.rounds)).append(" rounds, ");
+            evaluations = result.evaluations, seconds = result.seconds, converged = result.converged;
+        } else {
+            RootFinder finder(text, tolerance);
+            RootFinder::Result result = method == 'R' ? finder.brent(a, b) : finder.newton(a);
+            answer.append("Root = ").appendGeneral(result.root);
+            detail.append(result.method).append(", ").appendInt(static_cast<long long>(result.iterations)).append(" iterations, ");
+            evaluations = result.evaluations, seconds = result.seconds, converged = result.converged;
+        }
+        detail.appendInt(static_cast<long long>(evaluations)).append(" evaluations in ").appendFixed(seconds * 1e3).append(" ms");
+        showBanner(converged ? GREEN_COLOR : YELLOW_COLOR, answer);
+        cout << CYAN_COLOR << detail.view() << (converged ? "" : " (tolerance not reached)") << RESET_COLOR << "\n";
+    }
+
+public:
+    explicit Program(const string& historyLog = "") : history(4096, historyLog) {}
+
+    void run() {
+        showWelcome();
+        OutputFormat::header(out);
+
+        while (true) {
+            displayMenu();
+            // Out-of-range and non-finite entries would overflow the cast; they fall to the default case instead
+            double entered = getDoubleInput("Enter choice (1-14): ");
+            int choice = isfinite(entered) && entered >= 1 && entered < 15 ? static_cast<int>(entered) : 0;
+            clearInputBuffer();
+
+            // Each case computes its result once, into the history record that is shown and stored
+            try {
+                switch (choice) {
+                    case 1: {
+                        double num1 = getDoubleInput("Enter first number: ");
+                        char op = getCharInput("Enter operation (+, -, *, /, ^, S(sin), C(cos), T(tan)): ");
+                        double num2 = 0.0;
+                        if (op != 'S' && op != 'C' && op != 'T') {
+                            num2 = getDoubleInput("Enter second number: ");
+                        }
+                        HistoryRecord record = HistoryRecord::make(OpKind::Calculator, num1, num2, measured(OpKind::Calculator, toupper(op), 0, [&] {
+                            return Calculator(num1, op, num2).calculate();
+                        }));
+                        record.op = op;
+                        HistoryRecord::Text input;
+                        record.formatInput(input);
+                        showResult(record, "Input", input);
+                        remember(record);
+                        break;
+                    }
+                    case 2: {
+                        double temp = getDoubleInput("Enter temperature: ");
+                        char from = getCharInput("Enter from unit (C or F): ");
+                        char to = getCharInput("Enter to unit (C or F): ");
+                        HistoryRecord record = HistoryRecord::make(OpKind::Temperature, temp, 0.0, measured(OpKind::Temperature, toupper(from), toupper(to), [&] {
+                            return TemperatureConverter(temp, from, to).convert();
+                        }));
+                        record.from = toupper(from);
+                        record.to = toupper(to);
+                        showResult(record, "Input", codePair(record.from, record.to));
+                        remember(record);
+                        break;
+                    }
+                    case 3: {
+                        string number = getStringInput("Enter number: ");
+                        char from = getCharInput("Enter from base (B(binary), D(decimal), O(octal), H(hex)): ");
+                        char to = getCharInput("Enter to base (B, D, O, H): ");
+                        string digits;
+                        double value = measured(OpKind::NumberBase, toupper(from), toupper(to), [&] {
+                            NumberBaseConverter baseConv(number, from, to);
+                            digits = baseConv.getResultString();
+                            return baseConv.convert();
+                        });
+                        HistoryRecord record = HistoryRecord::make(OpKind::NumberBase, value, 0.0, value);
+                        record.from = toupper(from);
+                        record.to = toupper(to);
+                        record.setLabel(number);
+                        showResult(record, "Input", codePair(record.from, record.to), digits);
+                        remember(record, number, digits);
+                        break;
+                    }
+                    case 4: {
+                        double num = getDoubleInput("Enter number: ");
+                        char type = getCharInput("Enter log type (L=log10, N=ln, B=log2): ");
+                        HistoryRecord record = HistoryRecord::make(OpKind::Logarithm, num, 0.0, measured(OpKind::Logarithm, toupper(type), 0, [&] {
+                            return LogarithmicCalculator(num, type).convert();
+                        }));
+                        record.op = toupper(type);
+                        showResult(record, "Input", record.op == 'L' ? "log10" : record.op == 'N' ? "ln" : "log2");
+                        remember(record);
+                        break;
+                    }
+                    case 5: {
+                        double amount = getDoubleInput("Enter amount: ");
+                        string from = getStringInput("Enter from currency (I, U, E, G or ISO code): ");
+                        string to = getStringInput("Enter to currency (I, U, E, G or ISO code): ");
+                        for (char& c : from) c = toupper(c);
+                        for (char& c : to) c = toupper(c);
+                        int fromKey = RateTable::currencyKey(from), toKey = RateTable::currencyKey(to);
+                        HistoryRecord record = HistoryRecord::make(OpKind::Currency, amount, 0.0, measured(OpKind::Currency, fromKey, toKey, [&] {
+                            return CurrencyConverter(amount, from, to).convert();
+                        }));
+                        record.fromUnit = static_cast<int16_t>(fromKey);
+                        record.toUnit = static_cast<int16_t>(toKey);
+                        TextBuffer<64> pair;
+                        pair.append(from).append(" to ").append(to);
+                        showResult(record, "Input", pair);
+                        remember(record);
+                        break;
+                    }
+                    case 6: {
+                        double length = getDoubleInput("Enter length: ");
+                        char from = getCharInput("Enter from unit (M or F): ");
+                        char to = getCharInput("Enter to unit (M or F): ");
+                        HistoryRecord record = HistoryRecord::make(OpKind::Length, length, 0.0, measured(OpKind::Length, toupper(from), toupper(to), [&] {
+                            return LengthConverter(length, from, to).convert();
+                        }));
+                        record.from = toupper(from);
+                        record.to = toupper(to);
+                        showResult(record, "Input", codePair(record.from, record.to));
+                        remember(record);
+                        break;
+                    }
+                    case 7: {
+                        string text = getLineInput("Enter expression (e.g. 2*x^2 + sin(30)): ");
+                        CompiledExpression expression(text);
+                        vector<double> values;
+                        for (const string& name : expression.variables()) {
+                            values.push_back(getDoubleInput("Enter value for " + name + ": "));
+                        }
+                        if (!values.empty()) clearInputBuffer();
+                        HistoryRecord record = HistoryRecord::make(OpKind::Expression, values.empty() ? 0.0 : values[0],
+                                                                   values.size() > 1 ? values[1] : 0.0,
+                                                                   measured(OpKind::Expression, 0, 0, [&] { return expression.evaluate(values); }));
+                        record.setLabel(text);
+                        showResult(record, "Expression", text);
+                        remember(record, text, {}, values.size());
+                        break;
+                    }
+                    case 8: {
+                        double amount = getDoubleInput("Enter value: ");
+                        string from = getStringInput("Enter from unit (e.g. km, lb, psi, kWh, GiB; ? lists all): ");
+                        if (from == "?") {
+                            displayUnitList();
+                            from = getStringInput("Enter from unit: ");
+                        }
+                        string to = getStringInput("Enter to unit: ");
+                        int fromId = UnitRegistry::instance().find(from), toId = UnitRegistry::instance().find(to);
+                        string info;
+                        HistoryRecord record = HistoryRecord::make(OpKind::Unit, amount, 0.0, measured(OpKind::Unit, fromId, toId, [&] {
+                            UnitConverter unitConv(amount, from, to);
+                            info = unitConv.getUnitInfo();
+                            return unitConv.convert();
+                        }));
+                        record.fromUnit = static_cast<int16_t>(fromId);
+                        record.toUnit = static_cast<int16_t>(toId);
+                        showResult(record, "Input", info);
+                        remember(record);
+                        break;
+                    }
+                    case 9:
+                        displayHistory();
+                        break;
+                    case 10:
+                        displayStatistics();
+                        break;
+                    case 11:
+                        runSheet();
+                        break;
+                    case 12:
+                        runMatrix();
+                        break;
+                    case 13:
+                        runSolver();
+                        break;
+                    case 14:
+                        showBanner(CYAN_COLOR, "Thank you for using Professional Converter!");
+                        return;
+                    default:
+                        showBanner(RED_COLOR, "Invalid choice. Please select 1-14.");
+                }
+            } catch (const runtime_error& e) {
+                showError(e.what());
+            }
+        }
+    }
+};
+
+// The value after the option at args[i], which i then points at
+static const string& optionValue(const vector<string>& args, size_t& i) {
+    if (i + 1 >= args.size()) throw runtime_error("Missing value for " + args[i]);
+    return args[++i];
+}
+
+static void warnTruncated(const TraceFile& trace) {
+    if (trace.droppedBytes() == 0) return;
+    cerr << YELLOW_COLOR << "Trace ends in a partial entry: kept " << trace.size() << " entries, dropped the last "
+         << trace.droppedBytes() << " bytes" << RESET_COLOR << endl;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    string historyLog;
+    try {
+        // Global options: --rates <file> loads a binary rate table and reloads it whenever it changes,
+        // --history-log <file> keeps the spilled session history in a named file,
+        // --cache <entries> memoizes pow, logarithm and number base results,
+        // --fast-math <1ulp|4ulp|relaxed> switches trig and logarithms to the fast kernels,
+        // --format <plain|json|csv> selects how results are written (menu and batch),
+        // --metrics <file> times every operation and writes the latencies there (.json or Prometheus text),
+        // --trace <file> captures every operation (menu, batch, sheet or server) for --replay
+        static constexpr string_view GLOBAL_OPTIONS[] = {"--rates", "--cache", "--format", "--fast-math", "--metrics", "--trace",
+                                                         "--history-log"};
+        for (size_t i = 0; i < args.size();) {
+            if (find(begin(GLOBAL_OPTIONS), end(GLOBAL_OPTIONS), args[i]) == end(GLOBAL_OPTIONS)) {
+                ++i;
+                continue;
+            }
+            size_t at = i;
+            string option = args[i], value = optionValue(args, i);
+            args.erase(args.begin() + at, args.begin() + at + 2);
+            i = at;
+            if (option == "--rates") {
+                CurrencyRates::instance().watch(value, chrono::milliseconds(500));
+            } else if (option == "--cache") {
+                ResultCache::enable(max<size_t>(strtoull(value.c_str(), nullptr, 10), 1));
+            } else if (option == "--format") {
+                OutputFormat::select(OutputFormat::parse(value));
+            } else if (option == "--fast-math") {
+                FastMath::enable(FastMath::parseAccuracy(value));
+            } else if (option == "--metrics") {
+                Metrics::enable();
+                Metrics::reportPath() = value;
+            } else if (option == "--trace") {
+                TraceCapture::start(value);
+            } else {
+                historyLog = value;
+            }
+        }
+        string mode = args.empty() ? "" : args[0];
+        if (mode == "--batch") {
+            // --batch [file|-] [--threads N] [--errors report.tsv]
+            size_t threads = 1;
+            string path = "-", errorPath;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "--threads") {
+                    threads = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                } else if (args[i] == "--errors") {
+                    errorPath = optionValue(args, i);
+                } else {
+                    path = args[i];
+                }
+            }
+            FILE* in = stdin;
+            if (path != "-") {
+                in = fopen(path.c_str(), "rb");
+                if (!in) {
+                    cerr << RED_COLOR << "Cannot open " << path << RESET_COLOR << endl;
+                    return 1;
+                }
+            }
+            FILE* errors = nullptr;
+            if (!errorPath.empty() && !(errors = fopen(errorPath.c_str(), "wb"))) {
+                cerr << RED_COLOR << "Cannot create " << errorPath << RESET_COLOR << endl;
+                return 1;
+            }
+            Metrics::PeriodicReport report;
+            size_t failures;
+            if (threads > 1) {
+                ParallelBatchExecutor executor(threads);
+                failures = executor.run(in, stdout, errors);
+            } else {
+                BatchProcessor processor;
+                failures = processor.run(in, stdout, errors);
+            }
+            if (in != stdin) fclose(in);
+            if (errors) {
+                fclose(errors);
+                cerr << (failures ? YELLOW_COLOR : GREEN_COLOR) << failures << " failed rows, see " << errorPath << RESET_COLOR << endl;
+            }
+            ResultCache::report(cerr);
+            return failures == 0 ? 0 : 2;
+        }
+        if (mode == "--aggregate" && args.size() >= 4) {
+            // --aggregate <temp|len|curr|unit> <from> <to> [file|-] [--threads N] [--errors report.tsv]
+            //             [--quantiles 0.5,0.9,0.99]
+            LinearFactors factors = ColumnAggregator::factorsFor(args[1], args[2], args[3]);
+            size_t threads = 1;
+            string path = "-", errorPath;
+            vector<double> quantiles = {0.5, 0.9, 0.99};
+            for (size_t i = 4; i < args.size(); ++i) {
+                if (args[i] == "--threads") {
+                    threads = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                } else if (args[i] == "--errors") {
+                    errorPath = optionValue(args, i);
+                } else if (args[i] == "--quantiles") {
+                    quantiles.clear();
+                    string_view list = optionValue(args, i);
+                    while (!list.empty()) {
+                        size_t comma = list.find(',');
+                        string_view field = list.substr(0, comma);
+                        double q;
+                        if (NumberParser::parseDouble(field, q) != ParseStatus::Ok || !(q >= 0.0 && q <= 1.0)) {
+                            throw runtime_error("Invalid quantile '" + string(field) + "' (use fractions from 0 to 1)");
+                        }
+                        quantiles.push_back(q);
+                        list = comma == string_view::npos ? string_view() : list.substr(comma + 1);
+                    }
+                } else {
+                    path = args[i];
+                }
+            }
+            FILE* in = stdin;
+            if (path != "-") {
+                in = fopen(path.c_str(), "rb");
+                if (!in) {
+                    cerr << RED_COLOR << "Cannot open " << path << RESET_COLOR << endl;
+                    return 1;
+                }
+            }
+            FILE* errors = nullptr;
+            if (!errorPath.empty() && !(errors = fopen(errorPath.c_str(), "wb"))) {
+                cerr << RED_COLOR << "Cannot create " << errorPath << RESET_COLOR << endl;
+                return 1;
+            }
+            size_t failures = 0;
+            ColumnAggregator aggregator(factors, threads);
+            StreamingStats stats = aggregator.run(in, failures, errors);
+            if (in != stdin) fclose(in);
+            if (errors) fclose(errors);
+            BufferedWriter out(stdout);
+            stats.write(out, quantiles);
+            out.flush();
+            if (failures) cerr << YELLOW_COLOR << failures << " rows were not numbers" << (errors ? ", see " + errorPath : "") << RESET_COLOR << endl;
+            return failures == 0 ? 0 : 2;
+        }
+        if (mode == "--columns" && args.size() >= 5) {
+            // --columns <in.col> <out.col> <temp|len|curr|unit> <from> <to> [--threads N] [--direct]
+            // --columns <in.col> <out.col> log <L|N|B> [--threads N] [--direct]
+            bool logarithm = args[3] == "log";
+            ColumnConverter::Conversion conversion = ColumnConverter::parse(args[3], args[4], logarithm || args.size() < 6 ? "" : args[5]);
+            size_t threads = 1;
+            bool direct = false;
+            for (size_t i = logarithm ? 5 : 6; i < args.size(); ++i) {
+                if (args[i] == "--threads") threads = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                else if (args[i] == "--direct") direct = true;
+                else throw runtime_error("Unknown option " + args[i]);
+            }
+            unique_ptr<ColumnFile> in = ColumnFile::load(args[1]);
+            ColumnWriter out(args[2], ColumnType::Float64, in->size(), direct);
+            auto started = chrono::steady_clock::now();
+            size_t failures = ColumnConverter::run(conversion, *in, out, threads);
+            out.finish();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+            cerr << GREEN_COLOR << in->size() << " values in " << fixed << setprecision(3) << seconds << " s ("
+                 << in->size() * 16 / max(seconds, 1e-9) / 1e9 << " GB/s read + written"
+                 << (direct && !out.isDirect() ? ", O_DIRECT unsupported here" : "") << ")" << RESET_COLOR << endl;
+            if (failures) cerr << YELLOW_COLOR << failures << " values had no logarithm and are NaN" << RESET_COLOR << endl;
+            return failures == 0 ? 0 : 2;
+        }
+        if (mode == "--pack-column" && args.size() >= 3) {
+            // --pack-column <text file|-> <out.col> [--int64] [--errors report.tsv]
+            ColumnType type = ColumnType::Float64;
+            string errorPath;
+            for (size_t i = 3; i < args.size(); ++i) {
+                if (args[i] == "--int64") type = ColumnType::Int64;
+                else if (args[i] == "--errors") errorPath = optionValue(args, i);
+                else throw runtime_error("Unknown option " + args[i]);
+            }
+            FILE* in = args[1] == "-" ? stdin : fopen(args[1].c_str(), "rb");
+            if (!in) {
+                cerr << RED_COLOR << "Cannot open " << args[1] << RESET_COLOR << endl;
+                return 1;
+            }
+            FILE* errorFile = nullptr;
+            if (!errorPath.empty() && !(errorFile = fopen(errorPath.c_str(), "wb"))) {
+                cerr << RED_COLOR << "Cannot create " << errorPath << RESET_COLOR << endl;
+                return 1;
+            }
+            size_t failures;
+            {
+                unique_ptr<BufferedWriter> errors;
+                if (errorFile) errors = make_unique<BufferedWriter>(errorFile);
+                failures = ColumnText::pack(in, args[2], type, errors.get());
+            }
+            if (in != stdin) fclose(in);
+            if (errorFile) fclose(errorFile);
+            if (failures) cerr << YELLOW_COLOR << failures << " rows were not numbers" << (errorFile ? ", see " + errorPath : "") << RESET_COLOR << endl;
+            return failures == 0 ? 0 : 2;
+        }
+        if (mode == "--dump-column" && args.size() == 2) {
+            unique_ptr<ColumnFile> column = ColumnFile::load(args[1]);
+            BufferedWriter out(stdout);
+            ColumnText::dump(*column, out);
+            out.flush();
+            return 0;
+        }
+        if (mode == "--ledger" && args.size() >= 3) {
+            // --ledger <from> <to> [file|-] [--scale N] [--to-scale N] [--rows converted.txt] [--errors report.tsv]
+            int fromScale = 2, toScale = -1;
+            string path = "-", rowsPath, errorPath;
+            for (size_t i = 3; i < args.size(); ++i) {
+                if (args[i] == "--scale") fromScale = atoi(optionValue(args, i).c_str());
+                else if (args[i] == "--to-scale") toScale = atoi(optionValue(args, i).c_str());
+                else if (args[i] == "--rows") rowsPath = optionValue(args, i);
+                else if (args[i] == "--errors") errorPath = optionValue(args, i);
+                else path = args[i];
+            }
+            if (toScale < 0) toScale = fromScale;
+            MoneyRate rate = MoneyRate::between(args[1], args[2], fromScale, toScale);
+            FILE* in = path == "-" ? stdin : fopen(path.c_str(), "rb");
+            if (!in) {
+                cerr << RED_COLOR << "Cannot open " << path << RESET_COLOR << endl;
+                return 1;
+            }
+            FILE* rowsFile = nullptr;
+            if (!rowsPath.empty() && !(rowsFile = fopen(rowsPath.c_str(), "wb"))) {
+                cerr << RED_COLOR << "Cannot create " << rowsPath << RESET_COLOR << endl;
+                return 1;
+            }
+            FILE* errors = nullptr;
+            if (!errorPath.empty() && !(errors = fopen(errorPath.c_str(), "wb"))) {
+                cerr << RED_COLOR << "Cannot create " << errorPath << RESET_COLOR << endl;
+                return 1;
+            }
+            size_t failures = 0;
+            MoneyLedger ledger(rate, fromScale, toScale);
+            MoneyLedger::Totals totals;
+            {
+                unique_ptr<BufferedWriter> rows;
+                if (rowsFile) rows = make_unique<BufferedWriter>(rowsFile);
+                totals = ledger.run(in, rows.get(), failures, errors);
+            }
+            if (in != stdin) fclose(in);
+            if (rowsFile) fclose(rowsFile);
+            if (errors) fclose(errors);
+            BufferedWriter out(stdout);
+            ledger.write(out, totals);
+            out.flush();
+            if (failures) cerr << YELLOW_COLOR << failures << " rows were not amounts" << (errors ? ", see " + errorPath : "") << RESET_COLOR << endl;
+            return failures == 0 ? 0 : 2;
+        }
+        if ((mode == "--root" || mode == "--integrate") && args.size() >= 3) {
+            // --root <expression> <a> [b] [--tol t]: Brent on [a, b], Newton from a alone
+            // --integrate <expression> <a> <b> [--tol t] [--max-pieces N] [--threads N]
+            vector<double> bounds;
+            double tolerance = mode == "--root" ? 1e-12 : 1e-10;
+            size_t threads = max<size_t>(thread::hardware_concurrency(), 1), maxPieces = 1 << 16;
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (args[i] == "--tol") tolerance = strtod(optionValue(args, i).c_str(), nullptr);
+                else if (args[i] == "--threads") threads = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                else if (args[i] == "--max-pieces") maxPieces = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                else {
+                    double bound;
+                    if (NumberParser::parseDouble(args[i], bound) != ParseStatus::Ok) throw runtime_error("Invalid bound " + args[i]);
+                    bounds.push_back(bound);
+                }
+            }
+            BufferedWriter out(stdout);
+            if (mode == "--root") {
+                if (bounds.empty() || bounds.size() > 2) throw runtime_error("--root needs a starting point or a bracket");
+                RootFinder finder(args[1], tolerance);
+                RootFinder::Result result = bounds.size() == 2 ? finder.brent(bounds[0], bounds[1]) : finder.newton(bounds[0]);
+                result.write(out);
+                out.flush();
+                return result.converged ? 0 : 2;
+            }
+            if (bounds.size() != 2) throw runtime_error("--integrate needs both limits");
+            AdaptiveIntegrator integrator(threads);
+            AdaptiveIntegrator::Result result = integrator.integrate(args[1], bounds[0], bounds[1], tolerance, tolerance, maxPieces);
+            result.write(out);
+            out.flush();
+            return result.converged ? 0 : 2;
+        }
+        if (mode == "--replay" && args.size() >= 2) {
+            // --replay <trace> [--threads N] [--speed x] [--repeat N] [--mismatches N]
+            TraceReplayer::Options options;
+            size_t threads = 1;
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (args[i] == "--threads") threads = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                else if (args[i] == "--speed") options.speed = strtod(optionValue(args, i).c_str(), nullptr);
+                else if (args[i] == "--repeat") options.repeat = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                else if (args[i] == "--mismatches") options.maxMismatches = strtoull(optionValue(args, i).c_str(), nullptr, 10);
+                else throw runtime_error("Unknown option " + args[i]);
+            }
+            unique_ptr<TraceFile> trace = TraceFile::load(args[1]);
+            warnTruncated(*trace);
+            TraceReplayer replayer(threads);
+            TraceReplayer::Report report = replayer.replay(*trace, options);
+            BufferedWriter out(stdout);
+            report.write(out);
+            out.flush();
+            for (const TraceReplayer::Mismatch& m : report.samples) {
+                cerr << YELLOW_COLOR << "entry " << m.entry << ": " << m.input << ": captured " << m.expected << ", replayed "
+                     << m.actual << RESET_COLOR << "\n";
+            }
+            if (report.mismatches) cerr << RED_COLOR << report.mismatches << " results differ from the trace" << RESET_COLOR << endl;
+            return report.mismatches == 0 && trace->droppedBytes() == 0 ? 0 : 2;
+        }
+        if (mode == "--dump-trace" && args.size() == 2) {
+            // One line per entry: ms since capture began, type, input, captured result and its time in ns
+            unique_ptr<TraceFile> trace = TraceFile::load(args[1]);
+            warnTruncated(*trace);
+            BufferedWriter out(stdout);
+            for (size_t i = 0; i < trace->size(); ++i) {
+                const TraceEntry& entry = (*trace)[i];
+                HistoryRecord::Text input;
+                TraceReplayer::historyRecord(entry).formatInput(input);
+                TextBuffer<32> when;
+                when.appendFixed(static_cast<double>(entry.timestamp - trace->started()) / 1e6);
+                out.write(when.view());
+                out.put('\t');
+                out.write(opKindName(entry.kind));
+                out.put('\t');
+                out.write(input.view());
+                out.put('\t');
+                if (entry.outcome == TraceOutcome::Number) out.writeFixed(entry.result);
+                else if (entry.outcome == TraceOutcome::Failed) out.write("error: ");
+                if (entry.outcome != TraceOutcome::Number) out.write(entry.resultText());
+                out.put('\t');
+                out.writeInt(entry.nanos);
+                out.put('\n');
+            }
+            out.flush();
+            return 0;
+        }
+        if (mode == "--serve" && args.size() >= 2) {
+            // --serve <socket path> [--tcp <port>] [--threads N]
+            int tcpPort = 0;
+            size_t threads = max<size_t>(thread::hardware_concurrency(), 1);
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (args[i] == "--tcp") tcpPort = atoi(optionValue(args, i).c_str());
+                else if (args[i] == "--threads") threads = max<size_t>(strtoull(optionValue(args, i).c_str(), nullptr, 10), 1);
+                else throw runtime_error("Unknown option " + args[i]);
+            }
+            ConversionServer server(args[1], tcpPort, threads);
+            cerr << CYAN_COLOR << "Serving on " << args[1] << (tcpPort > 0 ? " and 127.0.0.1:" + to_string(tcpPort) : "")
+                 << " with " << threads << " workers" << RESET_COLOR << endl;
+            Metrics::PeriodicReport report;
+            server.run();
+            return 0;
+        }
+        if (mode == "--loadgen" && args.size() >= 2) {
+            // --loadgen <socket path|tcp:port> [--connections N] [--requests N] [--pipeline N] [--batch N]
+            size_t connections = 4, requests = 200000, pipeline = 16, batch = 1;
+            for (size_t i = 2; i < args.size(); ++i) {
+                const string& option = args[i];
+                size_t value = strtoull(optionValue(args, i).c_str(), nullptr, 10);
+                if (option == "--connections") connections = value;
+                else if (option == "--requests") requests = value;
+                else if (option == "--pipeline") pipeline = value;
+                else if (option == "--batch") batch = value;
+                else throw runtime_error("Unknown option " + option);
+            }
+            LoadGenerator::run(args[1], connections, requests, pipeline, batch);
+            return 0;
+        }
+        if (mode == "--compile-rates" && args.size() == 3) {
+            RateTable::compile(args[1], args[2]);
+            return 0;
+        }
+    } catch (const runtime_error& e) {
+        cerr << RED_COLOR << "Error: " << e.what() << RESET_COLOR << endl;
+        return 1;
+    }
+    Program program(historyLog);
+    Metrics::PeriodicReport report;
+    program.run();
+    return 0;
+}
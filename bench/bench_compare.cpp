@@ -0,0 +1,262 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+
+// Just enough JSON for Google Benchmark reports: objects, arrays, strings, numbers, literals
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    double number = 0.0;
+    string text;
+    vector<JsonValue> items;
+    vector<pair<string, JsonValue>> members;
+
+    const JsonValue* get(string_view key) const {
+        for (const auto& [name, value] : members) {
+            if (name == key) return &value;
+        }
+        return nullptr;
+    }
+};
+
+class JsonReader {
+private:
+    string_view text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const string& what) const {
+        throw runtime_error(what + " at offset " + to_string(pos));
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+    }
+
+    void expect(char c) {
+        skipSpace();
+        if (pos >= text.size() || text[pos] != c) fail(string("Expected '") + c + "'");
+        ++pos;
+    }
+
+    // Consumes the comma before another member or element
+    bool nextItem() {
+        skipSpace();
+        if (pos >= text.size() || text[pos] != ',') return false;
+        ++pos;
+        return true;
+    }
+
+    string parseString() {
+        expect('"');
+        string result;
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c == '\\' && pos < text.size()) {
+                char escaped = text[pos++];
+                switch (escaped) {
+                    case 'n': result += '\n'; break;
+                    case 't': result += '\t'; break;
+                    case 'u': result += '?'; pos += 4; break;   // names and labels are ASCII
+                    default: result += escaped;
+                }
+            } else {
+                result += c;
+            }
+        }
+        if (pos >= text.size()) fail("Unterminated string");
+        ++pos;
+        return result;
+    }
+
+public:
+    explicit JsonReader(string_view source) : text(source) {}
+
+    JsonValue parse() {
+        skipSpace();
+        if (pos >= text.size()) fail("Unexpected end of input");
+        JsonValue value;
+        char c = text[pos];
+        if (c == '{') {
+            value.type = JsonValue::Type::Object;
+            ++pos;
+            skipSpace();
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                return value;
+            }
+            while (true) {
+                string key = parseString();
+                expect(':');
+                value.members.emplace_back(move(key), parse());
+                if (!nextItem()) break;
+            }
+            expect('}');
+        } else if (c == '[') {
+            value.type = JsonValue::Type::Array;
+            ++pos;
+            skipSpace();
+            if (pos < text.size() && text[pos] == ']') {
+                ++pos;
+                return value;
+            }
+            while (true) {
+                value.items.push_back(parse());
+                if (!nextItem()) break;
+            }
+            expect(']');
+        } else if (c == '"') {
+            value.type = JsonValue::Type::String;
+            value.text = parseString();
+        } else if (text.substr(pos, 4) == "true" || text.substr(pos, 5) == "false") {
+            value.type = JsonValue::Type::Bool;
+            value.number = text[pos] == 't';
+            pos += text[pos] == 't' ? 4 : 5;
+        } else if (text.substr(pos, 4) == "null") {
+            pos += 4;
+        } else {
+            const char* start = text.data() + pos;
+            char* end = nullptr;
+            value.type = JsonValue::Type::Number;
+            value.number = strtod(start, &end);
+            if (end == start) fail("Invalid value");
+            pos += end - start;
+        }
+        return value;
+    }
+};
+
+// What a report says about one benchmark: throughput (higher is better), time per item and the
+// user counters, taken from the median aggregate when there were repetitions
+struct Measurement {
+    double itemsPerSecond = 0.0;
+    double realTime = 0.0;
+    map<string, double> counters;
+};
+
+static map<string, Measurement> loadReport(const string& path) {
+    ifstream file(path);
+    if (!file) throw runtime_error("Cannot read " + path);
+    stringstream buffer;
+    buffer << file.rdbuf();
+    string text = buffer.str();
+    JsonValue root = JsonReader(text).parse();
+    const JsonValue* benchmarks = root.get("benchmarks");
+    if (!benchmarks || benchmarks->type != JsonValue::Type::Array) throw runtime_error(path + " has no benchmarks array");
+
+    // Step 1: Group the runs by benchmark; a median aggregate replaces the single runs
+    map<string, vector<Measurement>> runs;
+    map<string, Measurement> medians;
+    for (const JsonValue& entry : benchmarks->items) {
+        const JsonValue* runName = entry.get("run_name");
+        const JsonValue* name = entry.get("name");
+        string key = runName ? runName->text : name ? name->text : "";
+        const JsonValue* runType = entry.get("run_type");
+        const JsonValue* aggregate = entry.get("aggregate_name");
+        bool isAggregate = runType && runType->text == "aggregate";
+        if (isAggregate && (!aggregate || aggregate->text != "median")) continue;
+        Measurement m;
+        for (const auto& [field, value] : entry.members) {
+            if (value.type != JsonValue::Type::Number) continue;
+            if (field == "items_per_second") m.itemsPerSecond = value.number;
+            else if (field == "real_time") m.realTime = value.number;
+            else if (field != "iterations" && field != "cpu_time" && field != "repetition_index" && field != "repetitions" &&
+                     field != "threads" && field != "family_index" && field != "per_family_instance_index" &&
+                     field != "bytes_per_second") {
+                m.counters[field] = value.number;
+            }
+        }
+        if (isAggregate) medians[key] = m;
+        else runs[key].push_back(m);
+    }
+    // Step 2: Without an aggregate, the median run by throughput (or time) stands for the benchmark
+    map<string, Measurement> result = medians;
+    for (auto& [key, list] : runs) {
+        if (result.count(key)) continue;
+        sort(list.begin(), list.end(), [](const Measurement& a, const Measurement& b) {
+            return a.itemsPerSecond != b.itemsPerSecond ? a.itemsPerSecond < b.itemsPerSecond : a.realTime > b.realTime;
+        });
+        result[key] = list[list.size() / 2];
+    }
+    return result;
+}
+
+static string human(double value) {
+    static const char* suffixes[] = {"", "k", "M", "G", "T"};
+    int i = 0;
+    while (fabs(value) >= 1000.0 && i < 4) {
+        value /= 1000.0;
+        ++i;
+    }
+    ostringstream out;
+    out << fixed << setprecision(value < 10.0 ? 3 : value < 100.0 ? 2 : 1) << value << suffixes[i];
+    return out.str();
+}
+
+// bench_compare <baseline.json> <current.json> [--threshold percent]
+// Fails (exit 1) when any benchmark lost more than the threshold in throughput, or when a
+// "bytes_per_item" footprint counter grew by more than it. Exit 2 when a report can't be read.
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    double threshold = 10.0;
+    for (size_t i = 0; i < args.size();) {
+        if (args[i] == "--threshold" && i + 1 < args.size()) {
+            threshold = strtod(args[i + 1].c_str(), nullptr);
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        } else {
+            ++i;
+        }
+    }
+    if (args.size() != 2) {
+        cerr << "usage: bench_compare <baseline.json> <current.json> [--threshold percent]" << endl;
+        return 2;
+    }
+    try {
+        map<string, Measurement> baseline = loadReport(args[0]);
+        map<string, Measurement> current = loadReport(args[1]);
+        size_t regressions = 0, compared = 0;
+        cout << left << setw(40) << "Benchmark" << setw(16) << "metric" << right << setw(12) << "baseline" << setw(12)
+             << "current" << setw(10) << "change" << "\n";
+        auto report = [&](const string& name, const string& metric, double before, double after, bool higherIsBetter) {
+            double change = (after / before - 1.0) * 100.0;
+            bool regressed = higherIsBetter ? change < -threshold : change > threshold;
+            ++compared;
+            if (regressed) ++regressions;
+            cout << left << setw(40) << name << setw(16) << metric << right << setw(12) << human(before) << setw(12)
+                 << human(after) << setw(9) << showpos << fixed << setprecision(1) << change << noshowpos << "%"
+                 << (regressed ? "  REGRESSION" : "") << "\n";
+        };
+        for (const auto& [name, before] : baseline) {
+            auto it = current.find(name);
+            if (it == current.end()) {
+                cout << left << setw(40) << name << "missing from the current report\n";
+                continue;
+            }
+            const Measurement& after = it->second;
+            if (before.itemsPerSecond > 0.0 && after.itemsPerSecond > 0.0) {
+                report(name, "items/s", before.itemsPerSecond, after.itemsPerSecond, true);
+            } else if (before.counters.empty() && before.realTime > 0.0 && after.realTime > 0.0) {
+                report(name, "time", before.realTime, after.realTime, false);
+            }
+            auto footprint = before.counters.find("bytes_per_item");
+            if (footprint != before.counters.end() && footprint->second > 0.0 && after.counters.count("bytes_per_item")) {
+                report(name, "bytes/item", footprint->second, after.counters.at("bytes_per_item"), false);
+            }
+        }
+        cout << regressions << " of " << compared << " measurements regressed by more than " << threshold << "%\n";
+        return regressions == 0 ? 0 : 1;
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 2;
+    }
+}
@@ -0,0 +1,1498 @@
+#include "techneon/engine.hpp"
+#include "techneon/metrics.hpp"
+#include "techneon/format.hpp"
+#include "techneon/batch.hpp"
+#include "techneon/history.hpp"
+#include "techneon/stats.hpp"
+#include "techneon/columns.hpp"
+#include "techneon/sheet.hpp"
+#include "techneon/money.hpp"
+#include "techneon/matrix.hpp"
+#include "techneon/solvers.hpp"
+
+#include <map>
+#include <optional>
+#include <regex>
+#include <ctime>
+#include <malloc.h>
+
+using namespace std;
+using namespace techneon;
+
+class Benchmarks {
+private:
+    template <typename Fn>
+    static double secondsFor(Fn&& fn) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    template <typename ConverterType>
+    static void compareColumn(const string& label, const vector<double>& in, vector<double>& out, char from, char to) {
+        size_t n = in.size();
+        // Per-object path: one heap-allocated converter and one virtual call per value
+        double perObject = secondsFor([&] {
+            for (size_t i = 0; i < n; ++i) {
+                unique_ptr<Converter> conv = make_unique<ConverterType>(in[i], from, to);
+                out[i] = conv->convert();
+            }
+        });
+        double check = out[n / 2];
+        double column = secondsFor([&] { ConverterType::convert(span<const double>(in), span<double>(out), from, to); });
+        if (fabs(out[n / 2] - check) > 1e-9 * fabs(check)) {
+            cout << RED_COLOR << label << ": column result differs from per-object result" << RESET_COLOR << "\n";
+        }
+        cout << left << setw(16) << label
+             << right << fixed << setprecision(2)
+             << setw(14) << perObject * 1e9 / n
+             << setw(14) << column * 1e9 / n
+             << setw(11) << perObject / column << "x\n";
+    }
+
+public:
+    static void conversions(size_t n) {
+        vector<double> in(n), out(n);
+        for (size_t i = 0; i < n; ++i) {
+            in[i] = static_cast<double>(i % 1000) * 0.37 - 40.0;
+        }
+        cout << "Column conversion, " << n << " values, kernel: " << LinearKernel::name() << "\n";
+        cout << left << setw(16) << "pair" << right << setw(14) << "object ns/val" << setw(14) << "column ns/val" << setw(12) << "speedup" << "\n";
+        compareColumn<TemperatureConverter>("Temperature C>F", in, out, 'C', 'F');
+        compareColumn<LengthConverter>("Length M>F", in, out, 'M', 'F');
+        compareColumn<CurrencyConverter>("Currency U>I", in, out, 'U', 'I');
+    }
+
+    static void expressions(size_t n) {
+        const string text = "x^2 + 3*x*y - sin(x) / (y + 1) + 2^10 * (4 - 1)";
+        CompiledExpression expression(text);
+        int x = expression.variableIndex("x"), y = expression.variableIndex("y");
+        double values[2] = {0.0, 0.0};
+        double sum = 0.0;
+        double compiled = secondsFor([&] {
+            for (size_t i = 0; i < n; ++i) {
+                values[x] = static_cast<double>(i % 1000) * 0.5;
+                values[y] = static_cast<double>(i % 7);
+                sum += expression.evaluate(values);
+            }
+        });
+        size_t reparseCount = max<size_t>(n / 100, 1);
+        double reparse = secondsFor([&] {
+            for (size_t i = 0; i < reparseCount; ++i) {
+                CompiledExpression fresh(text);
+                values[0] = static_cast<double>(i % 1000) * 0.5;
+                values[1] = static_cast<double>(i % 7);
+                sum += fresh.evaluate(values);
+            }
+        });
+        cout << "Expression: " << text << " (" << expression.instructionCount() << " instructions after folding)\n";
+        cout << fixed << setprecision(2)
+             << "  compiled evaluate: " << compiled * 1e9 / n << " ns/eval\n"
+             << "  parse + evaluate:  " << reparse * 1e9 / reparseCount << " ns/eval\n"
+             << "  (checksum " << sum << ")\n";
+    }
+    static void radix(const vector<size_t>& sizes) {
+        cout << left << setw(10) << "digits" << right << setw(14) << "dec->big ms" << setw(14) << "big->hex ms"
+             << setw(14) << "big->dec ms" << setw(14) << "hex->dec ms" << "\n";
+        for (size_t n : sizes) {
+            string decimal(n, '0');
+            uint64_t state = 88172645463325252ull;
+            for (size_t i = 0; i < n; ++i) {
+                state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+                decimal[i] = static_cast<char>('0' + state % 10);
+            }
+            decimal[0] = '7';
+            BigUnsigned value;
+            string hex, back, converted;
+            double parse = secondsFor([&] { value = RadixConverter::parse(decimal, 10); });
+            double toHex = secondsFor([&] { hex = RadixConverter::print(value, 16); });
+            double toDec = secondsFor([&] { back = RadixConverter::print(value, 10); });
+            double hexToDec = secondsFor([&] { converted = RadixConverter::convert(hex, 16, 10); });
+            if (back != decimal || converted != decimal) {
+                cout << RED_COLOR << "round trip mismatch at " << n << " digits" << RESET_COLOR << "\n";
+            }
+            cout << left << setw(10) << n << right << fixed << setprecision(2) << setw(14) << parse * 1e3
+                 << setw(14) << toHex * 1e3 << setw(14) << toDec * 1e3 << setw(14) << hexToDec * 1e3 << "\n";
+        }
+    }
+
+    // Conversion throughput on several threads while another thread keeps replacing the rate file
+    static void rateReloads(size_t seconds) {
+        // Step 1: Synthetic table with 180 currencies, pivot first
+        vector<RateFileEntry> rows;
+        for (int i = 0; i < 180; ++i) {
+            RateFileEntry entry{};
+            string code = RateTable::codeOfKey(i * 97 + 3);
+            memcpy(entry.code, code.data(), 3);
+            entry.unitsPerPivot = i == 0 ? 1.0 : 0.5 + i * 0.37;
+            rows.push_back(entry);
+        }
+        string path = "bench_rates_" + to_string(getpid()) + ".bin";
+        RateTable::write(path, rows);
+        CurrencyRates& rates = CurrencyRates::instance();
+        rates.load(path);
+        unsigned readers = max(2u, thread::hardware_concurrency());
+        for (bool reloading : {false, true}) {
+            atomic<bool> stop{false};
+            vector<unsigned long> counts(readers * 8, 0);   // one cache line apart
+            vector<thread> threads;
+            unsigned long reloadsBefore = rates.reloadCount();
+            for (unsigned t = 0; t < readers; ++t) {
+                threads.emplace_back([&, t] {
+                    unsigned long done = 0;
+                    double sink = 0.0;
+                    uint32_t state = t * 7919 + 1;
+                    while (!stop.load(memory_order_relaxed)) {
+                        for (int k = 0; k < 256; ++k) {
+                            state = state * 1664525u + 1013904223u;
+                            int from = (state >> 8) % 180 * 97 + 3, to = (state >> 20) % 180 * 97 + 3;
+                            sink += CurrencyConverter(100.0, from, to).convert();
+                        }
+                        done += 256;
+                    }
+                    counts[t * 8] = done + (sink < 0 ? 1 : 0);
+                });
+            }
+            thread writer;
+            if (reloading) {
+                writer = thread([&] {
+                    for (int round = 1; !stop.load(); ++round) {
+                        rows[1].unitsPerPivot = 1.0 + round % 100;
+                        RateTable::write(path, rows);
+                        rates.load(path);
+                    }
+                });
+            }
+            this_thread::sleep_for(chrono::seconds(seconds));
+            stop = true;
+            for (thread& th : threads) th.join();
+            if (writer.joinable()) writer.join();
+            unsigned long total = 0;
+            for (unsigned t = 0; t < readers; ++t) total += counts[t * 8];
+            cout << (reloading ? "with reloads:    " : "without reloads: ") << fixed << setprecision(2)
+                 << total / 1e6 / seconds << " M conversions/s on " << readers << " threads, "
+                 << rates.reloadCount() - reloadsBefore << " reloads\n";
+        }
+        remove(path.c_str());
+    }
+
+    // Fast math against a long double reference with exact degree reduction, next to the libm
+    // path; returns false when a tier misses its bound or a batch result differs from the single one
+    static bool fastMathAccuracy() {
+        using Function = FastMath::Function;
+        using Accuracy = FastMath::Accuracy;
+        const long double pi = 3.141592653589793238462643383279502884L;
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        auto uniform = [&](double lo, double hi) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return lo + (hi - lo) * (static_cast<double>(state >> 11) * 0x1p-53);
+        };
+        vector<double> angles, positives;
+        for (int i = -720000; i <= 720000; ++i) angles.push_back(i / 1000.0);
+        for (int i = 0; i < 200000; ++i) angles.push_back(uniform(-1e6, 1e6));
+        for (int i = 0; i < 1000; ++i) angles.push_back(uniform(-1e18, 1e18));
+        for (int i = 1; i < 40; ++i) angles.push_back(90.0 - ldexp(1.0, -i));
+        for (int i = 0; i < 200000; ++i) positives.push_back(exp2(uniform(-1020, 1020)));
+        for (int i = 0; i < 100000; ++i) positives.push_back(1.0 + uniform(-1e-2, 1e-2));
+        for (int i = 1; i < 53; ++i) {
+            positives.push_back(1.0 + ldexp(1.0, -i));
+            positives.push_back(1.0 - ldexp(1.0, -i));
+        }
+        for (int i = -300; i <= 300; ++i) positives.push_back(pow(10.0, i));
+        positives.push_back(4.9e-320);
+
+        auto reference = [&](Function f, double x) -> long double {
+            // Same exact reduction in long double, so multiples of 90 degrees give exact zeros
+            long double degrees = fmodl(x, 360.0L);
+            long double n = nearbyintl(degrees / 90);
+            long double r = (degrees - 90 * n) * pi / 180;
+            int quadrant = static_cast<int>(n) & 3;
+            long double s = sinl(r), c = cosl(r);
+            long double sine = quadrant == 0 ? s : quadrant == 1 ? c : quadrant == 2 ? -s : -c;
+            long double cosine = quadrant == 0 ? c : quadrant == 1 ? -s : quadrant == 2 ? -c : s;
+            switch (f) {
+                case Function::Sin: return sine;
+                case Function::Cos: return cosine;
+                case Function::Tan: return sine / cosine;
+                case Function::Ln: return logl(x);
+                case Function::Log2: return log2l(x);
+                default: return log10l(x);
+            }
+        };
+        auto libm = [](Function f, double x) {
+            switch (f) {
+                case Function::Sin: return sin(x * M_PI / 180.0);
+                case Function::Cos: return cos(x * M_PI / 180.0);
+                case Function::Tan: return tan(x * M_PI / 180.0);
+                case Function::Ln: return log(x);
+                case Function::Log2: return log2(x);
+                default: return log10(x);
+            }
+        };
+        const double bounds[3] = {1.0, 4.0, 0.0};   // ulp bounds; the relaxed tier is checked by relative error
+        bool ok = true;
+        cout << "Fast math accuracy against long double references\n" << left << setw(8) << "func" << setw(10) << "tier"
+             << right << setw(14) << "max ulp" << setw(14) << "max rel err" << "\n";
+        for (int fi = 0; fi < 6; ++fi) {
+            Function f = static_cast<Function>(fi);
+            const vector<double>& inputs = fi < 3 ? angles : positives;
+            vector<double> batch(inputs.size());
+            for (int tier = -1; tier < 3; ++tier) {
+                Accuracy a = static_cast<Accuracy>(max(tier, 0));
+                if (tier >= 0) FastMath::compute(f, span<const double>(inputs), span<double>(batch), a);
+                double maxUlp = 0.0, maxRelative = 0.0;
+                size_t mismatches = 0;
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    double x = inputs[i];
+                    if (f == Function::Tan && fmod(fabs(x), 180.0) == 90.0) continue;
+                    double got = tier < 0 ? libm(f, x) : FastMath::compute(f, x, a);
+                    if (tier >= 0 && memcmp(&got, &batch[i], sizeof(got)) != 0) ++mismatches;
+                    long double expected = reference(f, x);
+                    double rounded = static_cast<double>(expected);
+                    long double error = fabsl(got - expected);
+                    if (error == 0) continue;
+                    double ulp = nextafter(fabs(rounded), numeric_limits<double>::infinity()) - fabs(rounded);
+                    if (rounded == 0) ulp = numeric_limits<double>::denorm_min();
+                    maxUlp = max(maxUlp, static_cast<double>(error / ulp));
+                    maxRelative = max(maxRelative, static_cast<double>(error / fabsl(expected)));
+                }
+                bool pass = mismatches == 0 && (tier < 0 || (tier == 2 ? maxRelative <= 1e-7 : maxUlp <= bounds[tier]));
+                ok = ok && pass;
+                cout << left << setw(8) << FastMath::functionName(f) << setw(10) << (tier < 0 ? "libm" : FastMath::accuracyName(a))
+                     << right << scientific << setprecision(3) << setw(14) << maxUlp << setw(14) << maxRelative;
+                if (mismatches) cout << "  " << mismatches << " batch mismatches";
+                cout << (pass ? "" : "  FAIL") << "\n" << defaultfloat;
+            }
+        }
+        return ok;
+    }
+
+    // n values in total, as repeated passes over a 4096-value column that stays in cache
+    static void fastMath(size_t n) {
+        using Function = FastMath::Function;
+        const size_t width = 4096, passes = max<size_t>(n / width, 1);
+        vector<double> angles(width), positives(width), out(width);
+        for (size_t i = 0; i < width; ++i) {
+            angles[i] = static_cast<double>(i) * 0.17 - 360.0;
+            positives[i] = 1e-3 + static_cast<double>(i) * 37.1;
+        }
+        double count = static_cast<double>(width * passes);
+        cout << "Fast math batch, " << width * passes << " values, kernel: " << FastMath::name() << "\n" << left << setw(8)
+             << "func" << right << setw(12) << "libm ns" << setw(12) << "1ulp ns" << setw(12) << "4ulp ns"
+             << setw(12) << "relaxed ns" << setw(12) << "speedup" << "\n";
+        double sum = 0.0;
+        for (int fi = 0; fi < 6; ++fi) {
+            Function f = static_cast<Function>(fi);
+            const vector<double>& in = fi < 3 ? angles : positives;
+            double libm = secondsFor([&] {
+                for (size_t pass = 0; pass < passes; ++pass) {
+                    for (size_t i = 0; i < width; ++i) {
+                        double x = in[i];
+                        switch (f) {
+                            case Function::Sin: out[i] = sin(x * M_PI / 180.0); break;
+                            case Function::Cos: out[i] = cos(x * M_PI / 180.0); break;
+                            case Function::Tan: out[i] = tan(x * M_PI / 180.0); break;
+                            case Function::Ln: out[i] = log(x); break;
+                            case Function::Log2: out[i] = log2(x); break;
+                            case Function::Log10: out[i] = log10(x); break;
+                        }
+                    }
+                    sum += out[pass % width];
+                }
+            });
+            cout << left << setw(8) << FastMath::functionName(f) << right << fixed << setprecision(2) << setw(12)
+                 << libm * 1e9 / count;
+            double precise = libm;
+            for (int tier = 0; tier < 3; ++tier) {
+                double seconds = secondsFor([&] {
+                    for (size_t pass = 0; pass < passes; ++pass) {
+                        FastMath::compute(f, span<const double>(in), span<double>(out), static_cast<FastMath::Accuracy>(tier));
+                        sum += out[pass % width];
+                    }
+                });
+                if (tier == 0) precise = seconds;
+                cout << setw(12) << seconds * 1e9 / count;
+            }
+            cout << setw(11) << libm / precise << "x\n";
+        }
+        cout << "(checksum " << sum << "; speedup is for the 1ulp tier)\n";
+    }
+
+    // n keys drawn from ranks 0..universe-1 with probability proportional to 1 / (rank + 1)^skew
+    static vector<uint32_t> zipfKeys(size_t n, size_t universe, double skew) {
+        vector<double> cdf(universe);
+        double sum = 0.0;
+        for (size_t r = 0; r < universe; ++r) {
+            sum += pow(static_cast<double>(r + 1), -skew);
+            cdf[r] = sum;
+        }
+        vector<uint32_t> keys(n);
+        uint64_t state = 0x2545F4914F6CDD1Dull;
+        for (size_t i = 0; i < n; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            double u = static_cast<double>(state >> 11) * 0x1p-53 * sum;
+            size_t rank = upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+            keys[i] = static_cast<uint32_t>(min(rank, universe - 1));
+        }
+        return keys;
+    }
+
+    // Cached against direct evaluation for uniform to strongly skewed inputs
+    // A ledger of n INR amounts converted to USD and totalled: the double path (column kernel, then
+    // a running sum) against the exact decimal kernel, which converts and sums in one pass
+    static void money(size_t n) {
+        vector<int64_t> paise(n);
+        vector<double> rupees(n);
+        uint64_t state = 88172645463325252ull;
+        for (size_t i = 0; i < n; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            paise[i] = static_cast<int64_t>(state % 10000000) - 1000000;   // -10,000.00 to 89,999.99
+            rupees[i] = static_cast<double>(paise[i]) / 100.0;
+        }
+        cout << "Ledger, " << n << " rows INR to USD; decimal kernel: " << MoneyKernel::name()
+             << ", double kernel: " << LinearKernel::name() << "\n";
+        // Step 1: Exact cents, rounded half to even per row and summed in the same pass
+        MoneyRate rate = MoneyRate::between("INR", "USD", 2, 2);
+        __int128 exactTotal = 0;
+        double decimalSeconds;
+        {
+            vector<int64_t> cents(n);
+            decimalSeconds = secondsFor([&] { exactTotal = MoneyKernel::convert(paise, cents, rate); });
+            for (size_t i = 0; i < n; i += 9973) {
+                if (cents[i] != rate.apply(paise[i])) {
+                    cout << RED_COLOR << "Decimal kernel differs from the exact conversion at row " << i << RESET_COLOR << "\n";
+                    break;
+                }
+            }
+        }
+        // Step 2: The double path, rounded only when printed
+        double doubleTotal = 0.0, doubleSeconds;
+        {
+            vector<double> dollars(n);
+            doubleSeconds = secondsFor([&] {
+                CurrencyConverter::convert(span<const double>(rupees), span<double>(dollars), 'I', 'U');
+                for (double d : dollars) doubleTotal += d;
+            });
+        }
+        TextBuffer<64> exact;
+        Decimal::appendUnits(exact, exactTotal, 2);
+        cout << left << setw(10) << "path" << right << setw(12) << "ns/row" << setw(12) << "GB/s" << setw(24) << "total USD" << "\n";
+        cout << fixed << setprecision(2);
+        cout << left << setw(10) << "double" << right << setw(12) << doubleSeconds * 1e9 / n << setw(12) << n * 16 / doubleSeconds / 1e9
+             << setw(24) << doubleTotal << "\n";
+        cout << left << setw(10) << "decimal" << right << setw(12) << decimalSeconds * 1e9 / n << setw(12) << n * 16 / decimalSeconds / 1e9
+             << setw(24) << exact.view() << "\n";
+        cout << "decimal / double time: " << setprecision(3) << decimalSeconds / doubleSeconds
+             << "; the double total is off the ledger's by " << setprecision(2)
+             << fabs(doubleTotal - static_cast<double>(exactTotal) / 100.0) << " USD\n";
+    }
+
+    // c = a b the textbook way, for rows [0, rows) of c only
+    static void naiveMultiply(const Matrix& a, const Matrix& b, const Matrix& c, size_t rows) {
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < b.cols; ++j) {
+                double sum = 0.0;
+                for (size_t p = 0; p < a.cols; ++p) sum += a.at(i, p) * b.at(p, j);
+                c.at(i, j) = sum;
+            }
+        }
+    }
+
+    static void fillMatrix(const Matrix& m, double seed) {
+        for (size_t r = 0; r < m.rows; ++r) {
+            for (size_t c = 0; c < m.cols; ++c) m.at(r, c) = sin(seed + static_cast<double>(r * 31 + c * 17));
+        }
+    }
+
+    static void matrices(size_t maxSize) {
+        MatrixEngine serial(1), parallel;
+        cout << "Matrix multiply, " << MatrixEngine::name() << " kernel, " << parallel.threads() << " threads\n" << left << setw(8)
+             << "n" << right << setw(14) << "naive GF/s" << setw(14) << "1 thread" << setw(14) << "all threads" << setw(12)
+             << "speedup" << "\n";
+        for (size_t n = 64; n <= maxSize; n *= 2) {
+            MatrixArena arena;
+            Matrix a = Matrix::allocate(arena, n, n), b = Matrix::allocate(arena, n, n);
+            Matrix c = Matrix::allocate(arena, n, n), check = Matrix::allocate(arena, n, n);
+            fillMatrix(a, 1.0);
+            fillMatrix(b, 2.0);
+            double flops = 2.0 * n * n * n;
+            // Step 1: The naive loop on enough rows for about half a second; rows all cost the same
+            size_t rows = n;
+            double naive = secondsFor([&] { naiveMultiply(a, b, check, min<size_t>(n, 8)); });
+            rows = min(n, max<size_t>(8, static_cast<size_t>(0.5 / max(naive, 1e-9) * 8)));
+            naive = secondsFor([&] { naiveMultiply(a, b, check, rows); }) * static_cast<double>(n) / static_cast<double>(rows);
+            // Step 2: The blocked kernels, repeated to about a quarter second, best of three
+            auto best = [&](MatrixEngine& engine) {
+                size_t reps = max<size_t>(1, static_cast<size_t>(5e9 / flops));
+                double fastest = numeric_limits<double>::max();
+                for (int round = 0; round < 3; ++round) {
+                    fastest = min(fastest, secondsFor([&] {
+                        for (size_t r = 0; r < reps; ++r) engine.multiply(a, b, c);
+                    }) / static_cast<double>(reps));
+                }
+                return fastest;
+            };
+            double one = best(serial), all = best(parallel);
+            double error = 0.0;
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < n; ++j) error = max(error, fabs(c.at(i, j) - check.at(i, j)));
+            }
+            if (error > 1e-9 * static_cast<double>(n)) {
+                cout << RED_COLOR << "Blocked product differs from the naive one by " << error << RESET_COLOR << "\n";
+            }
+            cout << left << setw(8) << n << right << fixed << setprecision(2) << setw(14) << flops / naive / 1e9 << setw(14)
+                 << flops / one / 1e9 << setw(14) << flops / all / 1e9 << setw(11) << naive / min(one, all) << "x\n";
+        }
+    }
+
+    // Tolerance against cost: evaluations, pieces and time for integrands with known integrals (trig
+    // is in degrees, as everywhere in the calculator), then the same for Brent and Newton root finding
+    static void solvers(size_t threads) {
+        AdaptiveIntegrator integrator(threads);
+        constexpr double PI = 3.14159265358979323846;
+        struct Case {
+            const char* expression;
+            double a, b, exact;
+        };
+        const Case cases[] = {{"1/(1+x^2)", 0.0, 1.0, PI / 4.0},
+                              {"x^0.5", 0.0, 1.0, 2.0 / 3.0},
+                              {"x^-0.5", 0.0, 1.0, 2.0},
+                              {"cos(x)", 0.0, 3645.0, 180.0 / PI * sqrt(0.5)}};
+        cout << "Adaptive Gauss-Kronrod, " << integrator.threadCount() << " threads\n" << left << setw(12) << "integrand" << right
+             << setw(8) << "tol" << setw(10) << "evals" << setw(8) << "pieces" << setw(8) << "rounds" << setw(10) << "us"
+             << setw(12) << "estimate" << setw(12) << "actual" << "\n";
+        for (const Case& c : cases) {
+            for (double tolerance : {1e-4, 1e-7, 1e-10, 1e-13}) {
+                AdaptiveIntegrator::Result result = integrator.integrate(c.expression, c.a, c.b, tolerance, tolerance);
+                cout << left << setw(12) << c.expression << right << scientific << setprecision(0) << setw(8) << tolerance
+                     << setw(10) << result.evaluations << setw(8) << result.pieces << setw(8) << result.rounds << fixed
+                     << setprecision(1) << setw(10) << result.seconds * 1e6 << scientific << setprecision(1) << setw(12)
+                     << result.error << setw(12) << fabs(result.integral - c.exact) << (result.converged ? "" : "  (not reached)")
+                     << "\n";
+            }
+        }
+        cout << "\nRoot of x^3 - 2*x - 5\n" << left << setw(14) << "method" << right << setw(8) << "tol" << setw(8) << "evals"
+             << setw(8) << "iters" << setw(10) << "us" << setw(12) << "|f(root)|" << "\n";
+        for (double tolerance : {1e-4, 1e-8, 1e-12}) {
+            RootFinder finder("x^3 - 2*x - 5", tolerance);
+            for (RootFinder::Result result : {finder.brent(0.0, 10.0), finder.newton(10.0)}) {
+                cout << left << setw(14) << result.method << right << scientific << setprecision(0) << setw(8) << tolerance
+                     << setw(8) << result.evaluations << setw(8) << result.iterations << fixed << setprecision(2) << setw(10)
+                     << result.seconds * 1e6 << scientific << setprecision(1) << setw(12) << fabs(result.value) << "\n";
+            }
+        }
+        cout << fixed;
+    }
+
+    static void cache(size_t n, size_t entries) {
+        const size_t universe = 200000;
+        vector<string> hexInputs(universe);
+        for (size_t k = 0; k < universe; ++k) {
+            char text[40];
+            snprintf(text, sizeof(text), "%016llx%016llx", static_cast<unsigned long long>(k * 0x9E3779B97F4A7C15ull),
+                     static_cast<unsigned long long>(k));
+            hexInputs[k] = text;
+        }
+        cout << "Result cache, " << entries << " entries, " << universe << " distinct inputs\n"
+             << left << setw(8) << "op" << right << setw(6) << "skew" << setw(14) << "direct ns/op"
+             << setw(14) << "cached ns/op" << setw(10) << "speedup" << setw(10) << "hit rate" << "  cache\n";
+        double sum = 0.0;
+        size_t length = 0;
+        for (const char* workload : {"pow", "log", "base"}) {
+            bool text = strcmp(workload, "base") == 0;
+            size_t count = text ? max<size_t>(n / 20, 1) : n;
+            for (double skew : {0.0, 0.8, 1.0, 1.2}) {
+                vector<uint32_t> keys = zipfKeys(count, universe, skew);
+                auto runAll = [&] {
+                    for (uint32_t k : keys) {
+                        if (text) {
+                            length += ResultCache::numberBase(hexInputs[k], 'H', 'D').size();
+                        } else if (workload[0] == 'p') {
+                            sum += ResultCache::calculate(1.0 + k * 1e-6, '^', 2.5 + (k & 7) * 0.1);
+                        } else {
+                            sum += ResultCache::logarithm(1.0 + k, 'N');
+                        }
+                    }
+                };
+                ResultCache::disable();
+                double direct = secondsFor(runAll);
+                ResultCache::enable(entries);
+                double cached = secondsFor(runAll);
+                CacheStats stats = text ? ResultCache::textStats() : ResultCache::numericStats();
+                uint64_t lookups = max<uint64_t>(stats.hits + stats.misses, 1);
+                cout << left << setw(8) << workload << right << fixed << setprecision(1) << setw(6) << skew
+                     << setprecision(2) << setw(14) << direct * 1e9 / count << setw(14) << cached * 1e9 / count
+                     << setw(9) << direct / cached << "x" << setprecision(1) << setw(9) << 100.0 * stats.hits / lookups
+                     << "%  " << (stats.enabled ? "on" : "off") << "\n";
+            }
+        }
+        ResultCache::disable();
+        cout << "(checksum " << sum + static_cast<double>(length) << ")\n";
+    }
+
+    // Result formatting: the ostringstream/setw tables and printf values used before, against
+    // TableLayout and to_chars writing into a reused buffer
+    static void formatting(size_t n) {
+        vector<double> values(n);
+        for (size_t i = 0; i < n; ++i) values[i] = (static_cast<double>(i % 100003) - 50000.0) * 1.37;
+        const int COL_WIDTH = 15;
+        size_t bytes = 0;
+        ostringstream stream;
+        double streamTables = secondsFor([&] {
+            for (double result : values) {
+                ostringstream oss;
+                oss << fixed << setprecision(2) << result;
+                string resultStr = oss.str();
+                stream << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
+                stream << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + "Input" + RESET_COLOR
+                       << "|" << setw(COL_WIDTH) << left << BLUE_COLOR + string("C to F") + RESET_COLOR
+                       << "|" << setw(COL_WIDTH) << left << GREEN_COLOR + resultStr + RESET_COLOR << "|\n";
+                stream << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+" << string(COL_WIDTH, '-') << "+\n";
+                if (stream.tellp() > (1 << 20)) {
+                    bytes += static_cast<size_t>(stream.tellp());
+                    stream.str("");
+                }
+            }
+        });
+        BufferedWriter buffer;
+        using Table = TableLayout<15, 15, 15>;
+        double layoutTables = secondsFor([&] {
+            for (double result : values) {
+                TextBuffer<320> number;
+                Table::rule(buffer);
+                Table::row(buffer, {BLUE_COLOR, "Input"}, {BLUE_COLOR, "C to F"}, {GREEN_COLOR, number.appendFixed(result)});
+                Table::rule(buffer);
+                if (buffer.size() > (1 << 20)) {
+                    bytes += buffer.size();
+                    buffer.clear();
+                }
+            }
+        });
+        char text[400];
+        double printfValues = secondsFor([&] {
+            for (double result : values) bytes += snprintf(text, sizeof(text), "%.2f\n", result);
+        });
+        double charsValues = secondsFor([&] {
+            for (double result : values) {
+                buffer.writeFixed(result);
+                buffer.put('\n');
+                if (buffer.size() > (1 << 20)) {
+                    bytes += buffer.size();
+                    buffer.clear();
+                }
+            }
+        });
+        cout << "Result formatting, " << n << " results\n" << left << setw(16) << "output" << right
+             << setw(14) << "before ns" << setw(14) << "after ns" << setw(12) << "speedup" << "\n"
+             << fixed << setprecision(2)
+             << left << setw(16) << "menu table" << right << setw(14) << streamTables * 1e9 / n
+             << setw(14) << layoutTables * 1e9 / n << setw(11) << streamTables / layoutTables << "x\n"
+             << left << setw(16) << "batch value" << right << setw(14) << printfValues * 1e9 / n
+             << setw(14) << charsValues * 1e9 / n << setw(11) << printfValues / charsValues << "x\n"
+             << "(" << bytes + buffer.size() << " bytes)\n";
+    }
+
+    // Batch input parsing with 5% malformed rows: exceptions against result codes, strtod against
+    // from_chars, and the digit scan with and without SIMD
+    static void parsing(size_t n) {
+        static const char* samples[] = {
+            "calc 3.5 ^ 2.25", "calc 30 S", "log 12345.678 N", "temp 98.6 F C", "len 12 F M",
+            "curr 100 I U", "unit 3 mi km", "base 1777777 O H", "radix 123456789abcdef0123456789abcdef 16 36",
+        };
+        static const char* malformed[] = {
+            "calc 3.5x ^ 2.25", "calc 30 Q Q", "log abc N", "temp 98.6 FF C", "unit 3 mi parsec",
+            "base 1787777 O H", "radix 123456789abcdefg 16 36", "conv 1 2 3",
+        };
+        string text;
+        vector<string_view> lines;
+        vector<pair<size_t, size_t>> spans;
+        for (size_t i = 0; i < n; ++i) {
+            const char* line = i % 20 == 7 ? malformed[(i / 20) % size(malformed)] : samples[(i * 7) % size(samples)];
+            spans.emplace_back(text.size(), strlen(line));
+            text += line;
+        }
+        for (auto [offset, length] : spans) lines.emplace_back(text.data() + offset, length);
+        double megabytes = text.size() / 1e6;
+        // Step 1: Whole rows, failing by exception and by status code
+        size_t failures = 0;
+        double thrown = secondsFor([&] {
+            for (string_view line : lines) {
+                try {
+                    BatchProcessor::parse(line);
+                } catch (const runtime_error&) {
+                    ++failures;
+                }
+            }
+        });
+        double coded = secondsFor([&] {
+            Operation op;
+            string_view field;
+            for (string_view line : lines) failures += BatchProcessor::tryParse(line, op, field) != ParseStatus::Ok;
+        });
+        // Step 2: Number fields alone
+        vector<string> numbers;
+        size_t numberBytes = 0;
+        for (size_t i = 0; i < n; ++i) {
+            numbers.push_back(to_string((static_cast<double>(i % 100003) - 50000.0) * 1.37));
+            numberBytes += numbers.back().size();
+        }
+        double sum = 0.0;
+        double strtodTime = secondsFor([&] {
+            for (const string& number : numbers) {
+                char* end = nullptr;
+                sum += strtod(number.c_str(), &end);
+                failures += end != number.c_str() + number.size();
+            }
+        });
+        double fromCharsTime = secondsFor([&] {
+            for (const string& number : numbers) {
+                double value = 0.0;
+                failures += NumberParser::parseDouble(number, value) != ParseStatus::Ok;
+                sum += value;
+            }
+        });
+        // Step 3: Digit validation over long hexadecimal strings
+        string digits(1 << 20, '0');
+        for (size_t i = 0; i < digits.size(); ++i) digits[i] = "0123456789abcdefABCDEF"[(i * 7919) % 22];
+        size_t rounds = max<size_t>(n / 4096, 1), scanned = 0;
+        double scalarScan = secondsFor([&] {
+            for (size_t r = 0; r < rounds; ++r) scanned += NumberParser::firstInvalidDigitScalar(digits, 16);
+        });
+        double simdScan = secondsFor([&] {
+            for (size_t r = 0; r < rounds; ++r) scanned += NumberParser::firstInvalidDigit(digits, 16);
+        });
+        double gigabytes = rounds * digits.size() / 1e9;
+        cout << "Input parsing, " << n << " rows (5% malformed), digit scan " << NumberParser::kernelName() << "\n"
+             << left << setw(16) << "stage" << right << setw(14) << "before" << setw(14) << "after" << setw(12) << "speedup" << "\n"
+             << fixed << setprecision(2)
+             << left << setw(16) << "rows MB/s" << right << setw(14) << megabytes / thrown
+             << setw(14) << megabytes / coded << setw(11) << thrown / coded << "x\n"
+             << left << setw(16) << "numbers MB/s" << right << setw(14) << numberBytes / 1e6 / strtodTime
+             << setw(14) << numberBytes / 1e6 / fromCharsTime << setw(11) << strtodTime / fromCharsTime << "x\n"
+             << left << setw(16) << "digits GB/s" << right << setw(14) << gigabytes / scalarScan
+             << setw(14) << gigabytes / simdScan << setw(11) << scalarScan / simdScan << "x\n"
+             << "(" << failures << " failures, checksum " << sum << ", " << scanned << " digits)\n";
+    }
+
+    // Heterogeneous batch on 1, 2, 4, ... threads up to maxThreads
+    static void scaling(size_t n, size_t maxThreads) {
+        static const char* samples[] = {
+            "calc 3.5 ^ 2.25", "calc 30 S", "log 12345.678 N", "temp 98.6 F C", "len 12 F M",
+            "curr 100 I U", "unit 3 mi km", "base 1777777 O H", "radix 123456789012345678901234567890 10 36",
+            "expr 2 * (3 + 4) ^ 2 - sin(30)",
+        };
+        string text;
+        vector<pair<size_t, size_t>> spans;
+        for (size_t i = 0; i < n; ++i) {
+            const char* sample = samples[(i * 7) % (sizeof(samples) / sizeof(samples[0]))];
+            spans.emplace_back(text.size(), strlen(sample));
+            text += sample;
+        }
+        vector<string_view> lines;
+        for (auto [offset, length] : spans) lines.emplace_back(text.data() + offset, length);
+        vector<size_t> counts;
+        for (size_t t = 1; t < maxThreads; t *= 2) counts.push_back(t);
+        counts.push_back(maxThreads);
+        cout << "Parallel batch, " << n << " operations\n" << left << setw(10) << "threads" << right
+             << setw(16) << "M ops/s" << setw(12) << "speedup" << "\n";
+        double base = 0.0;
+        for (size_t threads : counts) {
+            ParallelBatchExecutor executor(threads);
+            BufferedWriter sink;
+            double seconds = secondsFor([&] { executor.execute(lines, sink); });
+            double rate = n / seconds;
+            if (threads == 1) base = rate;
+            cout << left << setw(10) << threads << right << fixed << setprecision(2)
+                 << setw(16) << rate / 1e6 << setw(11) << rate / base << "x\n";
+        }
+    }
+};
+
+// Google Benchmark-style runner. Every case runs in growing batches until one batch takes at least
+// the minimum time, and reports time per item and throughput. The JSON output has the same layout
+// as Google Benchmark's --benchmark_out, so bench_compare and the usual tools can read it.
+class BenchmarkSuite {
+public:
+    struct State {
+        size_t iterations = 0;           // how many items the case processes in this run
+        double bytesPerItem = 0.0;       // set by cases that stream data, for bytes_per_second
+        map<string, double> counters;    // user counters, copied into the report as they are
+        bool fixedIterations = false;    // one-shot cases (memory footprint) run exactly once
+    };
+
+    using Case = function<void(State&)>;
+
+    struct Result {
+        string name;
+        size_t iterations = 0;
+        double realNs = 0.0, cpuNs = 0.0;   // per item
+        double bytesPerItem = 0.0;
+        map<string, double> counters;
+        string aggregate;                   // empty for a single run, else "mean", "median" or "stddev"
+        size_t repetition = 0;
+        bool oneShot = false;               // footprint cases report counters, not throughput
+
+        bool reportsRate() const { return !oneShot && aggregate != "stddev" && cpuNs > 0.0; }
+    };
+
+    // Keeps a value alive and opaque to the optimizer
+    template <typename T>
+    static void keep(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+private:
+    struct Entry {
+        string name;
+        Case fn;
+        function<void()> setup;   // untimed, once before the case's first run
+    };
+
+    vector<Entry> cases;
+    vector<Result> results;
+
+    static double cpuSeconds() {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    static Result measure(const string& name, const Case& fn, double minTime) {
+        size_t iterations = 1;
+        while (true) {
+            State state;
+            state.iterations = iterations;
+            auto start = chrono::steady_clock::now();
+            double cpuStart = cpuSeconds();
+            fn(state);
+            double cpu = cpuSeconds() - cpuStart;
+            double real = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            // Step 1: Report once the run was long enough, or for one-shot cases
+            if (real >= minTime || state.fixedIterations || iterations >= (size_t(1) << 40)) {
+                Result r;
+                r.name = name;
+                r.iterations = iterations;
+                r.realNs = real * 1e9 / iterations;
+                r.cpuNs = cpu * 1e9 / iterations;
+                r.bytesPerItem = state.bytesPerItem;
+                r.counters = move(state.counters);
+                r.oneShot = state.fixedIterations;
+                return r;
+            }
+            // Step 2: Otherwise aim 40% past the minimum time, growing at most tenfold per round
+            double factor = real > 0.0 ? minTime * 1.4 / real : 10.0;
+            iterations = max(iterations + 1, static_cast<size_t>(iterations * min(factor, 10.0)));
+        }
+    }
+
+    static Result aggregate(const vector<Result>& runs, const string& kind) {
+        Result r = runs.front();
+        r.aggregate = kind;
+        auto combine = [&](auto field) {
+            vector<double> values;
+            for (const Result& run : runs) values.push_back(run.*field);
+            sort(values.begin(), values.end());
+            double mean = 0.0;
+            for (double v : values) mean += v / values.size();
+            if (kind == "median") return values[values.size() / 2];
+            if (kind == "mean") return mean;
+            double variance = 0.0;
+            for (double v : values) variance += (v - mean) * (v - mean) / max<size_t>(values.size() - 1, 1);
+            return sqrt(variance);
+        };
+        r.realNs = combine(&Result::realNs);
+        r.cpuNs = combine(&Result::cpuNs);
+        return r;
+    }
+
+    static string human(double value) {
+        static const char* suffixes[] = {"", "k", "M", "G", "T"};
+        int i = 0;
+        while (fabs(value) >= 1000.0 && i < 4) {
+            value /= 1000.0;
+            ++i;
+        }
+        ostringstream out;
+        out << setprecision(value < 10.0 ? 3 : value < 100.0 ? 4 : 5) << value << suffixes[i];
+        return out.str();
+    }
+
+    static void jsonEscape(ostream& out, string_view text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+
+public:
+    void add(string name, Case fn, function<void()> setup = {}) { cases.push_back({move(name), move(fn), move(setup)}); }
+
+    void list(ostream& out) const {
+        for (const auto& c : cases) out << c.name << "\n";
+    }
+
+    // Runs every case whose name matches the filter; with repetitions > 1 each case also gets
+    // mean, median and standard deviation entries
+    void run(const string& filter, double minTime, size_t repetitions, ostream& console) {
+        regex pattern(filter.empty() ? "." : filter);
+        console << string(100, '-') << "\n"
+                << left << setw(40) << "Benchmark" << right << setw(15) << "Time" << setw(15) << "CPU" << setw(13)
+                << "Iterations" << " UserCounters...\n"
+                << string(100, '-') << "\n";
+        for (const auto& [name, fn, setup] : cases) {
+            if (!regex_search(name, pattern)) continue;
+            if (setup) setup();
+            vector<Result> runs;
+            for (size_t rep = 0; rep < repetitions; ++rep) {
+                runs.push_back(measure(name, fn, minTime));
+                runs.back().repetition = rep;
+                print(console, runs.back());
+            }
+            results.insert(results.end(), runs.begin(), runs.end());
+            if (repetitions > 1) {
+                for (const char* kind : {"mean", "median", "stddev"}) {
+                    results.push_back(aggregate(runs, kind));
+                    print(console, results.back());
+                }
+            }
+        }
+    }
+
+    // Nanoseconds scaled to ns, us or ms for the console
+    static void printTime(ostream& out, double ns) {
+        const char* unit = ns >= 1e6 ? " ms" : ns >= 1e4 ? " us" : " ns";
+        out << setw(12) << (ns >= 1e6 ? ns / 1e6 : ns >= 1e4 ? ns / 1e3 : ns) << unit;
+    }
+
+    static void print(ostream& out, const Result& r) {
+        string name = r.aggregate.empty() ? r.name : r.name + "_" + r.aggregate;
+        out << left << setw(40) << name << right << fixed << setprecision(2);
+        printTime(out, r.realNs);
+        printTime(out, r.cpuNs);
+        out << setw(13) << r.iterations;
+        if (r.reportsRate()) {
+            out << " items_per_second=" << human(1e9 / r.cpuNs) << "/s";
+            if (r.bytesPerItem > 0.0) out << " bytes_per_second=" << human(r.bytesPerItem * 1e9 / r.cpuNs) << "B/s";
+        }
+        for (const auto& [counter, value] : r.counters) out << " " << counter << "=" << human(value);
+        out << "\n";
+    }
+
+    void writeJson(ostream& out, const string& executable) const {
+        char date[64];
+        time_t now = time(nullptr);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+        char host[256] = "";
+        gethostname(host, sizeof(host) - 1);
+        out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n    \"host_name\": ";
+        jsonEscape(out, host);
+        out << ",\n    \"executable\": ";
+        jsonEscape(out, executable);
+        out << ",\n    \"num_cpus\": " << thread::hardware_concurrency() << ",\n    \"mhz_per_cpu\": 0"
+            << ",\n    \"cpu_scaling_enabled\": false,\n    \"library_build_type\": "
+#ifdef NDEBUG
+            << "\"release\""
+#else
+            << "\"debug\""
+#endif
+            << ",\n    \"column_kernel\": \"" << LinearKernel::name() << "\",\n    \"digit_kernel\": \""
+            << NumberParser::kernelName() << "\"\n  },\n  \"benchmarks\": [";
+        bool first = true;
+        for (const Result& r : results) {
+            string name = r.aggregate.empty() ? r.name : r.name + "_" + r.aggregate;
+            out << (first ? "\n" : ",\n") << "    {\n      \"name\": ";
+            jsonEscape(out, name);
+            out << ",\n      \"run_name\": ";
+            jsonEscape(out, r.name);
+            out << ",\n      \"run_type\": \"" << (r.aggregate.empty() ? "iteration" : "aggregate") << "\",\n"
+                << "      \"repetition_index\": " << r.repetition << ",\n";
+            if (!r.aggregate.empty()) out << "      \"aggregate_name\": \"" << r.aggregate << "\",\n";
+            out << setprecision(17) << defaultfloat << "      \"iterations\": " << r.iterations << ",\n"
+                << "      \"real_time\": " << r.realNs << ",\n      \"cpu_time\": " << r.cpuNs << ",\n"
+                << "      \"time_unit\": \"ns\"";
+            if (r.reportsRate()) {
+                out << ",\n      \"items_per_second\": " << 1e9 / r.cpuNs;
+                if (r.bytesPerItem > 0.0) out << ",\n      \"bytes_per_second\": " << r.bytesPerItem * 1e9 / r.cpuNs;
+            }
+            for (const auto& [counter, value] : r.counters) out << ",\n      \"" << counter << "\": " << value;
+            out << "\n    }";
+            first = false;
+        }
+        out << "\n  ]\n}\n";
+    }
+};
+
+// The regression suite: scalar and bulk throughput of every operation, parsing and formatting
+// cost, history growth and memory footprint
+class EngineBenchmarks {
+private:
+    using State = BenchmarkSuite::State;
+
+    static Operation parsed(const char* line) { return BatchProcessor::parse(line); }
+
+    // Heap bytes in use, for the footprint cases
+    static double heapBytes() {
+#ifdef __GLIBC__
+        return static_cast<double>(mallinfo2().uordblks);
+#else
+        return 0.0;
+#endif
+    }
+
+    // Converts a 4096-value column one value at a time with the given function; an item is one value
+    template <typename Convert>
+    static void perValue(State& state, Convert convert) {
+        vector<double> in(4096), out(4096);
+        for (size_t i = 0; i < in.size(); ++i) in[i] = 1.0 + static_cast<double>(i) * 0.25;
+        for (size_t done = 0; done < state.iterations; done += in.size()) {
+            size_t n = min(in.size(), state.iterations - done);
+            for (size_t i = 0; i < n; ++i) out[i] = convert(in[i]);
+            BenchmarkSuite::keep(out[0]);
+        }
+    }
+
+    static vector<string> sampleLines(size_t n) {
+        static const char* samples[] = {
+            "calc 3.5 ^ 2.25", "calc 30 S", "log 12345.678 N", "temp 98.6 F C", "len 12 F M",
+            "curr 100 I U", "unit 3 mi km", "base 1777777 O H", "radix 123456789012345678901234567890 10 36",
+            "expr 2 * (3 + 4) ^ 2 - sin(30)",
+        };
+        vector<string> lines;
+        for (size_t i = 0; i < n; ++i) lines.emplace_back(samples[(i * 7) % size(samples)]);
+        return lines;
+    }
+
+public:
+    static void registerAll(BenchmarkSuite& suite) {
+        // Step 1: One operation at a time, through the same evaluate() the batch and server use
+        static const pair<const char*, const char*> scalar[] = {
+            {"scalar/calc_add", "calc 3.5 + 2.25"}, {"scalar/calc_pow", "calc 3.5 ^ 2.25"},
+            {"scalar/calc_sin", "calc 30 S"},       {"scalar/temperature", "temp 98.6 F C"},
+            {"scalar/length", "len 12 F M"},        {"scalar/unit", "unit 3 mi km"},
+            {"scalar/currency", "curr 100 I U"},    {"scalar/logarithm", "log 12345.678 N"},
+            {"scalar/number_base", "base 1777777 O H"},
+            {"scalar/radix", "radix 123456789012345678901234567890 10 36"},
+            {"scalar/expression", "expr 2 * (3 + 4) ^ 2 - sin(30)"},
+        };
+        for (const auto& [name, line] : scalar) {
+            suite.add(name, [op = parsed(line)](State& state) {
+                for (size_t i = 0; i < state.iterations; ++i) {
+                    OperationResult r = BatchProcessor::evaluate(op);
+                    BenchmarkSuite::keep(r.number);
+                }
+            });
+        }
+        suite.add("scalar/expression_compiled", [](State& state) {
+            CompiledExpression expression("2 * x ^ 2 + sin(y)");
+            vector<double> values = {3.0, 30.0};
+            for (size_t i = 0; i < state.iterations; ++i) BenchmarkSuite::keep(expression.evaluate(values));
+        });
+
+        // Step 2: Whole columns and files; an item is one value or one line
+        suite.add("bulk/temperature_column", [](State& state) { column<TemperatureConverter>(state, 'C', 'F'); });
+        suite.add("bulk/length_column", [](State& state) { column<LengthConverter>(state, 'M', 'F'); });
+        for (auto [name, function] : {pair{"bulk/fastmath_sin", FastMath::Function::Sin}, pair{"bulk/fastmath_ln", FastMath::Function::Ln}}) {
+            suite.add(name, [function](State& state) {
+                vector<double> in(4096), out(4096);
+                for (size_t i = 0; i < in.size(); ++i) in[i] = 0.5 + static_cast<double>(i) * 0.37;
+                state.bytesPerItem = 16.0;
+                for (size_t done = 0; done < state.iterations; done += in.size()) {
+                    size_t n = min(in.size(), state.iterations - done);
+                    FastMath::compute(function, span<const double>(in.data(), n), span<double>(out.data(), n), FastMath::Accuracy::Ulp1);
+                    BenchmarkSuite::keep(out[0]);
+                }
+            });
+        }
+        suite.add("bulk/batch_lines", [](State& state) {
+            vector<string> lines = sampleLines(4096);
+            BufferedWriter sink;
+            for (size_t i = 0; i < state.iterations; ++i) {
+                BatchProcessor::processLine(lines[i % lines.size()], sink);
+                if (sink.size() > (1 << 20)) sink.clear();
+            }
+        });
+        // The same lines with every operation captured, to see what --trace costs
+        suite.add("bulk/batch_lines_traced", [](State& state) {
+            vector<string> lines = sampleLines(4096);
+            BufferedWriter sink;
+            TraceCapture::start("/dev/null");
+            for (size_t i = 0; i < state.iterations; ++i) {
+                BatchProcessor::processLine(lines[i % lines.size()], sink);
+                if (sink.size() > (1 << 20)) sink.clear();
+            }
+            TraceCapture::stop();
+        });
+        suite.add("bulk/batch_lines_parallel", [](State& state) {
+            static ParallelBatchExecutor executor(max<size_t>(thread::hardware_concurrency(), 1));
+            vector<string> text = sampleLines(min<size_t>(state.iterations, 1 << 16));
+            vector<string_view> lines(text.begin(), text.end());
+            BufferedWriter sink;
+            for (size_t done = 0; done < state.iterations; done += lines.size()) {
+                size_t n = min(lines.size(), state.iterations - done);
+                executor.execute(vector<string_view>(lines.begin(), lines.begin() + n), sink);
+                sink.clear();
+            }
+        });
+        suite.add("bulk/radix_digits", [](State& state) {
+            string digits(100000, '7');
+            for (size_t i = 0; i < digits.size(); i += 7) digits[i] = static_cast<char>('1' + i % 9);
+            for (size_t done = 0; done < state.iterations; done += digits.size()) {
+                BenchmarkSuite::keep(RadixConverter::convert(digits, 10, 16).size());
+            }
+        });
+
+        suite.add("bulk/aggregate_converted", [](State& state) {
+            vector<double> in(4096);
+            for (size_t i = 0; i < in.size(); ++i) in[i] = 0.5 + static_cast<double>(i % 997) * 0.37;
+            LinearFactors f = TemperatureConverter::linearFactors('C', 'F');
+            StreamingStats stats;
+            state.bytesPerItem = 8.0;
+            for (size_t done = 0; done < state.iterations; done += in.size()) {
+                stats.addConverted(span<const double>(in.data(), min(in.size(), state.iterations - done)), f);
+            }
+            BenchmarkSuite::keep(stats.mean());
+        });
+        suite.add("bulk/column_file_convert", [](State& state) {
+            // A 2M-value column file mapped in, converted and written to a mapped output file
+            struct InputFile {
+                string path = "/tmp/techneon_bench_" + to_string(getpid()) + ".col";
+                InputFile() {
+                    ColumnWriter writer(path, ColumnType::Float64, 1 << 21, false);
+                    span<double> values = writer.doubles();
+                    for (size_t i = 0; i < values.size(); ++i) values[i] = 10.0 + static_cast<double>(i % 1000) * 0.5;
+                    writer.finish();
+                }
+                ~InputFile() { unlink(path.c_str()); }
+            };
+            static const InputFile input;
+            unique_ptr<ColumnFile> in = ColumnFile::load(input.path);
+            ColumnConverter::Conversion conversion = ColumnConverter::parse("len", "M", "F");
+            string output = input.path + ".out";
+            state.bytesPerItem = 16.0;
+            for (size_t done = 0; done < state.iterations; done += in->size()) {
+                ColumnWriter out(output, ColumnType::Float64, in->size(), false);
+                ColumnConverter::run(conversion, *in, out, 1);
+                out.finish();
+            }
+            unlink(output.c_str());
+        });
+        suite.add("bulk/ledger_double", [](State& state) {
+            vector<double> in(1 << 16), out(1 << 16);
+            for (size_t i = 0; i < in.size(); ++i) in[i] = static_cast<double>((i * 7919) % 1000000) / 100.0;
+            state.bytesPerItem = 16.0;
+            double total = 0.0;
+            for (size_t done = 0; done < state.iterations; done += in.size()) {
+                size_t n = min(in.size(), state.iterations - done);
+                CurrencyConverter::convert(span<const double>(in.data(), n), span<double>(out.data(), n), 'I', 'U');
+                for (size_t i = 0; i < n; ++i) total += out[i];
+            }
+            BenchmarkSuite::keep(total);
+        });
+        suite.add("bulk/ledger_decimal", [](State& state) {
+            vector<int64_t> in(1 << 16), out(1 << 16);
+            for (size_t i = 0; i < in.size(); ++i) in[i] = static_cast<int64_t>((i * 7919) % 1000000);
+            MoneyRate rate = MoneyRate::between("INR", "USD", 2, 2);
+            state.bytesPerItem = 16.0;
+            __int128 total = 0;
+            for (size_t done = 0; done < state.iterations; done += in.size()) {
+                size_t n = min(in.size(), state.iterations - done);
+                total += MoneyKernel::convert(span<const int64_t>(in.data(), n), span<int64_t>(out.data(), n), rate);
+            }
+            BenchmarkSuite::keep(static_cast<int64_t>(total));
+        });
+        suite.add("bulk/aggregate_merge", [](State& state) {
+            // An item is one merged partial state of 64K values, as a worker hands back per block
+            StreamingStats part;
+            for (size_t i = 0; i < 65536; ++i) part.add(static_cast<double>((i * 7919) % 65536));
+            StreamingStats total;
+            for (size_t i = 0; i < state.iterations; ++i) total.merge(part);
+            BenchmarkSuite::keep(total.quantile(0.5));
+        });
+
+        // Step 3: Typed quantities against the same arithmetic by hand and through the runtime registry
+        suite.add("units/handwritten_mi_to_km", [](State& state) { perValue(state, [](double x) { return x * 1.609344; }); });
+        suite.add("units/quantity_mi_to_km", [](State& state) {
+            perValue(state, [](double x) { return quantityCast<units::Kilometer>(Quantity<double, units::Mile>(x)).value(); });
+        });
+        suite.add("units/registry_mi_to_km", [](State& state) {
+            const UnitRegistry& registry = UnitRegistry::instance();
+            int from = registry.find("mi"), to = registry.find("km");
+            perValue(state, [&](double x) { return registry.convert(x, from, to); });
+        });
+        suite.add("units/handwritten_c_to_f", [](State& state) { perValue(state, [](double x) { return x * 1.8 + 32.0; }); });
+        suite.add("units/quantity_c_to_f", [](State& state) {
+            perValue(state, [](double x) { return quantityCast<units::Fahrenheit>(Quantity<double, units::Celsius>(x)).value(); });
+        });
+        suite.add("units/converter_c_to_f", [](State& state) {
+            perValue(state, [](double x) { return TemperatureConverter(x, 'C', 'F').convert(); });
+        });
+        suite.add("units/quantity_chain_mi_km_m_ft", [](State& state) {
+            perValue(state, [](double x) { return Conversion<units::Mile, units::Kilometer, units::Meter, units::Foot>::apply(x); });
+        });
+
+        // Step 4: Input parsing; an item is one row, one number or one digit
+        suite.add("parse/row", [](State& state) {
+            vector<string> lines = sampleLines(4096);
+            double bytes = 0.0;
+            for (const string& line : lines) bytes += line.size();
+            state.bytesPerItem = bytes / lines.size();
+            Operation op;
+            string_view field;
+            for (size_t i = 0; i < state.iterations; ++i) {
+                BenchmarkSuite::keep(BatchProcessor::tryParse(lines[i % lines.size()], op, field));
+            }
+        });
+        suite.add("parse/double", [](State& state) {
+            vector<string> numbers;
+            for (size_t i = 0; i < 4096; ++i) numbers.push_back(to_string((static_cast<double>(i) - 2048.0) * 1.37));
+            double value = 0.0;
+            for (size_t i = 0; i < state.iterations; ++i) {
+                NumberParser::parseDouble(numbers[i % numbers.size()], value);
+                BenchmarkSuite::keep(value);
+            }
+        });
+        suite.add("parse/digits", [](State& state) {
+            string digits(1 << 16, '0');
+            for (size_t i = 0; i < digits.size(); ++i) digits[i] = "0123456789abcdefABCDEF"[(i * 7919) % 22];
+            state.bytesPerItem = 1.0;
+            for (size_t done = 0; done < state.iterations; done += digits.size()) {
+                BenchmarkSuite::keep(NumberParser::firstInvalidDigit(string_view(digits).substr(0, min(digits.size(), state.iterations - done)), 16));
+            }
+        });
+        suite.add("parse/expression_compile", [](State& state) {
+            for (size_t i = 0; i < state.iterations; ++i) BenchmarkSuite::keep(CompiledExpression("2 * (3 + x) ^ 2 - sin(30)").evaluate({{1.0}}));
+        });
+
+        // Step 5: Formatting one result in every output style
+        for (auto [name, style] : {pair{"format/plain", OutputFormat::Style::Plain}, pair{"format/json", OutputFormat::Style::Json},
+                                   pair{"format/csv", OutputFormat::Style::Csv}}) {
+            suite.add(name, [style](State& state) {
+                OutputFormat::Style previous = OutputFormat::style();
+                OutputFormat::select(style);
+                BufferedWriter sink;
+                for (size_t i = 0; i < state.iterations; ++i) {
+                    OutputFormat::result(sink, "Temperature", "temp 98.6 F C", 37.0 + static_cast<double>(i & 1023) * 0.01);
+                    sink.put('\n');
+                    if (sink.size() > (1 << 20)) sink.clear();
+                }
+                OutputFormat::select(previous);
+            });
+        }
+        suite.add("format/table_row", [](State& state) {
+            BufferedWriter sink;
+            using Table = TableLayout<15, 15, 15>;
+            for (size_t i = 0; i < state.iterations; ++i) {
+                TextBuffer<64> number;
+                Table::row(sink, {BLUE_COLOR, "Input"}, {BLUE_COLOR, "C to F"}, {GREEN_COLOR, number.appendFixed(static_cast<double>(i))});
+                if (sink.size() > (1 << 20)) sink.clear();
+            }
+        });
+
+        // Step 6: History growth; the ring spills to an anonymous file once it is full
+        suite.add("history/append", [](State& state) {
+            HistoryStore store(4096);
+            for (size_t i = 0; i < state.iterations; ++i) {
+                store.append(HistoryRecord::make(OpKind::Calculator, static_cast<double>(i), 2.0, static_cast<double>(i) + 2.0));
+            }
+        });
+        suite.add("history/query_last_100", [](State& state) {
+            static HistoryStore store(4096);
+            static bool filled = [] {
+                for (size_t i = 0; i < 100000; ++i) store.append(HistoryRecord::make(OpKind::Unit, static_cast<double>(i), 0.0, 1.0));
+                return true;
+            }();
+            BenchmarkSuite::keep(filled);
+            for (size_t i = 0; i < state.iterations; ++i) BenchmarkSuite::keep(store.last(100).size());
+        });
+        // One page of the history view over a million records: the newest page, a page of one type
+        // that appears only at the start of the log, and a jump into the middle
+        static unique_ptr<HistoryStore> million;
+        auto millionRecords = [] {
+            if (!million) {
+                million = make_unique<HistoryStore>(4096);
+                for (size_t i = 0; i < 1000000; ++i) {
+                    OpKind kind = i < 50 ? OpKind::Currency : OpKind::Unit;
+                    million->append(HistoryRecord::make(kind, static_cast<double>(i), 0.0, 1.0));
+                }
+            }
+            return million.get();
+        };
+        suite.add("history/page_newest", [=](State& state) {
+            HistoryCursor cursor(*millionRecords(), 40);
+            for (size_t i = 0; i < state.iterations; ++i) {
+                cursor.newest();
+                BenchmarkSuite::keep(cursor.entries().size());
+            }
+        });
+        suite.add("history/page_filtered", [=](State& state) {
+            HistoryCursor cursor(*millionRecords(), 40);
+            HistoryStore::Query q;
+            q.anyKind = false;
+            q.kind = OpKind::Currency;
+            for (size_t i = 0; i < state.iterations; ++i) {
+                cursor.select(q);
+                BenchmarkSuite::keep(cursor.entries().size());
+            }
+        });
+        suite.add("history/page_jump", [=](State& state) {
+            HistoryCursor cursor(*millionRecords(), 40);
+            for (size_t i = 0; i < state.iterations; ++i) {
+                cursor.jump(500000 + (i & 1023));
+                BenchmarkSuite::keep(cursor.entries().size());
+            }
+        });
+
+        // Step 7: One edit in a 1M-cell sheet of 1000 chains of 1000 cells; every chain starts from
+        // its own input plus a shared root. An item is one edit and its recomputation.
+        static unique_ptr<Sheet> chains;
+        auto buildChains = [] {
+            if (chains) return;
+            auto cell = [](int chain, int i) {
+                TextBuffer<32> name;
+                name.append('x').appendInt(chain);
+                if (i >= 0) name.append('_').appendInt(i);
+                return string(name.view());
+            };
+            chains = make_unique<Sheet>();
+            chains->set("root", 1.0);
+            for (int c = 0; c < 1000; ++c) {
+                chains->set(cell(c, -1), static_cast<double>(c));
+                chains->define(cell(c, 0), cell(c, -1) + " + root");
+                for (int i = 1; i < 1000; ++i) chains->define(cell(c, i), cell(c, i - 1) + " * 1.0001 + 1");
+            }
+        };
+        suite.add("sheet/edit_one_input", [](State& state) {
+            static double next = 0.0;
+            for (size_t i = 0; i < state.iterations; ++i) {
+                TextBuffer<32> name;
+                chains->set(string(name.append('x').appendInt(static_cast<long long>(i % 1000)).view()), next += 1.0);
+            }
+            state.counters["recomputed"] = static_cast<double>(chains->lastUpdate().recomputed);
+        }, buildChains);
+        suite.add("sheet/edit_root", [](State& state) {
+            static double next = 1.0;
+            for (size_t i = 0; i < state.iterations; ++i) chains->set("root", next += 1.0);
+            state.counters["recomputed"] = static_cast<double>(chains->lastUpdate().recomputed);
+        }, buildChains);
+
+        // Step 8: Matrix products; an item is one product, gflop the work in it
+        for (size_t n : {64, 256, 1024}) {
+            suite.add("matrix/multiply_" + to_string(n), [n](State& state) { matrixProduct(state, n, false); });
+        }
+        suite.add("matrix/naive_256", [](State& state) { matrixProduct(state, 256, true); });
+        suite.add("matrix/solve_256", [](State& state) {
+            MatrixArena arena;
+            Matrix a = Matrix::allocate(arena, 256, 256), b = Matrix::allocate(arena, 256, 1);
+            Matrix lu = Matrix::allocate(arena, 256, 256), x = Matrix::allocate(arena, 256, 1);
+            for (size_t r = 0; r < 256; ++r) {
+                for (size_t c = 0; c < 256; ++c) a.at(r, c) = (r == c ? 256.0 : 0.0) + sin(static_cast<double>(r * 31 + c * 17));
+                b.at(r, 0) = static_cast<double>(r);
+            }
+            for (size_t i = 0; i < state.iterations; ++i) {
+                memcpy(lu.data, a.data, a.bytes());
+                memcpy(x.data, b.data, b.bytes());
+                MatrixEngine::solve(lu, x);
+                BenchmarkSuite::keep(x.data[0]);
+            }
+        });
+
+        // Step 9: Solvers; an item is one root or one integral, evaluations the integrand points it took
+        suite.add("solve/brent", [](State& state) {
+            RootFinder finder("x^3 - 2*x - 5");
+            RootFinder::Result result;
+            for (size_t i = 0; i < state.iterations; ++i) BenchmarkSuite::keep((result = finder.brent(0.0, 10.0)).root);
+            state.counters["evaluations"] = static_cast<double>(result.evaluations);
+        });
+        suite.add("solve/newton", [](State& state) {
+            RootFinder finder("x^3 - 2*x - 5");
+            RootFinder::Result result;
+            for (size_t i = 0; i < state.iterations; ++i) BenchmarkSuite::keep((result = finder.newton(10.0)).root);
+            state.counters["evaluations"] = static_cast<double>(result.evaluations);
+        });
+        for (auto [name, expression] : {pair{"solve/integrate_smooth", "1/(1+x^2)"}, pair{"solve/integrate_singular", "x^-0.5"}}) {
+            suite.add(name, [expression](State& state) {
+                AdaptiveIntegrator integrator(1);
+                AdaptiveIntegrator::Result result;
+                for (size_t i = 0; i < state.iterations; ++i) {
+                    BenchmarkSuite::keep((result = integrator.integrate(expression, 0.0, 1.0, 1e-10, 1e-10)).integral);
+                }
+                state.counters["evaluations"] = static_cast<double>(result.evaluations);
+            });
+        }
+        // An item is one point: the expression per point against once per column
+        for (bool column : {false, true}) {
+            suite.add(column ? "solve/eval_column" : "solve/eval_scalar", [column](State& state) {
+                CompiledExpression expression("3*x^2 - 2*x + 1/(1+x*x)");
+                vector<double> points(1024), values(1024);
+                for (size_t i = 0; i < points.size(); ++i) points[i] = static_cast<double>(i) / 100.0;
+                state.bytesPerItem = 16;
+                for (size_t i = 0; i < state.iterations; i += points.size()) {
+                    if (column) {
+                        expression.evaluateColumn(points, values);
+                    } else {
+                        for (size_t k = 0; k < points.size(); ++k) values[k] = expression.evaluate(span<const double>(&points[k], 1));
+                    }
+                    BenchmarkSuite::keep(values[i % points.size()]);
+                }
+            });
+        }
+
+        // Step 10: Memory footprint, one run each; counters are bytes per item (lower is better)
+        suite.add("memory/history_1m_records", [](State& state) {
+            state.fixedIterations = true;
+            double before = heapBytes();
+            HistoryStore store(4096);
+            for (size_t i = 0; i < 1000000; ++i) {
+                store.append(HistoryRecord::make(OpKind::Calculator, static_cast<double>(i), 2.0, static_cast<double>(i) + 2.0));
+            }
+            state.counters["bytes_per_item"] = (heapBytes() - before) / 1e6;
+        });
+        suite.add("memory/result_cache_64k_entries", [](State& state) {
+            state.fixedIterations = true;
+            double before = heapBytes();
+            ShardedClockCache<NumericKey, double, NumericKeyHash> cache(1 << 16);
+            for (uint64_t i = 0; i < (1 << 16); ++i) {
+                cache.getOrCompute(NumericKey{i, i + 1, '^'}, [&] { return static_cast<double>(i); });
+            }
+            state.counters["bytes_per_item"] = (heapBytes() - before) / (1 << 16);
+        });
+    }
+
+private:
+    static void matrixProduct(State& state, size_t n, bool naive) {
+        static MatrixEngine engine;
+        MatrixArena arena;
+        Matrix a = Matrix::allocate(arena, n, n), b = Matrix::allocate(arena, n, n), c = Matrix::allocate(arena, n, n);
+        Benchmarks::fillMatrix(a, 1.0);
+        Benchmarks::fillMatrix(b, 2.0);
+        for (size_t i = 0; i < state.iterations; ++i) {
+            if (naive) Benchmarks::naiveMultiply(a, b, c, n);
+            else engine.multiply(a, b, c);
+            BenchmarkSuite::keep(c.data[0]);
+        }
+        state.counters["gflop"] = 2.0 * n * n * n / 1e9;
+    }
+
+    template <typename ConverterType>
+    static void column(State& state, char from, char to) {
+        vector<double> in(1 << 16), out(1 << 16);
+        for (size_t i = 0; i < in.size(); ++i) in[i] = static_cast<double>(i) * 0.5 - 1000.0;
+        state.bytesPerItem = 16.0;
+        for (size_t done = 0; done < state.iterations; done += in.size()) {
+            size_t n = min(in.size(), state.iterations - done);
+            ConverterType::convert(span<const double>(in.data(), n), span<double>(out.data(), n), from, to);
+            BenchmarkSuite::keep(out[0]);
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    try {
+        // The detailed before/after reports
+        string mode = args.empty() ? "" : args[0];
+        auto count = [&](size_t fallback) {
+            return args.size() >= 2 ? max<size_t>(strtoull(args[1].c_str(), nullptr, 10), 1) : fallback;
+        };
+        if (mode == "--bench-convert") {
+            Benchmarks::conversions(count(10000000));
+            return 0;
+        }
+        if (mode == "--bench-radix") {
+            vector<size_t> sizes;
+            for (size_t i = 1; i < args.size(); ++i) sizes.push_back(max<size_t>(strtoull(args[i].c_str(), nullptr, 10), 1));
+            if (sizes.empty()) sizes = {1000, 100000, 1000000};
+            Benchmarks::radix(sizes);
+            return 0;
+        }
+        if (mode == "--bench-expr") {
+            Benchmarks::expressions(count(1000000));
+            return 0;
+        }
+        if (mode == "--bench-scaling") {
+            size_t threads = args.size() >= 3 ? strtoull(args[2].c_str(), nullptr, 10) : thread::hardware_concurrency();
+            Benchmarks::scaling(count(2000000), max<size_t>(threads, 1));
+            return 0;
+        }
+        if (mode == "--selftest-fastmath") {
+            return Benchmarks::fastMathAccuracy() ? 0 : 1;
+        }
+        if (mode == "--bench-fastmath") {
+            Benchmarks::fastMath(count(1 << 24));
+            return 0;
+        }
+        if (mode == "--bench-parse") {
+            Benchmarks::parsing(count(1000000));
+            return 0;
+        }
+        if (mode == "--bench-format") {
+            Benchmarks::formatting(count(2000000));
+            return 0;
+        }
+        if (mode == "--bench-cache") {
+            size_t entries = args.size() >= 3 ? max<size_t>(strtoull(args[2].c_str(), nullptr, 10), 1) : 16384;
+            Benchmarks::cache(count(2000000), entries);
+            return 0;
+        }
+        if (mode == "--bench-money") {
+            Benchmarks::money(count(100000000));
+            return 0;
+        }
+        if (mode == "--bench-matrix") {
+            Benchmarks::matrices(count(4096));
+            return 0;
+        }
+        if (mode == "--bench-solvers") {
+            Benchmarks::solvers(count(thread::hardware_concurrency()));
+            return 0;
+        }
+        if (mode == "--bench-rates") {
+            Benchmarks::rateReloads(count(2));
+            return 0;
+        }
+        // The regression suite, with Google Benchmark's flags
+        string filter, outPath, format = "console";
+        double minTime = 0.2;
+        size_t repetitions = 1;
+        bool listOnly = false;
+        for (const string& arg : args) {
+            auto value = [&](const char* flag) {
+                size_t len = strlen(flag);
+                return arg.compare(0, len, flag) == 0 ? optional<string>(arg.substr(len)) : nullopt;
+            };
+            if (auto v = value("--benchmark_filter=")) filter = *v;
+            else if (auto v = value("--benchmark_min_time=")) minTime = strtod(v->c_str(), nullptr);
+            else if (auto v = value("--benchmark_repetitions=")) repetitions = max<size_t>(strtoull(v->c_str(), nullptr, 10), 1);
+            else if (auto v = value("--benchmark_out=")) outPath = *v;
+            else if (auto v = value("--benchmark_format=")) format = *v;
+            else if (arg == "--benchmark_list_tests" || arg == "--benchmark_list_tests=true") listOnly = true;
+            else throw runtime_error("Unknown option " + arg);
+        }
+        BenchmarkSuite suite;
+        EngineBenchmarks::registerAll(suite);
+        if (listOnly) {
+            suite.list(cout);
+            return 0;
+        }
+        // With --benchmark_format=json the console table goes to stderr, like Google Benchmark
+        suite.run(filter, minTime, repetitions, format == "json" ? cerr : cout);
+        if (format == "json") suite.writeJson(cout, argv[0]);
+        if (!outPath.empty()) {
+            ofstream out(outPath, ios::trunc);
+            if (!out) throw runtime_error("Cannot write " + outPath);
+            suite.writeJson(out, argv[0]);
+        }
+    } catch (const exception& e) {
+        cerr << RED_COLOR << "Error: " << e.what() << RESET_COLOR << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,605 @@
+// Line-oriented batch processing, single-threaded and on a work-stealing pool
+#pragma once
+
+#include "techneon/format.hpp"
+#include "techneon/metrics.hpp"
+#include "techneon/trace.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+class ChunkedLineReader {
+private:
+    FILE* file;
+    vector<char> buffer;
+    size_t begin = 0, end = 0;
+    bool eof = false;
+
+public:
+    explicit ChunkedLineReader(FILE* in, size_t chunkSize = 1 << 20) : file(in), buffer(chunkSize) {}
+
+    bool nextLine(string_view& line) {
+        while (true) {
+            // Step 1: Return the next complete line already in the buffer
+            const char* start = buffer.data() + begin;
+            const void* newline = memchr(start, '\n', end - begin);
+            if (newline) {
+                size_t len = static_cast<const char*>(newline) - start;
+                line = string_view(start, len);
+                begin += len + 1;
+                return true;
+            }
+            // Step 2: At end of input, hand out the unterminated tail once
+            if (eof) {
+                if (begin == end) return false;
+                line = string_view(start, end - begin);
+                begin = end;
+                return true;
+            }
+            // Step 3: Move the partial line to the front, growing the buffer for very long lines
+            if (begin > 0) {
+                memmove(buffer.data(), start, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+            if (end == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+            // Step 4: Read the next chunk; read() returns what a pipe has instead of waiting for a full buffer
+            ssize_t got = ::read(fileno(file), buffer.data() + end, buffer.size() - end);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) eof = true;
+            else end += static_cast<size_t>(got);
+        }
+    }
+};
+
+// Where a batch line failed. column is the 1-based offset of the offending field, or 0 when the
+// whole line is at fault or the operation parsed but could not be computed.
+struct RowError {
+    size_t row = 0;
+    size_t column = 0;
+    TextBuffer<192> message;
+};
+
+class BatchProcessor {
+private:
+    static constexpr size_t MAX_TOKENS = 5;
+
+    // Returns MAX_TOKENS + 1 when the line has more fields than any command takes
+    static size_t tokenize(string_view line, string_view* tokens) {
+        size_t count = 0, i = 0;
+        while (i < line.size()) {
+            while (i < line.size() && isspace(static_cast<unsigned char>(line[i]))) ++i;
+            if (i == line.size()) break;
+            size_t start = i;
+            while (i < line.size() && !isspace(static_cast<unsigned char>(line[i]))) ++i;
+            if (count == MAX_TOKENS) return MAX_TOKENS + 1;
+            tokens[count++] = line.substr(start, i - start);
+        }
+        return count;
+    }
+
+    static ParseStatus parseCode(string_view token, char& code) {
+        if (token.size() != 1) return ParseStatus::InvalidCode;
+        code = static_cast<char>(toupper(static_cast<unsigned char>(token[0])));
+        return ParseStatus::Ok;
+    }
+
+    // Digits of a number base or radix operation, checked before any conversion work is done.
+    // Bad codes and bases are left for the converters, which report them as before.
+    static bool validDigits(string_view digits, int base) {
+        if (!digits.empty() && (digits[0] == '-' || digits[0] == '+')) digits.remove_prefix(1);
+        return !digits.empty() && NumberParser::firstInvalidDigit(digits, base) == digits.size();
+    }
+
+    static int baseOfCode(char code) {
+        switch (code) {
+            case 'B': return 2;
+            case 'D': return 10;
+            case 'O': return 8;
+            case 'H': return 16;
+            default: return 0;
+        }
+    }
+
+public:
+    // Line format (fields separated by whitespace, '#' starts a comment line):
+    //   calc <a> <op> [b]     op is + - * / ^ S C T (b omitted for S, C, T)
+    //   temp <value> <C|F> <C|F>
+    //   base <number> <B|D|O|H> <B|D|O|H>
+    //   log  <value> <L|N|B>
+    //   curr <amount> <from> <to>   I, U, E, G or any ISO code in the rate table
+    //   len  <value> <M|F> <M|F>
+    //   radix <digits> <from 2-36> <to 2-36>
+    //   unit <value> <symbol> <symbol>    any registry unit, e.g. unit 3 mi km
+    //   expr <expression>     e.g. expr 2 * (3 + 4) ^ 2 - sin(30)
+    // Fills op, or returns why the line is malformed with field set to the offending token
+    // (empty when the line as a whole is wrong). Never throws.
+    static ParseStatus tryParse(string_view line, Operation& op, string_view& field) {
+        field = {};
+        size_t start = line.find_first_not_of(" \t");
+        if (start == string_view::npos) return ParseStatus::UnknownCommand;
+        if (line.substr(start, 5) == "expr " || line.substr(start, 5) == "expr\t") {
+            op.kind = OpKind::Expression;
+            op.text = line.substr(start + 5);
+            return ParseStatus::Ok;
+        }
+        string_view tokens[MAX_TOKENS];
+        size_t count = tokenize(line, tokens);
+        if (count > MAX_TOKENS) return ParseStatus::TooManyFields;
+        string_view command = tokens[0];
+        ParseStatus status = ParseStatus::Ok;
+        auto number = [&](size_t i, double& value) {
+            if (status == ParseStatus::Ok && (status = NumberParser::parseDouble(tokens[i], value)) != ParseStatus::Ok) field = tokens[i];
+        };
+        auto code = [&](size_t i, char& value) {
+            if (status == ParseStatus::Ok && (status = parseCode(tokens[i], value)) != ParseStatus::Ok) field = tokens[i];
+        };
+        auto unit = [&](size_t i, int& id) {
+            if (status == ParseStatus::Ok && (id = UnitRegistry::instance().find(tokens[i])) < 0) {
+                status = ParseStatus::UnknownUnit;
+                field = tokens[i];
+            }
+        };
+        if (command == "calc" && (count == 3 || count == 4)) {
+            op.kind = OpKind::Calculator;
+            number(1, op.a);
+            code(2, op.op);
+            bool trig = op.op == 'S' || op.op == 'C' || op.op == 'T';
+            if (status == ParseStatus::Ok && trig != (count == 3)) return ParseStatus::WrongOperands;
+            if (!trig) number(3, op.b);
+        } else if (command == "radix" && count == 4) {
+            op.kind = OpKind::Radix;
+            op.text = tokens[1];
+            number(2, op.a);
+            number(3, op.b);
+            if (status == ParseStatus::Ok && op.a >= 2 && op.a <= 36 && !validDigits(op.text, static_cast<int>(op.a))) {
+                status = ParseStatus::InvalidDigits;
+                field = tokens[1];
+            }
+        } else if (command == "unit" && count == 4) {
+            op.kind = OpKind::Unit;
+            number(1, op.a);
+            unit(2, op.fromUnit);
+            unit(3, op.toUnit);
+        } else if (command == "log" && count == 3) {
+            op.kind = OpKind::Logarithm;
+            number(1, op.a);
+            code(2, op.op);
+        } else if (command == "curr" && count == 4) {
+            op.kind = OpKind::Currency;
+            number(1, op.a);
+            op.fromUnit = RateTable::currencyKey(tokens[2]);
+            op.toUnit = RateTable::currencyKey(tokens[3]);
+        } else if (count == 4 && (command == "temp" || command == "len" || command == "base")) {
+            if (command == "base") {
+                op.kind = OpKind::NumberBase;
+                op.text = tokens[1];
+            } else {
+                op.kind = command == "temp" ? OpKind::Temperature : OpKind::Length;
+                number(1, op.a);
+            }
+            code(2, op.from);
+            code(3, op.to);
+            // Decimal input with a fraction or exponent is still a number, just not an integer
+            int base = baseOfCode(op.from);
+            double ignored;
+            if (status == ParseStatus::Ok && op.kind == OpKind::NumberBase && base != 0 && !validDigits(op.text, base) &&
+                (base != 10 || NumberParser::parseDouble(op.text, ignored) != ParseStatus::Ok)) {
+                status = ParseStatus::InvalidDigits;
+                field = tokens[1];
+            }
+        } else {
+            field = command;
+            return ParseStatus::UnknownCommand;
+        }
+        return status;
+    }
+
+    // Unit ids index the registry directly and radix bases are cast to int. The batch parser only
+    // produces valid ones; operations decoded from a wire frame or a trace file may hold anything.
+    static void validate(const Operation& op) {
+        if (op.kind == OpKind::Unit) {
+            int units = static_cast<int>(UnitRegistry::instance().unitCount());
+            if (op.fromUnit < 0 || op.fromUnit >= units || op.toUnit < 0 || op.toUnit >= units) {
+                throw runtime_error("Unknown unit id");
+            }
+        }
+        if (op.kind == OpKind::Radix) {
+            for (double base : {op.a, op.b}) {
+                if (!(base >= 2.0 && base <= 36.0) || trunc(base) != base) throw runtime_error("Base must be between 2 and 36");
+            }
+        }
+    }
+
+    // The message batch output has always shown for each status
+    template <size_t N>
+    static void describe(ParseStatus status, string_view field, TextBuffer<N>& message) {
+        switch (status) {
+            case ParseStatus::Ok: break;
+            case ParseStatus::InvalidNumber: message.append("Invalid number: ").append(field); break;
+            case ParseStatus::OutOfRange: message.append("Number out of range: ").append(field); break;
+            case ParseStatus::InvalidDigits: message.append("Invalid number format for the specified base"); break;
+            case ParseStatus::InvalidCode: message.append("Invalid code: ").append(field); break;
+            case ParseStatus::UnknownUnit: message.append("Unknown unit '").append(field).append('\''); break;
+            case ParseStatus::WrongOperands: message.append("Wrong number of operands"); break;
+            case ParseStatus::TooManyFields: message.append("Too many fields"); break;
+            case ParseStatus::UnknownCommand: message.append("Unknown command or wrong field count: ").append(field); break;
+        }
+    }
+
+    // For callers that want an exception, e.g. the load generator's fixed samples
+    static Operation parse(string_view line) {
+        Operation op;
+        string_view field;
+        ParseStatus status = tryParse(line, op, field);
+        if (status != ParseStatus::Ok) {
+            TextBuffer<192> message;
+            describe(status, field, message);
+            throw runtime_error(string(message.view()));
+        }
+        return op;
+    }
+
+    // Number base and radix conversions produce digits; every other operation a number. With a
+    // trace open (--trace) the operation is captured with its result or failure.
+    static OperationResult evaluate(const Operation& op) {
+        if (!TraceCapture::active()) return compute(op);
+        int64_t started = TraceCapture::monotonic();
+        try {
+            OperationResult r = compute(op);
+            TraceCapture::record(started, op, r);
+            return r;
+        } catch (const runtime_error& e) {
+            TraceCapture::recordFailure(started, op, e.what());
+            throw;
+        }
+    }
+
+    static OperationResult compute(const Operation& op) {
+        Metrics::Span span(Metrics::Phase::Compute, op);
+        OperationResult r;
+        switch (op.kind) {
+            case OpKind::Calculator:
+                r.number = ResultCache::calculate(op.a, static_cast<char>(toupper(op.op)), op.b);
+                break;
+            case OpKind::Temperature:
+                r.number = TemperatureConverter(op.a, op.from, op.to).convert();
+                break;
+            case OpKind::NumberBase:
+                r.isText = true;
+                r.text = ResultCache::numberBase(op.text, op.from, op.to);
+                break;
+            case OpKind::Logarithm:
+                r.number = ResultCache::logarithm(op.a, op.op);
+                break;
+            case OpKind::Currency:
+                r.number = CurrencyConverter(op.a, op.fromUnit, op.toUnit).convert();
+                break;
+            case OpKind::Length:
+                r.number = LengthConverter(op.a, op.from, op.to).convert();
+                break;
+            case OpKind::Expression:
+                r.number = CompiledExpression(string(op.text)).evaluate();
+                break;
+            case OpKind::Radix:
+                r.isText = true;
+                r.text = RadixConverter::convert(op.text, RadixConverter::baseOf(op.a), RadixConverter::baseOf(op.b));
+                break;
+            case OpKind::Unit:
+                r.number = UnitConverter(op.a, op.fromUnit, op.toUnit).convert();
+                break;
+        }
+        return r;
+    }
+
+    // Each result is computed once and formatted straight into the output buffer
+    static void execute(const Operation& op, string_view input, BufferedWriter& out) {
+        OperationResult r = evaluate(op);
+        Metrics::Span span(Metrics::Phase::Display, op);
+        if (r.isText) OutputFormat::result(out, opKindName(op.kind), input, string_view(r.text));
+        else OutputFormat::result(out, opKindName(op.kind), input, r.number);
+    }
+
+    // Blank and comment lines produce no output; returns false when the line failed, filling
+    // error (if given) with the column and message. Malformed lines are reported without throwing;
+    // only errors from the computation itself come back as exceptions.
+    static bool processLine(string_view line, BufferedWriter& out, RowError* error = nullptr) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        size_t first = line.find_first_not_of(" \t");
+        if (first == string_view::npos || line[first] == '#') return true;
+        string_view input = line.substr(first);
+        Operation op;
+        string_view field;
+        ParseStatus status = tryParse(line, op, field);
+        if (status != ParseStatus::Ok) {
+            TextBuffer<192> message;
+            describe(status, field, message);
+            // Bad digits used to surface from the converter, so they keep the operation's type
+            string_view type = status == ParseStatus::InvalidDigits ? opKindName(op.kind) : "";
+            OutputFormat::error(out, type, input, message);
+            out.put('\n');
+            if (error) {
+                error->column = field.empty() ? 0 : static_cast<size_t>(field.data() - line.data()) + 1;
+                error->message = message;
+            }
+            return false;
+        }
+        bool ok = true;
+        try {
+            execute(op, input, out);
+        } catch (const runtime_error& e) {
+            OutputFormat::error(out, opKindName(op.kind), input, e.what());
+            if (error) {
+                error->column = 0;
+                error->message = TextBuffer<192>();
+                error->message.append(e.what());
+            }
+            ok = false;
+        }
+        out.put('\n');
+        return ok;
+    }
+
+    // Error report for --errors: a header, then row, column and message per failed line, tab separated
+    static void reportHeader(BufferedWriter& errors) { errors.write("row\tcolumn\terror\n"); }
+
+    static void report(BufferedWriter& errors, const RowError& error) {
+        errors.writeInt(static_cast<long long>(error.row));
+        errors.put('\t');
+        errors.writeInt(static_cast<long long>(error.column));
+        errors.put('\t');
+        errors.write(error.message.view());
+        errors.put('\n');
+    }
+
+    // Writes one output line per input line, and the failed rows (numbered from 1, counting blank
+    // and comment lines) to errorFile if given. Returns the number of lines that failed.
+    size_t run(FILE* in, FILE* outFile, FILE* errorFile = nullptr) {
+        ChunkedLineReader reader(in);
+        BufferedWriter out(outFile);
+        OutputFormat::header(out);
+        unique_ptr<BufferedWriter> errors;
+        if (errorFile) {
+            errors = make_unique<BufferedWriter>(errorFile);
+            reportHeader(*errors);
+        }
+        string_view line;
+        size_t failures = 0;
+        RowError error;
+        while (reader.nextLine(line)) {
+            ++error.row;
+            if (!processLine(line, out, errors ? &error : nullptr)) {
+                ++failures;
+                if (errors) report(*errors, error);
+            }
+        }
+        return failures;
+    }
+};
+
+// Fixed set of worker threads running index ranges with work stealing. Each worker starts with a
+// contiguous slice of the tasks and takes them from the front; an idle worker steals the back
+// half of the busiest-looking victim's remaining range. The calling thread acts as worker 0.
+class WorkStealingPool {
+private:
+    struct alignas(64) TaskRange {
+        mutex lock;
+        size_t begin = 0, end = 0;
+    };
+
+    vector<unique_ptr<TaskRange>> ranges;
+    vector<thread> threads;
+    mutex jobLock;
+    condition_variable jobReady, jobDone;
+    const function<void(size_t, size_t)>* job = nullptr;
+    unsigned long generation = 0;
+    size_t running = 0;
+    bool stopping = false;
+    exception_ptr failure;
+
+    bool takeLocal(size_t worker, size_t& task) {
+        TaskRange& own = *ranges[worker];
+        lock_guard<mutex> lock(own.lock);
+        if (own.begin == own.end) return false;
+        task = own.begin++;
+        return true;
+    }
+
+    bool steal(size_t worker, size_t& task) {
+        size_t n = ranges.size();
+        for (size_t k = 1; k < n; ++k) {
+            TaskRange& victim = *ranges[(worker + k) % n];
+            size_t begin, end;
+            {
+                lock_guard<mutex> lock(victim.lock);
+                size_t remaining = victim.end - victim.begin;
+                if (remaining == 0) continue;
+                begin = victim.end - (remaining + 1) / 2;
+                end = victim.end;
+                victim.end = begin;
+            }
+            TaskRange& own = *ranges[worker];
+            lock_guard<mutex> lock(own.lock);
+            own.begin = begin + 1;
+            own.end = end;
+            task = begin;
+            return true;
+        }
+        return false;
+    }
+
+    void work(size_t worker) {
+        size_t task;
+        while (takeLocal(worker, task) || steal(worker, task)) {
+            try {
+                (*job)(task, worker);
+            } catch (...) {
+                lock_guard<mutex> lock(jobLock);
+                if (!failure) failure = current_exception();
+            }
+        }
+    }
+
+    void workerLoop(size_t worker) {
+        unsigned long seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> lock(jobLock);
+                jobReady.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            work(worker);
+            lock_guard<mutex> lock(jobLock);
+            if (--running == 0) jobDone.notify_one();
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t threadCount = thread::hardware_concurrency()) {
+        threadCount = max<size_t>(threadCount, 1);
+        for (size_t i = 0; i < threadCount; ++i) ranges.push_back(make_unique<TaskRange>());
+        for (size_t i = 1; i < threadCount; ++i) threads.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> lock(jobLock);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (thread& t : threads) t.join();
+    }
+
+    size_t size() const { return ranges.size(); }
+
+    // Runs fn(task, worker) for every task in [0, count) and returns when all are done.
+    // worker is in [0, size()) and identifies the thread, for per-thread state.
+    void parallelFor(size_t count, const function<void(size_t, size_t)>& fn) {
+        if (count == 0) return;
+        size_t n = ranges.size();
+        for (size_t i = 0; i < n; ++i) {
+            lock_guard<mutex> lock(ranges[i]->lock);
+            ranges[i]->begin = count * i / n;
+            ranges[i]->end = count * (i + 1) / n;
+        }
+        {
+            lock_guard<mutex> lock(jobLock);
+            job = &fn;
+            failure = nullptr;
+            running = n - 1;
+            ++generation;
+        }
+        jobReady.notify_all();
+        work(0);
+        unique_lock<mutex> lock(jobLock);
+        jobDone.wait(lock, [&] { return running == 0; });
+        job = nullptr;
+        if (failure) rethrow_exception(failure);
+    }
+};
+
+// Runs batch lines on a WorkStealingPool. Lines are processed in chunks; every worker formats
+// into its own buffer and the chunks are written back in input order.
+class ParallelBatchExecutor {
+private:
+    static constexpr size_t CHUNK_LINES = 512;
+    static constexpr size_t BLOCK_LINES = 1 << 20;
+
+    struct alignas(64) WorkerOutput {
+        BufferedWriter buffer;
+        size_t failures = 0;
+        vector<RowError> errors;   // only collected when an error report is wanted
+    };
+
+    struct ChunkResult {
+        size_t worker, offset, length;
+        size_t errorOffset, errorCount;
+    };
+
+    WorkStealingPool pool;
+    vector<unique_ptr<WorkerOutput>> outputs;
+    vector<ChunkResult> chunks;
+
+public:
+    explicit ParallelBatchExecutor(size_t threads) : pool(threads) {
+        for (size_t i = 0; i < pool.size(); ++i) outputs.push_back(make_unique<WorkerOutput>());
+    }
+
+    size_t threadCount() const { return pool.size(); }
+
+    // Processes the lines in parallel and writes the results to out in input order; returns failures.
+    // With an errors writer the failed rows are reported too, numbered from firstRow.
+    size_t execute(const vector<string_view>& lines, BufferedWriter& out, BufferedWriter* errors = nullptr, size_t firstRow = 1) {
+        // Step 1: Every chunk appends to its worker's buffers and records where its output landed
+        chunks.assign((lines.size() + CHUNK_LINES - 1) / CHUNK_LINES, ChunkResult{0, 0, 0, 0, 0});
+        pool.parallelFor(chunks.size(), [&](size_t chunk, size_t worker) {
+            WorkerOutput& local = *outputs[worker];
+            size_t start = local.buffer.size(), errorStart = local.errors.size();
+            size_t end = min(lines.size(), (chunk + 1) * CHUNK_LINES);
+            RowError error;
+            for (size_t i = chunk * CHUNK_LINES; i < end; ++i) {
+                if (BatchProcessor::processLine(lines[i], local.buffer, errors ? &error : nullptr)) continue;
+                ++local.failures;
+                if (errors) {
+                    error.row = firstRow + i;
+                    local.errors.push_back(error);
+                }
+            }
+            chunks[chunk] = {worker, start, local.buffer.size() - start, errorStart, local.errors.size() - errorStart};
+        });
+        // Step 2: Merge the per-worker buffers in chunk order, which keeps the error rows sorted
+        size_t failures = 0;
+        for (const ChunkResult& c : chunks) {
+            out.write(outputs[c.worker]->buffer.data() + c.offset, c.length);
+            for (size_t i = 0; i < c.errorCount; ++i) {
+                BatchProcessor::report(*errors, outputs[c.worker]->errors[c.errorOffset + i]);
+            }
+        }
+        for (auto& local : outputs) {
+            failures += local->failures;
+            local->failures = 0;
+            local->buffer.clear();
+            local->errors.clear();
+        }
+        return failures;
+    }
+
+    size_t run(FILE* in, FILE* outFile, FILE* errorFile = nullptr) {
+        ChunkedLineReader reader(in);
+        BufferedWriter out(outFile);
+        OutputFormat::header(out);
+        unique_ptr<BufferedWriter> errors;
+        if (errorFile) {
+            errors = make_unique<BufferedWriter>(errorFile);
+            BatchProcessor::reportHeader(*errors);
+        }
+        size_t rows = 0;
+        // Lines are copied into a block because the reader reuses its buffer
+        string block;
+        vector<pair<size_t, size_t>> spans;
+        vector<string_view> lines;
+        size_t failures = 0;
+        auto flushBlock = [&] {
+            lines.clear();
+            for (auto [offset, length] : spans) lines.emplace_back(block.data() + offset, length);
+            failures += execute(lines, out, errors.get(), rows + 1);
+            rows += lines.size();
+            block.clear();
+            spans.clear();
+        };
+        string_view line;
+        while (reader.nextLine(line)) {
+            spans.emplace_back(block.size(), line.size());
+            block.append(line);
+            if (spans.size() == BLOCK_LINES) flushBlock();
+        }
+        flushBlock();
+        return failures;
+    }
+};
+
+}  // namespace techneon
@@ -0,0 +1,2408 @@
+// Conversion and calculation engines: unit registry, converters, radix, rates, calculator, expressions, caches
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <span>
+#include <memory>
+#include <chrono>
+#include <array>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <utility>
+#include <charconv>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <deque>
+#include <bit>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define TECHNEON_X86_DISPATCH 1
+#endif
+
+#include "techneon/units.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+const string GREEN_COLOR = "\033[32m";
+const string RED_COLOR = "\033[31m";
+const string YELLOW_COLOR = "\033[33m";
+const string CYAN_COLOR = "\033[36m";
+const string BLUE_COLOR = "\033[34m";
+const string RESET_COLOR = "\033[0m";
+
+// Column kernels: out[i] = in[i] * scale + offset, with the best instruction set picked once at startup
+class LinearKernel {
+private:
+    using KernelFn = void (*)(const double*, double*, size_t, double, double);
+
+    static void scalar(const double* in, double* out, size_t n, double scale, double offset) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = in[i] * scale + offset;
+        }
+    }
+
+#ifdef TECHNEON_X86_DISPATCH
+    __attribute__((target("avx2,fma")))
+    static void avx2(const double* in, double* out, size_t n, double scale, double offset) {
+        const __m256d vs = _mm256_set1_pd(scale), vo = _mm256_set1_pd(offset);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_pd(out + i, _mm256_fmadd_pd(_mm256_loadu_pd(in + i), vs, vo));
+            _mm256_storeu_pd(out + i + 4, _mm256_fmadd_pd(_mm256_loadu_pd(in + i + 4), vs, vo));
+        }
+        for (; i < n; ++i) {
+            out[i] = __builtin_fma(in[i], scale, offset);
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static void avx512(const double* in, double* out, size_t n, double scale, double offset) {
+        const __m512d vs = _mm512_set1_pd(scale), vo = _mm512_set1_pd(offset);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            _mm512_storeu_pd(out + i, _mm512_fmadd_pd(_mm512_loadu_pd(in + i), vs, vo));
+            _mm512_storeu_pd(out + i + 8, _mm512_fmadd_pd(_mm512_loadu_pd(in + i + 8), vs, vo));
+        }
+        for (; i + 8 <= n; i += 8) {
+            _mm512_storeu_pd(out + i, _mm512_fmadd_pd(_mm512_loadu_pd(in + i), vs, vo));
+        }
+        if (i < n) {
+            __mmask8 rest = static_cast<__mmask8>((1u << (n - i)) - 1);
+            _mm512_mask_storeu_pd(out + i, rest, _mm512_fmadd_pd(_mm512_maskz_loadu_pd(rest, in + i), vs, vo));
+        }
+    }
+#endif
+
+    static KernelFn select() {
+#ifdef TECHNEON_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return avx512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2;
+#endif
+        return scalar;
+    }
+
+public:
+    static void apply(span<const double> in, span<double> out, double scale, double offset) {
+        static const KernelFn kernel = select();
+        if (out.size() < in.size()) {
+            throw runtime_error("Output column is shorter than input column");
+        }
+        kernel(in.data(), out.data(), in.size(), scale, offset);
+    }
+
+    static const char* name() {
+        KernelFn kernel = select();
+#ifdef TECHNEON_X86_DISPATCH
+        if (kernel == avx512) return "AVX-512";
+        if (kernel == avx2) return "AVX2+FMA";
+#endif
+        return kernel == scalar ? "scalar" : "unknown";
+    }
+};
+
+// Lane helpers are always inlined, so the vector ABI warnings don't apply; they take vectors by
+// reference because GCC's note about by-value vector parameters ignores the diagnostic pragma, and
+// its note about vector returns comes at the end of the file, which the build silences instead.
+// Contraction into FMA is off so the error-free products stay exact and every instruction set
+// returns bit-identical results.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+// GCC vector types for the fast math kernels: 2 doubles for SSE2, 4 for AVX2, 8 for AVX-512
+template <int N>
+struct FastMathLanes {
+    typedef double Float __attribute__((vector_size(N * 8)));
+    typedef int64_t Bits __attribute__((vector_size(N * 8)));
+    typedef uint64_t Words __attribute__((vector_size(N * 8)));
+    static constexpr int width = N;
+};
+
+// Integer lanes matching a float lane type; plain double is the one-lane case
+template <typename V>
+struct FastMathLaneTraits {
+    using Bits = int64_t;
+    using Words = uint64_t;
+    static constexpr int width = 1;
+};
+template <> struct FastMathLaneTraits<FastMathLanes<2>::Float> : FastMathLanes<2> {};
+template <> struct FastMathLaneTraits<FastMathLanes<4>::Float> : FastMathLanes<4> {};
+template <> struct FastMathLaneTraits<FastMathLanes<8>::Float> : FastMathLanes<8> {};
+
+// Opt-in fast math: sin/cos/tan of degrees and ln/log2/log10 from short polynomials and a small
+// table, in three accuracy tiers. Degree arguments are reduced exactly (x - 90n has no rounding
+// error), so sin(180) is exactly 0 and tan(90) is undefined instead of 1.6e16.
+// Each kernel is written once over a lane type: double for single values, or a GCC vector for
+// the batch APIs, which are compiled for AVX-512 or AVX2 when the CPU has them.
+class FastMath {
+public:
+    enum class Accuracy { Ulp1, Ulp4, Relaxed };   // within ~1 ulp, ~4 ulp, ~1e-7 relative
+    enum class Function { Sin, Cos, Tan, Ln, Log2, Log10 };
+
+private:
+    using BatchFn = void (*)(const double*, double*, size_t);
+    using ScalarFn = double (*)(double);
+
+    static constexpr size_t VARIANTS = 6 * 3;
+    static constexpr double ROUND_MAGIC = 0x1.8p52;     // x + ROUND_MAGIC - ROUND_MAGIC rounds to an integer
+    static constexpr int64_t LOG_OFFSET = 0x3fe5f00000000000;   // z in [0.6855, 1.371), 1.0 centred in entry 80
+    static constexpr int LOG_TABLE_BITS = 7;
+
+    // Log table and split constants, computed once in long double
+    struct Constants {
+        double invc[1 << LOG_TABLE_BITS], logcHi[1 << LOG_TABLE_BITS], logcLo[1 << LOG_TABLE_BITS];
+        double radHi, radLo, rad;                 // pi / 180
+        double kHi[3], kLo[3], k[3];              // per-exponent term for ln, log2, log10 (kHi has 42 bits)
+        double bHi[3], bLo[3], b[3];              // ln(z) multiplier for ln, log2, log10
+
+        Constants() {
+            const long double pi = 3.141592653589793238462643383279502884L;
+            const long double ln2 = 0.693147180559945309417232121458176568L;
+            const long double ln10 = 2.302585092994045684017646009693436L;
+            split(pi / 180, radHi, radLo);
+            rad = static_cast<double>(pi / 180);
+            const long double perExponent[3] = {ln2, 1.0L, ln2 / ln10};
+            const long double perLn[3] = {1.0L, 1.0L / ln2, 1.0L / ln10};
+            for (int f = 0; f < 3; ++f) {
+                k[f] = static_cast<double>(perExponent[f]);
+                split(perExponent[f], kHi[f], kLo[f]);
+                uint64_t bits = bitsOf(kHi[f]) & ~((1ull << 11) - 1);
+                kHi[f] = fromBits<double>(static_cast<int64_t>(bits));
+                kLo[f] = static_cast<double>(perExponent[f] - kHi[f]);
+                b[f] = static_cast<double>(perLn[f]);
+                split(perLn[f], bHi[f], bLo[f]);
+            }
+            for (int i = 0; i < (1 << LOG_TABLE_BITS); ++i) {
+                int64_t lo = LOG_OFFSET + (static_cast<int64_t>(i) << (52 - LOG_TABLE_BITS));
+                int64_t hi = lo + (1ll << (52 - LOG_TABLE_BITS));
+                long double center = (static_cast<long double>(fromBits<double>(lo)) + fromBits<double>(hi)) / 2;
+                invc[i] = lo <= bitsOf(1.0) && bitsOf(1.0) < hi ? 1.0 : static_cast<double>(1.0L / center);
+                split(-logl(invc[i]), logcHi[i], logcLo[i]);
+            }
+        }
+
+        static void split(long double value, double& hi, double& lo) {
+            hi = static_cast<double>(value);
+            lo = static_cast<double>(value - hi);
+        }
+    };
+
+    static const Constants& constants() {
+        static const Constants table;
+        return table;
+    }
+
+    template <typename V>
+    using BitsOf = typename FastMathLaneTraits<V>::Bits;
+
+    template <typename V>
+    [[gnu::always_inline]] static inline BitsOf<V> bitsOf(const V& x) { return __builtin_bit_cast(BitsOf<V>, x); }
+
+    template <typename V>
+    [[gnu::always_inline]] static inline V fromBits(const BitsOf<V>& bits) { return __builtin_bit_cast(V, bits); }
+
+    // mask is all ones or all zeros per lane
+    template <typename V>
+    [[gnu::always_inline]] static inline V blend(const BitsOf<V>& mask, const V& ifSet, const V& ifClear) {
+        return fromBits<V>((mask & bitsOf(ifSet)) | (~mask & bitsOf(ifClear)));
+    }
+
+    template <typename V>
+    [[gnu::always_inline]] static inline V flipSign(const V& x, const BitsOf<V>& signBit) {
+        return fromBits<V>(bitsOf(x) ^ (signBit & numeric_limits<int64_t>::min()));
+    }
+
+    // AVX2 has no 64-bit arithmetic shift, so only logical shifts are used on lanes
+    template <typename V>
+    [[gnu::always_inline]] static inline BitsOf<V> shiftRight(const BitsOf<V>& bits, int n) {
+        using Words = typename FastMathLaneTraits<V>::Words;
+        return __builtin_bit_cast(BitsOf<V>, __builtin_bit_cast(Words, bits) >> n);
+    }
+
+    template <typename V>
+    [[gnu::always_inline]] static inline V gather(const double* table, const BitsOf<V>& index) {
+        if constexpr (FastMathLaneTraits<V>::width == 1) {
+            return table[index];
+        } else {
+            V result;
+            for (int j = 0; j < FastMathLaneTraits<V>::width; ++j) result[j] = table[index[j]];
+            return result;
+        }
+    }
+
+    // Exact a * b = hi + lo by Veltkamp splitting, so no FMA instruction is needed
+    template <typename V>
+    [[gnu::always_inline]] static inline void twoProduct(const V& a, const V& b, V& hi, V& lo) {
+        V ca = a * 134217729.0, cb = b * 134217729.0;
+        V ah = ca - (ca - a), bh = cb - (cb - b);
+        V al = a - ah, bl = b - bh;
+        hi = a * b;
+        lo = ((ah * bh - hi) + ah * bl + al * bh) + al * bl;
+    }
+
+    template <Function F, Accuracy A, typename V>
+    [[gnu::always_inline]] static inline V trig(const V& x, const Constants& c) {
+        // Step 1: x = 90n + r with |r| <= 45 degrees; r is exact for |x| < 2^50
+        V shifted = x * (1.0 / 90.0) + ROUND_MAGIC;
+        auto quadrant = bitsOf(shifted) & 3;
+        V n = shifted - ROUND_MAGIC;
+        V r = x - n * 90.0;
+        // Step 2: Convert r to radians, as a double-double for the 1 ulp tier
+        V t, tail;
+        if constexpr (A == Accuracy::Ulp1) {
+            twoProduct(r, V{} + c.radHi, t, tail);
+            tail += r * c.radLo;
+        } else {
+            t = r * c.rad;
+            tail = t * 0.0;
+        }
+        // Step 3: sin and cos of t on [-pi/4, pi/4]
+        V z = t * t, s, co, sLo = tail * 0.0, coLo = sLo;
+        if constexpr (A == Accuracy::Relaxed) {
+            s = t + t * z * (-1.0 / 6 + z * (1.0 / 120 + z * (-1.0 / 5040 + z * (1.0 / 362880))));
+            co = 1.0 + z * (-0.5 + z * (1.0 / 24 + z * (-1.0 / 720 + z * (1.0 / 40320))));
+        } else {
+            // Minimax coefficients of the fdlibm kernels
+            V v = z * t;
+            V ps = 8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 +
+                   z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)));
+            V sRest = (z * (0.5 * tail - v * ps) - tail) - v * -1.66666666666666324348e-01;
+            s = t - sRest;
+            sLo = (t - s) - sRest;
+            V w = z * z;
+            V pc = z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * 2.48015872894767294178e-05)) +
+                   w * w * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11));
+            V hz = 0.5 * z;
+            w = 1.0 - hz;
+            V coRest = ((1.0 - w) - hz) + (z * pc - t * tail);
+            co = w + coRest;
+            coLo = (w - co) + coRest;
+        }
+        // Step 4: Pick and negate according to the quadrant, with bit masks rather than branches
+        auto odd = -(quadrant & 1);
+        if constexpr (F == Function::Sin) {
+            return flipSign(blend(odd, co, s), (quadrant & 2) << 62);
+        } else if constexpr (F == Function::Cos) {
+            return flipSign(blend(odd, s, co), ((quadrant + 1) & 2) << 62);
+        } else {
+            V numerator = blend(odd, co, s), denominator = blend(odd, s, co);
+            V value = numerator / denominator;
+            if constexpr (A == Accuracy::Ulp1) {
+                // One correction step with the low parts, so the quotient keeps the kernels' accuracy
+                V product, error;
+                twoProduct(value, denominator, product, error);
+                V remainder = ((numerator - product) - error) + (blend(odd, coLo, sLo) - value * blend(odd, sLo, coLo));
+                value = value + remainder / denominator;
+            }
+            return flipSign(value, quadrant << 63);
+        }
+    }
+
+    template <Function F, Accuracy A, typename V>
+    [[gnu::always_inline]] static inline V logarithm(const V& x, const Constants& c) {
+        constexpr int f = static_cast<int>(F) - static_cast<int>(Function::Ln);
+        // Step 1: x = 2^k * z with z in [0.6855, 1.371); the top mantissa bits of z pick a table entry
+        auto bits = bitsOf(x);
+        auto offset = bits - LOG_OFFSET;
+        auto index = shiftRight<V>(offset, 52 - LOG_TABLE_BITS) & ((1 << LOG_TABLE_BITS) - 1);
+        V z = fromBits<V>(bits - (offset & static_cast<int64_t>(0xfff0000000000000ull)));
+        V kd = fromBits<V>(shiftRight<V>(offset + (1ll << 62), 52) - 1024 + bitsOf(ROUND_MAGIC)) - ROUND_MAGIC;
+        V invc = gather<V>(c.invc, index), logcHi = gather<V>(c.logcHi, index), logcLo = gather<V>(c.logcLo, index);
+        // Step 2: ln(x) = k ln2 - ln(invc) + ln(1 + r) with r = z * invc - 1, |r| < 2^-8
+        if constexpr (A == Accuracy::Relaxed) {
+            V r = z * invc - 1.0;
+            V p = r * r * (-0.5 + r * (1.0 / 3 + r * -0.25));
+            return kd * c.k[f] + (logcHi + r + p) * c.b[f];
+        } else {
+            V product, error;
+            twoProduct(z, invc, product, error);
+            V r = (product - 1.0) + error;
+            V rLo = ((product - 1.0) - r) + error;
+            V p = r * r * (-0.5 + r * (1.0 / 3 + r * (-0.25 + r * (0.2 + r * (-1.0 / 6 + r * (1.0 / 7))))));
+            if constexpr (A == Accuracy::Ulp4) {
+                return kd * c.k[f] + (logcHi + (r + (p + logcLo))) * c.b[f];
+            } else {
+                // Step 3: Keep ln(z) as hi + lo, scale it and add the exponent term without losing the tail
+                V hi = logcHi + r;
+                V lo = ((logcHi - hi) + r) + (p + logcLo + rLo);
+                if constexpr (F != Function::Ln) {
+                    V scaled, scaledLo;
+                    twoProduct(hi, V{} + c.bHi[f], scaled, scaledLo);
+                    lo = scaledLo + lo * c.bHi[f] + hi * c.bLo[f];
+                    hi = scaled;
+                }
+                V exponentTerm = kd * c.kHi[f];
+                V sum = exponentTerm + hi;
+                return sum + (((exponentTerm - sum) + hi) + (lo + kd * c.kLo[f]));
+            }
+        }
+    }
+
+    template <Function F, Accuracy A, typename V>
+    [[gnu::always_inline]] static inline V kernel(const V& x, const Constants& c) {
+        if constexpr (F == Function::Sin || F == Function::Cos || F == Function::Tan) {
+            return trig<F, A>(x, c);
+        } else {
+            return logarithm<F, A>(x, c);
+        }
+    }
+
+    // Inputs the vector kernels don't cover: huge, infinite or NaN angles; zero, negative,
+    // subnormal, infinite or NaN logarithm arguments. A bool, or a lane mask for vectors.
+    template <Function F, typename V>
+    [[gnu::always_inline]] static inline auto special(const V& x) {
+        // Floating-point compares: they vectorize on every instruction set, and NaN fails them
+        if constexpr (F == Function::Sin || F == Function::Cos || F == Function::Tan) {
+            V magnitude = fromBits<V>(bitsOf(x) & numeric_limits<int64_t>::max());
+            return !(magnitude < 0x1p50);
+        } else {
+            // Positive normal finite values are one contiguous bit range, so a single unsigned
+            // compare covers it (two compares joined with & scalarize on 512-bit vectors)
+            using Words = typename FastMathLaneTraits<V>::Words;
+            const uint64_t lowest = 0x0010000000000000, span = 0x7ff0000000000000 - lowest;
+            return !((__builtin_bit_cast(Words, x) - lowest) < span);
+        }
+    }
+
+    template <Function F, Accuracy A>
+    static double slowPath(double x) {
+        switch (F) {
+            case Function::Ln: return log(x);
+            case Function::Log2: return log2(x);
+            case Function::Log10: return log10(x);
+            default:
+                // fmod is exact, so the reduced angle is still exact
+                return isfinite(x) ? kernel<F, A>(fmod(x, 360.0), constants()) : x - x;
+        }
+    }
+
+    template <Function F, Accuracy A>
+    static double single(double x) {
+        return special<F>(x) ? slowPath<F, A>(x) : kernel<F, A>(x, constants());
+    }
+
+    template <Function F, Accuracy A, int W>
+    [[gnu::always_inline]] static inline void batch(const double* in, double* out, size_t n) {
+        using V = typename FastMathLanes<W>::Float;
+        const Constants& c = constants();
+        size_t i = 0;
+        for (; i + W <= n; i += W) {
+            V x, y;
+            memcpy(&x, in + i, sizeof(x));
+            y = kernel<F, A>(x, c);
+            memcpy(out + i, &y, sizeof(y));
+            BitsOf<V> slow = special<F>(x);
+            int64_t any = 0;
+            for (int j = 0; j < W; ++j) any |= slow[j];
+            if (any) {
+                for (int j = 0; j < W; ++j) {
+                    if (slow[j]) out[i + j] = slowPath<F, A>(in[i + j]);
+                }
+            }
+        }
+        for (; i < n; ++i) out[i] = single<F, A>(in[i]);
+    }
+
+    template <Function F, Accuracy A>
+    static void batchGeneric(const double* in, double* out, size_t n) { batch<F, A, 2>(in, out, n); }
+
+#ifdef TECHNEON_X86_DISPATCH
+    template <Function F, Accuracy A>
+    __attribute__((target("avx2"))) static void batchAvx2(const double* in, double* out, size_t n) {
+        batch<F, A, 4>(in, out, n);
+    }
+
+    template <Function F, Accuracy A>
+    __attribute__((target("avx512f,avx512dq"))) static void batchAvx512(const double* in, double* out, size_t n) {
+        batch<F, A, 8>(in, out, n);
+    }
+#endif
+
+    template <template <Function, Accuracy> class Pick, size_t... I>
+    static constexpr auto variants(index_sequence<I...>) {
+        return array<remove_const_t<decltype(Pick<Function::Sin, Accuracy::Ulp1>::fn)>, VARIANTS>{
+            Pick<static_cast<Function>(I / 3), static_cast<Accuracy>(I % 3)>::fn...};
+    }
+
+    template <Function F, Accuracy A> struct PickSingle { static constexpr ScalarFn fn = single<F, A>; };
+    template <Function F, Accuracy A> struct PickGeneric { static constexpr BatchFn fn = batchGeneric<F, A>; };
+#ifdef TECHNEON_X86_DISPATCH
+    template <Function F, Accuracy A> struct PickAvx2 { static constexpr BatchFn fn = batchAvx2<F, A>; };
+    template <Function F, Accuracy A> struct PickAvx512 { static constexpr BatchFn fn = batchAvx512<F, A>; };
+#endif
+
+    static const array<BatchFn, VARIANTS>& batchKernels() {
+        static const array<BatchFn, VARIANTS> kernels = [] {
+#ifdef TECHNEON_X86_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+                return variants<PickAvx512>(make_index_sequence<VARIANTS>());
+            }
+            if (__builtin_cpu_supports("avx2")) return variants<PickAvx2>(make_index_sequence<VARIANTS>());
+#endif
+            return variants<PickGeneric>(make_index_sequence<VARIANTS>());
+        }();
+        return kernels;
+    }
+
+    static size_t variant(Function f, Accuracy a) { return static_cast<size_t>(f) * 3 + static_cast<size_t>(a); }
+
+    static atomic<int>& mode() {
+        static atomic<int> current{-1};
+        return current;
+    }
+
+public:
+    // Selected with --fast-math; the menu, batch and expression operations use it when enabled
+    static void enable(Accuracy a) { mode().store(static_cast<int>(a)); }
+    static bool enabled() { return mode().load(memory_order_relaxed) >= 0; }
+    static Accuracy accuracy() { return static_cast<Accuracy>(max(mode().load(memory_order_relaxed), 0)); }
+
+    static Accuracy parseAccuracy(const string& name) {
+        if (name == "1ulp") return Accuracy::Ulp1;
+        if (name == "4ulp") return Accuracy::Ulp4;
+        if (name == "relaxed") return Accuracy::Relaxed;
+        throw runtime_error("Unknown accuracy '" + name + "' (use 1ulp, 4ulp, relaxed)");
+    }
+
+    static const char* accuracyName(Accuracy a) {
+        return a == Accuracy::Ulp1 ? "1ulp" : a == Accuracy::Ulp4 ? "4ulp" : "relaxed";
+    }
+
+    static const char* functionName(Function f) {
+        static const char* names[] = {"sin", "cos", "tan", "ln", "log2", "log10"};
+        return names[static_cast<int>(f)];
+    }
+
+    static double compute(Function f, double x, Accuracy a) {
+        static constexpr array<ScalarFn, VARIANTS> singles = variants<PickSingle>(make_index_sequence<VARIANTS>());
+        return singles[variant(f, a)](x);
+    }
+
+    static double compute(Function f, double x) { return compute(f, x, accuracy()); }
+
+    static void compute(Function f, span<const double> in, span<double> out, Accuracy a) {
+        if (out.size() < in.size()) {
+            throw runtime_error("Output column is shorter than input column");
+        }
+        batchKernels()[variant(f, a)](in.data(), out.data(), in.size());
+    }
+
+    static const char* name() {
+#ifdef TECHNEON_X86_DISPATCH
+        if (batchKernels()[0] == PickAvx512<Function::Sin, Accuracy::Ulp1>::fn) return "AVX-512";
+        if (batchKernels()[0] == PickAvx2<Function::Sin, Accuracy::Ulp1>::fn) return "AVX2";
+#endif
+        return "generic";
+    }
+};
+
+#pragma GCC pop_options
+#pragma GCC diagnostic pop
+
+// Why a field was rejected. Parsing reports these codes instead of throwing, so a batch with many
+// malformed rows costs no more than a clean one.
+enum class ParseStatus : unsigned char {
+    Ok, InvalidNumber, OutOfRange, InvalidDigits, InvalidCode, UnknownUnit, WrongOperands, TooManyFields, UnknownCommand
+};
+
+// Locale-free number parsing. Doubles go through from_chars; digit strings in bases 2-36 are
+// checked 32 or 64 characters at a time, with the instruction set picked once at startup.
+class NumberParser {
+private:
+    using ScanFn = size_t (*)(const char*, size_t, int);
+
+    // 0-9 below the base, then letters of either case for bases above 10
+    static bool isDigit(unsigned char c, int base) {
+        unsigned decimal = c - '0';    // wraps for characters below '0'
+        unsigned letter = (c | 0x20u) - 'a';
+        return decimal < static_cast<unsigned>(min(base, 10)) || (base > 10 && letter < static_cast<unsigned>(base - 10));
+    }
+
+    static size_t scalar(const char* p, size_t n, int base) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!isDigit(static_cast<unsigned char>(p[i]), base)) return i;
+        }
+        return n;
+    }
+
+#ifdef TECHNEON_X86_DISPATCH
+    // A byte is valid when c - '0' <= min(base, 10) - 1 or (c | 0x20) - 'a' <= base - 11, both
+    // unsigned: saturating subtraction of the limit leaves zero exactly for the valid bytes
+    __attribute__((target("avx2")))
+    static size_t avx2(const char* p, size_t n, int base) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ascii0 = _mm256_set1_epi8('0'), lowerA = _mm256_set1_epi8('a'), caseBit = _mm256_set1_epi8(0x20);
+        const __m256i decimalMax = _mm256_set1_epi8(static_cast<char>(min(base, 10) - 1));
+        const __m256i letterMax = _mm256_set1_epi8(static_cast<char>(base - 11));
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i ok = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(c, ascii0), decimalMax), zero);
+            if (base > 10) {
+                __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, caseBit), lowerA);
+                ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(_mm256_subs_epu8(letter, letterMax), zero));
+            }
+            uint32_t bad = ~static_cast<uint32_t>(_mm256_movemask_epi8(ok));
+            if (bad) return i + __builtin_ctz(bad);
+        }
+        return i + scalar(p + i, n - i, base);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    static size_t avx512(const char* p, size_t n, int base) {
+        const __m512i ascii0 = _mm512_set1_epi8('0'), lowerA = _mm512_set1_epi8('a'), caseBit = _mm512_set1_epi8(0x20);
+        const __m512i decimalMax = _mm512_set1_epi8(static_cast<char>(min(base, 10) - 1));
+        const __m512i letterMax = _mm512_set1_epi8(static_cast<char>(base - 11));
+        size_t i = 0;
+        while (i < n) {
+            // Full blocks, then one masked load for the tail; bytes past the end are ignored
+            __mmask64 live = n - i >= 64 ? ~0ull : (1ull << (n - i)) - 1;
+            __m512i c = _mm512_maskz_loadu_epi8(live, p + i);
+            __mmask64 ok = _mm512_cmple_epu8_mask(_mm512_sub_epi8(c, ascii0), decimalMax);
+            if (base > 10) ok |= _mm512_cmple_epu8_mask(_mm512_sub_epi8(_mm512_or_si512(c, caseBit), lowerA), letterMax);
+            uint64_t bad = ~static_cast<uint64_t>(ok) & live;
+            if (bad) return i + __builtin_ctzll(bad);
+            i += 64;
+        }
+        return n;
+    }
+#endif
+
+    static ScanFn select() {
+#ifdef TECHNEON_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw")) return avx512;
+        if (__builtin_cpu_supports("avx2")) return avx2;
+#endif
+        return scalar;
+    }
+
+public:
+    // The whole field must be the number: optional sign, decimal or 0x-prefixed hex float, inf or
+    // nan. No whitespace, no locale. Values too small for a double become zero, as with strtod.
+    static ParseStatus parseDouble(string_view text, double& value) {
+        const char* first = text.data();
+        const char* last = first + text.size();
+        bool negative = first != last && *first == '-';
+        if (first != last && (*first == '-' || *first == '+')) ++first;
+        chars_format format = chars_format::general;
+        if (last - first > 2 && first[0] == '0' && (first[1] | 0x20) == 'x') {
+            first += 2;
+            format = chars_format::hex;
+        }
+        if (first == last || *first == '-' || *first == '+') return ParseStatus::InvalidNumber;
+        auto [end, ec] = from_chars(first, last, value, format);
+        if (ec == errc::result_out_of_range && end == last) {
+            // from_chars reports underflow and overflow alike; only overflow is an error
+            string copy(text);
+            if (fabs(strtod(copy.c_str(), nullptr)) != HUGE_VAL) {
+                value = negative ? -0.0 : 0.0;
+                return ParseStatus::Ok;
+            }
+            return ParseStatus::OutOfRange;
+        }
+        if (ec != errc() || end != last) return ParseStatus::InvalidNumber;
+        if (negative) value = -value;
+        return ParseStatus::Ok;
+    }
+
+    // Offset of the first character that is not a digit in the base (2-36), or digits.size()
+    static size_t firstInvalidDigit(string_view digits, int base) {
+        static const ScanFn kernel = select();
+        return kernel(digits.data(), digits.size(), base);
+    }
+
+    // Same scan without SIMD, for comparison in the benchmarks
+    static size_t firstInvalidDigitScalar(string_view digits, int base) {
+        return scalar(digits.data(), digits.size(), base);
+    }
+
+    static const char* kernelName() {
+        ScanFn kernel = select();
+#ifdef TECHNEON_X86_DISPATCH
+        if (kernel == avx512) return "AVX-512";
+        if (kernel == avx2) return "AVX2";
+#endif
+        return "scalar";
+    }
+};
+
+// Symbol and letter-code lookup over the unit table. The pair factors come from UNIT_MATRIX, which
+// the compiler has already filled, so a conversion is one indexed lookup plus one multiply-add.
+class UnitRegistry {
+private:
+    vector<string> symbols, dimensions;
+    unordered_map<string, int> bySymbol, byFoldedSymbol;
+
+    static string folded(string_view symbol) {
+        string key(symbol);
+        for (char& c : key) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return key;
+    }
+
+    UnitRegistry() {
+        for (int dim = 0; dim < UNIT_LAYOUT.dimensionCount; ++dim) dimensions.emplace_back(UNIT_LAYOUT.dimensionName[dim]);
+        for (size_t i = 0; i < UNIT_COUNT; ++i) {
+            const UnitDefinition& def = UNIT_TABLE[i];
+            int id = static_cast<int>(i);
+            bySymbol.emplace(def.symbol, id);
+            byFoldedSymbol.emplace(folded(def.symbol), id);
+            symbols.emplace_back(def.symbol);
+        }
+    }
+
+public:
+    int findDimension(string_view name) const { return dimensionIndex(name); }
+
+    static const UnitRegistry& instance() {
+        static const UnitRegistry registry;
+        return registry;
+    }
+
+    size_t unitCount() const { return UNIT_COUNT; }
+    const string& symbol(int unit) const { return symbols[unit]; }
+    const string& dimensionOf(int unit) const { return dimensions[UNIT_LAYOUT.dimension[unit]]; }
+
+    // Exact symbol first, then a case-insensitive match; -1 when unknown
+    int find(string_view symbol) const {
+        auto exact = bySymbol.find(string(symbol));
+        if (exact != bySymbol.end()) return exact->second;
+        auto loose = byFoldedSymbol.find(folded(symbol));
+        return loose != byFoldedSymbol.end() ? loose->second : -1;
+    }
+
+    // Unit for a menu letter code inside a dimension; -1 when unknown
+    static int findByCode(int dimension, char code) {
+        return dimension < 0 ? -1 : UNIT_LAYOUT.byCode[dimension][static_cast<unsigned char>(toupper(code))];
+    }
+
+    string unitsOf(string_view dimension) const {
+        string list;
+        for (size_t i = 0; i < UNIT_COUNT; ++i) {
+            if (dimensions[UNIT_LAYOUT.dimension[i]] != dimension) continue;
+            if (!list.empty()) list += ", ";
+            list += symbols[i];
+        }
+        return list;
+    }
+
+    vector<string> dimensionNames() const { return dimensions; }
+
+    LinearFactors factors(int from, int to) const {
+        if (UNIT_LAYOUT.dimension[from] != UNIT_LAYOUT.dimension[to]) {
+            throw runtime_error("Cannot convert " + dimensionOf(from) + " to " + dimensionOf(to));
+        }
+        return UNIT_MATRIX[unitSlot(from, to)];
+    }
+
+    double convert(double value, int from, int to) const {
+        LinearFactors f = factors(from, to);
+        return value * f.scale + f.offset;
+    }
+};
+
+class Converter {
+protected:
+    double value;
+public:
+    Converter(double val = 0.0) : value(val) {}
+    virtual ~Converter() = default;
+    virtual double convert() const = 0;
+    virtual string getType() const = 0;
+};
+
+// Menu converter over the compile-time unit tables; the letter codes resolve to unit ids once, and
+// both codes always come from the same dimension, so the pair needs no further check
+class RegistryConverter : public Converter {
+protected:
+    int fromId, toId;
+    const char* unitError;
+
+    RegistryConverter(double val, int dimension, char from, char to, const char* error)
+        : Converter(val),
+          fromId(UnitRegistry::findByCode(dimension, from)),
+          toId(UnitRegistry::findByCode(dimension, to)),
+          unitError(error) {}
+
+    static LinearFactors codeFactors(int dimension, char from, char to, const char* error) {
+        int a = UnitRegistry::findByCode(dimension, from), b = UnitRegistry::findByCode(dimension, to);
+        if (a < 0 || b < 0) throw runtime_error(error);
+        return UNIT_MATRIX[unitSlot(a, b)];
+    }
+
+public:
+    double convert() const override {
+        if (fromId < 0 || toId < 0) throw runtime_error(unitError);
+        LinearFactors f = UNIT_MATRIX[unitSlot(fromId, toId)];
+        return value * f.scale + f.offset;
+    }
+};
+
+class TemperatureConverter : public RegistryConverter {
+private:
+    static constexpr int DIMENSION = dimensionIndex("Temperature");
+    static constexpr const char* UNIT_ERROR = "Invalid temperature units (use C or F)";
+public:
+    TemperatureConverter(double temp, char from, char to)
+        : RegistryConverter(temp, DIMENSION, from, to, UNIT_ERROR) {}
+
+    using RegistryConverter::convert;
+
+    static LinearFactors linearFactors(char from, char to) {
+        return codeFactors(DIMENSION, from, to, UNIT_ERROR);
+    }
+
+    static void convert(span<const double> in, span<double> out, char from, char to) {
+        LinearFactors f = linearFactors(from, to);
+        LinearKernel::apply(in, out, f.scale, f.offset);
+    }
+
+    string getType() const override { return "Temperature"; }
+};
+
+// Arbitrary-width unsigned integer in 32-bit limbs, little-endian, with no leading zero limbs
+class BigUnsigned {
+public:
+    using Limb = uint32_t;
+    vector<Limb> limbs;
+
+    BigUnsigned() = default;
+    explicit BigUnsigned(uint64_t v) {
+        while (v != 0) {
+            limbs.push_back(static_cast<Limb>(v));
+            v >>= 32;
+        }
+    }
+
+    // The integer part of a finite double, exactly: the 53-bit mantissa shifted by the exponent
+    static BigUnsigned fromDouble(double v) {
+        if (!isfinite(v)) throw runtime_error("Only finite numbers have an integer part");
+        v = fabs(trunc(v));
+        if (v < 18446744073709551616.0) return BigUnsigned(static_cast<uint64_t>(v));
+        int exponent;
+        double fraction = frexp(v, &exponent);
+        uint64_t mantissa = static_cast<uint64_t>(ldexp(fraction, 53));
+        return BigUnsigned(mantissa).shiftedLeft(static_cast<size_t>(exponent - 53));
+    }
+
+    bool isZero() const { return limbs.empty(); }
+
+    void trim() {
+        while (!limbs.empty() && limbs.back() == 0) limbs.pop_back();
+    }
+
+    size_t bitLength() const {
+        if (limbs.empty()) return 0;
+        return (limbs.size() - 1) * 32 + (32 - __builtin_clz(limbs.back()));
+    }
+
+    double toDouble() const {
+        double result = 0.0;
+        for (size_t i = limbs.size(); i-- > 0;) result = result * 4294967296.0 + limbs[i];
+        return result;
+    }
+
+    static BigUnsigned powerOfTwo(size_t bits) {
+        BigUnsigned result;
+        result.limbs.assign(bits / 32 + 1, 0);
+        result.limbs.back() = Limb(1) << (bits % 32);
+        return result;
+    }
+
+    static int compare(const BigUnsigned& a, const BigUnsigned& b) {
+        if (a.limbs.size() != b.limbs.size()) return a.limbs.size() < b.limbs.size() ? -1 : 1;
+        for (size_t i = a.limbs.size(); i-- > 0;) {
+            if (a.limbs[i] != b.limbs[i]) return a.limbs[i] < b.limbs[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // this = this * m + add
+    void mulAddSmall(Limb m, Limb add) {
+        uint64_t carry = add;
+        for (Limb& limb : limbs) {
+            uint64_t t = static_cast<uint64_t>(limb) * m + carry;
+            limb = static_cast<Limb>(t);
+            carry = t >> 32;
+        }
+        if (carry) limbs.push_back(static_cast<Limb>(carry));
+    }
+
+    // this = this / d, returns the remainder
+    Limb divSmall(Limb d) {
+        uint64_t rem = 0;
+        for (size_t i = limbs.size(); i-- > 0;) {
+            uint64_t cur = (rem << 32) | limbs[i];
+            limbs[i] = static_cast<Limb>(cur / d);
+            rem = cur % d;
+        }
+        trim();
+        return static_cast<Limb>(rem);
+    }
+
+    static BigUnsigned add(const BigUnsigned& a, const BigUnsigned& b) {
+        BigUnsigned result = a;
+        addInto(result.limbs, 0, b.limbs.data(), b.limbs.size());
+        result.trim();
+        return result;
+    }
+
+    // Requires a >= b
+    static BigUnsigned subtract(const BigUnsigned& a, const BigUnsigned& b) {
+        BigUnsigned result = a;
+        subtractFrom(result.limbs, b.limbs.data(), b.limbs.size());
+        result.trim();
+        return result;
+    }
+
+    static BigUnsigned multiply(const BigUnsigned& a, const BigUnsigned& b) {
+        BigUnsigned result;
+        result.limbs = multiplyRange(a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size());
+        result.trim();
+        return result;
+    }
+
+    BigUnsigned shiftedLeft(size_t bits) const {
+        if (isZero()) return {};
+        size_t words = bits / 32, shift = bits % 32;
+        BigUnsigned result;
+        result.limbs.assign(limbs.size() + words + 1, 0);
+        for (size_t i = 0; i < limbs.size(); ++i) {
+            uint64_t v = static_cast<uint64_t>(limbs[i]) << shift;
+            result.limbs[i + words] |= static_cast<Limb>(v);
+            result.limbs[i + words + 1] |= static_cast<Limb>(v >> 32);
+        }
+        result.trim();
+        return result;
+    }
+
+    BigUnsigned shiftedRight(size_t bits) const {
+        size_t words = bits / 32, shift = bits % 32;
+        if (words >= limbs.size()) return {};
+        BigUnsigned result;
+        result.limbs.resize(limbs.size() - words);
+        for (size_t i = 0; i < result.limbs.size(); ++i) {
+            uint64_t v = limbs[i + words];
+            if (i + words + 1 < limbs.size()) v |= static_cast<uint64_t>(limbs[i + words + 1]) << 32;
+            result.limbs[i] = static_cast<Limb>(v >> shift);
+        }
+        result.trim();
+        return result;
+    }
+
+private:
+    static constexpr size_t KARATSUBA_THRESHOLD = 40;
+
+    // acc += b << (32 * offset), growing acc as needed
+    static void addInto(vector<Limb>& acc, size_t offset, const Limb* b, size_t nb) {
+        if (acc.size() < offset + nb + 1) acc.resize(offset + nb + 1, 0);
+        uint64_t carry = 0;
+        size_t i = 0;
+        for (; i < nb; ++i) {
+            uint64_t t = static_cast<uint64_t>(acc[offset + i]) + b[i] + carry;
+            acc[offset + i] = static_cast<Limb>(t);
+            carry = t >> 32;
+        }
+        for (size_t j = offset + i; carry != 0; ++j) {
+            if (j == acc.size()) acc.push_back(0);
+            uint64_t t = static_cast<uint64_t>(acc[j]) + carry;
+            acc[j] = static_cast<Limb>(t);
+            carry = t >> 32;
+        }
+    }
+
+    // acc -= b, requires acc >= b
+    static void subtractFrom(vector<Limb>& acc, const Limb* b, size_t nb) {
+        int64_t borrow = 0;
+        size_t i = 0;
+        for (; i < nb; ++i) {
+            int64_t t = static_cast<int64_t>(acc[i]) - b[i] - borrow;
+            borrow = t < 0;
+            acc[i] = static_cast<Limb>(t);
+        }
+        for (; borrow != 0 && i < acc.size(); ++i) {
+            int64_t t = static_cast<int64_t>(acc[i]) - borrow;
+            borrow = t < 0;
+            acc[i] = static_cast<Limb>(t);
+        }
+    }
+
+    static vector<Limb> multiplyRange(const Limb* a, size_t na, const Limb* b, size_t nb) {
+        while (na > 0 && a[na - 1] == 0) --na;
+        while (nb > 0 && b[nb - 1] == 0) --nb;
+        if (na < nb) {
+            swap(a, b);
+            swap(na, nb);
+        }
+        if (nb == 0) return {};
+        // Step 1: Schoolbook multiplication for small operands
+        if (nb < KARATSUBA_THRESHOLD) {
+            vector<Limb> out(na + nb, 0);
+            for (size_t j = 0; j < nb; ++j) {
+                uint64_t carry = 0, m = b[j];
+                for (size_t i = 0; i < na; ++i) {
+                    uint64_t t = a[i] * m + out[i + j] + carry;
+                    out[i + j] = static_cast<Limb>(t);
+                    carry = t >> 32;
+                }
+                out[na + j] = static_cast<Limb>(carry);
+            }
+            return out;
+        }
+        // Step 2: Split a = a1 * B^m + a0 around the middle of the longer operand
+        size_t m = na / 2;
+        vector<Limb> out;
+        if (nb <= m) {
+            // Step 3: Unbalanced operands, b has no high half: a1*b << m + a0*b
+            out = multiplyRange(a, m, b, nb);
+            vector<Limb> high = multiplyRange(a + m, na - m, b, nb);
+            addInto(out, m, high.data(), high.size());
+            return out;
+        }
+        // Step 4: Karatsuba: z1 = (a0 + a1)(b0 + b1) - z0 - z2
+        vector<Limb> z0 = multiplyRange(a, m, b, m);
+        vector<Limb> z2 = multiplyRange(a + m, na - m, b + m, nb - m);
+        vector<Limb> sumA(a, a + m), sumB(b, b + m);
+        addInto(sumA, 0, a + m, na - m);
+        addInto(sumB, 0, b + m, nb - m);
+        vector<Limb> z1 = multiplyRange(sumA.data(), sumA.size(), sumB.data(), sumB.size());
+        subtractFrom(z1, z0.data(), z0.size());
+        subtractFrom(z1, z2.data(), z2.size());
+        out = z0;
+        addInto(out, m, z1.data(), z1.size());
+        addInto(out, 2 * m, z2.data(), z2.size());
+        return out;
+    }
+};
+
+// Radix conversion between bases 2-36 for inputs of any length.
+// Power-of-two bases are repacked bit by bit in linear time. Other bases use divide and conquer:
+// parsing splits the digit string at b^(k*2^j) and joins halves with Karatsuba products, printing
+// splits the number with Barrett division by the same powers (reciprocals from Newton iteration).
+class RadixConverter {
+private:
+    static constexpr size_t SCHOOL_LIMBS = 24;    // below this size the quadratic loops are faster
+
+    struct BaseInfo {
+        int base;
+        int digitsPerWord;   // k such that base^k still fits in a limb
+        uint32_t wordBase;   // base^k
+        int bitsPerDigit;    // > 0 for power-of-two bases
+    };
+
+    static BaseInfo info(int base) {
+        if (base < 2 || base > 36) throw runtime_error("Base must be between 2 and 36");
+        BaseInfo bi{base, 0, 1, 0};
+        while (static_cast<uint64_t>(bi.wordBase) * base <= 0xFFFFFFFFull) {
+            bi.wordBase *= base;
+            ++bi.digitsPerWord;
+        }
+        if ((base & (base - 1)) == 0) bi.bitsPerDigit = __builtin_ctz(base);
+        return bi;
+    }
+
+    static const char* digitChars() { return "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"; }
+
+    static int digitValue(char c) {
+        static const auto table = [] {
+            array<signed char, 256> t;
+            t.fill(-1);
+            for (int i = 0; i < 36; ++i) {
+                t[static_cast<unsigned char>(digitChars()[i])] = static_cast<signed char>(i);
+                t[static_cast<unsigned char>(tolower(digitChars()[i]))] = static_cast<signed char>(i);
+            }
+            return t;
+        }();
+        return table[static_cast<unsigned char>(c)];
+    }
+
+    // Two output digits per lookup: pairs[2*v], pairs[2*v+1] spell v in the given base
+    static const string& digitPairs(int base) {
+        static array<string, 37> tables;
+        static once_flag flags[37];
+        call_once(flags[base], [base] {
+            string& t = tables[base];
+            t.resize(2 * base * base);
+            for (int v = 0; v < base * base; ++v) {
+                t[2 * v] = digitChars()[v / base];
+                t[2 * v + 1] = digitChars()[v % base];
+            }
+        });
+        return tables[base];
+    }
+
+    // Writes exactly `count` digits of `word` ending at dest[count - 1], zero padded
+    static void writeWord(uint32_t word, int count, char* dest, const BaseInfo& bi, const string& pairs) {
+        uint32_t square = bi.base * bi.base;
+        while (count >= 2) {
+            uint32_t pair = word % square;
+            word /= square;
+            count -= 2;
+            memcpy(dest + count, pairs.data() + 2 * pair, 2);
+        }
+        if (count == 1) dest[0] = digitChars()[word % bi.base];
+    }
+
+    // powers[j] = wordBase^(2^j), grown on demand
+    static const BigUnsigned& power(vector<BigUnsigned>& powers, const BaseInfo& bi, size_t j) {
+        if (powers.empty()) powers.push_back(BigUnsigned(bi.wordBase));
+        while (powers.size() <= j) powers.push_back(BigUnsigned::multiply(powers.back(), powers.back()));
+        return powers[j];
+    }
+
+    static BigUnsigned parseSchoolbook(string_view digits, const BaseInfo& bi) {
+        BigUnsigned result;
+        size_t i = 0;
+        // Step 1: Leading partial word so the rest splits into whole words
+        size_t head = digits.size() % bi.digitsPerWord;
+        if (head == 0) head = bi.digitsPerWord;
+        while (i < digits.size()) {
+            uint32_t word = 0, scale = 1;
+            size_t end = i + head;
+            for (; i < end; ++i) {
+                word = word * bi.base + digitValue(digits[i]);
+                scale *= bi.base;
+            }
+            // Step 2: Shift the accumulated value by one word and add the new one
+            result.mulAddSmall(scale, word);
+            head = bi.digitsPerWord;
+        }
+        result.trim();
+        return result;
+    }
+
+    static BigUnsigned parseRecursive(string_view digits, const BaseInfo& bi, vector<BigUnsigned>& powers) {
+        size_t words = (digits.size() + bi.digitsPerWord - 1) / bi.digitsPerWord;
+        if (words <= SCHOOL_LIMBS) return parseSchoolbook(digits, bi);
+        // Low half holds k * 2^j digits, the largest such split that leaves a non-empty high half
+        size_t j = 0;
+        while ((static_cast<size_t>(bi.digitsPerWord) << (j + 1)) < digits.size()) ++j;
+        size_t lowCount = static_cast<size_t>(bi.digitsPerWord) << j;
+        BigUnsigned high = parseRecursive(digits.substr(0, digits.size() - lowCount), bi, powers);
+        BigUnsigned low = parseRecursive(digits.substr(digits.size() - lowCount), bi, powers);
+        return BigUnsigned::add(BigUnsigned::multiply(high, power(powers, bi, j)), low);
+    }
+
+    static BigUnsigned parsePowerOfTwo(string_view digits, const BaseInfo& bi) {
+        BigUnsigned result;
+        result.limbs.assign((digits.size() * bi.bitsPerDigit + 31) / 32 + 1, 0);
+        size_t bit = 0;
+        for (size_t i = digits.size(); i-- > 0; bit += bi.bitsPerDigit) {
+            uint64_t v = static_cast<uint64_t>(digitValue(digits[i])) << (bit % 32);
+            result.limbs[bit / 32] |= static_cast<uint32_t>(v);
+            if (v >> 32) result.limbs[bit / 32 + 1] |= static_cast<uint32_t>(v >> 32);
+        }
+        result.trim();
+        return result;
+    }
+
+    static string printPowerOfTwo(const BigUnsigned& n, const BaseInfo& bi) {
+        size_t count = (n.bitLength() + bi.bitsPerDigit - 1) / bi.bitsPerDigit;
+        string out(count, '0');
+        uint32_t mask = bi.base - 1;
+        for (size_t d = 0, bit = 0; d < count; ++d, bit += bi.bitsPerDigit) {
+            uint64_t v = n.limbs[bit / 32];
+            if (bit / 32 + 1 < n.limbs.size()) v |= static_cast<uint64_t>(n.limbs[bit / 32 + 1]) << 32;
+            out[count - 1 - d] = digitChars()[(v >> (bit % 32)) & mask];
+        }
+        return out;
+    }
+
+    // floor(2^(2s) / d) where s = bitLength(d), by Newton iteration from a half-precision estimate
+    static BigUnsigned reciprocal(const BigUnsigned& d) {
+        size_t s = d.bitLength();
+        if (s <= 62) {
+            uint64_t dv = d.limbs[0] | (d.limbs.size() > 1 ? static_cast<uint64_t>(d.limbs[1]) << 32 : 0);
+            return BigUnsigned(static_cast<uint64_t>((static_cast<unsigned __int128>(1) << (2 * s)) / dv));
+        }
+        // Step 1: Estimate from the top h bits, rounded up so the estimate stays below the true value
+        size_t h = s / 2 + 4;
+        BigUnsigned top = BigUnsigned::add(d.shiftedRight(s - h), BigUnsigned(1));
+        size_t t = top.bitLength();
+        BigUnsigned v = reciprocal(top).shiftedLeft(s + h - 2 * t);
+        // Step 2: One Newton step doubles the correct bits: v += v * (2^(2s) - d*v) / 2^(2s)
+        BigUnsigned full = BigUnsigned::powerOfTwo(2 * s);
+        BigUnsigned error = BigUnsigned::subtract(full, BigUnsigned::multiply(d, v));
+        v = BigUnsigned::add(v, BigUnsigned::multiply(v, error).shiftedRight(2 * s));
+        // Step 3: Fix the last few units exactly
+        error = BigUnsigned::subtract(full, BigUnsigned::multiply(d, v));
+        while (BigUnsigned::compare(error, d) >= 0) {
+            error = BigUnsigned::subtract(error, d);
+            v = BigUnsigned::add(v, BigUnsigned(1));
+        }
+        return v;
+    }
+
+    struct Divisor {
+        BigUnsigned value, inverse;
+        size_t bits;
+    };
+
+    // Barrett division of n < 2^(2*bits) by a precomputed divisor
+    static void divide(const BigUnsigned& n, const Divisor& d, BigUnsigned& q, BigUnsigned& r) {
+        q = BigUnsigned::multiply(n.shiftedRight(d.bits - 1), d.inverse).shiftedRight(d.bits + 1);
+        BigUnsigned product = BigUnsigned::multiply(q, d.value);
+        while (BigUnsigned::compare(product, n) > 0) {
+            product = BigUnsigned::subtract(product, d.value);
+            q = BigUnsigned::subtract(q, BigUnsigned(1));
+        }
+        r = BigUnsigned::subtract(n, product);
+        while (BigUnsigned::compare(r, d.value) >= 0) {
+            r = BigUnsigned::subtract(r, d.value);
+            q = BigUnsigned::add(q, BigUnsigned(1));
+        }
+    }
+
+    static void printRecursive(BigUnsigned n, size_t level, char* dest, size_t count, const BaseInfo& bi,
+                               vector<Divisor>& divisors, const string& pairs) {
+        if (n.limbs.size() <= SCHOOL_LIMBS) {
+            // Step 1: Small values: peel off one word of digits at a time from the right
+            size_t pos = count;
+            while (!n.isZero() && pos > 0) {
+                uint32_t word = n.divSmall(bi.wordBase);
+                size_t width = min<size_t>(bi.digitsPerWord, pos);
+                pos -= width;
+                writeWord(word, static_cast<int>(width), dest + pos, bi, pairs);
+            }
+            return;
+        }
+        // Step 2: Split into high and low halves by wordBase^(2^(level-1)) and recurse
+        const Divisor& d = divisors[level - 1];
+        BigUnsigned q, r;
+        divide(n, d, q, r);
+        size_t half = count / 2;
+        printRecursive(move(q), level - 1, dest, count - half, bi, divisors, pairs);
+        printRecursive(move(r), level - 1, dest + count - half, half, bi, divisors, pairs);
+    }
+
+public:
+    static BigUnsigned parse(string_view digits, int base) {
+        BaseInfo bi = info(base);
+        if (digits.empty()) throw runtime_error("Invalid number format for the specified base");
+        if (NumberParser::firstInvalidDigit(digits, base) != digits.size()) {
+            throw runtime_error("Invalid number format for the specified base");
+        }
+        if (bi.bitsPerDigit > 0) return parsePowerOfTwo(digits, bi);
+        vector<BigUnsigned> powers;
+        return parseRecursive(digits, bi, powers);
+    }
+
+    static string print(const BigUnsigned& n, int base) {
+        BaseInfo bi = info(base);
+        if (n.isZero()) return "0";
+        if (bi.bitsPerDigit > 0) return printPowerOfTwo(n, bi);
+        // Step 1: Find the level whose power exceeds n; the output has k * 2^level digits at most
+        vector<BigUnsigned> powers;
+        size_t level = 0;
+        while (BigUnsigned::compare(power(powers, bi, level), n) <= 0) ++level;
+        // Step 2: Reciprocals for the Barrett division at each level
+        vector<Divisor> divisors;
+        for (size_t j = 0; j < level; ++j) {
+            divisors.push_back({powers[j], reciprocal(powers[j]), powers[j].bitLength()});
+        }
+        // Step 3: Preallocate the zero-padded output and fill it in place
+        size_t count = static_cast<size_t>(bi.digitsPerWord) << level;
+        string out(count, '0');
+        printRecursive(n, level, out.data(), count, bi, divisors, digitPairs(base));
+        size_t first = out.find_first_not_of('0');
+        return out.substr(first);
+    }
+
+    // The base a numeric operand names, truncated as before, or 0 (which convert() rejects) when it is
+    // NaN or outside 2-36, so no out-of-range value is ever cast to int
+    static int baseOf(double operand) {
+        return operand >= 2.0 && operand < 37.0 ? static_cast<int>(operand) : 0;
+    }
+
+    // Accepts an optional leading sign
+    static string convert(string_view digits, int fromBase, int toBase) {
+        bool negative = !digits.empty() && digits[0] == '-';
+        if (!digits.empty() && (digits[0] == '-' || digits[0] == '+')) digits.remove_prefix(1);
+        BigUnsigned n = parse(digits, fromBase);
+        string result = print(n, toBase);
+        return negative && !n.isZero() ? "-" + result : result;
+    }
+};
+
+class NumberBaseConverter : public Converter {
+private:
+    string inputValue;
+    char fromBase, toBase;
+    bool integral = false;    // input parsed exactly as an integer of any width
+    bool negative = false;
+    BigUnsigned magnitude;
+
+    static int radixOf(char code) {
+        switch (code) {
+            case 'B': return 2;
+            case 'D': return 10;
+            case 'O': return 8;
+            case 'H': return 16;
+            default: return 0;
+        }
+    }
+
+public:
+    NumberBaseConverter(string val, char from, char to)
+        : Converter(0), inputValue(val), fromBase(toupper(from)), toBase(toupper(to)) {
+        // Step-by-step process to parse the input string
+        // Step 1: Check the source base
+        int radix = radixOf(fromBase);
+        if (radix == 0) {
+            throw runtime_error("Invalid source base (use B, D, O, H)");
+        }
+        // Step 2: Split off an optional sign
+        string_view digits = val;
+        negative = !digits.empty() && digits[0] == '-';
+        if (!digits.empty() && (digits[0] == '-' || digits[0] == '+')) digits.remove_prefix(1);
+        // Step 3: Decimal numbers with a fraction keep the old behaviour (the fraction is dropped on output)
+        if (fromBase == 'D' && NumberParser::firstInvalidDigit(digits, 10) != digits.size()) {
+            ParseStatus status = NumberParser::parseDouble(val, value);
+            if (status == ParseStatus::OutOfRange) throw runtime_error("Number out of range for conversion");
+            if (status != ParseStatus::Ok || !isfinite(value)) throw runtime_error("Invalid number format for the specified base");
+            negative = value < 0;
+            magnitude = BigUnsigned::fromDouble(value);
+            return;
+        }
+        // Step 4: Integers of any length are parsed exactly
+        magnitude = RadixConverter::parse(digits, radix);
+        integral = true;
+        value = negative ? -magnitude.toDouble() : magnitude.toDouble();
+    }
+
+    // The numeric value of the input; getResultString() holds the digits in the target base
+    double convert() const override {
+        if (radixOf(toBase) == 0) {
+            throw runtime_error("Invalid target base (use B, D, O, H)");
+        }
+        return integral ? value : trunc(value);
+    }
+
+    string getResultString() const {
+        // Step 1: Check the target base
+        int radix = radixOf(toBase);
+        if (radix == 0) {
+            throw runtime_error("Invalid target base");
+        }
+        // Step 2: Print the magnitude in the target base and restore the sign
+        string digits = RadixConverter::print(magnitude, radix);
+        return negative && !magnitude.isZero() ? "-" + digits : digits;
+    }
+
+    string getType() const override { return "Number Base"; }
+};
+
+class LogarithmicCalculator : public Converter {
+private:
+    char logType;
+public:
+    LogarithmicCalculator(double val, char type) : Converter(val), logType(toupper(type)) {}
+
+    double convert() const override {
+        return apply(value, logType);
+    }
+
+    static double apply(double value, char logType) {
+        // Step-by-step logarithmic calculation process
+        // Step 1: Check if the input value is positive (log is undefined for non-positive numbers)
+        if (value <= 0) {
+            throw runtime_error("Logarithm undefined for non-positive numbers");
+        }
+        // Step 2: Check the type of logarithm to compute (the fast math kernels when enabled)
+        bool fast = FastMath::enabled();
+        if (logType == 'L') {
+            // Step 3: For base 10 logarithm, use log10() function
+            return fast ? FastMath::compute(FastMath::Function::Log10, value) : log10(value);
+        }
+        if (logType == 'N') {
+            // Step 4: For natural logarithm (base e), use log() function
+            return fast ? FastMath::compute(FastMath::Function::Ln, value) : log(value);
+        }
+        if (logType == 'B') {
+            // Step 5: For base 2 logarithm, use log2() function
+            return fast ? FastMath::compute(FastMath::Function::Log2, value) : log2(value);
+        }
+        // Step 6: If the log type is invalid, throw an error
+        throw runtime_error("Invalid log type (use L, N, B)");
+    }
+    string getType() const override { return "Logarithm"; }
+};
+
+// Binary rate table: a 16-byte header followed by one 16-byte entry per currency, little-endian.
+// unitsPerPivot is how much of the currency one unit of the pivot currency buys, so any pair
+// converts as amount / unitsPerPivot[from] * unitsPerPivot[to].
+struct RateFileHeader {
+    char magic[4];        // "TCRT"
+    uint32_t version;     // 1
+    uint32_t count;
+    uint32_t pivot;       // index of the pivot currency (its rate is 1)
+};
+
+struct RateFileEntry {
+    char code[4];         // ISO 4217 code, NUL padded
+    uint32_t reserved;
+    double unitsPerPivot;
+};
+
+// One immutable snapshot of the rates, either memory-mapped from a file or built in
+class RateTable {
+private:
+    static constexpr int CODE_SPACE = 26 * 26 * 26;
+
+    vector<RateFileEntry> owned;
+    const RateFileEntry* entries = nullptr;
+    size_t count = 0;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    vector<int16_t> byCode;      // dense index over all three-letter codes
+
+    RateTable() : byCode(CODE_SPACE, -1) {}
+
+    void index() {
+        for (size_t i = 0; i < count; ++i) {
+            int key = currencyKey(string_view(entries[i].code, strnlen(entries[i].code, 4)));
+            double rate = entries[i].unitsPerPivot;
+            if (key < 0 || !(rate > 0.0) || !isfinite(rate)) {
+                throw runtime_error("Invalid rate table entry " + to_string(i));
+            }
+            byCode[key] = static_cast<int16_t>(i);
+        }
+    }
+
+public:
+    // Dense key for a currency: three-letter ISO codes, or the menu letters I, U, E, G; -1 if invalid
+    static int currencyKey(string_view code) {
+        if (code.size() == 1) {
+            switch (toupper(static_cast<unsigned char>(code[0]))) {
+                case 'I': return currencyKey("INR");
+                case 'U': return currencyKey("USD");
+                case 'E': return currencyKey("EUR");
+                case 'G': return currencyKey("GBP");
+                default: return -1;
+            }
+        }
+        if (code.size() != 3) return -1;
+        int key = 0;
+        for (char c : code) {
+            c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            if (c < 'A' || c > 'Z') return -1;
+            key = key * 26 + (c - 'A');
+        }
+        return key;
+    }
+
+    static string codeOfKey(int key) {
+        string code(3, 'A');
+        for (int i = 2; i >= 0; --i, key /= 26) code[i] = static_cast<char>('A' + key % 26);
+        return code;
+    }
+
+    RateTable(const RateTable&) = delete;
+    RateTable& operator=(const RateTable&) = delete;
+
+    ~RateTable() {
+        if (mapping) munmap(mapping, mappingSize);
+    }
+
+    static unique_ptr<RateTable> builtin() {
+        unique_ptr<RateTable> table(new RateTable());
+        table->owned = {{"USD", 0, 1.0}, {"INR", 0, 83.33}, {"EUR", 0, 0.92}, {"GBP", 0, 0.79}};
+        table->entries = table->owned.data();
+        table->count = table->owned.size();
+        table->index();
+        return table;
+    }
+
+    static unique_ptr<RateTable> load(const string& path) {
+        // Step 1: Map the whole file read-only
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open rate table " + path);
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(RateFileHeader)) {
+            close(fd);
+            throw runtime_error("Rate table " + path + " is too short");
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) throw runtime_error("Cannot map rate table " + path);
+        unique_ptr<RateTable> table(new RateTable());
+        table->mapping = mapping;
+        table->mappingSize = size;
+        // Step 2: Validate the header against the file size
+        const auto* header = static_cast<const RateFileHeader*>(mapping);
+        if (memcmp(header->magic, "TCRT", 4) != 0 || header->version != 1) {
+            throw runtime_error("Rate table " + path + " has an unknown format");
+        }
+        if (header->count == 0 || header->count > 32767 || header->pivot >= header->count ||
+            size < sizeof(RateFileHeader) + static_cast<size_t>(header->count) * sizeof(RateFileEntry)) {
+            throw runtime_error("Rate table " + path + " is truncated or inconsistent");
+        }
+        // Step 3: Entries are used in place
+        table->entries = reinterpret_cast<const RateFileEntry*>(header + 1);
+        table->count = header->count;
+        table->index();
+        return table;
+    }
+
+    // Text format: one "<ISO code> <units per pivot>" pair per line, the pivot (rate 1) listed first
+    static void compile(const string& textPath, const string& binaryPath) {
+        ifstream in(textPath);
+        if (!in) throw runtime_error("Cannot open " + textPath);
+        vector<RateFileEntry> rows;
+        string code;
+        double rate;
+        while (in >> code >> rate) {
+            if (code.size() != 3 || currencyKey(code) < 0 || !(rate > 0.0)) {
+                throw runtime_error("Invalid rate line for " + code);
+            }
+            RateFileEntry entry{};
+            for (int i = 0; i < 3; ++i) entry.code[i] = static_cast<char>(toupper(static_cast<unsigned char>(code[i])));
+            entry.unitsPerPivot = rate;
+            rows.push_back(entry);
+        }
+        if (rows.empty()) throw runtime_error("No rates in " + textPath);
+        write(binaryPath, rows);
+    }
+
+    // Writes to a temporary file and renames it over the target, so mapped readers never see a partial file
+    static void write(const string& path, const vector<RateFileEntry>& rows) {
+        RateFileHeader header{{'T', 'C', 'R', 'T'}, 1, static_cast<uint32_t>(rows.size()), 0};
+        string temp = path + ".tmp";
+        FILE* out = fopen(temp.c_str(), "wb");
+        if (!out) throw runtime_error("Cannot write " + temp);
+        fwrite(&header, sizeof(header), 1, out);
+        fwrite(rows.data(), sizeof(RateFileEntry), rows.size(), out);
+        if (fclose(out) != 0 || rename(temp.c_str(), path.c_str()) != 0) {
+            throw runtime_error("Cannot replace " + path);
+        }
+    }
+
+    size_t size() const { return count; }
+    string_view code(int index) const { return string_view(entries[index].code, strnlen(entries[index].code, 4)); }
+
+    // Index of a currency key in this table, -1 when the table does not list it
+    int indexOf(int key) const { return key < 0 || key >= CODE_SPACE ? -1 : byCode[key]; }
+
+    // Units of the currency per unit of the pivot
+    double quote(int index) const { return entries[index].unitsPerPivot; }
+
+    LinearFactors factors(int from, int to) const {
+        return {entries[to].unitsPerPivot / entries[from].unitsPerPivot, 0.0};
+    }
+
+    double convert(double amount, int from, int to) const {
+        return amount / entries[from].unitsPerPivot * entries[to].unitsPerPivot;
+    }
+};
+
+// Publishes the current RateTable to any number of reader threads (read-copy-update).
+// Readers never block: they bump a per-slot counter for the current epoch, confirm the epoch did
+// not move meanwhile, and load the pointer.
+// A reload swaps the pointer, flips the epoch and frees the old table once the old epoch drains.
+class CurrencyRates {
+private:
+    static constexpr size_t READER_SLOTS = 64;
+
+    struct alignas(64) ReaderSlot {
+        atomic<long> active[2] = {0, 0};
+    };
+
+    atomic<const RateTable*> current;
+    atomic<unsigned long> epoch{0};
+    ReaderSlot slots[READER_SLOTS];
+    mutex writerLock;
+    atomic<unsigned long> reloads{0};
+
+    string watchedPath;
+    thread watcher;
+    atomic<bool> stopWatcher{false};
+
+    CurrencyRates() : current(RateTable::builtin().release()) {}
+
+    static size_t slotIndex() {
+        static atomic<size_t> nextSlot{0};
+        thread_local size_t index = nextSlot.fetch_add(1) % READER_SLOTS;
+        return index;
+    }
+
+public:
+    class ReadGuard {
+    private:
+        atomic<long>* counter;
+        const RateTable* table;
+    public:
+        ReadGuard(atomic<long>* c, const RateTable* t) : counter(c), table(t) {}
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ~ReadGuard() { counter->fetch_sub(1, memory_order_release); }
+        const RateTable* operator->() const { return table; }
+        const RateTable& operator*() const { return *table; }
+    };
+
+    ~CurrencyRates() {
+        stopWatcher = true;
+        if (watcher.joinable()) watcher.join();
+        delete current.load();
+    }
+
+    static CurrencyRates& instance() {
+        static CurrencyRates rates;
+        return rates;
+    }
+
+    ReadGuard read() {
+        // The epoch is checked again after the increment: a reader that counted itself under an epoch
+        // that has since flipped may not be waited for by the next writer, so it backs out and retries
+        ReaderSlot& slot = slots[slotIndex()];
+        while (true) {
+            unsigned long seen = epoch.load();
+            atomic<long>* counter = &slot.active[seen & 1];
+            counter->fetch_add(1);
+            if (epoch.load() == seen) return ReadGuard(counter, current.load());
+            counter->fetch_sub(1);
+        }
+    }
+
+    void publish(unique_ptr<RateTable> next) {
+        lock_guard<mutex> lock(writerLock);
+        // Step 1: New readers see the new table from here on
+        const RateTable* old = current.exchange(next.release());
+        // Step 2: Move new readers to the other counter, then wait for the old epoch to drain
+        unsigned long parity = epoch.fetch_add(1) & 1;
+        for (ReaderSlot& slot : slots) {
+            while (slot.active[parity].load() != 0) this_thread::yield();
+        }
+        delete old;
+        ++reloads;
+    }
+
+    void load(const string& path) { publish(RateTable::load(path)); }
+
+    unsigned long reloadCount() const { return reloads.load(); }
+
+    // Polls the file's modification time and reloads it in the background; a bad file keeps the old rates
+    void watch(const string& path, chrono::milliseconds interval) {
+        load(path);
+        watchedPath = path;
+        watcher = thread([this, interval] {
+            struct stat last{};
+            stat(watchedPath.c_str(), &last);
+            while (!stopWatcher) {
+                this_thread::sleep_for(interval);
+                struct stat now{};
+                if (stat(watchedPath.c_str(), &now) != 0) continue;
+                if (now.st_mtim.tv_sec == last.st_mtim.tv_sec && now.st_mtim.tv_nsec == last.st_mtim.tv_nsec &&
+                    now.st_ino == last.st_ino && now.st_size == last.st_size) {
+                    continue;
+                }
+                last = now;
+                try {
+                    load(watchedPath);
+                } catch (const runtime_error& e) {
+                    cerr << RED_COLOR << "Rate reload failed: " << e.what() << RESET_COLOR << endl;
+                }
+            }
+        });
+    }
+};
+
+class CurrencyConverter : public Converter {
+private:
+    int fromKey, toKey;
+
+    static constexpr const char* UNIT_ERROR = "Invalid or unsupported currency (use I, U, E, G or an ISO code)";
+
+    static pair<int, int> resolve(const RateTable& table, int fromKey, int toKey) {
+        int a = table.indexOf(fromKey), b = table.indexOf(toKey);
+        if (a < 0 || b < 0) throw runtime_error(UNIT_ERROR);
+        return {a, b};
+    }
+
+public:
+    CurrencyConverter(double amount, char from, char to)
+        : CurrencyConverter(amount, string_view(&from, 1), string_view(&to, 1)) {}
+
+    CurrencyConverter(double amount, string_view from, string_view to)
+        : CurrencyConverter(amount, RateTable::currencyKey(from), RateTable::currencyKey(to)) {}
+
+    // Keys from RateTable::currencyKey()
+    CurrencyConverter(double amount, int from, int to) : Converter(amount), fromKey(from), toKey(to) {}
+
+    double convert() const override {
+        auto rates = CurrencyRates::instance().read();
+        auto [a, b] = resolve(*rates, fromKey, toKey);
+        return rates->convert(value, a, b);
+    }
+
+    static LinearFactors linearFactors(string_view from, string_view to) {
+        auto rates = CurrencyRates::instance().read();
+        auto [a, b] = resolve(*rates, RateTable::currencyKey(from), RateTable::currencyKey(to));
+        return rates->factors(a, b);
+    }
+
+    static LinearFactors linearFactors(char from, char to) {
+        return linearFactors(string_view(&from, 1), string_view(&to, 1));
+    }
+
+    static void convert(span<const double> in, span<double> out, char from, char to) {
+        LinearFactors f = linearFactors(from, to);
+        LinearKernel::apply(in, out, f.scale, f.offset);
+    }
+
+    string getType() const override { return "Currency"; }
+};
+
+class LengthConverter : public RegistryConverter {
+private:
+    static constexpr int DIMENSION = dimensionIndex("Length");
+    static constexpr const char* UNIT_ERROR = "Invalid length units (use M or F)";
+public:
+    LengthConverter(double length, char from, char to)
+        : RegistryConverter(length, DIMENSION, from, to, UNIT_ERROR) {}
+
+    using RegistryConverter::convert;
+
+    static LinearFactors linearFactors(char from, char to) {
+        return codeFactors(DIMENSION, from, to, UNIT_ERROR);
+    }
+
+    static void convert(span<const double> in, span<double> out, char from, char to) {
+        LinearFactors f = linearFactors(from, to);
+        LinearKernel::apply(in, out, f.scale, f.offset);
+    }
+
+    string getType() const override { return "Length"; }
+};
+
+// Any registry unit by symbol, e.g. "km" to "mi" or "kWh" to "BTU"
+class UnitConverter : public Converter {
+private:
+    int fromId, toId;
+public:
+    UnitConverter(double val, string_view from, string_view to)
+        : UnitConverter(val, UnitRegistry::instance().find(from), UnitRegistry::instance().find(to)) {
+        if (fromId < 0) throw runtime_error("Unknown unit '" + string(from) + "'");
+        if (toId < 0) throw runtime_error("Unknown unit '" + string(to) + "'");
+    }
+
+    UnitConverter(double val, int from, int to) : Converter(val), fromId(from), toId(to) {}
+
+    double convert() const override {
+        return UnitRegistry::instance().convert(value, fromId, toId);
+    }
+
+    string getUnitInfo() const {
+        const UnitRegistry& registry = UnitRegistry::instance();
+        return registry.symbol(fromId) + " to " + registry.symbol(toId);
+    }
+
+    string getType() const override { return UnitRegistry::instance().dimensionOf(fromId); }
+};
+
+class Calculator {
+private:
+    double num1, num2;
+    char operation;
+public:
+    Calculator(double n1, char op, double n2 = 0.0) : num1(n1), num2(n2), operation(toupper(op)) {}
+
+    double calculate() const {
+        return apply(num1, operation, num2);
+    }
+
+    // Shared operator semantics for the menu, batch mode and compiled expressions
+    static double apply(double num1, char operation, double num2) {
+        // Step-by-step calculation process based on the operation
+        switch (operation) {
+            case '+':
+                // Step 1: For addition, add num1 and num2
+                return num1 + num2;
+            case '-':
+                // Step 2: For subtraction, subtract num2 from num1
+                return num1 - num2;
+            case '*':
+                // Step 3: For multiplication, multiply num1 by num2
+                return num1 * num2;
+            case '/':
+                // Step 4: For division, check if num2 is zero
+                if (num2 == 0) {
+                    // Step 5: If num2 is zero, throw an error
+                    throw runtime_error("Division by zero");
+                }
+                // Step 6: Divide num1 by num2
+                return num1 / num2;
+            case '^':
+                // Step 7: For exponentiation, raise num1 to the power of num2
+                return pow(num1, num2);
+            case 'S':
+                // Step 8: For sine, convert num1 from degrees to radians
+                //         - Multiply num1 by π/180
+                // Step 9: Compute the sine of the angle
+                if (FastMath::enabled()) return FastMath::compute(FastMath::Function::Sin, num1) + 0.0;   // no -0.00
+                return sin(num1 * M_PI / 180.0);
+            case 'C':
+                // Step 10: For cosine, convert num1 from degrees to radians
+                //          - Multiply num1 by π/180
+                // Step 11: Compute the cosine of the angle
+                if (FastMath::enabled()) return FastMath::compute(FastMath::Function::Cos, num1) + 0.0;
+                return cos(num1 * M_PI / 180.0);
+            case 'T': {
+                // Step 12: For tangent, convert num1 from degrees to radians
+                //          - Multiply num1 by π/180
+                //          (fast math reduces degrees exactly, so 90°, 270°, etc. give no finite result)
+                if (FastMath::enabled()) {
+                    double tangent = FastMath::compute(FastMath::Function::Tan, num1);
+                    if (!isfinite(tangent)) throw runtime_error("Tan undefined");
+                    return tangent + 0.0;
+                }
+                double radians = num1 * M_PI / 180.0;
+                // Step 13: Check if cosine is zero (tan is undefined at 90°, 270°, etc.)
+                if (cos(radians) == 0) {
+                    // Step 14: If cosine is zero, throw an error
+                    throw runtime_error("Tan undefined");
+                }
+                // Step 15: Compute the tangent of the angle
+                return tan(radians);
+            }
+            default:
+                // Step 16: If the operation is invalid, throw an error
+                throw runtime_error("Invalid operation (use +, -, *, /, ^, S, C, T)");
+        }
+    }
+};
+
+// Expression engine: tokenizer -> precedence-climbing parser -> folded AST -> flat stack program.
+// Operators and functions reuse Calculator::apply and LogarithmicCalculator::apply, so
+// "1 / 0", "tan(90)" or "log(-1)" fail exactly like the menu operations do.
+struct ExpressionToken {
+    enum Kind { Number, Identifier, Operator, LeftParen, RightParen, End } kind;
+    double number = 0.0;
+    string text;
+    size_t position = 0;
+};
+
+class ExpressionTokenizer {
+private:
+    const string& source;
+    size_t pos = 0;
+
+public:
+    explicit ExpressionTokenizer(const string& text) : source(text) {}
+
+    ExpressionToken next() {
+        while (pos < source.size() && isspace(static_cast<unsigned char>(source[pos]))) ++pos;
+        ExpressionToken token;
+        token.position = pos;
+        if (pos == source.size()) {
+            token.kind = ExpressionToken::End;
+            return token;
+        }
+        char c = source[pos];
+        if (isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            // Scan the literal (decimal, or hex after 0x), then parse it locale-free
+            size_t start = pos;
+            bool hex = c == '0' && pos + 2 < source.size() && (source[pos + 1] | 0x20) == 'x' &&
+                       (isxdigit(static_cast<unsigned char>(source[pos + 2])) || source[pos + 2] == '.');
+            if (hex) pos += 2;
+            auto digit = [&](char d) { return hex ? isxdigit(static_cast<unsigned char>(d)) : isdigit(static_cast<unsigned char>(d)); };
+            while (pos < source.size() && (digit(source[pos]) || source[pos] == '.')) ++pos;
+            if (pos < source.size() && (source[pos] | 0x20) == (hex ? 'p' : 'e')) {
+                size_t exponent = pos + 1;
+                if (exponent < source.size() && (source[exponent] == '+' || source[exponent] == '-')) ++exponent;
+                if (exponent < source.size() && isdigit(static_cast<unsigned char>(source[exponent]))) {
+                    pos = exponent;
+                    while (pos < source.size() && isdigit(static_cast<unsigned char>(source[pos]))) ++pos;
+                }
+            }
+            token.kind = ExpressionToken::Number;
+            ParseStatus status = NumberParser::parseDouble(string_view(source).substr(start, pos - start), token.number);
+            if (status == ParseStatus::OutOfRange) throw runtime_error("Number out of range at position " + to_string(start + 1));
+            if (status != ParseStatus::Ok) throw runtime_error("Invalid number at position " + to_string(start + 1));
+            return token;
+        }
+        if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = pos;
+            while (pos < source.size() && (isalnum(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) ++pos;
+            token.kind = ExpressionToken::Identifier;
+            token.text = source.substr(start, pos - start);
+            return token;
+        }
+        ++pos;
+        token.text = string(1, c);
+        if (c == '(') token.kind = ExpressionToken::LeftParen;
+        else if (c == ')') token.kind = ExpressionToken::RightParen;
+        else if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^') token.kind = ExpressionToken::Operator;
+        else throw runtime_error("Unexpected character '" + token.text + "' at position " + to_string(pos));
+        return token;
+    }
+};
+
+struct ExpressionNode {
+    enum Kind { Constant, Variable, Negate, Binary, Trig, Log } kind;
+    double value = 0.0;   // Constant
+    int variable = -1;    // Variable slot
+    char op = 0;          // Binary operator, trig S/C/T or log L/N/B
+    unique_ptr<ExpressionNode> left, right;
+
+    bool isConstant() const { return kind == Constant; }
+};
+
+class ExpressionParser {
+private:
+    ExpressionTokenizer tokenizer;
+    ExpressionToken current;
+    vector<string>& variables;
+
+    void advance() { current = tokenizer.next(); }
+
+    static int precedence(char op) {
+        if (op == '+' || op == '-') return 1;
+        if (op == '*' || op == '/') return 2;
+        if (op == '^') return 3;
+        return 0;
+    }
+
+    // Replace a node by its value when every operand is constant; errors are left for evaluation time
+    static unique_ptr<ExpressionNode> fold(unique_ptr<ExpressionNode> node) {
+        bool constant = node->left && node->left->isConstant() && (!node->right || node->right->isConstant());
+        if (!constant) return node;
+        try {
+            double a = node->left->value;
+            double folded = node->kind == ExpressionNode::Negate ? -a
+                          : node->kind == ExpressionNode::Binary ? Calculator::apply(a, node->op, node->right->value)
+                          : node->kind == ExpressionNode::Trig ? Calculator::apply(a, node->op, 0.0)
+                          : LogarithmicCalculator::apply(a, node->op);
+            auto result = make_unique<ExpressionNode>();
+            result->kind = ExpressionNode::Constant;
+            result->value = folded;
+            return result;
+        } catch (const runtime_error&) {
+            return node;
+        }
+    }
+
+    static unique_ptr<ExpressionNode> makeNode(ExpressionNode::Kind kind, char op, unique_ptr<ExpressionNode> left,
+                                               unique_ptr<ExpressionNode> right = nullptr) {
+        auto node = make_unique<ExpressionNode>();
+        node->kind = kind;
+        node->op = op;
+        node->left = move(left);
+        node->right = move(right);
+        return fold(move(node));
+    }
+
+    int variableSlot(const string& name) {
+        for (size_t i = 0; i < variables.size(); ++i) {
+            if (variables[i] == name) return static_cast<int>(i);
+        }
+        variables.push_back(name);
+        return static_cast<int>(variables.size() - 1);
+    }
+
+    unique_ptr<ExpressionNode> parsePrimary() {
+        ExpressionToken token = current;
+        if (token.kind == ExpressionToken::Number) {
+            advance();
+            auto node = make_unique<ExpressionNode>();
+            node->kind = ExpressionNode::Constant;
+            node->value = token.number;
+            return node;
+        }
+        if (token.kind == ExpressionToken::LeftParen) {
+            advance();
+            auto inner = parseExpression(1);
+            expect(ExpressionToken::RightParen, "')'");
+            return inner;
+        }
+        if (token.kind == ExpressionToken::Identifier) {
+            advance();
+            char function = token.text == "sin" ? 'S' : token.text == "cos" ? 'C' : token.text == "tan" ? 'T'
+                          : token.text == "log" ? 'L' : token.text == "ln" ? 'N' : token.text == "log2" ? 'B' : 0;
+            if (function != 0 && current.kind == ExpressionToken::LeftParen) {
+                advance();
+                auto argument = parseExpression(1);
+                expect(ExpressionToken::RightParen, "')'");
+                bool trig = function == 'S' || function == 'C' || function == 'T';
+                return makeNode(trig ? ExpressionNode::Trig : ExpressionNode::Log, function, move(argument));
+            }
+            auto node = make_unique<ExpressionNode>();
+            if (token.text == "pi" || token.text == "e") {
+                node->kind = ExpressionNode::Constant;
+                node->value = token.text == "pi" ? M_PI : M_E;
+            } else {
+                node->kind = ExpressionNode::Variable;
+                node->variable = variableSlot(token.text);
+            }
+            return node;
+        }
+        throw runtime_error("Unexpected " + (token.kind == ExpressionToken::End ? string("end of expression")
+                            : "'" + token.text + "'") + " at position " + to_string(token.position + 1));
+    }
+
+    unique_ptr<ExpressionNode> parseUnary() {
+        if (current.kind == ExpressionToken::Operator && (current.text == "-" || current.text == "+")) {
+            bool negate = current.text == "-";
+            advance();
+            // Unary minus binds looser than '^', so -2^2 is -(2^2)
+            auto operand = parseExpression(precedence('^'));
+            return negate ? makeNode(ExpressionNode::Negate, '-', move(operand)) : move(operand);
+        }
+        return parsePrimary();
+    }
+
+    unique_ptr<ExpressionNode> parseExpression(int minPrecedence) {
+        auto left = parseUnary();
+        while (current.kind == ExpressionToken::Operator && precedence(current.text[0]) >= minPrecedence) {
+            char op = current.text[0];
+            int prec = precedence(op);
+            advance();
+            // '^' is right associative, everything else is left associative
+            auto right = parseExpression(op == '^' ? prec : prec + 1);
+            left = makeNode(ExpressionNode::Binary, op, move(left), move(right));
+        }
+        return left;
+    }
+
+    void expect(ExpressionToken::Kind kind, const string& what) {
+        if (current.kind != kind) {
+            throw runtime_error("Expected " + what + " at position " + to_string(current.position + 1));
+        }
+        advance();
+    }
+
+public:
+    ExpressionParser(const string& source, vector<string>& variableNames) : tokenizer(source), variables(variableNames) {
+        advance();
+    }
+
+    unique_ptr<ExpressionNode> parse() {
+        auto root = parseExpression(1);
+        if (current.kind != ExpressionToken::End) {
+            throw runtime_error("Unexpected '" + current.text + "' at position " + to_string(current.position + 1));
+        }
+        return root;
+    }
+};
+
+class CompiledExpression {
+private:
+    enum class Opcode : unsigned char { Constant, Variable, Negate, Add, Subtract, Multiply, Binary, Trig, Log };
+
+    struct Instruction {
+        Opcode code;
+        char op;
+        int slot;
+        double constant;
+    };
+
+    static constexpr size_t COLUMN = 128;   // points per pass of evaluateColumn()
+
+    string source;
+    vector<string> variableNames;
+    vector<Instruction> program;
+    size_t maxDepth = 0;
+    mutable vector<double> stack;   // preallocated once; evaluate() never allocates
+    mutable vector<double> columns;   // maxDepth columns of COLUMN values, made on first evaluateColumn()
+
+    size_t lower(const ExpressionNode& node) {
+        // Returns the stack depth the subtree needs
+        switch (node.kind) {
+            case ExpressionNode::Constant:
+                program.push_back({Opcode::Constant, 0, -1, node.value});
+                return 1;
+            case ExpressionNode::Variable:
+                program.push_back({Opcode::Variable, 0, node.variable, 0.0});
+                return 1;
+            case ExpressionNode::Binary: {
+                size_t leftDepth = lower(*node.left);
+                size_t rightDepth = lower(*node.right);
+                Opcode code = node.op == '+' ? Opcode::Add : node.op == '-' ? Opcode::Subtract
+                            : node.op == '*' ? Opcode::Multiply : Opcode::Binary;
+                program.push_back({code, node.op, -1, 0.0});
+                return max(leftDepth, rightDepth + 1);
+            }
+            default: {
+                size_t depth = lower(*node.left);
+                Opcode code = node.kind == ExpressionNode::Negate ? Opcode::Negate
+                            : node.kind == ExpressionNode::Trig ? Opcode::Trig : Opcode::Log;
+                program.push_back({code, node.op, -1, 0.0});
+                return depth;
+            }
+        }
+    }
+
+public:
+    explicit CompiledExpression(const string& text) : source(text) {
+        ExpressionParser parser(text, variableNames);
+        unique_ptr<ExpressionNode> root = parser.parse();
+        maxDepth = lower(*root);
+        stack.resize(maxDepth);
+    }
+
+    const string& text() const { return source; }
+    const vector<string>& variables() const { return variableNames; }
+    size_t instructionCount() const { return program.size(); }
+
+    int variableIndex(const string& name) const {
+        for (size_t i = 0; i < variableNames.size(); ++i) {
+            if (variableNames[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // values[i] binds variables()[i]. Uses the object's own stack, so share one instance per thread.
+    double evaluate(span<const double> values = {}) const {
+        if (values.size() < variableNames.size()) {
+            throw runtime_error("Missing value for variable '" + variableNames[values.size()] + "'");
+        }
+        double* top = stack.data() - 1;
+        for (const Instruction& ins : program) {
+            switch (ins.code) {
+                case Opcode::Constant: *++top = ins.constant; break;
+                case Opcode::Variable: *++top = values[ins.slot]; break;
+                case Opcode::Negate: *top = -*top; break;
+                case Opcode::Add: top[-1] += top[0]; --top; break;
+                case Opcode::Subtract: top[-1] -= top[0]; --top; break;
+                case Opcode::Multiply: top[-1] *= top[0]; --top; break;
+                case Opcode::Binary: top[-1] = Calculator::apply(top[-1], ins.op, top[0]); --top; break;
+                case Opcode::Trig: *top = Calculator::apply(*top, ins.op, 0.0); break;
+                case Opcode::Log: *top = LogarithmicCalculator::apply(*top, ins.op); break;
+            }
+        }
+        return *top;
+    }
+
+    // out[i] = the value with the one variable bound to points[i]. The program runs once per
+    // COLUMN points with a column per stack slot, so each instruction is dispatched once for
+    // the whole column and the arithmetic ones are plain vectorizable loops.
+    void evaluateColumn(span<const double> points, span<double> out) const {
+        if (variableNames.size() > 1) throw runtime_error("Column evaluation needs at most one variable");
+        if (out.size() < points.size()) throw runtime_error("Output column is shorter than input column");
+        if (columns.empty()) columns.resize(maxDepth * COLUMN);
+        for (size_t start = 0; start < points.size(); start += COLUMN) {
+            size_t m = min(COLUMN, points.size() - start);
+            const double* x = points.data() + start;
+            double* top = columns.data() - COLUMN;
+            for (const Instruction& ins : program) {
+                double* below = top - COLUMN;
+                switch (ins.code) {
+                    case Opcode::Constant: top += COLUMN; fill(top, top + m, ins.constant); break;
+                    case Opcode::Variable: top += COLUMN; copy(x, x + m, top); break;
+                    case Opcode::Negate: for (size_t i = 0; i < m; ++i) top[i] = -top[i]; break;
+                    case Opcode::Add: for (size_t i = 0; i < m; ++i) below[i] += top[i]; top = below; break;
+                    case Opcode::Subtract: for (size_t i = 0; i < m; ++i) below[i] -= top[i]; top = below; break;
+                    case Opcode::Multiply: for (size_t i = 0; i < m; ++i) below[i] *= top[i]; top = below; break;
+                    case Opcode::Binary:
+                        for (size_t i = 0; i < m; ++i) below[i] = Calculator::apply(below[i], ins.op, top[i]);
+                        top = below;
+                        break;
+                    case Opcode::Trig: for (size_t i = 0; i < m; ++i) top[i] = Calculator::apply(top[i], ins.op, 0.0); break;
+                    case Opcode::Log: for (size_t i = 0; i < m; ++i) top[i] = LogarithmicCalculator::apply(top[i], ins.op); break;
+                }
+            }
+            copy(top, top + m, out.data() + start);
+        }
+    }
+};
+
+// Size-bounded memo table split into independently locked shards, evicting with the CLOCK policy
+// (a reference bit per slot; the hand clears bits until it finds an unreferenced victim).
+// One call in SAMPLE_EVERY is timed to estimate what a lookup and a computation cost. Every
+// WINDOW lookups a full shard checks whether hitRate * computeCost still beats lookupCost; if
+// not, the whole cache switches itself off and only the sampled calls keep going through it,
+// so it can switch back on when the inputs start repeating again.
+struct CacheStats {
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    size_t entries = 0;
+    bool enabled = true;
+};
+
+template <typename Key, typename Value, typename Hash = hash<Key>>
+class ShardedClockCache {
+private:
+    static constexpr uint64_t WINDOW = 1024;
+    static constexpr unsigned SAMPLE_EVERY = 64;
+
+    struct Slot {
+        Key key;
+        Value value;
+        bool referenced;
+    };
+
+    struct alignas(64) Shard {
+        mutex lock;
+        vector<Slot> slots;
+        unordered_map<Key, uint32_t, Hash> index;
+        size_t hand = 0;
+        uint64_t hits = 0, misses = 0, evictions = 0;
+        uint64_t windowLookups = 0, windowHits = 0;
+        double lookupNanos = -1.0, computeNanos = -1.0;   // moving averages, negative until sampled
+    };
+
+    Hash hasher;
+    size_t perShard;
+    size_t shardMask;
+    unique_ptr<Shard[]> shards;
+    atomic<bool> enabled{true};
+
+    Shard& shardFor(size_t h) {
+        // Mix the high bits in: std::hash of integers is the identity on libstdc++
+        h ^= h >> 31;
+        h *= 0x9E3779B97F4A7C15ull;
+        return shards[(h >> 40) & shardMask];
+    }
+
+    static double nanosSince(chrono::steady_clock::time_point start) {
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    }
+
+    static void average(double& mean, double sample) {
+        mean = mean < 0 ? sample : mean + (sample - mean) / 16;
+    }
+
+    // Called with the shard locked
+    void countLookup(Shard& shard, bool hit) {
+        hit ? ++shard.hits : ++shard.misses;
+        shard.windowHits += hit;
+        if (++shard.windowLookups < WINDOW) return;
+        // A shard that is still filling up says nothing about the hit rate yet
+        if (shard.slots.size() == perShard && shard.lookupNanos >= 0 && shard.computeNanos >= 0) {
+            double hitRate = static_cast<double>(shard.windowHits) / WINDOW;
+            enabled.store(hitRate * shard.computeNanos > shard.lookupNanos, memory_order_relaxed);
+        }
+        shard.windowLookups = shard.windowHits = 0;
+    }
+
+public:
+    explicit ShardedClockCache(size_t capacity, size_t shardCount = 16) : shardMask(1) {
+        while (shardMask < shardCount) shardMask <<= 1;
+        perShard = max<size_t>((capacity + shardMask - 1) / shardMask, 1);
+        shards.reset(new Shard[shardMask]);
+        for (size_t i = 0; i < shardMask; ++i) {
+            shards[i].slots.reserve(perShard);
+            shards[i].index.reserve(perShard);
+        }
+        --shardMask;
+    }
+
+    // Returns the cached value for key, or computes it with fn() and stores it. Exceptions from
+    // fn() propagate and nothing is stored.
+    template <typename Fn>
+    Value getOrCompute(const Key& key, Fn&& fn) {
+        thread_local unsigned tick = 0;
+        bool timed = ++tick % SAMPLE_EVERY == 0;
+        if (!timed && !enabled.load(memory_order_relaxed)) return fn();
+        auto start = timed ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+        Shard& shard = shardFor(hasher(key));
+        {
+            lock_guard<mutex> guard(shard.lock);
+            auto it = shard.index.find(key);
+            countLookup(shard, it != shard.index.end());
+            if (it != shard.index.end()) {
+                Slot& slot = shard.slots[it->second];
+                slot.referenced = true;
+                if (timed) average(shard.lookupNanos, nanosSince(start));
+                return slot.value;
+            }
+        }
+        // Computed outside the lock so a slow miss doesn't hold up the rest of the shard
+        double lookupNanos = timed ? nanosSince(start) : 0.0;
+        auto computeStart = timed ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+        Value value = fn();
+        double computeNanos = timed ? nanosSince(computeStart) : 0.0;
+        lock_guard<mutex> guard(shard.lock);
+        if (timed) {
+            average(shard.lookupNanos, lookupNanos);
+            average(shard.computeNanos, computeNanos);
+        }
+        if (shard.index.count(key)) return value;
+        uint32_t position;
+        if (shard.slots.size() < perShard) {
+            position = static_cast<uint32_t>(shard.slots.size());
+            shard.slots.push_back({key, value, false});
+        } else {
+            while (shard.slots[shard.hand].referenced) {
+                shard.slots[shard.hand].referenced = false;
+                shard.hand = (shard.hand + 1) % perShard;
+            }
+            position = static_cast<uint32_t>(shard.hand);
+            shard.hand = (shard.hand + 1) % perShard;
+            Slot& victim = shard.slots[position];
+            shard.index.erase(victim.key);
+            ++shard.evictions;
+            victim = {key, value, false};
+        }
+        shard.index.emplace(key, position);
+        return value;
+    }
+
+    CacheStats stats() {
+        CacheStats total;
+        for (size_t i = 0; i <= shardMask; ++i) {
+            lock_guard<mutex> guard(shards[i].lock);
+            total.hits += shards[i].hits;
+            total.misses += shards[i].misses;
+            total.evictions += shards[i].evictions;
+            total.entries += shards[i].slots.size();
+        }
+        total.enabled = enabled.load(memory_order_relaxed);
+        return total;
+    }
+};
+
+// Cache key for numeric results: operand bit patterns plus the operation
+struct NumericKey {
+    uint64_t a, b;
+    uint32_t op;
+
+    bool operator==(const NumericKey& other) const { return a == other.a && b == other.b && op == other.op; }
+};
+
+struct NumericKeyHash {
+    size_t operator()(const NumericKey& key) const {
+        uint64_t h = key.a * 0x9E3779B97F4A7C15ull;
+        h ^= (key.b + key.op) * 0xC2B2AE3D27D4EB4Full;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
+// Optional memoization for the repeated expensive operations: pow, logarithms and number base
+// conversions. Disabled unless enable() is called before any worker threads start.
+class ResultCache {
+public:
+    using NumericCache = ShardedClockCache<NumericKey, double, NumericKeyHash>;
+    using TextCache = ShardedClockCache<string, string>;
+
+private:
+    static unique_ptr<NumericCache>& numericSlot() {
+        static unique_ptr<NumericCache> cache;
+        return cache;
+    }
+
+    static unique_ptr<TextCache>& textSlot() {
+        static unique_ptr<TextCache> cache;
+        return cache;
+    }
+
+    static uint64_t bits(double value) {
+        uint64_t result;
+        memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+
+public:
+    static void enable(size_t entries) {
+        numericSlot() = make_unique<NumericCache>(entries);
+        textSlot() = make_unique<TextCache>(entries);
+    }
+
+    static void disable() {
+        numericSlot().reset();
+        textSlot().reset();
+    }
+
+    static bool enabled() { return numericSlot() != nullptr; }
+
+    static CacheStats numericStats() { return numericSlot()->stats(); }
+    static CacheStats textStats() { return textSlot()->stats(); }
+
+    static double calculate(double num1, char operation, double num2) {
+        NumericCache* cache = numericSlot().get();
+        if (!cache || operation != '^') return Calculator::apply(num1, operation, num2);
+        return cache->getOrCompute({bits(num1), bits(num2), static_cast<uint32_t>('^')},
+                                   [&] { return Calculator::apply(num1, operation, num2); });
+    }
+
+    static double logarithm(double value, char logType) {
+        NumericCache* cache = numericSlot().get();
+        logType = toupper(logType);
+        if (!cache) return LogarithmicCalculator::apply(value, logType);
+        return cache->getOrCompute({bits(value), 0, 0x100u | static_cast<unsigned char>(logType)},
+                                   [&] { return LogarithmicCalculator::apply(value, logType); });
+    }
+
+    static string numberBase(string_view digits, char from, char to) {
+        TextCache* cache = textSlot().get();
+        if (!cache) return NumberBaseConverter(string(digits), from, to).getResultString();
+        string key;
+        key.reserve(digits.size() + 2);
+        key += static_cast<char>(toupper(from));
+        key += static_cast<char>(toupper(to));
+        key += digits;
+        return cache->getOrCompute(key, [&] { return NumberBaseConverter(string(digits), from, to).getResultString(); });
+    }
+
+    static void report(ostream& out) {
+        if (!enabled()) return;
+        auto print = [&](const char* name, const CacheStats& stats) {
+            uint64_t lookups = stats.hits + stats.misses;
+            out << name << " cache: " << stats.hits << " hits, " << stats.misses << " misses ("
+                << fixed << setprecision(1) << (lookups ? 100.0 * stats.hits / lookups : 0.0) << "% hit rate), "
+                << stats.evictions << " evictions, " << stats.entries << " entries, "
+                << (stats.enabled ? "on" : "switched off") << "\n";
+        };
+        print("numeric", numericStats());
+        print("number base", textStats());
+    }
+};
+
+enum class OpKind : unsigned char { Calculator, Temperature, NumberBase, Logarithm, Currency, Length, Expression, Radix, Unit };
+
+inline const char* opKindName(OpKind kind) {
+    switch (kind) {
+        case OpKind::Calculator: return "Calculator";
+        case OpKind::Temperature: return "Temperature";
+        case OpKind::NumberBase: return "Number Base";
+        case OpKind::Logarithm: return "Logarithm";
+        case OpKind::Currency: return "Currency";
+        case OpKind::Length: return "Length";
+        case OpKind::Expression: return "Expression";
+        case OpKind::Radix: return "Radix";
+        case OpKind::Unit: return "Unit";
+    }
+    return "Unknown";
+}
+
+// One parsed request, independent of how it arrived (menu, batch line, ...)
+struct Operation {
+    OpKind kind = OpKind::Calculator;
+    char op = 0;             // calculator operation or log type
+    char from = 0, to = 0;   // unit, base or currency codes
+    double a = 0.0, b = 0.0;
+    int fromUnit = -1, toUnit = -1;   // unit registry ids, or currency keys
+    string_view text;        // number base digits or expression source, points into the caller's buffer
+};
+
+struct OperationResult {
+    bool isText = false;     // digits in text, otherwise number
+    double number = 0.0;
+    string text;
+};
+
+}  // namespace techneon
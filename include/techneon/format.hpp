@@ -0,0 +1,392 @@
+// Buffered output, fixed-capacity text, table layouts and the plain/JSON/CSV result formats
+#pragma once
+
+#include "techneon/engine.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+// Writes to a FILE in large blocks, or (without a file) collects everything in memory
+class BufferedWriter {
+private:
+    FILE* file;
+    vector<char> buffer;
+    size_t used = 0;
+
+    void reserve(size_t len) {
+        if (used + len > buffer.size()) {
+            if (file) flush();
+            else buffer.resize(max(buffer.size() * 2, used + len));
+        }
+    }
+
+public:
+    explicit BufferedWriter(FILE* out, size_t capacity = 1 << 20) : file(out), buffer(capacity) {}
+    BufferedWriter() : file(nullptr), buffer(1 << 16) {}
+    ~BufferedWriter() { flush(); }
+
+    const char* data() const { return buffer.data(); }
+    size_t size() const { return used; }
+    void clear() { used = 0; }
+
+    void write(const char* data, size_t len) {
+        if (file && len > buffer.size()) {
+            flush();
+            fwrite(data, 1, len, file);
+            return;
+        }
+        reserve(len);
+        memcpy(buffer.data() + used, data, len);
+        used += len;
+    }
+
+    void write(string_view text) { write(text.data(), text.size()); }
+
+    void put(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    void writeFixed(double number) {
+        // Same rendering as printf("%.2f"), without the locale and format string parsing.
+        // The widest double printed this way is 309 digits plus sign and fraction.
+        reserve(320);
+        auto [end, ec] = to_chars(buffer.data() + used, buffer.data() + buffer.size(), number, chars_format::fixed, 2);
+        if (ec == errc()) used = end - buffer.data();
+    }
+
+    void writeInt(long long number) {
+        reserve(24);
+        used = to_chars(buffer.data() + used, buffer.data() + buffer.size(), number).ptr - buffer.data();
+    }
+
+    void flush() {
+        if (!file) return;
+        if (used > 0) {
+            fwrite(buffer.data(), 1, used, file);
+            used = 0;
+        }
+        fflush(file);
+    }
+};
+
+// Fixed-capacity text on the stack for table cells and record labels; appends past the end are dropped
+template <size_t N>
+class TextBuffer {
+private:
+    char text[N];
+    size_t len = 0;
+
+public:
+    TextBuffer& append(string_view part) {
+        size_t n = min(part.size(), N - len);
+        memcpy(text + len, part.data(), n);
+        len += n;
+        return *this;
+    }
+
+    TextBuffer& append(char c) {
+        if (len < N) text[len++] = c;
+        return *this;
+    }
+
+    TextBuffer& appendInt(long long number) {
+        auto [end, ec] = to_chars(text + len, text + N, number);
+        if (ec == errc()) len = end - text;
+        return *this;
+    }
+
+    // Fixed, two decimals, like every result table
+    TextBuffer& appendFixed(double number) {
+        auto [end, ec] = to_chars(text + len, text + N, number, chars_format::fixed, 2);
+        if (ec == errc()) len = end - text;
+        return *this;
+    }
+
+    // Significant digits rather than decimals, for roots, integrals and error estimates
+    TextBuffer& appendGeneral(double number, int digits = 15) {
+        auto [end, ec] = to_chars(text + len, text + N, number, chars_format::general, digits);
+        if (ec == errc()) len = end - text;
+        return *this;
+    }
+
+    string_view view() const { return string_view(text, len); }
+    operator string_view() const { return view(); }
+};
+
+struct TableCell {
+    string_view color;   // empty for an uncolored cell
+    string_view text;
+};
+
+// Box table with the column widths fixed at compile time; the border row is a constant built once.
+// Cells are padded the way setw(width) << left pads a colored string: the color codes count
+// towards the width, so the output is byte for byte what the iostream tables printed.
+template <int... Widths>
+class TableLayout {
+private:
+    static constexpr size_t BORDER_SIZE = (static_cast<size_t>(Widths) + ...) + sizeof...(Widths) + 2;
+
+    static constexpr array<char, BORDER_SIZE> makeBorder() {
+        array<char, BORDER_SIZE> line{};
+        size_t i = 0;
+        for (int width : {Widths...}) {
+            line[i++] = '+';
+            for (int k = 0; k < width; ++k) line[i++] = '-';
+        }
+        line[i++] = '+';
+        line[i] = '\n';
+        return line;
+    }
+
+    static constexpr array<char, BORDER_SIZE> border = makeBorder();
+
+    template <int>
+    using CellFor = TableCell;
+
+    static void cell(BufferedWriter& out, int width, const TableCell& c) {
+        static constexpr char spaces[] = "                                                                ";
+        out.put('|');
+        out.write(c.color);
+        out.write(c.text);
+        if (!c.color.empty()) out.write(RESET_COLOR);
+        long pad = width - static_cast<long>(c.color.size() + c.text.size() + (c.color.empty() ? 0 : RESET_COLOR.size()));
+        for (; pad > 0; pad -= sizeof(spaces) - 1) out.write(spaces, min<size_t>(pad, sizeof(spaces) - 1));
+    }
+
+public:
+    static void rule(BufferedWriter& out) { out.write(border.data(), border.size()); }
+
+    // One argument per column, e.g. row(out, {BLUE_COLOR, "Input"}, {BLUE_COLOR, info}, {GREEN_COLOR, result})
+    static void row(BufferedWriter& out, CellFor<Widths>... cells) {
+        (cell(out, Widths, cells), ...);
+        out.write("|\n");
+    }
+};
+
+// How results are written: plain (tables in the menu, bare values in batch mode), one JSON object
+// per line, or CSV rows under a "type,input,result,error" header. Fields without a value (the
+// type of a line that failed to parse) are left out of JSON and empty in CSV.
+class OutputFormat {
+public:
+    enum class Style { Plain, Json, Csv };
+
+private:
+    friend class FieldReport;
+
+    static atomic<int>& current() {
+        static atomic<int> style{static_cast<int>(Style::Plain)};
+        return style;
+    }
+
+    static void jsonString(BufferedWriter& out, string_view text) {
+        static constexpr char hex[] = "0123456789abcdef";
+        out.put('"');
+        for (char c : text) {
+            unsigned char u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                out.put('\\');
+                out.put(c);
+            } else if (u < 0x20) {
+                char escape[] = {'\\', 'u', '0', '0', hex[u >> 4], hex[u & 15]};
+                out.write(escape, sizeof(escape));
+            } else {
+                out.put(c);
+            }
+        }
+        out.put('"');
+    }
+
+    static void csvField(BufferedWriter& out, string_view text) {
+        if (text.find_first_of(",\"\r\n") == string_view::npos) {
+            out.write(text);
+            return;
+        }
+        out.put('"');
+        for (char c : text) {
+            if (c == '"') out.put('"');
+            out.put(c);
+        }
+        out.put('"');
+    }
+
+    // JSON: {"type":..,"input":.., then the caller's result or error member
+    static void jsonOpen(BufferedWriter& out, string_view type, string_view input) {
+        out.put('{');
+        if (!type.empty()) {
+            out.write("\"type\":");
+            jsonString(out, type);
+            out.put(',');
+        }
+        if (!input.empty()) {
+            out.write("\"input\":");
+            jsonString(out, input);
+            out.put(',');
+        }
+    }
+
+    static void csvOpen(BufferedWriter& out, string_view type, string_view input) {
+        csvField(out, type);
+        out.put(',');
+        csvField(out, input);
+        out.put(',');
+    }
+
+public:
+    static void select(Style style) { current().store(static_cast<int>(style)); }
+    static Style style() { return static_cast<Style>(current().load(memory_order_relaxed)); }
+
+    static Style parse(const string& name) {
+        if (name == "plain") return Style::Plain;
+        if (name == "json") return Style::Json;
+        if (name == "csv") return Style::Csv;
+        throw runtime_error("Unknown output format '" + name + "' (use plain, json, csv)");
+    }
+
+    // Written once before the first result
+    static void header(BufferedWriter& out) {
+        if (style() == Style::Csv) out.write("type,input,result,error\n");
+    }
+
+    // Each of these writes one result without the line break
+    static void result(BufferedWriter& out, string_view type, string_view input, double number) {
+        switch (style()) {
+            case Style::Plain:
+                out.writeFixed(number);
+                break;
+            case Style::Json:
+                jsonOpen(out, type, input);
+                out.write("\"result\":");
+                // inf and nan are not JSON numbers
+                if (!isfinite(number)) out.put('"');
+                out.writeFixed(number);
+                if (!isfinite(number)) out.put('"');
+                out.put('}');
+                break;
+            case Style::Csv:
+                csvOpen(out, type, input);
+                out.writeFixed(number);
+                out.put(',');
+                break;
+        }
+    }
+
+    static void result(BufferedWriter& out, string_view type, string_view input, string_view text) {
+        switch (style()) {
+            case Style::Plain:
+                out.write(text);
+                break;
+            case Style::Json:
+                jsonOpen(out, type, input);
+                out.write("\"result\":");
+                jsonString(out, text);
+                out.put('}');
+                break;
+            case Style::Csv:
+                csvOpen(out, type, input);
+                csvField(out, text);
+                out.put(',');
+                break;
+        }
+    }
+
+    static void error(BufferedWriter& out, string_view type, string_view input, string_view message) {
+        switch (style()) {
+            case Style::Plain:
+                out.write("error: ");
+                out.write(message);
+                break;
+            case Style::Json:
+                jsonOpen(out, type, input);
+                out.write("\"error\":");
+                jsonString(out, message);
+                out.put('}');
+                break;
+            case Style::Csv:
+                csvOpen(out, type, input);
+                out.put(',');
+                csvField(out, message);
+                break;
+        }
+    }
+};
+
+// A summary as name/value fields in the current OutputFormat style: one per line, one JSON object,
+// or a CSV header and row. Numbers print with 15 significant digits rather than two decimals.
+class FieldReport {
+private:
+    enum class Kind : unsigned char { Number, Count, Text, Flag };
+
+    struct Field {
+        string name;
+        Kind kind;
+        string text;
+    };
+
+    vector<Field> fields;
+
+public:
+    FieldReport& number(string_view name, double value) {
+        TextBuffer<32> digits;
+        digits.appendGeneral(value);
+        fields.push_back({string(name), isfinite(value) ? Kind::Number : Kind::Text, string(digits.view())});
+        return *this;
+    }
+
+    FieldReport& count(string_view name, size_t value) {
+        TextBuffer<24> digits;
+        digits.appendInt(static_cast<long long>(value));
+        fields.push_back({string(name), Kind::Count, string(digits.view())});
+        return *this;
+    }
+
+    FieldReport& text(string_view name, string_view value) {
+        fields.push_back({string(name), Kind::Text, string(value)});
+        return *this;
+    }
+
+    FieldReport& flag(string_view name, bool value) {
+        fields.push_back({string(name), Kind::Flag, value ? "true" : "false"});
+        return *this;
+    }
+
+    void write(BufferedWriter& out) const {
+        OutputFormat::Style style = OutputFormat::style();
+        if (style == OutputFormat::Style::Csv) {
+            for (size_t i = 0; i < fields.size(); ++i) {
+                if (i) out.put(',');
+                out.write(fields[i].name);
+            }
+            out.put('\n');
+        }
+        if (style == OutputFormat::Style::Json) out.put('{');
+        for (size_t i = 0; i < fields.size(); ++i) {
+            const Field& field = fields[i];
+            switch (style) {
+                case OutputFormat::Style::Plain:
+                    out.write(field.name);
+                    out.put(' ');
+                    break;
+                case OutputFormat::Style::Json:
+                    if (i) out.put(',');
+                    out.put('"');
+                    out.write(field.name);
+                    out.write("\":");
+                    break;
+                case OutputFormat::Style::Csv:
+                    if (i) out.put(',');
+                    break;
+            }
+            // Text (and inf/nan, which are not JSON numbers) is a string in JSON, quoted as needed in CSV
+            if (field.kind != Kind::Text || style == OutputFormat::Style::Plain) out.write(field.text);
+            else if (style == OutputFormat::Style::Json) OutputFormat::jsonString(out, field.text);
+            else OutputFormat::csvField(out, field.text);
+            if (style == OutputFormat::Style::Plain) out.put('\n');
+        }
+        if (style == OutputFormat::Style::Json) out.write("}\n");
+        if (style == OutputFormat::Style::Csv) out.put('\n');
+    }
+};
+
+}  // namespace techneon
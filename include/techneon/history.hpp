@@ -0,0 +1,401 @@
+// Session history: 64-byte records in a bounded ring that spills to disk
+#pragma once
+
+#include "techneon/format.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+// One history entry in a fixed 64-byte record: operands and result stay numeric and are only
+// formatted when displayed. Text inputs (number base digits, expressions) keep a short label.
+struct HistoryRecord {
+    int64_t timestamp;        // microseconds since the epoch, never decreasing within a session
+    double a, b;              // numeric operands
+    double result;
+    OpKind kind;
+    char op;                  // calculator operation or log type
+    char from, to;            // temperature, length and number base letter codes
+    int16_t fromUnit, toUnit; // registry unit ids, currency keys or radix bases
+    char label[24];           // NUL-terminated, shortened with "..." when longer
+
+    static HistoryRecord make(OpKind kind, double a, double b, double result) {
+        HistoryRecord r{};
+        r.kind = kind;
+        r.a = a;
+        r.b = b;
+        r.result = result;
+        r.fromUnit = r.toUnit = -1;
+        return r;
+    }
+
+    void setLabel(string_view text) {
+        size_t len = min(text.size(), sizeof(label) - 1);
+        memcpy(label, text.data(), len);
+        label[len] = '\0';
+        if (text.size() > len) memcpy(label + len - 3, "...", 3);
+    }
+
+    bool labelTruncated() const {
+        size_t len = strnlen(label, sizeof(label));
+        return len == sizeof(label) - 1 && memcmp(label + len - 3, "...", 3) == 0;
+    }
+
+    static const char* typeName(OpKind kind) { return opKindName(kind); }
+
+    // The request this record answers, except for its text (the label may be shortened)
+    Operation operation() const {
+        Operation request;
+        request.kind = kind;
+        request.op = op;
+        request.from = from;
+        request.to = to;
+        request.a = a;
+        request.b = b;
+        request.fromUnit = fromUnit;
+        request.toUnit = toUnit;
+        return request;
+    }
+
+    // Enough for two full-width fixed doubles and an operator
+    using Text = TextBuffer<704>;
+
+    static string fixed2(double number) {
+        Text text;
+        return string(text.appendFixed(number).view());
+    }
+
+    void formatInput(Text& text) const {
+        switch (kind) {
+            case OpKind::Calculator:
+                text.appendFixed(a).append(' ').append(op);
+                if (op != 'S' && op != 'C' && op != 'T') text.append(' ').appendFixed(b);
+                break;
+            case OpKind::Temperature:
+            case OpKind::Length:
+                text.appendFixed(a).append(' ').append(from).append(" to ").append(to);
+                break;
+            case OpKind::NumberBase:
+                text.append(label).append(' ').append(from).append(" to ").append(to);
+                break;
+            case OpKind::Logarithm:
+                text.append(op == 'L' ? "log10(" : op == 'N' ? "ln(" : "log2(").appendFixed(a).append(')');
+                break;
+            case OpKind::Currency:
+                text.appendFixed(a).append(' ').append(RateTable::codeOfKey(fromUnit)).append(" to ").append(RateTable::codeOfKey(toUnit));
+                break;
+            case OpKind::Unit: {
+                const UnitRegistry& registry = UnitRegistry::instance();
+                text.appendFixed(a).append(' ').append(registry.symbol(fromUnit)).append(" to ").append(registry.symbol(toUnit));
+                break;
+            }
+            case OpKind::Radix:
+                text.append(label).append(' ').appendInt(fromUnit).append(" to ").appendInt(toUnit);
+                break;
+            case OpKind::Expression:
+                text.append(label);
+                break;
+        }
+    }
+
+    string inputText() const {
+        Text text;
+        formatInput(text);
+        return string(text.view());
+    }
+
+    string resultText() const {
+        // Digit results are recomputed from the stored input; only the visible rows pay for it
+        if (kind == OpKind::NumberBase || kind == OpKind::Radix) {
+            if (labelTruncated()) return "(input too long)";
+            try {
+                return kind == OpKind::NumberBase ? NumberBaseConverter(label, from, to).getResultString()
+                                                  : RadixConverter::convert(label, fromUnit, toUnit);
+            } catch (const runtime_error&) {
+                return "?";
+            }
+        }
+        return fixed2(result);
+    }
+};
+
+static_assert(sizeof(HistoryRecord) == 64, "history records are stored and spilled as 64-byte blocks");
+
+// Session history with bounded memory: the newest records live in a fixed ring, older ones are
+// appended to a binary log file. Per-block summaries (time span and a bit per operation kind)
+// let queries skip most of the log without reading it.
+class HistoryStore {
+public:
+    struct Query {
+        bool anyKind = true;
+        OpKind kind = OpKind::Calculator;
+        int64_t fromTime = numeric_limits<int64_t>::min();
+        int64_t toTime = numeric_limits<int64_t>::max();
+
+        bool everything() const {
+            return anyKind && fromTime == numeric_limits<int64_t>::min() && toTime == numeric_limits<int64_t>::max();
+        }
+
+        bool matches(const HistoryRecord& r) const {
+            return r.timestamp >= fromTime && r.timestamp <= toTime && (anyKind || r.kind == kind);
+        }
+    };
+
+    // A record and its position in the history, counting from 0 for the first ever appended
+    struct Entry {
+        uint64_t index;
+        HistoryRecord record;
+    };
+
+private:
+    static constexpr size_t BLOCK_RECORDS = 1024;
+    static constexpr size_t SPILL_BATCH = 256;
+
+    struct BlockSummary {
+        int64_t firstTime, lastTime;
+        uint32_t kinds;
+    };
+
+    size_t capacity;
+    unique_ptr<HistoryRecord[]> ring;   // one allocation for the session, indexed by sequence & (capacity - 1)
+    uint64_t count = 0;                 // records ever appended
+    uint64_t spilled = 0;               // records [0, spilled) are in the log file
+    vector<HistoryRecord> pending;      // records [spilled, count - capacity) waiting to be written
+    vector<BlockSummary> blocks;
+    int64_t lastTime = 0;
+    string logPath;
+    int logFd = -1;
+
+    void openLog() {
+        if (logPath.empty()) {
+            // Anonymous spill file: unlinked right away so it disappears with the process
+            const char* dir = getenv("TMPDIR");
+            string pattern = string(dir && *dir ? dir : "/tmp") + "/techneon_history_XXXXXX";
+            logFd = mkstemp(pattern.data());
+            if (logFd >= 0) unlink(pattern.c_str());
+        } else {
+            logFd = open(logPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        }
+        if (logFd < 0) throw runtime_error("Cannot open history log " + logPath);
+    }
+
+    void flushPending() {
+        if (pending.empty()) return;
+        if (logFd < 0) openLog();
+        const char* data = reinterpret_cast<const char*>(pending.data());
+        size_t left = pending.size() * sizeof(HistoryRecord);
+        while (left > 0) {
+            ssize_t written = ::write(logFd, data, left);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) throw runtime_error("Cannot write history log");
+            data += written;
+            left -= static_cast<size_t>(written);
+        }
+        spilled += pending.size();
+        pending.clear();
+    }
+
+    uint64_t oldestInRing() const { return count > capacity ? count - capacity : 0; }
+
+    // Copies records [first, last) into out, reading the spilled part with one pread
+    void load(uint64_t first, uint64_t last, vector<HistoryRecord>& out) const {
+        out.resize(last - first);
+        uint64_t i = first;
+        if (i < spilled) {
+            uint64_t end = min(last, spilled);
+            size_t bytes = (end - i) * sizeof(HistoryRecord);
+            char* dest = reinterpret_cast<char*>(out.data());
+            size_t done = 0;
+            while (done < bytes) {
+                ssize_t got = pread(logFd, dest + done, bytes - done, static_cast<off_t>(i * sizeof(HistoryRecord) + done));
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) throw runtime_error("Cannot read history log");
+                done += static_cast<size_t>(got);
+            }
+            i = end;
+        }
+        for (; i < last; ++i) {
+            out[i - first] = i < oldestInRing() ? pending[i - spilled] : ring[i & (capacity - 1)];
+        }
+    }
+
+public:
+    // capacity is rounded up to a power of two; an empty logPath spills to an anonymous temp file
+    explicit HistoryStore(size_t ringCapacity = 4096, string path = "") : capacity(1), logPath(move(path)) {
+        while (capacity < ringCapacity) capacity <<= 1;
+        ring.reset(new HistoryRecord[capacity]);
+    }
+
+    ~HistoryStore() {
+        try {
+            flushPending();
+        } catch (const runtime_error&) {
+        }
+        if (logFd >= 0) close(logFd);
+    }
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    uint64_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void append(HistoryRecord record) {
+        // Step 1: Stamp the record, keeping timestamps monotonic for range queries
+        if (record.timestamp == 0) {
+            record.timestamp = chrono::duration_cast<chrono::microseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+        }
+        record.timestamp = max(record.timestamp, lastTime);
+        lastTime = record.timestamp;
+        // Step 2: The slot about to be overwritten moves to the spill log
+        if (count >= capacity) {
+            pending.push_back(ring[count & (capacity - 1)]);
+            if (pending.size() >= SPILL_BATCH) flushPending();
+        }
+        ring[count & (capacity - 1)] = record;
+        // Step 3: Keep the block summary up to date
+        if (count % BLOCK_RECORDS == 0) blocks.push_back({record.timestamp, record.timestamp, 0});
+        BlockSummary& block = blocks.back();
+        block.lastTime = record.timestamp;
+        block.kinds |= 1u << static_cast<unsigned>(record.kind);
+        ++count;
+    }
+
+    HistoryRecord get(uint64_t index) const {
+        vector<HistoryRecord> one;
+        load(index, index + 1, one);
+        return one[0];
+    }
+
+    // The newest `limit` records matching the query with index below end, oldest first. Only
+    // blocks whose summary can match are read, and of those only the part below end, so the cost
+    // follows the page rather than the size of the history.
+    vector<Entry> before(const Query& q, uint64_t end, size_t limit) const {
+        vector<Entry> result;
+        vector<HistoryRecord> scratch;
+        uint32_t kindBit = 1u << static_cast<unsigned>(q.kind);
+        end = min(end, count);
+        // Blocks are in time order: start from the last block that begins before toTime
+        size_t b = partition_point(blocks.begin(), blocks.end(),
+                                   [&](const BlockSummary& s) { return s.firstTime <= q.toTime; }) - blocks.begin();
+        b = min<size_t>(b, (end + BLOCK_RECORDS - 1) / BLOCK_RECORDS);
+        while (b-- > 0 && result.size() < limit) {
+            const BlockSummary& s = blocks[b];
+            if (s.lastTime < q.fromTime) break;
+            if (!q.anyKind && !(s.kinds & kindBit)) continue;
+            uint64_t first = b * BLOCK_RECORDS, last = min<uint64_t>(first + BLOCK_RECORDS, end);
+            // Unfiltered, every record matches; read only the ones the page still needs
+            if (q.everything()) first = max(first, last - min<uint64_t>(last - first, limit - result.size()));
+            load(first, last, scratch);
+            for (size_t k = scratch.size(); k-- > 0 && result.size() < limit;) {
+                if (q.matches(scratch[k])) result.push_back({first + k, scratch[k]});
+            }
+        }
+        reverse(result.begin(), result.end());
+        return result;
+    }
+
+    // The oldest `limit` records matching the query from index start on, oldest first
+    vector<Entry> after(const Query& q, uint64_t start, size_t limit) const {
+        vector<Entry> result;
+        vector<HistoryRecord> scratch;
+        uint32_t kindBit = 1u << static_cast<unsigned>(q.kind);
+        for (size_t b = static_cast<size_t>(start / BLOCK_RECORDS); b < blocks.size() && result.size() < limit; ++b) {
+            const BlockSummary& s = blocks[b];
+            if (s.firstTime > q.toTime) break;
+            if (s.lastTime < q.fromTime || (!q.anyKind && !(s.kinds & kindBit))) continue;
+            uint64_t first = max<uint64_t>(b * BLOCK_RECORDS, start), last = min<uint64_t>(b * BLOCK_RECORDS + BLOCK_RECORDS, count);
+            if (q.everything()) last = min(last, first + (limit - result.size()));
+            load(first, last, scratch);
+            for (size_t k = 0; k < scratch.size() && result.size() < limit; ++k) {
+                if (q.matches(scratch[k])) result.push_back({first + k, scratch[k]});
+            }
+        }
+        return result;
+    }
+
+    // The newest `limit` records matching the query, oldest first
+    vector<HistoryRecord> query(const Query& q, size_t limit) const {
+        vector<HistoryRecord> result;
+        for (Entry& entry : before(q, count, limit)) result.push_back(entry.record);
+        return result;
+    }
+
+    vector<HistoryRecord> last(size_t n) const { return query(Query(), n); }
+};
+
+// A window of matching records over a HistoryStore, for paging through it. The window is kept as
+// the index just past its newest row and refetched with before() and after() on every move, so a
+// move reads about one page whatever the length of the history.
+class HistoryCursor {
+private:
+    const HistoryStore& store;
+    HistoryStore::Query filter;
+    size_t rows;
+    uint64_t end;
+    vector<HistoryStore::Entry> page;
+
+    void refresh() { page = store.before(filter, end, rows); }
+
+public:
+    HistoryCursor(const HistoryStore& history, size_t pageRows) : store(history), rows(max<size_t>(pageRows, 1)), end(history.size()) {
+        refresh();
+    }
+
+    const vector<HistoryStore::Entry>& entries() const { return page; }
+    const HistoryStore::Query& query() const { return filter; }
+    size_t pageRows() const { return rows; }
+
+    void resize(size_t pageRows) {
+        rows = max<size_t>(pageRows, 1);
+        refresh();
+    }
+
+    // A new filter starts again from the newest match
+    void select(const HistoryStore::Query& q) {
+        filter = q;
+        newest();
+    }
+
+    void newest() {
+        end = store.size();
+        refresh();
+    }
+
+    void oldest() {
+        vector<HistoryStore::Entry> first = store.after(filter, 0, rows);
+        end = first.empty() ? 0 : first.back().index + 1;
+        refresh();
+    }
+
+    // Moves the window n matching rows towards the oldest, stopping there
+    void older(size_t n) {
+        if (page.empty()) return;
+        vector<HistoryStore::Entry> earlier = store.before(filter, page.front().index, n);
+        if (earlier.empty()) return;
+        size_t shift = min(n, earlier.size());
+        // The new newest row is `shift` places before the current one in earlier + page
+        size_t position = earlier.size() + page.size() - 1 - shift;
+        end = (position < earlier.size() ? earlier[position] : page[position - earlier.size()]).index + 1;
+        refresh();
+    }
+
+    // Moves the window n matching rows towards the newest, stopping there
+    void newer(size_t n) {
+        if (page.empty()) return;
+        vector<HistoryStore::Entry> later = store.after(filter, page.back().index + 1, n);
+        if (later.empty()) return;
+        end = later.back().index + 1;
+        refresh();
+    }
+
+    // Puts the first match at or after index at the top, or shows the newest page when too few follow
+    void jump(uint64_t index) {
+        vector<HistoryStore::Entry> from = store.after(filter, index, rows);
+        end = from.size() == rows ? from.back().index + 1 : store.size();
+        refresh();
+    }
+};
+
+}  // namespace techneon
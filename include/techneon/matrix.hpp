@@ -0,0 +1,862 @@
+// Matrices and vectors: aligned arena storage, cache-blocked SIMD kernels and the calculator's matrix mode
+#pragma once
+
+#include "techneon/batch.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+// Bump allocator for matrix storage: 64-byte aligned runs of doubles carved out of large chunks.
+// Nothing is freed on its own; rewind() drops everything allocated since a mark and clear() drops
+// it all, keeping the chunks for reuse.
+class MatrixArena {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t ALIGNED_DOUBLES = ALIGNMENT / sizeof(double);
+
+    struct Mark {
+        size_t chunk = 0, used = 0;
+    };
+
+private:
+    static constexpr size_t CHUNK_DOUBLES = size_t(1) << 19;   // 4 MB
+
+    struct Chunk {
+        double* data;
+        size_t capacity;   // doubles
+    };
+
+    vector<Chunk> chunks;
+    size_t current = 0, used = 0;
+
+    void release() {
+        for (Chunk& chunk : chunks) free(chunk.data);
+        chunks.clear();
+        current = used = 0;
+    }
+
+public:
+    MatrixArena() = default;
+    MatrixArena(const MatrixArena&) = delete;
+    MatrixArena& operator=(const MatrixArena&) = delete;
+    MatrixArena(MatrixArena&& other) noexcept { *this = std::move(other); }
+
+    MatrixArena& operator=(MatrixArena&& other) noexcept {
+        if (this != &other) {
+            release();
+            chunks = std::move(other.chunks);
+            current = exchange(other.current, 0);
+            used = exchange(other.used, 0);
+            other.chunks.clear();
+        }
+        return *this;
+    }
+
+    ~MatrixArena() { release(); }
+
+    double* allocate(size_t count) {
+        count = (count + ALIGNED_DOUBLES - 1) / ALIGNED_DOUBLES * ALIGNED_DOUBLES;
+        for (; current < chunks.size(); ++current, used = 0) {
+            if (chunks[current].capacity - used >= count) {
+                double* block = chunks[current].data + used;
+                used += count;
+                return block;
+            }
+        }
+        size_t capacity = max(CHUNK_DOUBLES, count);
+        void* data = aligned_alloc(ALIGNMENT, capacity * sizeof(double));
+        if (!data) throw runtime_error("Out of memory for matrix storage");
+        chunks.push_back({static_cast<double*>(data), capacity});
+        current = chunks.size() - 1;
+        used = count;
+        return chunks[current].data;
+    }
+
+    Mark mark() const { return {current, used}; }
+
+    void rewind(Mark to) {
+        current = to.chunk;
+        used = to.used;
+    }
+
+    void clear() { current = used = 0; }
+
+    size_t bytesInUse() const {
+        size_t doubles = used;
+        for (size_t i = 0; i < current && i < chunks.size(); ++i) doubles += chunks[i].capacity;
+        return doubles * sizeof(double);
+    }
+};
+
+// A dense row-major matrix in arena memory, viewed rather than owned: it stays valid until its
+// arena is rewound past it. Rows are padded to whole cache lines so each starts 64-byte aligned;
+// a column vector is the exception and keeps its values contiguous. Padding is zero.
+struct Matrix {
+    static constexpr size_t MAX_ELEMENTS = size_t(1) << 31;
+
+    size_t rows = 0, cols = 0, stride = 0;
+    double* data = nullptr;
+
+    static Matrix allocate(MatrixArena& arena, size_t rows, size_t cols) {
+        if (rows == 0 || cols == 0) throw runtime_error("Matrix dimensions must be at least 1");
+        Matrix m;
+        m.rows = rows;
+        m.cols = cols;
+        m.stride = cols == 1 ? 1 : (cols + MatrixArena::ALIGNED_DOUBLES - 1) / MatrixArena::ALIGNED_DOUBLES * MatrixArena::ALIGNED_DOUBLES;
+        if (rows > MAX_ELEMENTS / m.stride) throw runtime_error("Matrix too large");
+        m.data = arena.allocate(rows * m.stride);
+        if (m.stride != cols) {
+            for (size_t r = 0; r < rows; ++r) fill(m.row(r) + cols, m.row(r) + m.stride, 0.0);
+        }
+        return m;
+    }
+
+    static Matrix scalar(MatrixArena& arena, double value) {
+        Matrix m = allocate(arena, 1, 1);
+        m.data[0] = value;
+        return m;
+    }
+
+    double* row(size_t r) const { return data + r * stride; }
+    double& at(size_t r, size_t c) const { return data[r * stride + c]; }
+    bool isScalar() const { return rows == 1 && cols == 1; }
+    bool isVector() const { return rows == 1 || cols == 1; }
+    size_t size() const { return rows * cols; }
+    size_t bytes() const { return rows * stride * sizeof(double); }
+
+    // Rows that are stored back to back, so a whole-matrix loop can run over them as one
+    bool contiguous() const { return stride == cols || rows == 1; }
+};
+
+// The SIMD parts of the matrix engine, written once over a lane type and compiled for AVX-512,
+// AVX2 with FMA, or two SSE2 lanes. The multiply tile keeps an MR x 2W block of C in registers
+// while it streams packed panels of A and B: 12 x 16 in 24 of AVX-512's 32 registers, 6 x 2W in
+// 12 of the 16 elsewhere. The rest are the streaming loops around it.
+// Contraction into FMA is on here, unlike the fast math kernels: results may differ between
+// instruction sets in the last bit, as they do between any two BLAS builds. Lane helpers are always
+// inlined, so the vector ABI warnings don't apply here either.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=fast")
+
+class MatrixKernel {
+public:
+    static constexpr size_t MAX_MR = 12, MAX_NR = 16;
+
+    using TileFn = void (*)(size_t kc, const double* a, const double* b, double* c, size_t ldc, bool accumulate);
+    using DotFn = double (*)(const double* a, const double* b, size_t n);
+    using AxpyFn = void (*)(double alpha, const double* x, double* y, size_t n);
+    using CombineFn = void (*)(const double* a, const double* b, double* out, size_t n, char op, int broadcast);
+
+    // Broadcast: which operand of combine is a single value
+    static constexpr int BOTH = 0, SCALAR_A = 1, SCALAR_B = 2;
+
+    struct Kernels {
+        TileFn tile;
+        size_t mr, nr;   // rows and columns of a register tile
+        DotFn dot;
+        AxpyFn axpy;
+        CombineFn combine;
+        const char* name;
+    };
+
+private:
+    template <int W, size_t MR>
+    [[gnu::always_inline]] static inline void tileLanes(size_t kc, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+        using V = typename FastMathLanes<W>::Float;
+        V acc[MR][2] = {};
+        for (size_t k = 0; k < kc; ++k) {
+            V b0, b1;
+            memcpy(&b0, b + k * 2 * W, sizeof(V));
+            memcpy(&b1, b + k * 2 * W + W, sizeof(V));
+#pragma GCC unroll 12
+            for (size_t r = 0; r < MR; ++r) {
+                V ar = a[k * MR + r] - V{};   // a broadcast; x + 0 isn't folded, -0 + 0 being +0
+                acc[r][0] += ar * b0;
+                acc[r][1] += ar * b1;
+            }
+        }
+#pragma GCC unroll 12
+        for (size_t r = 0; r < MR; ++r) {
+            for (int h = 0; h < 2; ++h) {
+                double* target = c + r * ldc + h * W;
+                V value = acc[r][h];
+                if (accumulate) {
+                    V old;
+                    memcpy(&old, target, sizeof(V));
+                    value += old;
+                }
+                memcpy(target, &value, sizeof(V));
+            }
+        }
+    }
+
+    template <int W>
+    [[gnu::always_inline]] static inline double dotLanes(const double* a, const double* b, size_t n) {
+        using V = typename FastMathLanes<W>::Float;
+        V sum[4] = {};
+        size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W) {
+            for (int j = 0; j < 4; ++j) {
+                V x, y;
+                memcpy(&x, a + i + j * W, sizeof(V));
+                memcpy(&y, b + i + j * W, sizeof(V));
+                sum[j] += x * y;
+            }
+        }
+        V total = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+        double result = 0.0;
+        for (int j = 0; j < W; ++j) result += total[j];
+        for (; i < n; ++i) result += a[i] * b[i];
+        return result;
+    }
+
+    template <int W>
+    [[gnu::always_inline]] static inline void axpyLanes(double alpha, const double* x, double* y, size_t n) {
+        using V = typename FastMathLanes<W>::Float;
+        const V va = alpha - V{};
+        size_t i = 0;
+        for (; i + W <= n; i += W) {
+            V vx, vy;
+            memcpy(&vx, x + i, sizeof(V));
+            memcpy(&vy, y + i, sizeof(V));
+            vy += va * vx;
+            memcpy(y + i, &vy, sizeof(V));
+        }
+        for (; i < n; ++i) y[i] += alpha * x[i];
+    }
+
+    template <int W, int Broadcast, typename Op>
+    [[gnu::always_inline]] static inline void combineLanes(const double* a, const double* b, double* out, size_t n, Op op) {
+        using V = typename FastMathLanes<W>::Float;
+        V va = a[0] - V{}, vb = b[0] - V{};
+        size_t i = 0;
+        for (; i + W <= n; i += W) {
+            if constexpr (Broadcast != SCALAR_A) memcpy(&va, a + i, sizeof(V));
+            if constexpr (Broadcast != SCALAR_B) memcpy(&vb, b + i, sizeof(V));
+            V value = op(va, vb);
+            memcpy(out + i, &value, sizeof(V));
+        }
+        for (; i < n; ++i) out[i] = op(Broadcast == SCALAR_A ? a[0] : a[i], Broadcast == SCALAR_B ? b[0] : b[i]);
+    }
+
+    template <int W, int Broadcast>
+    [[gnu::always_inline]] static inline void combineOp(const double* a, const double* b, double* out, size_t n, char op) {
+        switch (op) {
+            case '+': combineLanes<W, Broadcast>(a, b, out, n, [](const auto& x, const auto& y) { return x + y; }); break;
+            case '-': combineLanes<W, Broadcast>(a, b, out, n, [](const auto& x, const auto& y) { return x - y; }); break;
+            case '*': combineLanes<W, Broadcast>(a, b, out, n, [](const auto& x, const auto& y) { return x * y; }); break;
+            case '/': combineLanes<W, Broadcast>(a, b, out, n, [](const auto& x, const auto& y) { return x / y; }); break;
+            default: throw runtime_error(string("No vector kernel for '") + op + "'");
+        }
+    }
+
+    template <int W>
+    [[gnu::always_inline]] static inline void combineAny(const double* a, const double* b, double* out, size_t n, char op, int broadcast) {
+        if (broadcast == SCALAR_A) combineOp<W, SCALAR_A>(a, b, out, n, op);
+        else if (broadcast == SCALAR_B) combineOp<W, SCALAR_B>(a, b, out, n, op);
+        else combineOp<W, BOTH>(a, b, out, n, op);
+    }
+
+    static void tileGeneric(size_t kc, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+        tileLanes<2, 6>(kc, a, b, c, ldc, accumulate);
+    }
+    static double dotGeneric(const double* a, const double* b, size_t n) { return dotLanes<2>(a, b, n); }
+    static void axpyGeneric(double alpha, const double* x, double* y, size_t n) { axpyLanes<2>(alpha, x, y, n); }
+    static void combineGeneric(const double* a, const double* b, double* out, size_t n, char op, int broadcast) {
+        combineAny<2>(a, b, out, n, op, broadcast);
+    }
+
+#ifdef TECHNEON_X86_DISPATCH
+    __attribute__((target("avx2,fma")))
+    static void tileAvx2(size_t kc, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+        tileLanes<4, 6>(kc, a, b, c, ldc, accumulate);
+    }
+    __attribute__((target("avx2,fma"))) static double dotAvx2(const double* a, const double* b, size_t n) { return dotLanes<4>(a, b, n); }
+    __attribute__((target("avx2,fma"))) static void axpyAvx2(double alpha, const double* x, double* y, size_t n) {
+        axpyLanes<4>(alpha, x, y, n);
+    }
+    __attribute__((target("avx2,fma")))
+    static void combineAvx2(const double* a, const double* b, double* out, size_t n, char op, int broadcast) {
+        combineAny<4>(a, b, out, n, op, broadcast);
+    }
+
+    __attribute__((target("avx512f")))
+    static void tileAvx512(size_t kc, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+        tileLanes<8, 12>(kc, a, b, c, ldc, accumulate);
+    }
+    __attribute__((target("avx512f"))) static double dotAvx512(const double* a, const double* b, size_t n) { return dotLanes<8>(a, b, n); }
+    __attribute__((target("avx512f"))) static void axpyAvx512(double alpha, const double* x, double* y, size_t n) {
+        axpyLanes<8>(alpha, x, y, n);
+    }
+    __attribute__((target("avx512f")))
+    static void combineAvx512(const double* a, const double* b, double* out, size_t n, char op, int broadcast) {
+        combineAny<8>(a, b, out, n, op, broadcast);
+    }
+#endif
+
+    static Kernels select() {
+#ifdef TECHNEON_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return {tileAvx512, 12, 16, dotAvx512, axpyAvx512, combineAvx512, "AVX-512"};
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return {tileAvx2, 6, 8, dotAvx2, axpyAvx2, combineAvx2, "AVX2+FMA"};
+        }
+#endif
+        return {tileGeneric, 6, 4, dotGeneric, axpyGeneric, combineGeneric, "generic"};
+    }
+
+public:
+    static const Kernels& get() {
+        static const Kernels kernels = select();
+        return kernels;
+    }
+};
+
+#pragma GCC pop_options
+#pragma GCC diagnostic pop
+
+// Matrix operations over MatrixKernel. The product is blocked the classic way: a KC x NC slab
+// of B is packed into NR-wide column panels that stay in L3, an MC x KC block of A into MR-high
+// row panels that stay in L2, and the register tile walks them with one B panel resident in L1.
+// Large products split the row blocks of A over a WorkStealingPool.
+class MatrixEngine {
+public:
+    static constexpr size_t MC = 432, KC = 256, NC = 3072;   // MC a multiple of every MR, NC of every NR
+    static constexpr double PARALLEL_FLOPS = 1 << 22;   // smaller products run on the calling thread
+
+private:
+    WorkStealingPool pool;
+    MatrixArena packedB;
+    vector<MatrixArena> packedA;   // one per worker
+
+    static void packA(const Matrix& a, size_t ic, size_t pc, size_t mc, size_t kc, size_t mr, double* to) {
+        for (size_t ir = 0; ir < mc; ir += mr) {
+            size_t height = min(mr, mc - ir);
+            for (size_t k = 0; k < kc; ++k) {
+                for (size_t r = 0; r < mr; ++r) to[k * mr + r] = r < height ? a.at(ic + ir + r, pc + k) : 0.0;
+            }
+            to += mr * kc;
+        }
+    }
+
+    static void packB(const Matrix& b, size_t pc, size_t jc, size_t kc, size_t nc, size_t nr, double* to) {
+        for (size_t jr = 0; jr < nc; jr += nr) {
+            size_t width = min(nr, nc - jr);
+            for (size_t k = 0; k < kc; ++k) {
+                const double* from = b.row(pc + k) + jc + jr;
+                copy(from, from + width, to + k * nr);
+                fill(to + k * nr + width, to + (k + 1) * nr, 0.0);
+            }
+            to += nr * kc;
+        }
+    }
+
+    // One MC x NC block of C from packed panels; edge tiles go through a local tile
+    static void block(const MatrixKernel::Kernels& kernels, const double* pa, const double* pb, const Matrix& c, size_t ic, size_t jc,
+                      size_t mc, size_t nc, size_t kc, bool accumulate) {
+        const size_t mr = kernels.mr, nr = kernels.nr;
+        alignas(64) double edge[MatrixKernel::MAX_MR * MatrixKernel::MAX_NR];
+        for (size_t jr = 0; jr < nc; jr += nr) {
+            size_t width = min(nr, nc - jr);
+            for (size_t ir = 0; ir < mc; ir += mr) {
+                size_t height = min(mr, mc - ir);
+                double* target = c.row(ic + ir) + jc + jr;
+                if (height == mr && width == nr) {
+                    kernels.tile(kc, pa + ir * kc, pb + jr * kc, target, c.stride, accumulate);
+                    continue;
+                }
+                kernels.tile(kc, pa + ir * kc, pb + jr * kc, edge, nr, false);
+                for (size_t r = 0; r < height; ++r) {
+                    for (size_t j = 0; j < width; ++j) {
+                        double& out = target[r * c.stride + j];
+                        out = (accumulate ? out : 0.0) + edge[r * nr + j];
+                    }
+                }
+            }
+        }
+    }
+
+    static string shape(const Matrix& m) { return to_string(m.rows) + "x" + to_string(m.cols); }
+
+public:
+    explicit MatrixEngine(size_t threads = thread::hardware_concurrency()) : pool(threads), packedA(pool.size()) {}
+
+    size_t threads() const { return pool.size(); }
+
+    // c = a b; c must not share storage with a or b
+    void multiply(const Matrix& a, const Matrix& b, const Matrix& c) {
+        if (a.cols != b.rows || c.rows != a.rows || c.cols != b.cols) {
+            throw runtime_error("Can't multiply " + shape(a) + " by " + shape(b) + " (inner sizes differ)");
+        }
+        const MatrixKernel::Kernels& kernels = MatrixKernel::get();
+        const size_t m = a.rows, n = b.cols, k = a.cols, mr = kernels.mr, nr = kernels.nr;
+        size_t blocks = (m + MC - 1) / MC;
+        bool parallel = pool.size() > 1 && blocks > 1 && 2.0 * m * n * k >= PARALLEL_FLOPS;
+        packedB.clear();
+        double* pb = packedB.allocate(KC * ((min(NC, n) + nr - 1) / nr * nr));
+        for (MatrixArena& arena : packedA) arena.clear();
+        vector<double*> pa(packedA.size());
+        for (size_t w = 0; w < (parallel ? pa.size() : 1); ++w) {
+            pa[w] = packedA[w].allocate(KC * ((min(MC, m) + mr - 1) / mr * mr));
+        }
+        for (size_t jc = 0; jc < n; jc += NC) {
+            size_t nc = min(NC, n - jc);
+            for (size_t pc = 0; pc < k; pc += KC) {
+                size_t kc = min(KC, k - pc);
+                packB(b, pc, jc, kc, nc, nr, pb);
+                auto rowBlock = [&](size_t task, size_t worker) {
+                    size_t ic = task * MC, mc = min(MC, m - ic);
+                    packA(a, ic, pc, mc, kc, mr, pa[worker]);
+                    block(kernels, pa[worker], pb, c, ic, jc, mc, nc, kc, pc > 0);
+                };
+                if (parallel) pool.parallelFor(blocks, rowBlock);
+                else for (size_t task = 0; task < blocks; ++task) rowBlock(task, 0);
+            }
+        }
+    }
+
+    // out = a op b for + - * /, elementwise; either side may be a single value
+    static void combine(const Matrix& a, char op, const Matrix& b, const Matrix& out) {
+        const MatrixKernel::Kernels& kernels = MatrixKernel::get();
+        int broadcast = a.isScalar() && !b.isScalar() ? MatrixKernel::SCALAR_A : b.isScalar() ? MatrixKernel::SCALAR_B : MatrixKernel::BOTH;
+        const Matrix& shaped = broadcast == MatrixKernel::SCALAR_A ? b : a;
+        if (broadcast == MatrixKernel::BOTH && (a.rows != b.rows || a.cols != b.cols)) {
+            throw runtime_error("Shapes " + shape(a) + " and " + shape(b) + " don't match for '" + op + "' (use @ to multiply matrices)");
+        }
+        if (op == '/') {
+            for (size_t r = 0; r < b.rows; ++r) {
+                if (any_of(b.row(r), b.row(r) + b.cols, [](double x) { return x == 0.0; })) throw runtime_error("Division by zero");
+            }
+        }
+        auto at = [&](const Matrix& m, size_t r) { return broadcast == MatrixKernel::BOTH || !m.isScalar() ? m.row(r) : m.data; };
+        if (shaped.contiguous()) {
+            kernels.combine(a.data, b.data, out.data, shaped.size(), op, broadcast);
+            return;
+        }
+        for (size_t r = 0; r < shaped.rows; ++r) kernels.combine(at(a, r), at(b, r), out.row(r), shaped.cols, op, broadcast);
+    }
+
+    // out[i] = fn(a[i]) for the operations without a vector kernel
+    template <typename Fn>
+    static void apply(const Matrix& a, const Matrix& out, Fn&& fn) {
+        for (size_t r = 0; r < a.rows; ++r) {
+            const double* from = a.row(r);
+            double* to = out.row(r);
+            for (size_t j = 0; j < a.cols; ++j) to[j] = fn(from[j]);
+        }
+    }
+
+    static double dot(const Matrix& a, const Matrix& b) {
+        if (!a.isVector() || !b.isVector() || a.size() != b.size()) {
+            throw runtime_error("dot needs two vectors of the same length, not " + shape(a) + " and " + shape(b));
+        }
+        return MatrixKernel::get().dot(a.data, b.data, a.size());
+    }
+
+    // Blocked so both the rows read and the rows written stay in cache
+    static void transpose(const Matrix& a, const Matrix& out) {
+        constexpr size_t TILE = 32;
+        for (size_t i = 0; i < a.rows; i += TILE) {
+            for (size_t j = 0; j < a.cols; j += TILE) {
+                size_t rowEnd = min(i + TILE, a.rows), colEnd = min(j + TILE, a.cols);
+                for (size_t r = i; r < rowEnd; ++r) {
+                    const double* from = a.row(r);
+                    for (size_t c = j; c < colEnd; ++c) out.at(c, r) = from[c];
+                }
+            }
+        }
+    }
+
+    // Solves a x = b in place: a is overwritten by its LU factors and b by x. Gaussian elimination
+    // with partial pivoting, row by row so every update is one contiguous axpy.
+    static void solve(const Matrix& a, const Matrix& b) {
+        if (a.rows != a.cols) throw runtime_error("solve needs a square matrix, not " + shape(a));
+        if (b.rows != a.rows) throw runtime_error("solve: right-hand side " + shape(b) + " doesn't fit " + shape(a));
+        const MatrixKernel::Kernels& kernels = MatrixKernel::get();
+        const size_t n = a.rows;
+        double scale = 0.0;
+        for (size_t r = 0; r < n; ++r) {
+            for (size_t c = 0; c < n; ++c) scale = max(scale, fabs(a.at(r, c)));
+        }
+        const double tiny = scale * static_cast<double>(n) * numeric_limits<double>::epsilon();
+        // Step 1: Forward elimination
+        for (size_t k = 0; k < n; ++k) {
+            size_t pivot = k;
+            for (size_t r = k + 1; r < n; ++r) {
+                if (fabs(a.at(r, k)) > fabs(a.at(pivot, k))) pivot = r;
+            }
+            if (!(fabs(a.at(pivot, k)) > tiny)) throw runtime_error("Matrix is singular");
+            if (pivot != k) {
+                swap_ranges(a.row(k), a.row(k) + n, a.row(pivot));
+                swap_ranges(b.row(k), b.row(k) + b.cols, b.row(pivot));
+            }
+            for (size_t r = k + 1; r < n; ++r) {
+                double factor = a.at(r, k) / a.at(k, k);
+                if (factor == 0.0) continue;
+                a.at(r, k) = factor;
+                kernels.axpy(-factor, a.row(k) + k + 1, a.row(r) + k + 1, n - k - 1);
+                kernels.axpy(-factor, b.row(k), b.row(r), b.cols);
+            }
+        }
+        // Step 2: Back substitution
+        for (size_t k = n; k-- > 0;) {
+            for (size_t r = k + 1; r < n; ++r) kernels.axpy(-a.at(k, r), b.row(r), b.row(k), b.cols);
+            double inverse = 1.0 / a.at(k, k);
+            for (size_t c = 0; c < b.cols; ++c) b.at(k, c) *= inverse;
+        }
+    }
+
+    static const char* name() { return MatrixKernel::get().name; }
+};
+
+// The calculator's matrix mode: named matrices and one-line statements over them.
+//   a = [1 2; 3 4]          literal, rows split by ';'
+//   c = a @ b               matrix product; + - * / ^ are elementwise, with a number applying to every element
+//   x = solve(a, [5; 6])    also dot, transpose (or a'), eye, zeros, ones, rand, sin, cos, tan
+// A bare expression is stored as 'ans'. Matrices live in one arena that is compacted once dead
+// results take more room than live ones.
+class MatrixSession {
+public:
+    struct Result {
+        string name;
+        Matrix value;
+        double seconds = 0.0;
+    };
+
+private:
+    static constexpr size_t COMPACT_SLACK = size_t(64) << 20;
+    static constexpr size_t LITERAL_LIMIT = 4096;
+
+    MatrixEngine engine;
+    MatrixArena arena;
+    unordered_map<string, Matrix> values;
+    uint64_t seed = 88172645463325252ull;
+
+    string_view text;
+    size_t pos = 0;
+
+    static bool isNameStart(char c) { return isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+    static bool isNameChar(char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+    static bool isFunction(string_view name) {
+        static constexpr string_view FUNCTIONS[] = {"dot", "transpose", "solve", "eye", "zeros", "ones", "rand", "sin", "cos", "tan"};
+        return std::find(begin(FUNCTIONS), end(FUNCTIONS), name) != end(FUNCTIONS);
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) ++pos;
+    }
+
+    bool accept(char c) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!accept(c)) throw runtime_error(string("Expected '") + c + "' at column " + to_string(pos + 1));
+    }
+
+    string_view name() {
+        size_t start = pos;
+        while (pos < text.size() && isNameChar(text[pos])) ++pos;
+        return text.substr(start, pos - start);
+    }
+
+    double number() {
+        skipSpace();
+        size_t start = pos;
+        if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) ++pos;
+        while (pos < text.size() && (isdigit(static_cast<unsigned char>(text[pos])) || text[pos] == '.')) ++pos;
+        if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+            ++pos;
+            if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) ++pos;
+            while (pos < text.size() && isdigit(static_cast<unsigned char>(text[pos]))) ++pos;
+        }
+        double value;
+        string_view field = text.substr(start, pos - start);
+        if (NumberParser::parseDouble(field, value) != ParseStatus::Ok) {
+            throw runtime_error("Invalid number '" + string(field) + "' at column " + to_string(start + 1));
+        }
+        return value;
+    }
+
+    static size_t dimension(const Matrix& m) {
+        if (!m.isScalar() || !(m.data[0] >= 1.0) || m.data[0] != floor(m.data[0]) || m.data[0] > 1e9) {
+            throw runtime_error("Sizes must be whole numbers of at least 1");
+        }
+        return static_cast<size_t>(m.data[0]);
+    }
+
+    Matrix copyOf(const Matrix& m) {
+        Matrix out = Matrix::allocate(arena, m.rows, m.cols);
+        for (size_t r = 0; r < m.rows; ++r) copy(m.row(r), m.row(r) + m.cols, out.row(r));
+        return out;
+    }
+
+    Matrix elementwise(const Matrix& a, char op, const Matrix& b) {
+        Matrix out = Matrix::allocate(arena, a.isScalar() ? b.rows : a.rows, a.isScalar() ? b.cols : a.cols);
+        if (op != '^') {
+            MatrixEngine::combine(a, op, b, out);
+        } else if (b.isScalar()) {
+            double exponent = b.data[0];
+            MatrixEngine::apply(a, out, [&](double x) { return Calculator::apply(x, '^', exponent); });
+        } else if (a.isScalar()) {
+            double base = a.data[0];
+            MatrixEngine::apply(b, out, [&](double x) { return Calculator::apply(base, '^', x); });
+        } else {
+            if (a.rows != b.rows || a.cols != b.cols) MatrixEngine::combine(a, '^', b, out);   // reports the mismatch
+            for (size_t r = 0; r < a.rows; ++r) {
+                for (size_t c = 0; c < a.cols; ++c) out.at(r, c) = Calculator::apply(a.at(r, c), '^', b.at(r, c));
+            }
+        }
+        return out;
+    }
+
+    Matrix transposed(const Matrix& a) {
+        Matrix out = Matrix::allocate(arena, a.cols, a.rows);
+        MatrixEngine::transpose(a, out);
+        return out;
+    }
+
+    Matrix call(string_view function, vector<Matrix>& args) {
+        auto arity = [&](size_t n) {
+            if (args.size() != n) throw runtime_error(string(function) + " takes " + to_string(n) + " argument" + (n == 1 ? "" : "s"));
+        };
+        if (function == "dot") {
+            arity(2);
+            return Matrix::scalar(arena, MatrixEngine::dot(args[0], args[1]));
+        }
+        if (function == "transpose") {
+            arity(1);
+            return transposed(args[0]);
+        }
+        if (function == "solve") {
+            arity(2);
+            Matrix a = copyOf(args[0]), x = copyOf(args[1]);
+            MatrixEngine::solve(a, x);
+            return x;
+        }
+        if (function == "sin" || function == "cos" || function == "tan") {
+            arity(1);
+            char op = static_cast<char>(toupper(function[0]));
+            Matrix out = Matrix::allocate(arena, args[0].rows, args[0].cols);
+            MatrixEngine::apply(args[0], out, [&](double x) { return Calculator::apply(x, op, 0.0); });
+            return out;
+        }
+        // eye(n), zeros(rows[, cols]), ones(rows[, cols]), rand(rows[, cols])
+        if (args.empty() || args.size() > (function == "eye" ? 1u : 2u)) throw runtime_error(string(function) + ": wrong number of sizes");
+        size_t rows = dimension(args[0]), cols = args.size() == 2 ? dimension(args[1]) : rows;
+        Matrix out = Matrix::allocate(arena, rows, cols);
+        for (size_t r = 0; r < rows; ++r) {
+            double* row = out.row(r);
+            if (function == "rand") {
+                for (size_t c = 0; c < cols; ++c) {
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+                    row[c] = static_cast<double>(seed >> 11) * 0x1p-53;
+                }
+            } else {
+                fill(row, row + cols, function == "ones" ? 1.0 : 0.0);
+                if (function == "eye") row[r] = 1.0;
+            }
+        }
+        return out;
+    }
+
+    // [1 2, 3; 4 5 6]: numbers split by spaces or commas, rows by ';'
+    Matrix literal() {
+        vector<double> elements;
+        size_t cols = 0, rows = 0, inRow = 0;
+        while (true) {
+            skipSpace();
+            if (pos >= text.size()) throw runtime_error("Expected ']'");
+            char c = text[pos];
+            if (c == ']' || c == ';') {
+                if (inRow == 0) throw runtime_error("Empty row in matrix literal");
+                if (rows > 0 && inRow != cols) throw runtime_error("Rows of a matrix literal must be the same length");
+                cols = inRow;
+                ++rows;
+                inRow = 0;
+                ++pos;
+                if (c == ']') break;
+                continue;
+            }
+            if (c == ',') {
+                ++pos;
+                continue;
+            }
+            if (elements.size() == LITERAL_LIMIT) throw runtime_error("Matrix literals hold at most " + to_string(LITERAL_LIMIT) + " numbers");
+            elements.push_back(number());
+            ++inRow;
+        }
+        Matrix out = Matrix::allocate(arena, rows, cols);
+        for (size_t r = 0; r < rows; ++r) copy(elements.begin() + r * cols, elements.begin() + (r + 1) * cols, out.row(r));
+        return out;
+    }
+
+    // Step 1: Operands, postfix transpose
+    Matrix primary() {
+        skipSpace();
+        if (pos >= text.size()) throw runtime_error("Expected a value at the end of the line");
+        Matrix value;
+        char c = text[pos];
+        if (c == '(') {
+            ++pos;
+            value = expression();
+            expect(')');
+        } else if (c == '[') {
+            ++pos;
+            value = literal();
+        } else if (isNameStart(c)) {
+            string_view id = name();
+            if (accept('(')) {
+                if (!isFunction(id)) throw runtime_error("Unknown function '" + string(id) + "'");
+                vector<Matrix> args;
+                if (!accept(')')) {
+                    do args.push_back(expression());
+                    while (accept(','));
+                    expect(')');
+                }
+                value = call(id, args);
+            } else {
+                auto it = values.find(string(id));
+                if (it == values.end()) throw runtime_error("Unknown matrix '" + string(id) + "'");
+                value = it->second;
+            }
+        } else if (isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            value = Matrix::scalar(arena, number());
+        } else {
+            throw runtime_error(string("Unexpected '") + c + "' at column " + to_string(pos + 1));
+        }
+        while (accept('\'')) value = transposed(value);
+        return value;
+    }
+
+    // Step 2: Binary operators; ^ binds tightest and to the right, below a leading minus
+    Matrix power() {
+        Matrix base = primary();
+        if (accept('^')) {
+            Matrix exponent = unary();
+            return elementwise(base, '^', exponent);
+        }
+        return base;
+    }
+
+    Matrix unary() {
+        if (accept('-')) {
+            Matrix operand = unary();
+            return elementwise(Matrix::scalar(arena, 0.0), '-', operand);
+        }
+        return power();
+    }
+
+    Matrix term() {
+        Matrix left = unary();
+        while (true) {
+            skipSpace();
+            if (pos >= text.size()) return left;
+            char op = text[pos];
+            if (op != '*' && op != '/' && op != '@') return left;
+            ++pos;
+            Matrix right = unary();
+            if (op == '@') {
+                Matrix out = Matrix::allocate(arena, left.rows, right.cols);
+                engine.multiply(left, right, out);
+                left = out;
+            } else {
+                left = elementwise(left, op, right);
+            }
+        }
+    }
+
+    Matrix expression() {
+        Matrix left = term();
+        while (true) {
+            skipSpace();
+            if (pos >= text.size()) return left;
+            char op = text[pos];
+            if (op != '+' && op != '-') return left;
+            ++pos;
+            left = elementwise(left, op, term());
+        }
+    }
+
+    // Step 3: Once dead results outweigh the live ones, the live ones move to a fresh arena
+    void compact() {
+        size_t live = 0;
+        for (const auto& entry : values) live += entry.second.bytes();
+        if (arena.bytesInUse() <= 2 * live + COMPACT_SLACK) return;
+        MatrixArena fresh;
+        for (auto& entry : values) {
+            Matrix moved = Matrix::allocate(fresh, entry.second.rows, entry.second.cols);
+            memcpy(moved.data, entry.second.data, entry.second.bytes());
+            entry.second = moved;
+        }
+        arena = std::move(fresh);
+    }
+
+public:
+    explicit MatrixSession(size_t threads = thread::hardware_concurrency()) : engine(threads) {}
+
+    // "name = expression" or a bare expression, stored as ans
+    Result run(string_view line) {
+        Result result;
+        result.name = "ans";
+        text = line;
+        pos = 0;
+        skipSpace();
+        size_t start = pos;
+        if (pos < text.size() && isNameStart(text[pos])) {
+            string_view id = name();
+            if (accept('=')) {
+                if (isFunction(id)) throw runtime_error("'" + string(id) + "' is a function and can't name a matrix");
+                result.name = string(id);
+            } else {
+                pos = start;
+            }
+        }
+        MatrixArena::Mark before = arena.mark();
+        auto started = chrono::steady_clock::now();
+        try {
+            result.value = expression();
+            skipSpace();
+            if (pos != text.size()) throw runtime_error(string("Unexpected '") + text[pos] + "' at column " + to_string(pos + 1));
+        } catch (...) {
+            arena.rewind(before);
+            throw;
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        values[result.name] = result.value;
+        compact();
+        result.value = values[result.name];
+        return result;
+    }
+
+    void erase(const string& name) {
+        if (!values.erase(name)) throw runtime_error("Unknown matrix '" + name + "'");
+    }
+
+    const Matrix* find(const string& name) const {
+        auto it = values.find(name);
+        return it == values.end() ? nullptr : &it->second;
+    }
+
+    // fn(name, matrix) in name order
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        vector<const pair<const string, Matrix>*> sorted;
+        for (const auto& entry : values) sorted.push_back(&entry);
+        sort(sorted.begin(), sorted.end(), [](auto* a, auto* b) { return a->first < b->first; });
+        for (auto* entry : sorted) fn(entry->first, entry->second);
+    }
+};
+
+}  // namespace techneon
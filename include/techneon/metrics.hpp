@@ -0,0 +1,372 @@
+// Per-thread latency histograms for every operation phase
+#pragma once
+
+#include "techneon/engine.hpp"
+
+#ifndef TECHNEON_METRICS
+#define TECHNEON_METRICS 1
+#endif
+#if TECHNEON_METRICS && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TECHNEON_PROBE(name, phase, kind) DTRACE_PROBE2(techneon, name, phase, kind)
+#endif
+#endif
+#ifndef TECHNEON_PROBE
+#define TECHNEON_PROBE(name, phase, kind) ((void)0)
+#endif
+
+namespace techneon {
+
+using namespace std;
+
+// Latency instrumentation for the compute and display phase of every operation, per kind and unit
+// pair. Each thread records into its own table, single writer, so updates are plain relaxed
+// stores; reports merge the tables while they are being written. Compiled out with
+// -DTECHNEON_METRICS=0, and off at runtime until enabled (--metrics), which leaves one relaxed load
+// per span. Where <sys/sdt.h> exists, every span is also bracketed by USDT probes for perf.
+class Metrics {
+public:
+    enum class Phase : unsigned char { Compute, Display };
+
+private:
+    // Log-linear buckets as in HDR histograms: values below 8 ns exactly, then 8 buckets per power
+    // of two (12.5% resolution) up to 2^40 ns
+    static constexpr int SUB_BITS = 3;
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr size_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 1) << SUB_BITS;
+    static constexpr size_t SLOTS = 512;                  // series per thread, open addressing
+    static constexpr uint32_t ANY_UNIT = 0xFFFFFE;        // pair used once a thread's table is full
+    static constexpr uint32_t NO_UNIT = 0xFFFFFF;         // unit id -1
+
+    struct Series {
+        atomic<uint64_t> count{0}, errors{0}, sum{0}, peak{0};
+        atomic<uint64_t> buckets[BUCKETS] = {};
+    };
+
+    struct Slot {
+        atomic<uint64_t> key{0};     // published after series is set
+        unique_ptr<Series> series;
+    };
+
+    struct ThreadTable {
+        Slot slots[SLOTS];
+        atomic<uint64_t> dropped{0};
+    };
+
+    // Bit 63 marks a used key; then phase, kind, from and to, so keys sort in report order
+    static uint64_t keyOf(Phase phase, OpKind kind, int from, int to) {
+        auto unit = [](int id) { return static_cast<uint64_t>(id < 0 ? NO_UNIT : min<uint32_t>(id, ANY_UNIT - 1)); };
+        return 1ull << 63 | static_cast<uint64_t>(phase) << 60 | static_cast<uint64_t>(kind) << 52 | unit(from) << 26 | unit(to) << 1;
+    }
+
+    static size_t bucketOf(uint64_t nanos) {
+        nanos = min<uint64_t>(nanos, (1ull << MAX_EXPONENT) - 1);
+        if (nanos < (1u << SUB_BITS)) return static_cast<size_t>(nanos);
+        int exponent = bit_width(nanos) - 1;
+        size_t sub = (nanos >> (exponent - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+        return (static_cast<size_t>(exponent - SUB_BITS + 1) << SUB_BITS) + sub;
+    }
+
+    // Largest value that falls into the bucket
+    static uint64_t bucketLimit(size_t bucket) {
+        if (bucket < (1u << SUB_BITS)) return bucket;
+        int exponent = static_cast<int>(bucket >> SUB_BITS) + SUB_BITS - 1;
+        uint64_t sub = bucket & ((1u << SUB_BITS) - 1);
+        return (((1ull << SUB_BITS | sub) + 1) << (exponent - SUB_BITS)) - 1;
+    }
+
+    static void bump(atomic<uint64_t>& counter, uint64_t amount = 1) {
+        counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    static atomic<int>& state() {
+        static atomic<int> enabled{0};
+        return enabled;
+    }
+
+    static mutex& registryLock() {
+        static mutex lock;
+        return lock;
+    }
+
+    static vector<unique_ptr<ThreadTable>>& registry() {
+        static vector<unique_ptr<ThreadTable>> tables;
+        return tables;
+    }
+
+    static ThreadTable& local() {
+        thread_local ThreadTable* table = [] {
+            lock_guard<mutex> lock(registryLock());
+            registry().push_back(make_unique<ThreadTable>());
+            return registry().back().get();
+        }();
+        return *table;
+    }
+
+    static Series* find(ThreadTable& table, uint64_t key) {
+        size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 55) % SLOTS;
+        for (size_t probe = 0; probe < SLOTS; ++probe, slot = (slot + 1) % SLOTS) {
+            Slot& s = table.slots[slot];
+            uint64_t current = s.key.load(memory_order_relaxed);
+            if (current == key) return s.series.get();
+            if (current == 0) {
+                s.series = make_unique<Series>();
+                s.key.store(key, memory_order_release);
+                return s.series.get();
+            }
+        }
+        return nullptr;
+    }
+
+    static void record(uint64_t key, uint64_t nanos, bool failed) {
+        ThreadTable& table = local();
+        Series* series = find(table, key);
+        if (!series) {
+            // Table full: keep the kind, lose the unit pair
+            uint64_t anyPair = (key & ~((1ull << 50) - 1)) | static_cast<uint64_t>(ANY_UNIT) << 26 | static_cast<uint64_t>(ANY_UNIT) << 1;
+            series = find(table, anyPair);
+        }
+        if (!series) {
+            bump(table.dropped);
+            return;
+        }
+        bump(series->count);
+        if (failed) bump(series->errors);
+        bump(series->sum, nanos);
+        if (nanos > series->peak.load(memory_order_relaxed)) series->peak.store(nanos, memory_order_relaxed);
+        bump(series->buckets[bucketOf(nanos)]);
+    }
+
+    static int64_t now() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    // Times its scope. A scope left by an exception counts as an error.
+    class Span {
+    private:
+        uint64_t key = 0;
+        int64_t start = 0;
+        int exceptions = 0;
+
+    public:
+        Span(Phase phase, OpKind kind, int from = 0, int to = 0) {
+            TECHNEON_PROBE(begin, static_cast<int>(phase), static_cast<int>(kind));
+            if (!enabled()) return;
+            key = keyOf(phase, kind, from, to);
+            exceptions = uncaught_exceptions();
+            start = now();
+        }
+
+        ~Span() {
+            if (key) record(key, static_cast<uint64_t>(max<int64_t>(now() - start, 0)), uncaught_exceptions() > exceptions);
+            TECHNEON_PROBE(end, static_cast<int>(key >> 60 & 7), static_cast<int>(key >> 52 & 0xFF));
+        }
+
+        Span(Phase phase, const Operation& op) {
+            TECHNEON_PROBE(begin, static_cast<int>(phase), static_cast<int>(op.kind));
+            if (!enabled()) return;
+            auto [from, to] = pairOf(op);
+            key = keyOf(phase, op.kind, from, to);
+            exceptions = uncaught_exceptions();
+            start = now();
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    };
+
+    struct Summary {
+        Phase phase;
+        OpKind kind;
+        string pair;             // e.g. "mi->km", "+", or "(other)" once a thread ran out of slots
+        uint64_t count = 0, errors = 0, sum = 0, peak = 0;
+        vector<uint64_t> buckets = vector<uint64_t>(BUCKETS);
+
+        // Upper bound of the bucket holding the q-quantile, capped at the largest value seen
+        uint64_t quantile(double q) const {
+            uint64_t rank = static_cast<uint64_t>(ceil(q * static_cast<double>(count))), seen = 0;
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                seen += buckets[b];
+                if (seen >= max<uint64_t>(rank, 1)) return min(bucketLimit(b), peak);
+            }
+            return peak;
+        }
+    };
+
+    static bool enabled() {
+#if TECHNEON_METRICS
+        return state().load(memory_order_relaxed) != 0;
+#else
+        return false;
+#endif
+    }
+
+    static void enable(bool on = true) { state().store(on ? 1 : 0, memory_order_relaxed); }
+
+    static const char* phaseName(Phase phase) { return phase == Phase::Compute ? "compute" : "display"; }
+
+    // The key an operation is recorded under: its codes, unit ids, currency keys or bases
+    static pair<int, int> pairOf(const Operation& op) {
+        switch (op.kind) {
+            case OpKind::Calculator:
+            case OpKind::Logarithm: return {static_cast<unsigned char>(toupper(op.op)), 0};
+            case OpKind::Currency:
+            case OpKind::Unit: return {op.fromUnit, op.toUnit};
+            case OpKind::Radix: return {RadixConverter::baseOf(op.a), RadixConverter::baseOf(op.b)};
+            case OpKind::Expression: return {0, 0};
+            default: return {static_cast<unsigned char>(toupper(op.from)), static_cast<unsigned char>(toupper(op.to))};
+        }
+    }
+
+    // All series merged over threads, in phase, kind and pair order
+    static vector<Summary> snapshot() {
+        vector<pair<uint64_t, Summary>> merged;
+        {
+            lock_guard<mutex> lock(registryLock());
+            for (const auto& table : registry()) {
+                for (const Slot& slot : table->slots) {
+                    uint64_t key = slot.key.load(memory_order_acquire);
+                    if (key == 0) continue;
+                    auto it = find_if(merged.begin(), merged.end(), [&](const auto& entry) { return entry.first == key; });
+                    if (it == merged.end()) it = merged.insert(merged.end(), {key, Summary{}});
+                    Summary& s = it->second;
+                    const Series& series = *slot.series;
+                    s.count += series.count.load(memory_order_relaxed);
+                    s.errors += series.errors.load(memory_order_relaxed);
+                    s.sum += series.sum.load(memory_order_relaxed);
+                    s.peak = max(s.peak, series.peak.load(memory_order_relaxed));
+                    for (size_t b = 0; b < BUCKETS; ++b) s.buckets[b] += series.buckets[b].load(memory_order_relaxed);
+                }
+            }
+        }
+        sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        vector<Summary> result;
+        for (auto& [key, s] : merged) {
+            s.phase = static_cast<Phase>(key >> 60 & 7);
+            s.kind = static_cast<OpKind>(key >> 52 & 0xFF);
+            s.pair = pairLabel(s.kind, static_cast<uint32_t>(key >> 26 & NO_UNIT), static_cast<uint32_t>(key >> 1 & NO_UNIT));
+            result.push_back(move(s));
+        }
+        return result;
+    }
+
+    static string pairLabel(OpKind kind, uint32_t from, uint32_t to) {
+        if (from == ANY_UNIT) return "(other)";
+        auto unit = [](uint32_t id) { return id == NO_UNIT ? string("?") : UnitRegistry::instance().symbol(static_cast<int>(id)); };
+        auto currency = [](uint32_t key) { return key == NO_UNIT ? string("?") : RateTable::codeOfKey(static_cast<int>(key)); };
+        switch (kind) {
+            case OpKind::Calculator:
+            case OpKind::Logarithm: return string(1, static_cast<char>(from));
+            case OpKind::Unit: return unit(from) + "->" + unit(to);
+            case OpKind::Currency: return currency(from) + "->" + currency(to);
+            case OpKind::Radix: return to_string(from) + "->" + to_string(to);
+            case OpKind::Expression: return "";
+            default: return string(1, static_cast<char>(from)) + "->" + string(1, static_cast<char>(to));
+        }
+    }
+
+    static uint64_t dropped() {
+        lock_guard<mutex> lock(registryLock());
+        uint64_t total = 0;
+        for (const auto& table : registry()) total += table->dropped.load(memory_order_relaxed);
+        return total;
+    }
+
+    // Prometheus text exposition: one summary per series, latencies in seconds
+    static void writePrometheus(ostream& out) {
+        vector<Summary> series = snapshot();
+        auto labels = [](const Summary& s) {
+            return string("phase=\"") + phaseName(s.phase) + "\",kind=\"" + opKindName(s.kind) + "\",pair=\"" + s.pair + "\"";
+        };
+        out << "# HELP techneon_operation_seconds Time spent per operation phase, kind and unit pair\n"
+            << "# TYPE techneon_operation_seconds summary\n";
+        for (const Summary& s : series) {
+            for (double q : {0.5, 0.9, 0.99, 0.999}) {
+                out << "techneon_operation_seconds{" << labels(s) << ",quantile=\"" << q << "\"} " << s.quantile(q) * 1e-9 << "\n";
+            }
+            out << "techneon_operation_seconds_sum{" << labels(s) << "} " << s.sum * 1e-9 << "\n"
+                << "techneon_operation_seconds_count{" << labels(s) << "} " << s.count << "\n";
+        }
+        out << "# HELP techneon_operation_errors_total Operations that ended with an error\n"
+            << "# TYPE techneon_operation_errors_total counter\n";
+        for (const Summary& s : series) out << "techneon_operation_errors_total{" << labels(s) << "} " << s.errors << "\n";
+        out << "# HELP techneon_operation_dropped_total Measurements lost because a thread's series table was full\n"
+            << "# TYPE techneon_operation_dropped_total counter\n"
+            << "techneon_operation_dropped_total " << dropped() << "\n";
+    }
+
+    static void writeJson(ostream& out) {
+        out << "{\"series\":[";
+        bool first = true;
+        for (const Summary& s : snapshot()) {
+            out << (first ? "" : ",") << "\n  {\"phase\":\"" << phaseName(s.phase) << "\",\"kind\":\"" << opKindName(s.kind)
+                << "\",\"pair\":\"" << s.pair << "\",\"count\":" << s.count << ",\"errors\":" << s.errors
+                << ",\"sum_ns\":" << s.sum << ",\"p50_ns\":" << s.quantile(0.5) << ",\"p90_ns\":" << s.quantile(0.9)
+                << ",\"p99_ns\":" << s.quantile(0.99) << ",\"p999_ns\":" << s.quantile(0.999) << ",\"max_ns\":" << s.peak << "}";
+            first = false;
+        }
+        out << "\n],\"dropped\":" << dropped() << "}\n";
+    }
+
+    // JSON when the path ends in .json, Prometheus text otherwise. The file is replaced in one
+    // rename, so a scraper never sees half a report.
+    static void save(const string& path) {
+        string temporary = path + ".tmp";
+        {
+            ofstream file(temporary, ios::trunc);
+            if (!file) throw runtime_error("Cannot write metrics to " + path);
+            if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) writeJson(file);
+            else writePrometheus(file);
+        }
+        if (rename(temporary.c_str(), path.c_str()) != 0) throw runtime_error("Cannot write metrics to " + path);
+    }
+
+    // Report file given with --metrics; empty when none
+    static string& reportPath() {
+        static string path;
+        return path;
+    }
+
+    static void saveReport() {
+        if (reportPath().empty()) return;
+        try {
+            save(reportPath());
+        } catch (const runtime_error& e) {
+            cerr << RED_COLOR << e.what() << RESET_COLOR << endl;
+        }
+    }
+
+    // Rewrites the report file every interval while in scope, and once more at the end
+    class PeriodicReport {
+    private:
+        mutex lock;
+        condition_variable wake;
+        bool stopping = false;
+        thread writer;
+
+    public:
+        explicit PeriodicReport(chrono::milliseconds interval = chrono::milliseconds(1000)) {
+            if (reportPath().empty()) return;
+            writer = thread([this, interval] {
+                unique_lock<mutex> guard(lock);
+                while (!wake.wait_for(guard, interval, [this] { return stopping; })) saveReport();
+            });
+        }
+
+        ~PeriodicReport() {
+            if (writer.joinable()) {
+                {
+                    lock_guard<mutex> guard(lock);
+                    stopping = true;
+                }
+                wake.notify_one();
+                writer.join();
+            }
+            saveReport();
+        }
+    };
+};
+
+}  // namespace techneon
@@ -0,0 +1,429 @@
+// Exact money: scaled 64-bit decimals, currency rates as exact ratios and banker's rounding
+#pragma once
+
+#include "techneon/batch.hpp"
+
+#include <numeric>
+
+namespace techneon {
+
+using namespace std;
+
+// An amount held as units * 10^-scale, e.g. 1234 at scale 2 is 12.34. Every rounding, whether
+// parsing extra digits or changing scale or currency, is half to even (banker's rounding), so
+// no direction is favoured and a long ledger doesn't drift.
+class Decimal {
+public:
+    static constexpr int MAX_SCALE = 18;
+
+private:
+    static constexpr int64_t POW10[MAX_SCALE + 1] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000, 10000000000,
+        100000000000, 1000000000000, 10000000000000, 100000000000000, 1000000000000000,
+        10000000000000000, 100000000000000000, 1000000000000000000};
+
+    int64_t count = 0;
+    int places = 0;
+
+    static void checkScale(int scale) {
+        if (scale < 0 || scale > MAX_SCALE) throw runtime_error("Decimal scale must be 0 to " + to_string(MAX_SCALE));
+    }
+
+public:
+    constexpr Decimal() = default;
+    Decimal(int64_t units, int scale) : count(units), places(scale) { checkScale(scale); }
+
+    static int64_t pow10(int n) { return POW10[n]; }
+
+    // n / d rounded half to even, for d > 0
+    static int64_t divideRounded(__int128 n, int64_t d) {
+        __int128 q = n / d, r = n % d;
+        if (r < 0) {
+            --q;
+            r += d;
+        }
+        if (2 * r > d || (2 * r == d && (q & 1))) ++q;
+        if (q > numeric_limits<int64_t>::max() || q < numeric_limits<int64_t>::min()) {
+            throw runtime_error("Decimal amount out of range");
+        }
+        return static_cast<int64_t>(q);
+    }
+
+    // Optional sign, digits and an optional point; digits past the scale are rounded, never lost
+    // through binary floating point
+    static ParseStatus tryParse(string_view text, int scale, Decimal& out) {
+        checkScale(scale);
+        size_t i = 0;
+        bool negative = false;
+        if (!text.empty() && (text[0] == '-' || text[0] == '+')) negative = text[i++] == '-';
+        uint64_t units = 0;
+        int fraction = -1;         // digits seen after the point, -1 before it
+        int dropped = -1;          // first digit past the scale
+        bool sticky = false;       // any nonzero digit after that one
+        size_t digits = 0;
+        for (; i < text.size(); ++i) {
+            char c = text[i];
+            if (c == '.' && fraction < 0) {
+                fraction = 0;
+                continue;
+            }
+            if (c < '0' || c > '9') return ParseStatus::InvalidNumber;
+            ++digits;
+            if (fraction >= scale) {
+                if (fraction == scale) dropped = c - '0';
+                else sticky |= c != '0';
+                ++fraction;
+                continue;
+            }
+            if (__builtin_mul_overflow(units, 10u, &units) || __builtin_add_overflow(units, static_cast<unsigned>(c - '0'), &units)) {
+                return ParseStatus::OutOfRange;
+            }
+            if (fraction >= 0) ++fraction;
+        }
+        if (digits == 0) return ParseStatus::InvalidNumber;
+        for (int kept = max(fraction, 0); kept < scale; ++kept) {
+            if (__builtin_mul_overflow(units, 10u, &units)) return ParseStatus::OutOfRange;
+        }
+        if (dropped > 5 || (dropped == 5 && (sticky || (units & 1)))) ++units;
+        if (units > static_cast<uint64_t>(numeric_limits<int64_t>::max())) return ParseStatus::OutOfRange;
+        out.count = negative ? -static_cast<int64_t>(units) : static_cast<int64_t>(units);
+        out.places = scale;
+        return ParseStatus::Ok;
+    }
+
+    static Decimal parse(string_view text, int scale) {
+        Decimal result;
+        ParseStatus status = tryParse(text, scale, result);
+        if (status == ParseStatus::OutOfRange) throw runtime_error("Amount out of range: " + string(text));
+        if (status != ParseStatus::Ok) throw runtime_error("Invalid amount: " + string(text));
+        return result;
+    }
+
+    // The shortest decimal that reads back as value, so a quoted 0.92 is exactly 0.92
+    static Decimal fromDouble(double value, int scale) {
+        if (!isfinite(value)) throw runtime_error("Invalid amount: not a finite number");
+        char text[400];
+        auto [end, ec] = to_chars(text, text + sizeof(text), value, chars_format::fixed);
+        if (ec != errc()) throw runtime_error("Invalid amount");
+        return parse(string_view(text, end - text), scale);
+    }
+
+    int64_t units() const { return count; }
+    int scale() const { return places; }
+    double toDouble() const { return static_cast<double>(count) / static_cast<double>(POW10[places]); }
+
+    Decimal rescale(int scale) const {
+        checkScale(scale);
+        if (scale >= places) {
+            int64_t units;
+            if (__builtin_mul_overflow(count, POW10[scale - places], &units)) throw runtime_error("Decimal amount out of range");
+            return Decimal(units, scale);
+        }
+        return Decimal(divideRounded(count, POW10[places - scale]), scale);
+    }
+
+    // Sums and differences keep the finer of the two scales, so they are exact
+    friend Decimal operator+(const Decimal& a, const Decimal& b) {
+        int scale = max(a.places, b.places);
+        Decimal x = a.rescale(scale), y = b.rescale(scale);
+        if (__builtin_add_overflow(x.count, y.count, &x.count)) throw runtime_error("Decimal amount out of range");
+        return x;
+    }
+
+    friend Decimal operator-(const Decimal& a, const Decimal& b) { return a + Decimal(-b.count, b.places); }
+
+    friend bool operator==(const Decimal& a, const Decimal& b) { return a <=> b == 0; }
+
+    friend strong_ordering operator<=>(const Decimal& a, const Decimal& b) {
+        int scale = max(a.places, b.places);
+        __int128 x = static_cast<__int128>(a.count) * POW10[scale - a.places];
+        __int128 y = static_cast<__int128>(b.count) * POW10[scale - b.places];
+        return x <=> y;
+    }
+
+    // Units wider than 64 bits too, for ledger totals
+    template <size_t N>
+    static TextBuffer<N>& appendUnits(TextBuffer<N>& out, __int128 units, int scale) {
+        char digits[48];
+        int len = 0;
+        unsigned __int128 magnitude = units < 0 ? -static_cast<unsigned __int128>(units) : static_cast<unsigned __int128>(units);
+        do {
+            digits[len++] = static_cast<char>('0' + static_cast<int>(magnitude % 10));
+            magnitude /= 10;
+        } while (magnitude != 0 || len <= scale);
+        if (units < 0) out.append('-');
+        for (int i = len - 1; i >= 0; --i) {
+            out.append(digits[i]);
+            if (i == scale && scale > 0) out.append('.');
+        }
+        return out;
+    }
+
+    template <size_t N>
+    TextBuffer<N>& appendTo(TextBuffer<N>& out) const { return appendUnits(out, count, places); }
+
+    string text() const {
+        TextBuffer<48> out;
+        return string(appendTo(out).view());
+    }
+};
+
+// A currency rate as the exact ratio of the two quoted rates, with both amounts' scales folded in:
+// converted units = round(units * numerator / denominator). Quotes are read as the shortest
+// decimal that gives back the stored double, to QUOTE_SCALE places.
+struct MoneyRate {
+    static constexpr int QUOTE_SCALE = 12;
+
+    int64_t numerator = 1, denominator = 1;
+    double approx = 1.0;   // numerator / denominator, the kernels' first guess
+
+    // unitsPerPivot of the source and target currencies
+    static MoneyRate fromQuotes(double fromQuote, double toQuote, int fromScale, int toScale) {
+        if (min(fromScale, toScale) < 0 || max(fromScale, toScale) > Decimal::MAX_SCALE) {
+            throw runtime_error("Decimal scale must be 0 to " + to_string(Decimal::MAX_SCALE));
+        }
+        int64_t from = Decimal::fromDouble(fromQuote, QUOTE_SCALE).units();
+        int64_t to = Decimal::fromDouble(toQuote, QUOTE_SCALE).units();
+        if (from <= 0 || to <= 0) throw runtime_error("Currency rates must be positive");
+        MoneyRate rate;
+        int shift = toScale - fromScale;
+        int64_t g = gcd(from, to);
+        rate.numerator = to / g;
+        rate.denominator = from / g;
+        int64_t& widened = shift >= 0 ? rate.numerator : rate.denominator;
+        for (int i = 0; i < abs(shift); ++i) {
+            int64_t& other = shift >= 0 ? rate.denominator : rate.numerator;
+            if (other % 10 == 0) other /= 10;
+            else if (__builtin_mul_overflow(widened, int64_t(10), &widened)) throw runtime_error("Rate needs more than 64-bit precision");
+        }
+        g = gcd(rate.numerator, rate.denominator);
+        rate.numerator /= g;
+        rate.denominator /= g;
+        // The kernels' remainders are formed in 64 bits and doubled
+        if (rate.denominator >= (int64_t(1) << 61)) throw runtime_error("Rate needs more than 64-bit precision");
+        rate.approx = static_cast<double>(rate.numerator) / static_cast<double>(rate.denominator);
+        return rate;
+    }
+
+    // Menu letters or ISO codes, from the current rate table
+    static MoneyRate between(string_view from, string_view to, int fromScale, int toScale) {
+        auto rates = CurrencyRates::instance().read();
+        int a = rates->indexOf(RateTable::currencyKey(from)), b = rates->indexOf(RateTable::currencyKey(to));
+        if (a < 0 || b < 0) throw runtime_error("Invalid or unsupported currency (use I, U, E, G or an ISO code)");
+        return fromQuotes(rates->quote(a), rates->quote(b), fromScale, toScale);
+    }
+
+    int64_t apply(int64_t units) const { return Decimal::divideRounded(static_cast<__int128>(units) * numerator, denominator); }
+
+    Decimal apply(const Decimal& amount, int toScale) const { return Decimal(apply(amount.units()), toScale); }
+};
+
+// Bulk conversion and summation over columns of units. Each value is estimated in double,
+// floored, then corrected with its exact remainder units * numerator - q * denominator: the
+// remainder is small, so 64-bit wrap-around arithmetic gets it exactly from the low halves of
+// the products. One step each way fixes the estimate and the remainder decides the half-even
+// rounding. A block holding any |units| >= 2^53 or result near 2^50 is redone on the
+// 128-bit path instead, so every result is exact whatever the input.
+class MoneyKernel {
+public:
+    using KernelFn = __int128 (*)(const int64_t*, int64_t*, size_t, const MoneyRate&);
+
+    // Beyond these the double estimate may be off by more than one, and the block is redone exactly
+    static constexpr int64_t INPUT_LIMIT = int64_t(1) << 53;
+    static constexpr int64_t RESULT_LIMIT_BITS = int64_t(1023 + 50) << 52;   // 2^50 as double bits
+
+private:
+    static constexpr double ROUND_MAGIC = 0x1.8p52;    // x + ROUND_MAGIC - ROUND_MAGIC rounds to an integer
+    static constexpr size_t SUM_BLOCK = 2048;          // lane totals stay below 2^62 over a block
+
+    template <int W>
+    [[gnu::always_inline]] static inline __int128 lanes(const int64_t* in, int64_t* out, size_t n, const MoneyRate& rate) {
+        using V = typename FastMathLanes<W>::Float;
+        using B = typename FastMathLanes<W>::Bits;
+        using U = typename FastMathLanes<W>::Words;
+        const int64_t d = rate.denominator;
+        __int128 total = 0;
+        size_t i = 0;
+        while (i + W <= n) {
+            size_t blockStart = i, blockEnd = i + min(n - i, SUM_BLOCK) / W * W;
+            U lane = {};
+            B least = {}, most = {}, largest = {};
+            for (; i < blockEnd; i += W) {
+                B a;
+                memcpy(&a, in + i, sizeof(a));
+                // Step 1: floor of the estimate; within one of the true floor while |result| < 2^50
+                V x = __builtin_convertvector(a, V) * rate.approx;
+                V t = (x + ROUND_MAGIC) - ROUND_MAGIC;
+                B q = __builtin_convertvector(t, B) + (t > x);
+                // Step 2: The exact remainder, then one correction each way
+                B r = (B)((U)a * static_cast<uint64_t>(rate.numerator) - (U)q * static_cast<uint64_t>(d));
+                B below = r < 0;
+                q += below;
+                r += below & d;
+                B above = r >= d;
+                q -= above;
+                r -= above & d;
+                // Step 3: Round half to even
+                q -= (r + r > d) | ((r + r == d) & -(q & 1));
+                // Range checks wait for the end of the block: here they are lane minimums and
+                // maximums, the bits of |x| ordering like its magnitude
+                B magnitude = (B)x & (B{} + numeric_limits<int64_t>::max());
+                least = a < least ? a : least;
+                most = a > most ? a : most;
+                largest = magnitude > largest ? magnitude : largest;
+                memcpy(out + i, &q, sizeof(q));
+                lane += (U)q;
+            }
+            // Step 4: A block with any value out of the estimate's range is redone exactly
+            bool any = false;
+            for (int j = 0; j < W; ++j) {
+                any |= least[j] <= -INPUT_LIMIT || most[j] >= INPUT_LIMIT || largest[j] >= RESULT_LIMIT_BITS;
+            }
+            if (any) {
+                for (size_t k = blockStart; k < blockEnd; ++k) total += out[k] = rate.apply(in[k]);
+            } else {
+                for (int j = 0; j < W; ++j) total += static_cast<int64_t>(lane[j]);
+            }
+        }
+        for (; i < n; ++i) total += out[i] = rate.apply(in[i]);
+        return total;
+    }
+
+    static __int128 generic(const int64_t* in, int64_t* out, size_t n, const MoneyRate& rate) { return lanes<2>(in, out, n, rate); }
+
+#ifdef TECHNEON_X86_DISPATCH
+    // 64-bit lane multiplies and conversions need AVX-512DQ; AVX2 would emulate them lane by lane
+    __attribute__((target("avx512f,avx512dq")))
+    static __int128 avx512(const int64_t* in, int64_t* out, size_t n, const MoneyRate& rate) { return lanes<8>(in, out, n, rate); }
+#endif
+
+    static KernelFn select() {
+#ifdef TECHNEON_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return avx512;
+#endif
+        return generic;
+    }
+
+public:
+    // out[i] = in[i] converted and rounded half to even; returns the exact sum of out
+    static __int128 convert(span<const int64_t> in, span<int64_t> out, const MoneyRate& rate) {
+        static const KernelFn kernel = select();
+        if (out.size() < in.size()) {
+            throw runtime_error("Output column is shorter than input column");
+        }
+        return kernel(in.data(), out.data(), in.size(), rate);
+    }
+
+    // Exact whatever the length; two carries per value is cheaper than the memory it reads
+    static __int128 sum(span<const int64_t> values) {
+        __int128 total = 0;
+        for (int64_t v : values) total += v;
+        return total;
+    }
+
+    static const char* name() {
+#ifdef TECHNEON_X86_DISPATCH
+        if (select() == avx512) return "AVX-512DQ";
+#endif
+        return "generic";
+    }
+
+    // Every kernel this machine can run, for checking each against MoneyRate::apply
+    static vector<pair<const char*, KernelFn>> kernels() {
+        vector<pair<const char*, KernelFn>> all = {{"generic", generic}};
+#ifdef TECHNEON_X86_DISPATCH
+        if (select() == avx512) all.emplace_back("AVX-512DQ", avx512);
+#endif
+        return all;
+    }
+};
+
+// Converts a ledger of decimal amounts, one per line, and totals both sides exactly. Totals are
+// the sums of the rounded rows, so they match the converted ledger to the last unit.
+class MoneyLedger {
+public:
+    struct Totals {
+        size_t rows = 0;
+        __int128 source = 0, converted = 0;
+    };
+
+private:
+    static constexpr size_t BLOCK = 4096;
+
+    MoneyRate rate;
+    int fromScale, toScale;
+    vector<int64_t> amounts, converted;
+
+    void flush(Totals& totals, BufferedWriter* rows) {
+        if (amounts.empty()) return;
+        totals.source += MoneyKernel::sum(amounts);
+        totals.converted += MoneyKernel::convert(amounts, span<int64_t>(converted.data(), amounts.size()), rate);
+        totals.rows += amounts.size();
+        if (rows) {
+            for (size_t i = 0; i < amounts.size(); ++i) {
+                TextBuffer<48> text;
+                rows->write(Decimal::appendUnits(text, converted[i], toScale).view());
+                rows->put('\n');
+            }
+        }
+        amounts.clear();
+    }
+
+public:
+    MoneyLedger(const MoneyRate& r, int from, int to) : rate(r), fromScale(from), toScale(to), converted(BLOCK) {
+        amounts.reserve(BLOCK);
+    }
+
+    // Blank and '#' lines are skipped; rows that aren't amounts are counted in failures and
+    // reported to errorFile if given
+    Totals run(FILE* in, BufferedWriter* rows, size_t& failures, FILE* errorFile = nullptr) {
+        Totals totals;
+        failures = 0;
+        ChunkedLineReader reader(in);
+        unique_ptr<BufferedWriter> errors;
+        if (errorFile) {
+            errors = make_unique<BufferedWriter>(errorFile);
+            BatchProcessor::reportHeader(*errors);
+        }
+        string_view line;
+        size_t row = 0;
+        while (reader.nextLine(line)) {
+            ++row;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            size_t first = line.find_first_not_of(" \t");
+            if (first == string_view::npos || line[first] == '#') continue;
+            string_view field = line.substr(first, line.find_last_not_of(" \t") - first + 1);
+            Decimal amount;
+            ParseStatus status = Decimal::tryParse(field, fromScale, amount);
+            if (status != ParseStatus::Ok) {
+                ++failures;
+                if (errors) {
+                    RowError error;
+                    error.row = row;
+                    error.column = first + 1;
+                    BatchProcessor::describe(status, field, error.message);
+                    BatchProcessor::report(*errors, error);
+                }
+                continue;
+            }
+            amounts.push_back(amount.units());
+            if (amounts.size() == BLOCK) flush(totals, rows);
+        }
+        flush(totals, rows);
+        return totals;
+    }
+
+    // count, source and converted totals in the --format style; JSON numbers can't hold every
+    // exact total, so amounts are text fields
+    void write(BufferedWriter& out, const Totals& totals) const {
+        TextBuffer<64> source, converted;
+        Decimal::appendUnits(source, totals.source, fromScale);
+        Decimal::appendUnits(converted, totals.converted, toScale);
+        FieldReport report;
+        report.count("rows", totals.rows).text("source", source.view()).text("converted", converted.view());
+        report.write(out);
+    }
+};
+
+}  // namespace techneon
@@ -0,0 +1,278 @@
+// Trace replay: runs a captured trace against the engines, flat out or at the recorded pace
+#pragma once
+
+#include "techneon/stats.hpp"
+#include "techneon/history.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+// A trace file mapped read-only, with an index of its entries built in one pass
+class TraceFile {
+private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const TraceFileHeader* header = nullptr;
+    vector<const TraceEntry*> index;
+    size_t dropped = 0;
+
+    TraceFile() = default;
+
+public:
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    ~TraceFile() {
+        if (mapping) munmap(mapping, mappingSize);
+    }
+
+    static unique_ptr<TraceFile> load(const string& path) {
+        // Step 1: Map the whole file read-only
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open trace " + path);
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(TraceFileHeader)) {
+            close(fd);
+            throw runtime_error("Trace " + path + " is too short");
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) throw runtime_error("Cannot map trace " + path);
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        unique_ptr<TraceFile> file(new TraceFile());
+        file->mapping = mapping;
+        file->mappingSize = size;
+        file->header = static_cast<const TraceFileHeader*>(mapping);
+        if (memcmp(file->header->magic, "TCTR", 4) != 0 || file->header->version != 1) {
+            throw runtime_error("Trace " + path + " has an unknown format");
+        }
+        // Step 2: Walk the entries; a capture cut short leaves a partial last entry, which is dropped
+        // and counted. Anything else past the last whole entry means the file is damaged.
+        const char* at = static_cast<const char*>(mapping) + sizeof(TraceFileHeader);
+        const char* end = static_cast<const char*>(mapping) + size;
+        while (at != end) {
+            size_t left = static_cast<size_t>(end - at);
+            if (left < sizeof(TraceEntry)) {
+                file->dropped = left;
+                break;
+            }
+            const TraceEntry* entry = reinterpret_cast<const TraceEntry*>(at);
+            auto corrupt = [&](string_view why) {
+                return runtime_error("Trace " + path + " is corrupt at byte " + to_string(at - static_cast<const char*>(mapping)) +
+                                     string(why));
+            };
+            if (static_cast<unsigned>(entry->kind) > static_cast<unsigned>(OpKind::Unit) ||
+                static_cast<unsigned>(entry->outcome) > static_cast<unsigned>(TraceOutcome::Failed)) {
+                throw corrupt("");
+            }
+            if (entry->size() > left) {
+                file->dropped = left;
+                break;
+            }
+            // The same checks as a wire frame: replay and formatting index tables with these fields
+            try {
+                BatchProcessor::validate(entry->operation());
+            } catch (const runtime_error& e) {
+                throw corrupt(string(": ") + e.what());
+            }
+            file->index.push_back(entry);
+            at += entry->size();
+        }
+        return file;
+    }
+
+    size_t size() const { return index.size(); }
+    const TraceEntry& operator[](size_t i) const { return *index[i]; }
+    int64_t started() const { return header->started; }
+
+    // Bytes of a partial last entry that were left out of the index
+    size_t droppedBytes() const { return dropped; }
+};
+
+// Replays a trace and checks every result against the captured one: numbers bit for bit, digits
+// and failure messages as text. Flat out, the entries are split into chunks on a WorkStealingPool
+// and latency is the time each operation took. Paced (speed > 0), the entries run in timestamp
+// order at speed times the recorded rate, dealt round robin to the threads; latency is then
+// measured from when an operation was due, so a replay that falls behind shows up as latency.
+class TraceReplayer {
+public:
+    struct Options {
+        double speed = 0.0;          // 0 runs flat out, 1 at the recorded pace, 2 twice as fast
+        size_t repeat = 1;           // passes over the trace (flat out only)
+        size_t maxMismatches = 20;   // reported in detail; all are counted
+    };
+
+    struct Mismatch {
+        size_t entry;
+        string input, expected, actual;
+    };
+
+    struct Report {
+        size_t operations = 0, mismatches = 0, failures = 0;
+        double seconds = 0.0;
+        StreamingStats latency;        // nanoseconds
+        StreamingStats capturedLatency;
+        vector<Mismatch> samples;
+
+        void write(BufferedWriter& out) const {
+            static constexpr double QS[] = {0.5, 0.9, 0.99, 0.999};
+            double values[4], captured[4];
+            latency.quantiles(QS, values);
+            capturedLatency.quantiles(QS, captured);
+            FieldReport report;
+            report.count("operations", operations).number("seconds", seconds)
+                  .number("ops_per_second", seconds > 0 ? static_cast<double>(operations) / seconds : 0.0)
+                  .count("failures", failures).count("mismatches", mismatches)
+                  .number("latency_mean_ns", latency.mean()).number("latency_p50_ns", values[0])
+                  .number("latency_p90_ns", values[1]).number("latency_p99_ns", values[2])
+                  .number("latency_p999_ns", values[3]).number("latency_max_ns", latency.max())
+                  .number("captured_p50_ns", captured[0]).number("captured_p99_ns", captured[2]);
+            report.write(out);
+        }
+    };
+
+private:
+    static constexpr size_t CHUNK_ENTRIES = 1024;
+    static constexpr int64_t SPIN_NANOS = 200000;   // waits shorter than this spin instead of sleeping
+
+    struct alignas(64) WorkerState {
+        StreamingStats latency, capturedLatency;
+        size_t operations = 0, mismatches = 0, failures = 0;
+        vector<Mismatch> samples;
+    };
+
+    WorkStealingPool pool;
+    vector<unique_ptr<WorkerState>> workers;
+
+    // Expressions typed in the menu carry up to two variable values in a and b, and their count in op
+    static OperationResult run(const Operation& op) {
+        if (op.kind == OpKind::Expression && op.op > 0) {
+            double values[2] = {op.a, op.b};
+            OperationResult r;
+            r.number = CompiledExpression(string(op.text)).evaluate(span<const double>(values, min<size_t>(op.op, 2)));
+            return r;
+        }
+        return BatchProcessor::evaluate(op);
+    }
+
+    static string describe(const TraceEntry& entry) {
+        return string(opKindName(entry.kind)) + " " + historyRecord(entry).inputText();
+    }
+
+    static string shown(TraceOutcome outcome, double number, string_view text) {
+        TextBuffer<256> value;
+        if (outcome == TraceOutcome::Number) value.appendGeneral(number, 17);
+        else if (outcome == TraceOutcome::Failed) value.append("error: ").append(text);
+        else value.append(text);
+        return string(value.view());
+    }
+
+    // Runs one entry and compares it with the capture; returns the time it finished
+    static int64_t replayOne(const TraceEntry& entry, size_t i, WorkerState& local, size_t maxMismatches) {
+        TraceOutcome outcome;
+        OperationResult r;
+        string message;
+        try {
+            r = run(entry.operation());
+            outcome = r.isText ? TraceOutcome::Text : TraceOutcome::Number;
+        } catch (const runtime_error& e) {
+            outcome = TraceOutcome::Failed;
+            message = e.what();
+            ++local.failures;
+        }
+        int64_t finished = TraceCapture::monotonic();
+        string_view text = outcome == TraceOutcome::Failed ? string_view(message) : string_view(r.text);
+        bool same = outcome == entry.outcome &&
+                    (outcome == TraceOutcome::Number ? bit_cast<uint64_t>(r.number) == bit_cast<uint64_t>(entry.result) ||
+                                                           (isnan(r.number) && isnan(entry.result))
+                                                     : text == entry.resultText());
+        if (!same) {
+            if (local.samples.size() < maxMismatches) {
+                local.samples.push_back({i, describe(entry), shown(entry.outcome, entry.result, entry.resultText()),
+                                         shown(outcome, r.number, text)});
+            }
+            ++local.mismatches;
+        }
+        ++local.operations;
+        local.capturedLatency.add(static_cast<double>(entry.nanos));
+        return finished;
+    }
+
+public:
+    explicit TraceReplayer(size_t threads = 1) : pool(threads) {
+        for (size_t i = 0; i < pool.size(); ++i) workers.push_back(make_unique<WorkerState>());
+    }
+
+    // The entry as a history record, for formatting its input the way the history shows it
+    static HistoryRecord historyRecord(const TraceEntry& entry) {
+        HistoryRecord record = HistoryRecord::make(entry.kind, entry.a, entry.b, entry.result);
+        record.op = entry.op;
+        record.from = entry.from;
+        record.to = entry.to;
+        record.fromUnit = entry.fromUnit;
+        record.toUnit = entry.toUnit;
+        record.setLabel(entry.text());
+        return record;
+    }
+
+    Report replay(const TraceFile& trace, const Options& options) {
+        for (auto& worker : workers) *worker = WorkerState();
+        auto begin = chrono::steady_clock::now();
+        if (options.speed <= 0) {
+            // Step 1a: Flat out, chunks of consecutive entries per task
+            size_t chunks = (trace.size() + CHUNK_ENTRIES - 1) / CHUNK_ENTRIES;
+            for (size_t pass = 0; pass < max<size_t>(options.repeat, 1); ++pass) {
+                pool.parallelFor(chunks, [&](size_t chunk, size_t worker) {
+                    WorkerState& local = *workers[worker];
+                    size_t end = min(trace.size(), (chunk + 1) * CHUNK_ENTRIES);
+                    for (size_t i = chunk * CHUNK_ENTRIES; i < end; ++i) {
+                        int64_t started = TraceCapture::monotonic();
+                        int64_t finished = replayOne(trace[i], i, local, options.maxMismatches);
+                        local.latency.add(static_cast<double>(finished - started));
+                    }
+                });
+            }
+        } else {
+            // Step 1b: At the recorded pace, in timestamp order, entry k going to thread k % threads
+            vector<uint32_t> order(trace.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<uint32_t>(i);
+            stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) { return trace[x].timestamp < trace[y].timestamp; });
+            int64_t first = order.empty() ? 0 : trace[order[0]].timestamp;
+            int64_t origin = TraceCapture::monotonic();
+            size_t stripes = pool.size();
+            pool.parallelFor(stripes, [&](size_t stripe, size_t worker) {
+                WorkerState& local = *workers[worker];
+                for (size_t k = stripe; k < order.size(); k += stripes) {
+                    const TraceEntry& entry = trace[order[k]];
+                    int64_t due = origin + static_cast<int64_t>(static_cast<double>(entry.timestamp - first) / options.speed);
+                    int64_t wait = due - TraceCapture::monotonic();
+                    if (wait > SPIN_NANOS) this_thread::sleep_for(chrono::nanoseconds(wait - SPIN_NANOS));
+                    while (TraceCapture::monotonic() < due) {
+                    }
+                    int64_t finished = replayOne(entry, order[k], local, options.maxMismatches);
+                    local.latency.add(static_cast<double>(finished - due));
+                }
+            });
+        }
+
+        // Step 2: Merge the workers' counts, latencies and samples
+        Report report;
+        report.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        for (auto& worker : workers) {
+            report.operations += worker->operations;
+            report.mismatches += worker->mismatches;
+            report.failures += worker->failures;
+            report.latency.merge(worker->latency);
+            report.capturedLatency.merge(worker->capturedLatency);
+            for (Mismatch& m : worker->samples) {
+                if (report.samples.size() < options.maxMismatches) report.samples.push_back(move(m));
+            }
+        }
+        sort(report.samples.begin(), report.samples.end(), [](const Mismatch& x, const Mismatch& y) { return x.entry < y.entry; });
+        return report;
+    }
+};
+
+}  // namespace techneon
@@ -0,0 +1,653 @@
+// Binary wire protocol, the epoll conversion server and its load generator
+#pragma once
+
+#include "techneon/batch.hpp"
+
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace techneon {
+
+using namespace std;
+
+// Binary protocol for the conversion server. Every frame is a u32 byte length followed by that
+// many bytes; all integers and doubles are little-endian.
+//   request:  u32 id, u16 count, then count operations
+//             operation = u8 kind, u8 op, u8 from, u8 to, i32 fromUnit, i32 toUnit, f64 a, f64 b,
+//                         u16 text length, text bytes (fields as in Operation)
+//   response: u32 id, u16 count, then count results in request order
+//             result = u8 status, then f64 (NUMBER) or u16 length + bytes (TEXT, ERROR)
+// A count above 1 makes a batch frame. Clients may pipeline requests; responses carry the request
+// id and can come back in a different order than the requests were sent.
+class WireProtocol {
+public:
+    static_assert(endian::native == endian::little, "the wire format is the in-memory layout");
+
+    static constexpr uint32_t MAX_FRAME = 1 << 20;
+    static constexpr size_t FRAME_HEADER = 10;      // length, id, count
+    enum Status : uint8_t { NUMBER = 0, TEXT = 1, ERROR = 2 };
+
+    // Bounds-checked cursor over one received frame
+    class Reader {
+    private:
+        const char* pos;
+        const char* end;
+
+    public:
+        explicit Reader(string_view bytes) : pos(bytes.data()), end(bytes.data() + bytes.size()) {}
+
+        template <typename T>
+        T get() {
+            if (static_cast<size_t>(end - pos) < sizeof(T)) throw runtime_error("Truncated frame");
+            T value;
+            memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        string_view bytes(size_t n) {
+            if (static_cast<size_t>(end - pos) < n) throw runtime_error("Truncated frame");
+            string_view view(pos, n);
+            pos += n;
+            return view;
+        }
+
+        bool done() const { return pos == end; }
+    };
+
+    template <typename T>
+    static void put(string& frame, T value) {
+        frame.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Length of the frame starting at bytes, or 0 while the length prefix is incomplete
+    static uint32_t frameLength(string_view bytes) {
+        if (bytes.size() < 4) return 0;
+        uint32_t length;
+        memcpy(&length, bytes.data(), 4);
+        if (length < FRAME_HEADER - 4 || length > MAX_FRAME) throw runtime_error("Invalid frame length");
+        return length + 4;
+    }
+
+    // Returns the offset to pass to endFrame once the body is written
+    static size_t beginFrame(string& frame, uint32_t id, uint16_t count) {
+        size_t start = frame.size();
+        put<uint32_t>(frame, 0);
+        put(frame, id);
+        put(frame, count);
+        return start;
+    }
+
+    static void endFrame(string& frame, size_t start) {
+        uint32_t length = static_cast<uint32_t>(frame.size() - start - 4);
+        memcpy(&frame[start], &length, 4);
+    }
+
+    static void putOperation(string& frame, const Operation& op) {
+        put(frame, static_cast<uint8_t>(op.kind));
+        put(frame, op.op);
+        put(frame, op.from);
+        put(frame, op.to);
+        put<int32_t>(frame, op.fromUnit);
+        put<int32_t>(frame, op.toUnit);
+        put(frame, op.a);
+        put(frame, op.b);
+        put(frame, static_cast<uint16_t>(min<size_t>(op.text.size(), UINT16_MAX)));
+        frame.append(op.text.substr(0, UINT16_MAX));
+    }
+
+    // The text of the operation points into the frame
+    static Operation getOperation(Reader& in) {
+        Operation op;
+        uint8_t kind = in.get<uint8_t>();
+        if (kind > static_cast<uint8_t>(OpKind::Unit)) throw runtime_error("Unknown operation kind " + to_string(kind));
+        op.kind = static_cast<OpKind>(kind);
+        op.op = in.get<char>();
+        op.from = in.get<char>();
+        op.to = in.get<char>();
+        op.fromUnit = in.get<int32_t>();
+        op.toUnit = in.get<int32_t>();
+        op.a = in.get<double>();
+        op.b = in.get<double>();
+        op.text = in.bytes(in.get<uint16_t>());
+        return op;
+    }
+
+    static void putResult(string& frame, const OperationResult& r) {
+        if (r.isText) {
+            putText(frame, TEXT, r.text);
+        } else {
+            put(frame, static_cast<uint8_t>(NUMBER));
+            put(frame, r.number);
+        }
+    }
+
+    static void putText(string& frame, Status status, string_view text) {
+        text = text.substr(0, UINT16_MAX);
+        put(frame, static_cast<uint8_t>(status));
+        put(frame, static_cast<uint16_t>(text.size()));
+        frame.append(text);
+    }
+
+    // Answers every request frame in frames (complete frames, back to back) into out
+    static void answer(string_view frames, string& out) {
+        while (!frames.empty()) {
+            uint32_t length = frameLength(frames);
+            Reader in(frames.substr(4, length - 4));
+            frames.remove_prefix(length);
+            uint32_t id = in.get<uint32_t>();
+            uint16_t count = in.get<uint16_t>();
+            size_t start = beginFrame(out, id, count);
+            try {
+                for (uint16_t i = 0; i < count; ++i) {
+                    Operation op = getOperation(in);
+                    // Any failure of one operation, allocation included, is that operation's answer:
+                    // nothing a client sends may take the server down
+                    try {
+                        BatchProcessor::validate(op);
+                        putResult(out, BatchProcessor::evaluate(op));
+                    } catch (const exception& e) {
+                        putText(out, ERROR, e.what());
+                    }
+                }
+                if (!in.done()) throw runtime_error("Trailing bytes in frame");
+            } catch (const runtime_error&) {
+                out.resize(start);   // the frames before this one are still answered
+                throw;
+            }
+            endFrame(out, start);
+        }
+    }
+};
+
+// Long-running server for the wire protocol on a Unix domain socket and optionally on a loopback
+// TCP port. One thread runs an epoll loop that accepts, reads and writes without blocking; the
+// complete frames from each read go to a fixed pool of workers as one job, and the workers hand
+// their responses back to the loop through an eventfd. Malformed frames close the connection.
+class ConversionServer {
+private:
+    static constexpr size_t MAX_PENDING_JOBS = 64;   // per connection; reading pauses beyond this
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+
+    struct Connection {
+        int fd;
+        string in;                   // received bytes not yet framed (loop thread)
+        string outgoing;             // being written to the socket (loop thread)
+        size_t sent = 0;
+        uint32_t events = 0;
+        bool eof = false;            // the peer stopped sending; close once everything is answered
+        mutex outLock;
+        string out;                  // responses from the workers, not yet picked up
+        atomic<size_t> pending{0};   // jobs queued or running
+        atomic<bool> queued{false};  // already on the ready list
+        atomic<bool> closed{false};
+
+        explicit Connection(int socket) : fd(socket) {}
+    };
+
+    struct Job {
+        shared_ptr<Connection> connection;
+        string frames;
+    };
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    vector<int> listeners;
+    string socketPath;
+    unordered_map<int, shared_ptr<Connection>> connections;
+
+    mutex jobLock;
+    condition_variable jobReady;
+    deque<Job> jobs;
+    bool stopping = false;
+    vector<thread> workers;
+
+    mutex readyLock;
+    vector<shared_ptr<Connection>> ready;
+
+    static atomic<int>& stopFd() {
+        static atomic<int> fd{-1};
+        return fd;
+    }
+
+    static void onSignal(int) {
+        uint64_t one = 1;
+        int fd = stopFd().load();
+        if (fd >= 0 && ::write(fd, &one, sizeof(one)) < 0) {}
+    }
+
+    static void check(bool ok, const string& what) {
+        if (!ok) throw runtime_error(what + ": " + strerror(errno));
+    }
+
+    void watch(int fd, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        check(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0, "epoll_ctl");
+    }
+
+    void listenOn(int fd, const sockaddr* address, socklen_t length, const string& name) {
+        check(fd >= 0, "socket");
+        listeners.push_back(fd);
+        check(::bind(fd, address, length) == 0, "Cannot bind " + name);
+        check(::listen(fd, SOMAXCONN) == 0, "listen");
+        watch(fd, EPOLLIN);
+    }
+
+    void workerLoop() {
+        while (true) {
+            Job job;
+            {
+                unique_lock<mutex> lock(jobLock);
+                jobReady.wait(lock, [&] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = move(jobs.front());
+                jobs.pop_front();
+            }
+            Connection& c = *job.connection;
+            string response;
+            bool ok = true;
+            try {
+                WireProtocol::answer(job.frames, response);
+            } catch (const exception&) {
+                ok = false;
+            }
+            {
+                lock_guard<mutex> lock(c.outLock);
+                c.out += response;
+            }
+            if (!ok) c.closed = true;
+            c.pending.fetch_sub(1);
+            if (!c.queued.exchange(true)) {
+                lock_guard<mutex> lock(readyLock);
+                ready.push_back(move(job.connection));
+            }
+            uint64_t one = 1;
+            if (::write(wakeFd, &one, sizeof(one)) < 0) {}
+        }
+    }
+
+    void accept(int listener) {
+        while (true) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;   // EAGAIN, or a connection that failed before we got to it
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   // fails harmlessly on Unix sockets
+            auto c = make_shared<Connection>(fd);
+            c->events = EPOLLIN | EPOLLRDHUP;
+            watch(fd, c->events);
+            connections.emplace(fd, move(c));
+        }
+    }
+
+    void close(Connection& c) {
+        c.closed = true;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+        ::close(c.fd);
+        connections.erase(c.fd);   // workers still holding the connection keep it alive
+    }
+
+    // Reads everything available and queues the complete frames as one job; false on a read
+    // error or a malformed frame
+    bool receive(const shared_ptr<Connection>& c) {
+        char chunk[READ_CHUNK];
+        while (true) {
+            ssize_t got = ::read(c->fd, chunk, sizeof(chunk));
+            if (got > 0) {
+                c->in.append(chunk, static_cast<size_t>(got));
+                continue;
+            }
+            if (got == 0) {
+                c->eof = true;
+                break;
+            }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        size_t complete = 0;
+        try {
+            while (uint32_t length = WireProtocol::frameLength(string_view(c->in).substr(complete))) {
+                if (c->in.size() - complete < length) break;
+                complete += length;
+            }
+        } catch (const runtime_error&) {
+            return false;
+        }
+        if (complete == 0) return true;
+        Job job{c, c->in.substr(0, complete)};
+        c->in.erase(0, complete);
+        c->pending.fetch_add(1);
+        {
+            lock_guard<mutex> lock(jobLock);
+            jobs.push_back(move(job));
+        }
+        jobReady.notify_one();
+        return true;
+    }
+
+    // Writes as much output as the socket takes; false when the connection broke
+    bool transmit(Connection& c) {
+        {
+            lock_guard<mutex> lock(c.outLock);
+            if (c.outgoing.empty()) c.outgoing.swap(c.out);
+            else c.outgoing += c.out;
+            c.out.clear();
+        }
+        while (c.sent < c.outgoing.size()) {
+            ssize_t put = ::send(c.fd, c.outgoing.data() + c.sent, c.outgoing.size() - c.sent, MSG_NOSIGNAL);
+            if (put > 0) {
+                c.sent += static_cast<size_t>(put);
+            } else if (put < 0 && errno == EINTR) {
+                continue;
+            } else if (put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                return false;
+            }
+        }
+        if (c.sent == c.outgoing.size()) {
+            c.outgoing.clear();
+            c.sent = 0;
+        }
+        return true;
+    }
+
+    bool finished(Connection& c) {
+        if (!c.eof && !c.closed) return false;
+        lock_guard<mutex> lock(c.outLock);
+        return c.pending.load() == 0 && c.out.empty() && c.outgoing.empty();
+    }
+
+    // Read while the connection has few jobs in flight, write while output is waiting
+    void rearm(Connection& c) {
+        uint32_t events = 0;
+        if (!c.eof && !c.closed && c.pending.load() < MAX_PENDING_JOBS) events |= EPOLLIN | EPOLLRDHUP;
+        if (!c.outgoing.empty()) events |= EPOLLOUT;
+        if (events == c.events) return;
+        c.events = events;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = c.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+
+    void serviceReady() {
+        uint64_t count;
+        if (::read(wakeFd, &count, sizeof(count)) < 0) {}
+        vector<shared_ptr<Connection>> batch;
+        {
+            lock_guard<mutex> lock(readyLock);
+            batch.swap(ready);
+        }
+        for (auto& c : batch) {
+            c->queued = false;
+            auto it = connections.find(c->fd);
+            if (it == connections.end() || it->second != c) continue;   // already closed
+            if (!transmit(*c) || finished(*c)) close(*c);
+            else rearm(*c);
+        }
+    }
+
+public:
+    ConversionServer(const string& path, int tcpPort, size_t threads) : socketPath(path) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        check(epollFd >= 0, "epoll_create1");
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        check(wakeFd >= 0, "eventfd");
+        watch(wakeFd, EPOLLIN);
+
+        // Step 1: Unix socket; a stale socket file from an earlier run is replaced
+        sockaddr_un local{};
+        local.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(local.sun_path)) throw runtime_error("Socket path too long: " + path);
+        memcpy(local.sun_path, path.c_str(), path.size() + 1);
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) unlink(path.c_str());
+        listenOn(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0),
+                 reinterpret_cast<sockaddr*>(&local), sizeof(local), path);
+
+        // Step 2: Optional loopback TCP port
+        if (tcpPort > 0) {
+            int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int one = 1;
+            if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in loopback{};
+            loopback.sin_family = AF_INET;
+            loopback.sin_port = htons(static_cast<uint16_t>(tcpPort));
+            loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            listenOn(fd, reinterpret_cast<sockaddr*>(&loopback), sizeof(loopback), "127.0.0.1:" + to_string(tcpPort));
+        }
+
+        // Step 3: Workers
+        for (size_t i = 0; i < max<size_t>(threads, 1); ++i) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ConversionServer() {
+        {
+            lock_guard<mutex> lock(jobLock);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (thread& t : workers) t.join();
+        for (auto& entry : connections) ::close(entry.first);
+        for (int fd : listeners) ::close(fd);
+        unlink(socketPath.c_str());
+        ::close(wakeFd);
+        ::close(epollFd);
+    }
+
+    // Serves until SIGINT or SIGTERM
+    void run() {
+        int stop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        check(stop >= 0, "eventfd");
+        watch(stop, EPOLLIN);
+        stopFd() = stop;
+        signal(SIGINT, onSignal);
+        signal(SIGTERM, onSignal);
+        signal(SIGPIPE, SIG_IGN);
+
+        epoll_event events[256];
+        bool running = true;
+        while (running) {
+            int n = epoll_wait(epollFd, events, 256, -1);
+            if (n < 0 && errno == EINTR) continue;
+            check(n >= 0, "epoll_wait");
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == stop) {
+                    running = false;
+                } else if (fd == wakeFd) {
+                    serviceReady();
+                } else if (find(listeners.begin(), listeners.end(), fd) != listeners.end()) {
+                    accept(fd);
+                } else {
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) continue;
+                    shared_ptr<Connection> c = it->second;
+                    bool ok = true;
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ok = receive(c);
+                    if (ok && (events[i].events & EPOLLOUT)) ok = transmit(*c);
+                    if (ok && !finished(*c)) rearm(*c);
+                    else close(*c);
+                }
+            }
+        }
+        stopFd() = -1;
+        ::close(stop);
+    }
+};
+
+// Load generator for ConversionServer: each connection runs on its own thread and keeps a fixed
+// number of requests in flight, and the latency of every request is recorded. Addresses are a
+// Unix socket path or tcp:<port> for the loopback port.
+class LoadGenerator {
+private:
+    static constexpr const char* SAMPLES[] = {
+        "calc 3.5 ^ 2.25", "calc 30 S", "log 12345.678 N", "temp 98.6 F C", "len 12 F M", "curr 100 I U",
+        "unit 3 mi km", "base 1777777 O H", "radix 123456789012345678901234567890 10 36",
+        "expr 2 * (3 + 4) ^ 2 - sin(30)",
+    };
+
+    struct Totals {
+        vector<int64_t> latencies;   // nanoseconds, one per request
+        size_t operations = 0, errors = 0;
+    };
+
+    static int connectTo(const string& address) {
+        int fd;
+        if (address.rfind("tcp:", 0) == 0) {
+            fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_in loopback{};
+            loopback.sin_family = AF_INET;
+            loopback.sin_port = htons(static_cast<uint16_t>(strtoul(address.c_str() + 4, nullptr, 10)));
+            loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&loopback), sizeof(loopback)) != 0) {
+                int error = errno;
+                ::close(fd);
+                fd = -1;
+                errno = error;
+            }
+            int one = 1;
+            if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        } else {
+            fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_un local{};
+            local.sun_family = AF_UNIX;
+            strncpy(local.sun_path, address.c_str(), sizeof(local.sun_path) - 1);
+            if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+                int error = errno;
+                ::close(fd);
+                fd = -1;
+                errno = error;
+            }
+        }
+        if (fd < 0) throw runtime_error("Cannot connect to " + address + ": " + strerror(errno));
+        return fd;
+    }
+
+    static int64_t now() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // One connection: requests frames, pipeline in flight at a time
+    static void drive(const string& address, const vector<string>& templates, size_t requests, size_t pipeline, Totals& totals) {
+        int fd = connectTo(address);
+        vector<int64_t> sentAt(requests);
+        string sendBuffer, received;
+        size_t nextId = 0, done = 0;
+        auto queue = [&](size_t count) {
+            for (; count > 0 && nextId < requests; --count, ++nextId) {
+                const string& frame = templates[nextId % templates.size()];
+                size_t start = sendBuffer.size();
+                sendBuffer += frame;
+                uint32_t id = static_cast<uint32_t>(nextId);
+                memcpy(&sendBuffer[start + 4], &id, 4);
+                sentAt[nextId] = now();
+            }
+            for (size_t off = 0; off < sendBuffer.size();) {
+                ssize_t put = ::send(fd, sendBuffer.data() + off, sendBuffer.size() - off, MSG_NOSIGNAL);
+                if (put <= 0) throw runtime_error("Connection lost while sending");
+                off += static_cast<size_t>(put);
+            }
+            sendBuffer.clear();
+        };
+        queue(pipeline);
+        char chunk[64 * 1024];
+        while (done < requests) {
+            ssize_t got = ::read(fd, chunk, sizeof(chunk));
+            if (got <= 0) throw runtime_error("Connection closed by server");
+            received.append(chunk, static_cast<size_t>(got));
+            size_t offset = 0, answered = 0;
+            while (uint32_t length = WireProtocol::frameLength(string_view(received).substr(offset))) {
+                if (received.size() - offset < length) break;
+                WireProtocol::Reader in(string_view(received).substr(offset + 4, length - 4));
+                uint32_t id = in.get<uint32_t>();
+                uint16_t count = in.get<uint16_t>();
+                int64_t finished = now();
+                if (id >= requests) throw runtime_error("Unexpected response id");
+                totals.latencies.push_back(finished - sentAt[id]);
+                totals.operations += count;
+                for (uint16_t i = 0; i < count; ++i) {
+                    uint8_t status = in.get<uint8_t>();
+                    if (status == WireProtocol::NUMBER) in.get<double>();
+                    else in.bytes(in.get<uint16_t>());
+                    if (status == WireProtocol::ERROR) ++totals.errors;
+                }
+                offset += length;
+                ++answered;
+            }
+            received.erase(0, offset);
+            done += answered;
+            queue(answered);
+        }
+        ::close(fd);
+    }
+
+public:
+    static void run(const string& address, size_t connections, size_t requests, size_t pipeline, size_t batch) {
+        signal(SIGPIPE, SIG_IGN);
+        batch = clamp<size_t>(batch, 1, UINT16_MAX);
+        // Step 1: Encode request frames once; each cycles through the samples batch operations at a time
+        size_t sampleCount = sizeof(SAMPLES) / sizeof(SAMPLES[0]);
+        vector<string> templates;
+        for (size_t t = 0; t < sampleCount; ++t) {
+            string frame;
+            size_t start = WireProtocol::beginFrame(frame, 0, static_cast<uint16_t>(batch));
+            for (size_t i = 0; i < batch; ++i) {
+                WireProtocol::putOperation(frame, BatchProcessor::parse(SAMPLES[(t + i) % sampleCount]));
+            }
+            WireProtocol::endFrame(frame, start);
+            templates.push_back(move(frame));
+        }
+        // Step 2: Run the connections
+        connections = max<size_t>(connections, 1);
+        size_t perConnection = max<size_t>(requests / connections, 1);
+        vector<Totals> totals(connections);
+        vector<thread> threads;
+        string failure;
+        mutex failureLock;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < connections; ++i) {
+            threads.emplace_back([&, i] {
+                try {
+                    drive(address, templates, perConnection, max<size_t>(pipeline, 1), totals[i]);
+                } catch (const runtime_error& e) {
+                    lock_guard<mutex> lock(failureLock);
+                    failure = e.what();
+                }
+            });
+        }
+        for (thread& t : threads) t.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (!failure.empty()) throw runtime_error(failure);
+        // Step 3: Merge and report
+        vector<int64_t> latencies;
+        size_t operations = 0, errors = 0;
+        for (Totals& t : totals) {
+            latencies.insert(latencies.end(), t.latencies.begin(), t.latencies.end());
+            operations += t.operations;
+            errors += t.errors;
+        }
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies.empty() ? 0.0 : latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))] / 1e3;
+        };
+        cout << "Load test against " << address << ": " << connections << " connections, pipeline " << pipeline
+             << ", batch " << batch << "\n"
+             << right << setw(10) << "requests" << setw(12) << "req/s" << setw(12) << "ops/s" << setw(10) << "p50 us"
+             << setw(10) << "p99 us" << setw(10) << "p999 us" << setw(8) << "errors" << "\n"
+             << fixed << setprecision(0) << setw(10) << latencies.size() << setw(12) << latencies.size() / seconds
+             << setw(12) << operations / seconds << setprecision(1) << setw(10) << percentile(0.5)
+             << setw(10) << percentile(0.99) << setw(10) << percentile(0.999) << setw(8) << errors << "\n";
+    }
+};
+
+}  // namespace techneon
@@ -0,0 +1,424 @@
+// Named cells holding numbers, formulas or operation lines, kept up to date through a dependency graph
+#pragma once
+
+#include "techneon/batch.hpp"
+
+#include <atomic>
+
+namespace techneon {
+
+using namespace std;
+
+// A session's named values. A cell is an input (a number), a formula over other cells
+// ("2 * rate + fee") or a batch operation line whose operands name cells ("temp base C F").
+// Every cell knows its inputs and its dependents; the graph is kept acyclic by rejecting any
+// definition that would reach its own cell. After an edit only the cells downstream of it are
+// recomputed, one topological wavefront at a time: a wavefront's cells depend only on earlier
+// ones, so a wide wavefront is spread over a WorkStealingPool. A cell whose inputs all came out
+// unchanged is skipped without being evaluated, and so is everything below it.
+class Sheet {
+public:
+    enum class State : unsigned char {
+        Undefined,   // named by a formula but never given a value
+        Value,
+        Error,       // its own evaluation failed
+        Blocked      // an input has no value
+    };
+
+    enum class Kind : unsigned char { Input, Formula, Operation };
+
+    struct UpdateStats {
+        size_t affected = 0;     // cells downstream of the edit, the edited one included
+        size_t recomputed = 0;   // of those, the ones actually evaluated
+        size_t levels = 0;       // topological wavefronts
+        double seconds = 0.0;
+    };
+
+private:
+    static constexpr size_t PARALLEL_LEVEL = 256;   // smaller wavefronts run on the calling thread
+    static constexpr size_t CHUNK_CELLS = 128;
+    static constexpr size_t LOCAL_ARGS = 16;
+
+    // An operation line with every cell name in an operand field replaced by 0; refs are the
+    // slots in the cell's inputs that supply op.a and op.b, or -1 for a literal operand
+    struct OperationCell {
+        string source;
+        string line;   // op.text points into it
+        Operation op;
+        int refs[2] = {-1, -1};
+    };
+
+    // What an update touches comes first; names live apart, they are only read for display
+    struct Cell {
+        double value = 0.0;
+        State state = State::Undefined;
+        Kind kind = Kind::Input;
+        int pending = 0;          // affected inputs not yet refreshed in the current update
+        vector<int> inputs;       // formula variables in slot order, or operation operands
+        vector<int> dependents;   // cells with this one among their inputs, each listed once
+        uint64_t visited = 0, dirty = 0, changed = 0;   // epochs of the last search, edit and value change
+        unique_ptr<CompiledExpression> formula;
+        unique_ptr<OperationCell> operation;
+    };
+
+    vector<Cell> cells;
+    vector<string> names;
+    unordered_map<string, int> index;
+    unordered_map<int, string> errors;   // messages of cells in the Error state
+    mutex errorLock;
+    uint64_t epoch = 0;
+    WorkStealingPool pool;
+    vector<int> affected, level, next, search;
+    UpdateStats stats;
+
+    static bool isNameStart(char c) { return isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+
+    static string_view trim(string_view text) {
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == string_view::npos) return {};
+        return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+    }
+
+    static uint64_t bits(double value) {
+        uint64_t b;
+        memcpy(&b, &value, sizeof b);
+        return b;
+    }
+
+    // Names must read as formula variables, and not as commands, functions or constants
+    static void checkName(string_view name) {
+        static constexpr string_view RESERVED[] = {"calc", "temp", "base", "log", "curr", "len", "radix", "unit", "expr",
+                                                   "sin", "cos", "tan", "ln", "log2", "pi", "e"};
+        bool valid = !name.empty() && isNameStart(name[0]) &&
+                     all_of(name.begin(), name.end(), [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+        if (!valid) throw runtime_error("Invalid cell name '" + string(name) + "'");
+        if (std::find(begin(RESERVED), end(RESERVED), name) != end(RESERVED)) {
+            throw runtime_error("'" + string(name) + "' is reserved and can't name a cell");
+        }
+    }
+
+    static bool isOperation(string_view text) {
+        static constexpr string_view COMMANDS[] = {"calc", "temp", "base", "log", "curr", "len", "radix", "unit"};
+        size_t space = text.find_first_of(" \t");
+        return space != string_view::npos && std::find(begin(COMMANDS), end(COMMANDS), text.substr(0, space)) != end(COMMANDS);
+    }
+
+    // Step 1 of a definition: the numeric operand fields (1 and, for calc, 3) may name cells
+    static unique_ptr<OperationCell> compileOperation(string_view text, vector<string>& references) {
+        auto cell = make_unique<OperationCell>();
+        cell->source = string(text);
+        vector<string> tokens;
+        for (size_t i = 0; i < text.size();) {
+            size_t start = text.find_first_not_of(" \t", i);
+            if (start == string_view::npos) break;
+            i = min(text.find_first_of(" \t", start), text.size());
+            tokens.emplace_back(text.substr(start, i - start));
+        }
+        if (tokens[0] == "base" || tokens[0] == "radix") {
+            throw runtime_error("Number base and radix results are digits; sheet cells hold numbers");
+        }
+        const size_t fields[2] = {1, tokens[0] == "calc" ? size_t(3) : size_t(0)};
+        for (int k = 0; k < 2; ++k) {
+            size_t f = fields[k];
+            if (f == 0 || f >= tokens.size() || !isNameStart(tokens[f][0])) continue;
+            cell->refs[k] = static_cast<int>(references.size());
+            references.push_back(tokens[f]);
+            tokens[f] = "0";
+        }
+        for (const string& token : tokens) cell->line.append(token).append(" ");
+        string_view field;
+        ParseStatus status = BatchProcessor::tryParse(cell->line, cell->op, field);
+        if (status != ParseStatus::Ok) {
+            TextBuffer<192> message;
+            BatchProcessor::describe(status, field, message);
+            throw runtime_error(string(message.view()));
+        }
+        return cell;
+    }
+
+    // The cell named so, created undefined when nothing has named it yet
+    int resolve(const string& name) {
+        auto it = index.find(name);
+        if (it != index.end()) return it->second;
+        int id = static_cast<int>(cells.size());
+        cells.emplace_back();
+        names.push_back(name);
+        index.emplace(name, id);
+        return id;
+    }
+
+    // Marks every cell downstream of id (id included) with a fresh epoch
+    void markDownstream(int id) {
+        ++epoch;
+        search.assign(1, id);
+        cells[id].visited = epoch;
+        while (!search.empty()) {
+            int current = search.back();
+            search.pop_back();
+            for (int d : cells[current].dependents) {
+                if (cells[d].visited == epoch) continue;
+                cells[d].visited = epoch;
+                search.push_back(d);
+            }
+        }
+    }
+
+    // Drops id from its inputs' dependent lists and forgets its definition
+    void detach(int id) {
+        Cell& cell = cells[id];
+        for (int input : cell.inputs) {
+            vector<int>& list = cells[input].dependents;
+            auto it = std::find(list.begin(), list.end(), id);
+            if (it != list.end()) {
+                *it = list.back();
+                list.pop_back();
+            }
+        }
+        cell.inputs.clear();
+        cell.formula.reset();
+        cell.operation.reset();
+        cell.kind = Kind::Input;
+    }
+
+    // Evaluates a cell if it was edited or an input changed in this update; returns whether it ran
+    bool refresh(int id) {
+        Cell& cell = cells[id];
+        if (cell.dirty != epoch &&
+            none_of(cell.inputs.begin(), cell.inputs.end(), [&](int input) { return cells[input].changed == epoch; })) {
+            return false;
+        }
+        if (cell.kind == Kind::Input) {
+            cell.changed = epoch;   // set() or erase() already stored the new value
+            return false;
+        }
+        double local[LOCAL_ARGS];
+        vector<double> heap;
+        double* args = local;
+        if (cell.inputs.size() > LOCAL_ARGS) {
+            heap.resize(cell.inputs.size());
+            args = heap.data();
+        }
+        State state = State::Value;
+        double value = 0.0;
+        for (size_t i = 0; i < cell.inputs.size(); ++i) {
+            const Cell& input = cells[cell.inputs[i]];
+            if (input.state != State::Value) {
+                state = State::Blocked;
+                break;
+            }
+            args[i] = input.value;
+        }
+        if (state == State::Value) {
+            try {
+                if (cell.formula) {
+                    value = cell.formula->evaluate(span<const double>(args, cell.inputs.size()));
+                } else {
+                    Operation op = cell.operation->op;
+                    if (cell.operation->refs[0] >= 0) op.a = args[cell.operation->refs[0]];
+                    if (cell.operation->refs[1] >= 0) op.b = args[cell.operation->refs[1]];
+                    value = BatchProcessor::evaluate(op).number;
+                }
+            } catch (const runtime_error& e) {
+                state = State::Error;
+                lock_guard<mutex> lock(errorLock);
+                errors[id] = e.what();
+            }
+        }
+        if (cell.state == State::Error && state != State::Error) {
+            lock_guard<mutex> lock(errorLock);
+            errors.erase(id);
+        }
+        if (state != cell.state || (state == State::Value && bits(value) != bits(cell.value))) cell.changed = epoch;
+        cell.state = state;
+        cell.value = value;
+        return true;
+    }
+
+    // Recomputes what depends on the edited cell, in topological wavefronts
+    void update(int edited) {
+        auto start = chrono::steady_clock::now();
+        stats = {};
+        // Step 1: Collect everything downstream, breadth first, counting each cell's inputs inside
+        // that set; the edited cell has none, the graph being acyclic
+        ++epoch;
+        cells[edited].dirty = epoch;
+        affected.assign(1, edited);
+        cells[edited].visited = epoch;
+        cells[edited].pending = 0;
+        for (size_t i = 0; i < affected.size(); ++i) {
+            for (int d : cells[affected[i]].dependents) {
+                Cell& cell = cells[d];
+                if (cell.visited != epoch) {
+                    cell.visited = epoch;
+                    cell.pending = 0;
+                    affected.push_back(d);
+                }
+                ++cell.pending;
+            }
+        }
+        // Step 2: Refresh one wavefront at a time; a cell joins the next once all its affected inputs are done
+        atomic<size_t> recomputed{0};
+        auto release = [&](int id) {
+            for (int d : cells[id].dependents) {
+                if (--cells[d].pending == 0) next.push_back(d);
+            }
+        };
+        level.assign(1, edited);
+        while (!level.empty()) {
+            ++stats.levels;
+            next.clear();
+            if (level.size() >= PARALLEL_LEVEL && pool.size() > 1) {
+                pool.parallelFor((level.size() + CHUNK_CELLS - 1) / CHUNK_CELLS, [&](size_t chunk, size_t) {
+                    size_t begin = chunk * CHUNK_CELLS, end = min(level.size(), begin + CHUNK_CELLS), count = 0;
+                    for (size_t i = begin; i < end; ++i) count += refresh(level[i]);
+                    recomputed.fetch_add(count, memory_order_relaxed);
+                });
+                for (int id : level) release(id);
+            } else {
+                size_t count = 0;
+                for (int id : level) {
+                    count += refresh(id);
+                    release(id);
+                }
+                recomputed.fetch_add(count, memory_order_relaxed);
+            }
+            swap(level, next);
+        }
+        stats.affected = affected.size();
+        stats.recomputed = recomputed.load();
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+public:
+    explicit Sheet(size_t threads = max<size_t>(thread::hardware_concurrency(), 1)) : pool(threads) {}
+
+    // "42" makes an input, "temp price C F" an operation cell and anything else a formula;
+    // a leading "expr " is accepted for symmetry with batch lines
+    void assign(const string& name, string_view text) {
+        text = trim(text);
+        if (text.empty()) throw runtime_error("Nothing to assign to '" + name + "'");
+        double number;
+        if (NumberParser::parseDouble(text, number) == ParseStatus::Ok) set(name, number);
+        else define(name, text);
+    }
+
+    void set(const string& name, double value) {
+        checkName(name);
+        int id = resolve(name);
+        detach(id);
+        Cell& cell = cells[id];
+        if (cell.state == State::Value && bits(cell.value) == bits(value)) {
+            stats = {};
+            return;
+        }
+        cell.state = State::Value;
+        cell.value = value;
+        update(id);
+    }
+
+    void define(const string& name, string_view text) {
+        checkName(name);
+        text = trim(text);
+        if (text.substr(0, 5) == "expr " || text.substr(0, 5) == "expr\t") text = trim(text.substr(5));
+        // Step 1: Compile first, so a bad definition leaves the sheet as it was
+        vector<string> references;
+        unique_ptr<CompiledExpression> formula;
+        unique_ptr<OperationCell> operation;
+        if (isOperation(text)) {
+            operation = compileOperation(text, references);
+        } else {
+            formula = make_unique<CompiledExpression>(string(text));
+            references = formula->variables();
+        }
+        // Step 2: Reject a definition whose inputs are the cell itself or already downstream of it, or
+        // that names a cell no assignment could ever give a value
+        for (const string& input : references) checkName(input);
+        auto existing = index.find(name);
+        if (existing != index.end()) markDownstream(existing->second);
+        for (const string& input : references) {
+            auto it = index.find(input);
+            if (input == name || (existing != index.end() && it != index.end() && cells[it->second].visited == epoch)) {
+                throw runtime_error("Circular reference: '" + name + "' would depend on itself through '" + input + "'");
+            }
+        }
+        // Step 3: Rewire the graph and recompute downstream
+        int id = resolve(name);
+        vector<int> inputs;
+        for (const string& input : references) inputs.push_back(resolve(input));
+        detach(id);
+        Cell& cell = cells[id];
+        cell.inputs = inputs;
+        sort(inputs.begin(), inputs.end());
+        inputs.erase(unique(inputs.begin(), inputs.end()), inputs.end());
+        for (int input : inputs) cells[input].dependents.push_back(id);
+        cell.kind = formula ? Kind::Formula : Kind::Operation;
+        cell.formula = move(formula);
+        cell.operation = move(operation);
+        update(id);
+    }
+
+    // The cell loses its definition; cells that use it stay, blocked until it is assigned again
+    void erase(const string& name) {
+        int id = find(name);
+        if (id < 0 || cells[id].state == State::Undefined) throw runtime_error("Unknown cell '" + name + "'");
+        detach(id);
+        Cell& cell = cells[id];
+        if (cell.state == State::Error) errors.erase(id);
+        cell.state = State::Undefined;
+        update(id);
+    }
+
+    int find(const string& name) const {
+        auto it = index.find(name);
+        return it == index.end() ? -1 : it->second;
+    }
+
+    size_t size() const { return cells.size(); }
+    const string& name(int id) const { return names[id]; }
+    Kind kind(int id) const { return cells[id].kind; }
+    State state(int id) const { return cells[id].state; }
+    double value(int id) const { return cells[id].value; }
+
+    // Formula or operation text; empty for inputs
+    string_view definition(int id) const {
+        const Cell& cell = cells[id];
+        if (cell.formula) return cell.formula->text();
+        if (cell.operation) return cell.operation->source;
+        return {};
+    }
+
+    // Why a cell has no value
+    string error(int id) const {
+        const Cell& cell = cells[id];
+        switch (cell.state) {
+            case State::Value: return {};
+            case State::Undefined: return "'" + names[id] + "' is not defined";
+            case State::Error: return errors.at(id);
+            case State::Blocked:
+                for (int input : cell.inputs) {
+                    if (cells[input].state != State::Value) return "Depends on '" + names[input] + "', which has no value";
+                }
+        }
+        return {};
+    }
+
+    double value(const string& name) const {
+        int id = find(name);
+        if (id < 0) throw runtime_error("Unknown cell '" + name + "'");
+        if (cells[id].state != State::Value) throw runtime_error(error(id));
+        return cells[id].value;
+    }
+
+    // Cells in definition order, skipping erased ones nothing refers to
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t id = 0; id < cells.size(); ++id) {
+            if (cells[id].state == State::Undefined && cells[id].dependents.empty()) continue;
+            fn(static_cast<int>(id));
+        }
+    }
+
+    const UpdateStats& lastUpdate() const { return stats; }
+};
+
+}  // namespace techneon
@@ -0,0 +1,379 @@
+// Numeric solvers over compiled expressions: bracketed and Newton root finding, adaptive integration
+#pragma once
+
+#include <optional>
+#include "techneon/batch.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+// Roots of a one-variable expression. brent() keeps a sign-changing bracket and mixes inverse
+// quadratic interpolation, secant and bisection steps, so it always converges once it has a
+// bracket; newton() starts from one point with a central-difference derivative and hands over to
+// brent() as soon as two iterates straddle the root.
+class RootFinder {
+public:
+    struct Result {
+        double root = 0.0, value = 0.0;
+        size_t evaluations = 0, iterations = 0;
+        double seconds = 0.0;
+        string_view method;
+        bool converged = false;
+
+        void write(BufferedWriter& out) const {
+            FieldReport report;
+            report.number("root", root).number("value", value).count("evaluations", evaluations)
+                  .count("iterations", iterations).number("seconds", seconds).text("method", method)
+                  .flag("converged", converged);
+            report.write(out);
+        }
+    };
+
+private:
+    static constexpr size_t SCAN_POINTS = 256;   // samples taken when [a, b] has no sign change
+
+    CompiledExpression compiled;
+    double tolerance;
+    size_t maxIterations;
+    size_t evaluations = 0;
+    array<double, 1> argument{};
+
+    double f(double x) {
+        ++evaluations;
+        argument[0] = x;
+        return compiled.evaluate(argument);
+    }
+
+    // Narrows [a, b] to the first sample interval with a sign change, evaluating the samples as one column
+    bool scan(double& a, double& b, double& fa, double& fb) {
+        array<double, SCAN_POINTS + 1> xs, ys;
+        for (size_t i = 0; i <= SCAN_POINTS; ++i) xs[i] = a + (b - a) * static_cast<double>(i) / SCAN_POINTS;
+        compiled.evaluateColumn(xs, ys);
+        evaluations += xs.size();
+        for (size_t i = 0; i < SCAN_POINTS; ++i) {
+            if (ys[i] == 0.0 || ys[i + 1] == 0.0 || signbit(ys[i]) != signbit(ys[i + 1])) {
+                a = xs[i], b = xs[i + 1], fa = ys[i], fb = ys[i + 1];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Brent's zeroin on a bracket with fa and fb of opposite signs (or one of them zero)
+    Result refine(double a, double b, double fa, double fb, size_t iterations) {
+        Result result;
+        double c = a, fc = fa, d = b - a, e = d;
+        for (; iterations < maxIterations; ++iterations) {
+            // Step 1: Keep b the best estimate and c on the other side of the root
+            if ((fb > 0) == (fc > 0) && fb != 0.0) {
+                c = a, fc = fa;
+                d = e = b - a;
+            }
+            if (fabs(fc) < fabs(fb)) {
+                a = b, b = c, c = a;
+                fa = fb, fb = fc, fc = fa;
+            }
+            double tol = 2.0 * numeric_limits<double>::epsilon() * fabs(b) + 0.5 * tolerance;
+            double m = 0.5 * (c - b);
+            if (fabs(m) <= tol || fb == 0.0) {
+                result.converged = true;
+                break;
+            }
+
+            // Step 2: Interpolate when the last steps shrank fast enough, otherwise bisect
+            if (fabs(e) >= tol && fabs(fa) > fabs(fb)) {
+                double s = fb / fa, p, q;
+                if (a == c) {
+                    p = 2.0 * m * s;
+                    q = 1.0 - s;
+                } else {
+                    double r = fb / fc, t = fa / fc;
+                    p = s * (2.0 * m * t * (t - r) - (b - a) * (r - 1.0));
+                    q = (t - 1.0) * (r - 1.0) * (s - 1.0);
+                }
+                if (p > 0) q = -q;
+                else p = -p;
+                if (2.0 * p < min(3.0 * m * q - fabs(tol * q), fabs(e * q))) {
+                    e = d;
+                    d = p / q;
+                } else {
+                    d = e = m;
+                }
+            } else {
+                d = e = m;
+            }
+
+            // Step 3: Step by at least tol so the bracket keeps shrinking
+            a = b, fa = fb;
+            b += fabs(d) > tol ? d : (m > 0 ? tol : -tol);
+            fb = f(b);
+        }
+        result.root = b;
+        result.value = fb;
+        result.iterations = iterations;
+        return result;
+    }
+
+public:
+    // tolerance is absolute on x; the expression must have at most one variable
+    explicit RootFinder(const string& expression, double tolerance = 1e-12, size_t maxIterations = 200)
+        : compiled(expression), tolerance(tolerance), maxIterations(maxIterations) {
+        if (compiled.variables().size() > 1) throw runtime_error("Root finding needs at most one variable");
+        if (!(tolerance > 0)) throw runtime_error("Tolerance must be positive");
+    }
+
+    Result brent(double a, double b) {
+        auto start = chrono::steady_clock::now();
+        evaluations = 0;
+        if (!(a < b)) throw runtime_error("Bracket must have a < b");
+        double fa = f(a), fb = f(b);
+        if (fa != 0.0 && fb != 0.0 && signbit(fa) == signbit(fb) && !scan(a, b, fa, fb)) {
+            throw runtime_error("No sign change found in [a, b]");
+        }
+        Result result = refine(a, b, fa, fb, 0);
+        result.method = "brent";
+        result.evaluations = evaluations;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    Result newton(double x) {
+        auto start = chrono::steady_clock::now();
+        evaluations = 0;
+        Result result;
+        result.method = "newton";
+        double fx = f(x);
+        size_t iteration = 0;
+        for (; iteration < maxIterations && fx != 0.0; ++iteration) {
+            // Step 1: Central difference, with h scaled to x so it stays above rounding noise
+            double h = cbrt(numeric_limits<double>::epsilon()) * max(1.0, fabs(x));
+            double slope = (f(x + h) - f(x - h)) / (2.0 * h);
+            if (slope == 0.0 || !isfinite(slope)) throw runtime_error("Derivative vanished; try a bracket instead");
+
+            // Step 2: Take the step; a sign change means the root is bracketed, so finish with Brent
+            double next = x - fx / slope;
+            double fnext = f(next);
+            if (fnext != 0.0 && signbit(fnext) != signbit(fx)) {
+                result = refine(x, next, fx, fnext, iteration + 1);
+                result.method = "newton+brent";
+                break;
+            }
+            bool small = fabs(next - x) <= tolerance;
+            x = next, fx = fnext;
+            if (!isfinite(x) || !isfinite(fx)) throw runtime_error("Newton iteration diverged");
+            if (small) {
+                result.converged = true;
+                ++iteration;
+                break;
+            }
+        }
+        if (result.method == "newton") {
+            result.root = x;
+            result.value = fx;
+            result.iterations = iteration;
+            result.converged = result.converged || fx == 0.0;
+        }
+        result.evaluations = evaluations;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+// Adaptive Gauss-Kronrod (7-point Gauss inside 15-point Kronrod) integration of a one-variable
+// expression. Pieces sit in a max-heap by error estimate. Each round takes the worst pieces until
+// what is left would meet the tolerance, halves them all and evaluates the children across the
+// pool: a task gathers the 15 nodes of PIECES_PER_TASK children into one column and runs the
+// expression over it once, on the worker's own copy of the compiled program.
+class AdaptiveIntegrator {
+public:
+    struct Result {
+        double integral = 0.0, error = 0.0;
+        size_t evaluations = 0, pieces = 0, rounds = 0;
+        double seconds = 0.0;
+        bool converged = false;
+
+        void write(BufferedWriter& out) const {
+            FieldReport report;
+            report.number("integral", integral).number("error", error).count("evaluations", evaluations)
+                  .count("pieces", pieces).count("rounds", rounds).number("seconds", seconds)
+                  .flag("converged", converged);
+            report.write(out);
+        }
+    };
+
+private:
+    static constexpr size_t NODES = 15;
+    static constexpr size_t PIECES_PER_TASK = 8;   // 120 nodes, one pass of CompiledExpression's column
+    static constexpr size_t INITIAL_PIECES = 16;
+
+    // QUADPACK qk15: Kronrod abscissae (the odd ones are the Gauss nodes) and both weight sets
+    static constexpr double XK[8] = {0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+                                     0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+                                     0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+                                     0.207784955007898467600689403773245, 0.0};
+    static constexpr double WK[8] = {0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+                                     0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+                                     0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+                                     0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+    static constexpr double WG[4] = {0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+                                     0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+    struct Piece {
+        double a, b, integral, error;
+        bool roundoff;   // the estimate is at the rounding floor, so halving can't lower it
+        bool operator<(const Piece& other) const { return error < other.error; }
+    };
+
+    struct alignas(64) WorkerState {
+        optional<CompiledExpression> compiled;
+        array<double, PIECES_PER_TASK * NODES> points, values;
+        size_t evaluations = 0;
+    };
+
+    WorkStealingPool pool;
+    vector<unique_ptr<WorkerState>> workers;
+    vector<Piece> heap, pending, settled;   // settled pieces are not halved again, but their error still counts
+
+    // Node layout per piece: center, then the pairs center -/+ h * XK[j]
+    static void nodes(const Piece& piece, double* points) {
+        double center = 0.5 * (piece.a + piece.b), h = 0.5 * (piece.b - piece.a);
+        points[0] = center;
+        for (int j = 0; j < 7; ++j) {
+            points[1 + 2 * j] = center - h * XK[j];
+            points[2 + 2 * j] = center + h * XK[j];
+        }
+    }
+
+    // Kronrod sum, Gauss sum and QUADPACK's error estimate from the 15 values of one piece
+    static void rule(Piece& piece, const double* f) {
+        double h = 0.5 * (piece.b - piece.a), dh = fabs(h);
+        double kronrod = WK[7] * f[0], gauss = WG[3] * f[0], absolute = fabs(kronrod);
+        for (int j = 0; j < 7; ++j) {
+            double pair = f[1 + 2 * j] + f[2 + 2 * j];
+            kronrod += WK[j] * pair;
+            absolute += WK[j] * (fabs(f[1 + 2 * j]) + fabs(f[2 + 2 * j]));
+            if (j % 2 == 1) gauss += WG[j / 2] * pair;
+        }
+        double mean = 0.5 * kronrod, spread = WK[7] * fabs(f[0] - mean);
+        for (int j = 0; j < 7; ++j) spread += WK[j] * (fabs(f[1 + 2 * j] - mean) + fabs(f[2 + 2 * j] - mean));
+        spread *= dh;
+        absolute *= dh;
+        double error = fabs((kronrod - gauss) * h);
+        if (spread != 0.0 && error != 0.0) error = spread * min(1.0, pow(200.0 * error / spread, 1.5));
+        constexpr double eps = numeric_limits<double>::epsilon();
+        piece.roundoff = false;
+        if (absolute > numeric_limits<double>::min() / (50.0 * eps)) {
+            piece.roundoff = error <= 50.0 * eps * absolute;
+            error = max(50.0 * eps * absolute, error);
+        }
+        piece.integral = kronrod * h;
+        piece.error = error;
+        if (!isfinite(piece.integral)) {
+            TextBuffer<96> message;
+            message.append("Integrand is not finite on [").appendGeneral(piece.a).append(", ").appendGeneral(piece.b).append(']');
+            throw runtime_error(string(message.view()));
+        }
+    }
+
+    // Applies the rule to every pending piece, PIECES_PER_TASK at a time across the pool
+    void evaluatePending() {
+        size_t tasks = (pending.size() + PIECES_PER_TASK - 1) / PIECES_PER_TASK;
+        pool.parallelFor(tasks, [&](size_t task, size_t worker) {
+            WorkerState& local = *workers[worker];
+            size_t first = task * PIECES_PER_TASK, count = min(PIECES_PER_TASK, pending.size() - first);
+            for (size_t i = 0; i < count; ++i) nodes(pending[first + i], local.points.data() + i * NODES);
+            span<const double> points(local.points.data(), count * NODES);
+            local.compiled->evaluateColumn(points, local.values);
+            local.evaluations += points.size();
+            for (size_t i = 0; i < count; ++i) rule(pending[first + i], local.values.data() + i * NODES);
+        });
+    }
+
+public:
+    explicit AdaptiveIntegrator(size_t threads = thread::hardware_concurrency()) : pool(threads) {
+        for (size_t i = 0; i < pool.size(); ++i) workers.push_back(make_unique<WorkerState>());
+    }
+
+    size_t threadCount() const { return pool.size(); }
+
+    // Stops when the summed error estimate is within max(absTolerance, relTolerance * |integral|),
+    // or unconverged when maxPieces is reached or every piece left is too narrow or at the rounding floor
+    Result integrate(const string& expression, double a, double b, double absTolerance = 1e-10,
+                     double relTolerance = 1e-10, size_t maxPieces = 1 << 16) {
+        auto start = chrono::steady_clock::now();
+        if (!isfinite(a) || !isfinite(b)) throw runtime_error("Integration limits must be finite");
+        if (!(absTolerance > 0) && !(relTolerance > 0)) throw runtime_error("Tolerance must be positive");
+
+        // Step 1: A copy of the program per worker, since evaluation uses the object's own stack
+        for (auto& worker : workers) {
+            worker->compiled.emplace(expression);
+            worker->evaluations = 0;
+            if (worker->compiled->variables().size() > 1) throw runtime_error("Integration needs at most one variable");
+        }
+        Result result;
+        if (a == b) {
+            result.converged = true;
+            return result;
+        }
+        double sign = a < b ? 1.0 : -1.0;
+        if (b < a) swap(a, b);
+
+        // Step 2: Start from equal pieces so the first round already has work for every thread
+        heap.clear();
+        pending.clear();
+        settled.clear();
+        for (size_t i = 0; i < INITIAL_PIECES; ++i) {
+            double left = a + (b - a) * static_cast<double>(i) / INITIAL_PIECES;
+            double right = i + 1 == INITIAL_PIECES ? b : a + (b - a) * static_cast<double>(i + 1) / INITIAL_PIECES;
+            pending.push_back({left, right, 0.0, 0.0, false});
+        }
+
+        // Step 3: Evaluate the pending pieces, then split the worst ones until the tolerance is met
+        while (true) {
+            evaluatePending();
+            for (const Piece& piece : pending) {
+                heap.push_back(piece);
+                push_heap(heap.begin(), heap.end());
+            }
+            pending.clear();
+            ++result.rounds;
+
+            double integral = 0.0, error = 0.0;
+            for (const Piece& piece : heap) integral += piece.integral, error += piece.error;
+            for (const Piece& piece : settled) integral += piece.integral, error += piece.error;
+            result.integral = integral;
+            result.error = error;
+            result.pieces = heap.size() + settled.size();
+            double target = max(absTolerance, relTolerance * fabs(integral));
+            if (error <= target) {
+                result.converged = true;
+                break;
+            }
+            if (heap.empty() || result.pieces >= maxPieces) break;
+
+            size_t room = maxPieces - result.pieces;
+            while (!heap.empty() && error > target && pending.size() < 2 * room) {
+                pop_heap(heap.begin(), heap.end());
+                Piece worst = heap.back();
+                heap.pop_back();
+                double middle = 0.5 * (worst.a + worst.b);
+                if (worst.roundoff || middle <= worst.a || middle >= worst.b) {
+                    settled.push_back(worst);
+                    continue;
+                }
+                error -= worst.error;
+                pending.push_back({worst.a, middle, 0.0, 0.0, false});
+                pending.push_back({middle, worst.b, 0.0, 0.0, false});
+            }
+            if (pending.empty()) break;
+        }
+
+        result.integral *= sign;
+        for (const auto& worker : workers) result.evaluations += worker->evaluations;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+}  // namespace techneon
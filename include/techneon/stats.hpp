@@ -0,0 +1,385 @@
+// Single-pass summary statistics over converted values: moments, extremes and quantiles, all mergeable
+#pragma once
+
+#include "techneon/batch.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+// KLL quantile sketch: a stack of compactors, each holding items of weight 2^level. Levels above
+// the first are kept sorted; from a full level every other item (odd or even, at random) moves up. Memory stays near 3 * K
+// items (about 10 KB) however long the stream; at K = 400 the rank error stays under 0.5%. Two
+// sketches merge by concatenating their levels and compacting again.
+class QuantileSketch {
+private:
+    static constexpr size_t K = 400;
+    static constexpr size_t MIN_WIDTH = 8;
+
+    vector<vector<double>> levels;
+    vector<double> survivors, merged;          // scratch for compaction, reused
+    size_t n = 0, stored = 0;
+    vector<size_t> capacities{K};              // per level, recomputed when a level is added
+    size_t limit = K;                          // their total
+    uint64_t bits = 0x9E3779B97F4A7C15ull;    // fixed seed, so one thread's results are reproducible
+
+    // Capacities shrink by 2/3 per level below the top one
+    void resizeLevels(size_t count) {
+        levels.resize(count);
+        capacities.resize(count);
+        limit = 0;
+        double width = static_cast<double>(K);
+        for (size_t level = count; level-- > 0; width *= 2.0 / 3.0) {
+            capacities[level] = max(MIN_WIDTH, static_cast<size_t>(width));
+            limit += capacities[level];
+        }
+    }
+
+    bool randomBit() {
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        return bits & 1;
+    }
+
+    void compress() {
+        while (stored > limit) {
+            // Step 1: The lowest level over its capacity gives up half its items
+            size_t level = 0;
+            while (levels[level].size() <= capacities[level]) ++level;
+            if (level + 1 == levels.size()) resizeLevels(levels.size() + 1);
+            vector<double>& items = levels[level];
+            if (level == 0) sort(items.begin(), items.end());
+            // Step 2: An odd item out stays behind; the survivors of the rest double in weight and
+            // are merged into the level above, which stays sorted
+            double leftover = items.size() % 2 ? items.back() : 0.0;
+            bool keepLeftover = items.size() % 2;
+            size_t pairs = items.size() / 2;
+            size_t offset = randomBit();
+            survivors.clear();
+            for (size_t i = 0; i < pairs; ++i) survivors.push_back(items[2 * i + offset]);
+            vector<double>& above = levels[level + 1];
+            merged.resize(above.size() + pairs);
+            std::merge(above.begin(), above.end(), survivors.begin(), survivors.end(), merged.begin());
+            above.swap(merged);
+            items.clear();
+            if (keepLeftover) items.push_back(leftover);
+            stored -= pairs;
+        }
+    }
+
+public:
+    QuantileSketch() : levels(1) { levels[0].reserve(K); }
+
+    size_t count() const { return n; }
+
+    void add(double value) {
+        levels[0].push_back(value);
+        ++n;
+        if (++stored > limit) compress();
+    }
+
+    void merge(const QuantileSketch& other) {
+        if (levels.size() < other.levels.size()) resizeLevels(other.levels.size());
+        for (size_t level = 0; level < other.levels.size(); ++level) {
+            vector<double>& items = levels[level];
+            size_t sorted = items.size();
+            items.insert(items.end(), other.levels[level].begin(), other.levels[level].end());
+            if (level > 0) inplace_merge(items.begin(), items.begin() + sorted, items.end());
+        }
+        n += other.n;
+        stored += other.stored;
+        compress();
+    }
+
+    // Approximate values at each rank fraction in qs (each in [0, 1]); NaN when the sketch is empty
+    void quantiles(span<const double> qs, span<double> out) const {
+        vector<pair<double, uint64_t>> weighted;
+        weighted.reserve(stored);
+        for (size_t level = 0; level < levels.size(); ++level) {
+            for (double value : levels[level]) weighted.emplace_back(value, uint64_t(1) << level);
+        }
+        sort(weighted.begin(), weighted.end());
+        for (size_t i = 0; i < qs.size(); ++i) {
+            if (weighted.empty()) {
+                out[i] = numeric_limits<double>::quiet_NaN();
+                continue;
+            }
+            // The first item whose cumulative weight reaches q of the total
+            double target = clamp(qs[i], 0.0, 1.0) * static_cast<double>(n);
+            uint64_t seen = 0;
+            out[i] = weighted.back().first;
+            for (const auto& [value, weight] : weighted) {
+                seen += weight;
+                if (static_cast<double>(seen) >= target) {
+                    out[i] = value;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+// Count, sum, mean and variance (Welford, merged with Chan's formula), min, max and quantiles in
+// one pass. Every chunk of values is summarized on its own and then merged in, which keeps the
+// inner loops free of divisions and lets per-thread states combine the same way.
+class StreamingStats {
+private:
+    static constexpr size_t CHUNK_VALUES = 1024;
+
+    size_t n = 0;
+    double total = 0.0, average = 0.0, m2 = 0.0;
+    double low = numeric_limits<double>::infinity(), high = -numeric_limits<double>::infinity();
+    QuantileSketch sketch;
+
+    // Chan et al.: combine two (count, mean, sum of squared deviations) triples
+    void combine(size_t count, double chunkSum, double chunkMean, double chunkM2) {
+        if (count == 0) return;
+        size_t merged = n + count;
+        double delta = chunkMean - average;
+        average += delta * static_cast<double>(count) / static_cast<double>(merged);
+        m2 += chunkM2 + delta * delta * static_cast<double>(n) * static_cast<double>(count) / static_cast<double>(merged);
+        total += chunkSum;
+        n = merged;
+    }
+
+public:
+    size_t count() const { return n; }
+    double sum() const { return total; }
+    double mean() const { return n ? average : numeric_limits<double>::quiet_NaN(); }
+    // Sample variance (n - 1 in the denominator)
+    double variance() const { return n > 1 ? m2 / static_cast<double>(n - 1) : numeric_limits<double>::quiet_NaN(); }
+    double stddev() const { return sqrt(variance()); }
+    double min() const { return n ? low : numeric_limits<double>::quiet_NaN(); }
+    double max() const { return n ? high : numeric_limits<double>::quiet_NaN(); }
+
+    void add(double value) {
+        ++n;
+        total += value;
+        double delta = value - average;
+        average += delta / static_cast<double>(n);
+        m2 += delta * (value - average);
+        low = std::min(low, value);
+        high = std::max(high, value);
+        sketch.add(value);
+    }
+
+    void add(span<const double> values) {
+        for (size_t start = 0; start < values.size(); start += CHUNK_VALUES) {
+            span<const double> chunk = values.subspan(start, std::min(CHUNK_VALUES, values.size() - start));
+            // Step 1: Two passes over a chunk that is still in cache: sum and extremes, then deviations
+            double chunkSum = 0.0, chunkLow = low, chunkHigh = high;
+            for (double value : chunk) {
+                chunkSum += value;
+                chunkLow = std::min(chunkLow, value);
+                chunkHigh = std::max(chunkHigh, value);
+            }
+            double chunkMean = chunkSum / static_cast<double>(chunk.size());
+            double chunkM2 = 0.0;
+            for (double value : chunk) chunkM2 += (value - chunkMean) * (value - chunkMean);
+            // Step 2: Fold the chunk into the running state
+            combine(chunk.size(), chunkSum, chunkMean, chunkM2);
+            low = chunkLow;
+            high = chunkHigh;
+            for (double value : chunk) sketch.add(value);
+        }
+    }
+
+    // Converts in chunks through the column kernel into a stack buffer, so the converted column
+    // never exists in memory
+    void addConverted(span<const double> in, LinearFactors f) {
+        double converted[CHUNK_VALUES];
+        for (size_t start = 0; start < in.size(); start += CHUNK_VALUES) {
+            size_t len = std::min(CHUNK_VALUES, in.size() - start);
+            LinearKernel::apply(in.subspan(start, len), span<double>(converted, len), f.scale, f.offset);
+            add(span<const double>(converted, len));
+        }
+    }
+
+    void merge(const StreamingStats& other) {
+        combine(other.n, other.total, other.average, other.m2);
+        low = std::min(low, other.low);
+        high = std::max(high, other.high);
+        sketch.merge(other.sketch);
+    }
+
+    void quantiles(span<const double> qs, span<double> out) const {
+        sketch.quantiles(qs, out);
+        // The extremes are known exactly
+        for (size_t i = 0; i < qs.size(); ++i) {
+            if (n && qs[i] <= 0.0) out[i] = low;
+            if (n && qs[i] >= 1.0) out[i] = high;
+        }
+    }
+
+    double quantile(double q) const {
+        double value;
+        quantiles(span<const double>(&q, 1), span<double>(&value, 1));
+        return value;
+    }
+
+    // Label for a quantile column: 0.5 -> p50, 0.999 -> p99.9
+    static TextBuffer<16> quantileName(double q) {
+        char digits[24];
+        auto [end, ec] = to_chars(digits, digits + sizeof(digits), q * 100.0, chars_format::general, 10);
+        TextBuffer<16> name;
+        name.append('p').append(string_view(digits, ec == errc() ? end - digits : 0));
+        return name;
+    }
+
+    // The summary in the selected output style: "name value" lines, one JSON object, or a CSV
+    // header and row
+    void write(BufferedWriter& out, span<const double> qs) const {
+        vector<double> values(qs.size());
+        quantiles(qs, values);
+        FieldReport report;
+        report.count("count", n).number("sum", sum()).number("mean", mean()).number("variance", variance())
+              .number("stddev", stddev()).number("min", min()).number("max", max());
+        for (size_t i = 0; i < qs.size(); ++i) report.number(quantileName(qs[i]).view(), values[i]);
+        report.write(out);
+    }
+};
+
+// Reads a column of numbers (one per line), converts each through a unit pair's scale and offset and
+// aggregates the results. Blocks of lines are split into chunks on a WorkStealingPool; every worker
+// keeps its own StreamingStats, merged at the end. Memory stays at one block of input text plus
+// each worker's state, whatever the length of the column.
+class ColumnAggregator {
+private:
+    static constexpr size_t CHUNK_LINES = 4096;
+    static constexpr size_t BLOCK_LINES = 1 << 18;
+    static constexpr size_t PARSE_VALUES = 1024;
+
+    struct alignas(64) WorkerState {
+        StreamingStats stats;
+        vector<RowError> errors;
+        size_t failures = 0;
+    };
+
+    struct ChunkErrors {
+        size_t worker, offset, count;
+    };
+
+    LinearFactors factors;
+    WorkStealingPool pool;
+    vector<unique_ptr<WorkerState>> workers;
+    vector<ChunkErrors> chunks;
+
+    // Parses a run of lines into a small buffer and hands each full buffer to the converter
+    void aggregateLines(const vector<string_view>& lines, size_t begin, size_t end, size_t firstRow, WorkerState& local,
+                        bool collectErrors) {
+        double parsed[PARSE_VALUES];
+        size_t pending = 0;
+        for (size_t i = begin; i < end; ++i) {
+            string_view line = lines[i];
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            size_t first = line.find_first_not_of(" \t");
+            if (first == string_view::npos || line[first] == '#') continue;
+            size_t last = line.find_last_not_of(" \t");
+            string_view field = line.substr(first, last - first + 1);
+            double value;
+            ParseStatus status = NumberParser::parseDouble(field, value);
+            if (status == ParseStatus::Ok && !isfinite(value)) status = ParseStatus::InvalidNumber;
+            if (status != ParseStatus::Ok) {
+                ++local.failures;
+                if (collectErrors) {
+                    RowError error;
+                    error.row = firstRow + i;
+                    error.column = first + 1;
+                    BatchProcessor::describe(status, field, error.message);
+                    local.errors.push_back(error);
+                }
+                continue;
+            }
+            parsed[pending++] = value;
+            if (pending == PARSE_VALUES) {
+                local.stats.addConverted(span<const double>(parsed, pending), factors);
+                pending = 0;
+            }
+        }
+        local.stats.addConverted(span<const double>(parsed, pending), factors);
+    }
+
+public:
+    ColumnAggregator(LinearFactors f, size_t threads) : factors(f), pool(threads) {
+        for (size_t i = 0; i < pool.size(); ++i) workers.push_back(make_unique<WorkerState>());
+    }
+
+    // Scale and offset for a conversion named the way batch lines name it: temp C F, len M F,
+    // curr USD EUR (or the letter codes), unit mi km
+    static LinearFactors factorsFor(string_view kind, string_view from, string_view to) {
+        auto code = [&](string_view unit) {
+            if (unit.size() != 1) throw runtime_error("Expected a one-letter unit code, got '" + string(unit) + "'");
+            return unit[0];
+        };
+        if (kind == "temp") return TemperatureConverter::linearFactors(code(from), code(to));
+        if (kind == "len") return LengthConverter::linearFactors(code(from), code(to));
+        if (kind == "curr") {
+            if (from.size() == 1 && to.size() == 1) return CurrencyConverter::linearFactors(from[0], to[0]);
+            return CurrencyConverter::linearFactors(from, to);
+        }
+        if (kind == "unit") {
+            const UnitRegistry& registry = UnitRegistry::instance();
+            int a = registry.find(from), b = registry.find(to);
+            if (a < 0) throw runtime_error("Unknown unit '" + string(from) + "'");
+            if (b < 0) throw runtime_error("Unknown unit '" + string(to) + "'");
+            return registry.factors(a, b);
+        }
+        throw runtime_error("Unknown conversion '" + string(kind) + "' (use temp, len, curr or unit)");
+    }
+
+    // Aggregates every value in the input; rows that are not numbers are counted, and reported to
+    // errorFile (numbered from 1) if given
+    StreamingStats run(FILE* in, size_t& failures, FILE* errorFile = nullptr) {
+        ChunkedLineReader reader(in);
+        unique_ptr<BufferedWriter> errors;
+        if (errorFile) {
+            errors = make_unique<BufferedWriter>(errorFile);
+            BatchProcessor::reportHeader(*errors);
+        }
+        size_t rows = 0;
+        // Lines are copied into a block because the reader reuses its buffer
+        string block;
+        vector<pair<size_t, size_t>> spans;
+        vector<string_view> lines;
+        auto flushBlock = [&] {
+            lines.clear();
+            for (auto [offset, length] : spans) lines.emplace_back(block.data() + offset, length);
+            chunks.assign((lines.size() + CHUNK_LINES - 1) / CHUNK_LINES, ChunkErrors{0, 0, 0});
+            pool.parallelFor(chunks.size(), [&](size_t chunk, size_t worker) {
+                WorkerState& local = *workers[worker];
+                size_t errorStart = local.errors.size();
+                aggregateLines(lines, chunk * CHUNK_LINES, std::min(lines.size(), (chunk + 1) * CHUNK_LINES), rows + 1, local,
+                               errors != nullptr);
+                chunks[chunk] = {worker, errorStart, local.errors.size() - errorStart};
+            });
+            // Error rows go out in input order, as in batch mode
+            if (errors) {
+                for (const ChunkErrors& c : chunks) {
+                    for (size_t i = 0; i < c.count; ++i) BatchProcessor::report(*errors, workers[c.worker]->errors[c.offset + i]);
+                }
+                for (auto& local : workers) local->errors.clear();
+            }
+            rows += lines.size();
+            block.clear();
+            spans.clear();
+        };
+        string_view line;
+        while (reader.nextLine(line)) {
+            spans.emplace_back(block.size(), line.size());
+            block.append(line);
+            if (spans.size() == BLOCK_LINES) flushBlock();
+        }
+        flushBlock();
+        // Step 3: Merge the per-worker states
+        StreamingStats result = workers[0]->stats;
+        failures = workers[0]->failures;
+        for (size_t i = 1; i < workers.size(); ++i) {
+            result.merge(workers[i]->stats);
+            failures += workers[i]->failures;
+        }
+        return result;
+    }
+};
+
+}  // namespace techneon
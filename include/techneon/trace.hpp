@@ -0,0 +1,194 @@
+// Binary operation traces: every operation with its operands, result and timing, for replay
+#pragma once
+
+#include "techneon/format.hpp"
+
+namespace techneon {
+
+using namespace std;
+
+// Trace file: this header, then one TraceEntry per operation. Each entry is followed by its
+// operand text and its result text, padded to 8 bytes so the next entry can be read in place.
+struct TraceFileHeader {
+    char magic[4];       // "TCTR"
+    uint32_t version;    // 1
+    int64_t started;     // nanoseconds since the epoch when capture began
+};
+
+enum class TraceOutcome : uint8_t { Number, Text, Failed };
+
+struct TraceEntry {
+    int64_t timestamp;        // nanoseconds since the epoch when the operation started
+    double a, b;              // numeric operands (expression variables for menu expressions)
+    double result;            // for TraceOutcome::Number
+    uint32_t textLength;      // number base digits or expression source
+    uint32_t resultLength;    // digits of a Text result, or the message of a failure
+    int16_t fromUnit, toUnit; // registry unit ids or currency keys
+    OpKind kind;
+    char op;                  // calculator operation or log type; for expressions, how many of a and b are bound
+    char from, to;
+    TraceOutcome outcome;
+    uint8_t reserved[3];
+    uint32_t nanos;           // time the operation took when captured
+
+    size_t size() const { return (sizeof(TraceEntry) + textLength + resultLength + 7) & ~size_t(7); }
+    string_view text() const { return {reinterpret_cast<const char*>(this + 1), textLength}; }
+    string_view resultText() const { return {reinterpret_cast<const char*>(this + 1) + textLength, resultLength}; }
+
+    Operation operation() const {
+        Operation request;
+        request.kind = kind;
+        request.op = op;
+        request.from = from;
+        request.to = to;
+        request.a = a;
+        request.b = b;
+        request.fromUnit = fromUnit;
+        request.toUnit = toUnit;
+        request.text = text();
+        return request;
+    }
+};
+
+static_assert(sizeof(TraceEntry) == 56, "trace entries are written as they are laid out in memory");
+
+// Process-wide capture to one trace file (--trace). Off until started, which leaves one relaxed
+// load per operation. Each thread encodes entries into its own buffer and appends whole buffers to
+// the file under a lock, so entries from different threads interleave in blocks; the timestamps
+// give the real order. The buffers are flushed by stop() or at exit, once worker threads are done.
+class TraceCapture {
+private:
+    static constexpr size_t FLUSH_BYTES = 1 << 16;
+
+    struct ThreadBuffer {
+        vector<char> bytes;
+    };
+
+    struct Sink {
+        atomic<bool> active{false};
+        mutex lock;
+        FILE* file = nullptr;
+        string path;
+        vector<unique_ptr<ThreadBuffer>> buffers;
+
+        // Writes out what every thread still holds and closes the file
+        void close() {
+            active.store(false, memory_order_release);
+            lock_guard<mutex> guard(lock);
+            if (!file) return;
+            for (auto& buffer : buffers) {
+                try {
+                    drain(*this, *buffer);
+                } catch (const runtime_error&) {
+                }
+            }
+            fclose(file);
+            file = nullptr;
+        }
+
+        ~Sink() { close(); }
+    };
+
+    static Sink& sink() {
+        static Sink instance;
+        return instance;
+    }
+
+    static ThreadBuffer& local() {
+        thread_local ThreadBuffer* buffer = [] {
+            Sink& s = sink();
+            lock_guard<mutex> lock(s.lock);
+            s.buffers.push_back(make_unique<ThreadBuffer>());
+            s.buffers.back()->bytes.reserve(FLUSH_BYTES + 4096);
+            return s.buffers.back().get();
+        }();
+        return *buffer;
+    }
+
+    // Called with the sink locked
+    static void drain(Sink& s, ThreadBuffer& buffer) {
+        if (buffer.bytes.empty() || !s.file) return;
+        if (fwrite(buffer.bytes.data(), 1, buffer.bytes.size(), s.file) != buffer.bytes.size()) {
+            throw runtime_error("Cannot write trace " + s.path);
+        }
+        buffer.bytes.clear();
+    }
+
+    static void append(TraceEntry entry, string_view text, string_view result) {
+        entry.textLength = static_cast<uint32_t>(text.size());
+        entry.resultLength = static_cast<uint32_t>(result.size());
+        ThreadBuffer& buffer = local();
+        size_t at = buffer.bytes.size();
+        buffer.bytes.resize(at + entry.size());
+        char* out = buffer.bytes.data() + at;
+        memcpy(out, &entry, sizeof(entry));
+        memcpy(out + sizeof(entry), text.data(), text.size());
+        memcpy(out + sizeof(entry) + text.size(), result.data(), result.size());
+        memset(out + sizeof(entry) + text.size() + result.size(), 0, entry.size() - sizeof(entry) - text.size() - result.size());
+        if (buffer.bytes.size() >= FLUSH_BYTES) {
+            Sink& s = sink();
+            lock_guard<mutex> lock(s.lock);
+            drain(s, buffer);
+        }
+    }
+
+    // started and finished are monotonic(); the timestamp is the wall clock at the start, taken
+    // back from the wall clock now by the steady time since
+    static TraceEntry entryOf(int64_t started, int64_t finished, const Operation& op) {
+        TraceEntry entry{};
+        entry.timestamp = now() - (monotonic() - started);
+        entry.kind = op.kind;
+        entry.op = op.op;
+        entry.from = op.from;
+        entry.to = op.to;
+        entry.a = op.a;
+        entry.b = op.b;
+        entry.fromUnit = static_cast<int16_t>(op.fromUnit);
+        entry.toUnit = static_cast<int16_t>(op.toUnit);
+        entry.nanos = static_cast<uint32_t>(min<int64_t>(max<int64_t>(finished - started, 0), UINT32_MAX));
+        return entry;
+    }
+
+public:
+    static bool active() { return sink().active.load(memory_order_relaxed); }
+
+    // Wall clock, for timestamps only; it can jump, so durations use monotonic()
+    static int64_t now() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static int64_t monotonic() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void start(const string& path) {
+        Sink& s = sink();
+        lock_guard<mutex> lock(s.lock);
+        if (s.file) throw runtime_error("A trace is already being captured");
+        s.file = fopen(path.c_str(), "wb");
+        if (!s.file) throw runtime_error("Cannot create trace " + path);
+        s.path = path;
+        TraceFileHeader header{{'T', 'C', 'T', 'R'}, 1, now()};
+        fwrite(&header, sizeof(header), 1, s.file);
+        s.active.store(true, memory_order_release);
+    }
+
+    // Flushes every thread's buffer and closes the file; no thread may still be recording
+    static void stop() { sink().close(); }
+
+    // started is monotonic() taken just before the operation ran; finished defaults to monotonic()
+    static void record(int64_t started, const Operation& op, const OperationResult& result, int64_t finished = 0) {
+        TraceEntry entry = entryOf(started, finished ? finished : monotonic(), op);
+        entry.outcome = result.isText ? TraceOutcome::Text : TraceOutcome::Number;
+        entry.result = result.isText ? 0.0 : result.number;
+        append(entry, op.text, result.isText ? string_view(result.text) : string_view());
+    }
+
+    static void recordFailure(int64_t started, const Operation& op, string_view message) {
+        TraceEntry entry = entryOf(started, monotonic(), op);
+        entry.outcome = TraceOutcome::Failed;
+        append(entry, op.text, message);
+    }
+};
+
+}  // namespace techneon
@@ -0,0 +1,279 @@
+// Unit table and its compile-time pair matrix, plus typed quantities that convert with no runtime lookup
+#pragma once
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+
+namespace techneon {
+
+using namespace std;
+
+// Scale and offset of a unit pair, so a whole column can be converted with one multiply-add per value
+struct LinearFactors {
+    double scale, offset;
+};
+
+// Unit table: every unit is a linear map to its dimension's base unit, base = value * factor + offset.
+// The single-letter codes are the ones the menu converters have always accepted.
+struct UnitDefinition {
+    const char* dimension;
+    const char* symbol;
+    char code;
+    double factor;
+    double offset;
+};
+
+static constexpr UnitDefinition UNIT_TABLE[] = {
+    // Length, base metre
+    {"Length", "m", 'M', 1.0, 0.0},           {"Length", "ft", 'F', 0.3048, 0.0},
+    {"Length", "km", 0, 1000.0, 0.0},         {"Length", "cm", 0, 0.01, 0.0},
+    {"Length", "mm", 0, 0.001, 0.0},          {"Length", "um", 0, 1e-6, 0.0},
+    {"Length", "nm", 0, 1e-9, 0.0},           {"Length", "in", 0, 0.0254, 0.0},
+    {"Length", "yd", 0, 0.9144, 0.0},         {"Length", "mi", 0, 1609.344, 0.0},
+    {"Length", "nmi", 0, 1852.0, 0.0},        {"Length", "au", 0, 149597870700.0, 0.0},
+    {"Length", "ly", 0, 9460730472580800.0, 0.0},
+    // Mass, base kilogram
+    {"Mass", "kg", 0, 1.0, 0.0},              {"Mass", "g", 0, 1e-3, 0.0},
+    {"Mass", "mg", 0, 1e-6, 0.0},             {"Mass", "ug", 0, 1e-9, 0.0},
+    {"Mass", "t", 0, 1000.0, 0.0},            {"Mass", "lb", 0, 0.45359237, 0.0},
+    {"Mass", "oz", 0, 0.028349523125, 0.0},   {"Mass", "st", 0, 6.35029318, 0.0},
+    {"Mass", "ct", 0, 0.0002, 0.0},           {"Mass", "ton_us", 0, 907.18474, 0.0},
+    {"Mass", "ton_uk", 0, 1016.0469088, 0.0},
+    // Temperature, base kelvin
+    {"Temperature", "C", 'C', 1.0, 273.15},   {"Temperature", "F", 'F', 5.0 / 9.0, 459.67 * 5.0 / 9.0},
+    {"Temperature", "K", 0, 1.0, 0.0},        {"Temperature", "R", 0, 5.0 / 9.0, 0.0},
+    // Pressure, base pascal
+    {"Pressure", "Pa", 0, 1.0, 0.0},          {"Pressure", "hPa", 0, 100.0, 0.0},
+    {"Pressure", "kPa", 0, 1000.0, 0.0},      {"Pressure", "MPa", 0, 1e6, 0.0},
+    {"Pressure", "bar", 0, 1e5, 0.0},         {"Pressure", "mbar", 0, 100.0, 0.0},
+    {"Pressure", "atm", 0, 101325.0, 0.0},    {"Pressure", "psi", 0, 6894.757293168, 0.0},
+    {"Pressure", "torr", 0, 101325.0 / 760.0, 0.0},
+    {"Pressure", "mmHg", 0, 133.322387415, 0.0},
+    {"Pressure", "inHg", 0, 3386.389, 0.0},
+    // Energy, base joule
+    {"Energy", "J", 0, 1.0, 0.0},             {"Energy", "kJ", 0, 1e3, 0.0},
+    {"Energy", "MJ", 0, 1e6, 0.0},            {"Energy", "cal", 0, 4.184, 0.0},
+    {"Energy", "kcal", 0, 4184.0, 0.0},       {"Energy", "Wh", 0, 3600.0, 0.0},
+    {"Energy", "kWh", 0, 3.6e6, 0.0},         {"Energy", "eV", 0, 1.602176634e-19, 0.0},
+    {"Energy", "BTU", 0, 1055.05585262, 0.0}, {"Energy", "erg", 0, 1e-7, 0.0},
+    {"Energy", "ftlbf", 0, 1.3558179483314004, 0.0},
+    // Data size, base byte
+    {"Data", "B", 0, 1.0, 0.0},               {"Data", "bit", 0, 0.125, 0.0},
+    {"Data", "kB", 0, 1e3, 0.0},              {"Data", "MB", 0, 1e6, 0.0},
+    {"Data", "GB", 0, 1e9, 0.0},              {"Data", "TB", 0, 1e12, 0.0},
+    {"Data", "PB", 0, 1e15, 0.0},             {"Data", "KiB", 0, 1024.0, 0.0},
+    {"Data", "MiB", 0, 1048576.0, 0.0},       {"Data", "GiB", 0, 1073741824.0, 0.0},
+    {"Data", "TiB", 0, 1099511627776.0, 0.0}, {"Data", "PiB", 0, 1125899906842624.0, 0.0},
+    {"Data", "kbit", 0, 125.0, 0.0},          {"Data", "Mbit", 0, 125000.0, 0.0},
+    {"Data", "Gbit", 0, 125000000.0, 0.0},
+};
+
+constexpr size_t UNIT_COUNT = size(UNIT_TABLE);
+
+// Dimension id and position of every unit, where each dimension's square block of pair factors
+// starts in UNIT_MATRIX, and the unit behind each menu letter code. Dimension ids follow first
+// appearance in the table.
+struct UnitLayout {
+    array<int, UNIT_COUNT> dimension{}, localIndex{};
+    array<int, UNIT_COUNT> unitCount{};
+    array<size_t, UNIT_COUNT> matrixBase{};
+    array<string_view, UNIT_COUNT> dimensionName{};
+    array<array<short, 256>, UNIT_COUNT> byCode{};
+    int dimensionCount = 0;
+    size_t matrixSize = 0;
+};
+
+constexpr UnitLayout layoutUnits() {
+    UnitLayout layout;
+    for (size_t i = 0; i < UNIT_COUNT; ++i) {
+        int dim = 0;
+        while (dim < layout.dimensionCount && layout.dimensionName[dim] != UNIT_TABLE[i].dimension) ++dim;
+        if (dim == layout.dimensionCount) layout.dimensionName[layout.dimensionCount++] = UNIT_TABLE[i].dimension;
+        layout.dimension[i] = dim;
+        layout.localIndex[i] = layout.unitCount[dim]++;
+    }
+    for (auto& codes : layout.byCode) codes.fill(-1);
+    for (size_t i = 0; i < UNIT_COUNT; ++i) {
+        if (UNIT_TABLE[i].code != 0) layout.byCode[layout.dimension[i]][static_cast<unsigned char>(UNIT_TABLE[i].code)] = static_cast<short>(i);
+    }
+    for (int dim = 0; dim < layout.dimensionCount; ++dim) {
+        layout.matrixBase[dim] = layout.matrixSize;
+        layout.matrixSize += static_cast<size_t>(layout.unitCount[dim]) * layout.unitCount[dim];
+    }
+    return layout;
+}
+
+static constexpr UnitLayout UNIT_LAYOUT = layoutUnits();
+
+constexpr int dimensionIndex(string_view name) {
+    for (int dim = 0; dim < UNIT_LAYOUT.dimensionCount; ++dim) {
+        if (UNIT_LAYOUT.dimensionName[dim] == name) return dim;
+    }
+    return -1;
+}
+
+// Index of a pair inside its dimension's block; both units must share a dimension
+constexpr size_t unitSlot(int from, int to) {
+    int dim = UNIT_LAYOUT.dimension[from];
+    return UNIT_LAYOUT.matrixBase[dim] + static_cast<size_t>(UNIT_LAYOUT.localIndex[from]) * UNIT_LAYOUT.unitCount[dim] +
+           UNIT_LAYOUT.localIndex[to];
+}
+
+// Scale and offset for every pair inside each dimension, worked out by the compiler. The runtime
+// registry and the typed quantities both read from here, so they always agree.
+static constexpr auto UNIT_MATRIX = [] {
+    array<LinearFactors, UNIT_LAYOUT.matrixSize> matrix{};
+    for (size_t from = 0; from < UNIT_COUNT; ++from) {
+        for (size_t to = 0; to < UNIT_COUNT; ++to) {
+            if (UNIT_LAYOUT.dimension[from] != UNIT_LAYOUT.dimension[to]) continue;
+            const UnitDefinition& a = UNIT_TABLE[from];
+            const UnitDefinition& b = UNIT_TABLE[to];
+            // value * a.factor + a.offset = result * b.factor + b.offset
+            LinearFactors& f = matrix[unitSlot(static_cast<int>(from), static_cast<int>(to))];
+            f.scale = from == to ? 1.0 : a.factor / b.factor;
+            f.offset = from == to ? 0.0 : (a.offset - b.offset) / b.factor;
+        }
+    }
+    return matrix;
+}();
+
+// Table index of a symbol; used at compile time, where an unknown symbol fails the build
+constexpr int unitIndex(string_view symbol) {
+    for (size_t i = 0; i < UNIT_COUNT; ++i) {
+        if (symbol == UNIT_TABLE[i].symbol) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// A unit as a type: carries its table row so conversions between two of them are constants
+template <int Index>
+struct Unit {
+    static_assert(Index >= 0 && Index < static_cast<int>(UNIT_COUNT), "Unknown unit symbol");
+    static constexpr int index = Index;
+    static constexpr int dimension = UNIT_LAYOUT.dimension[Index];
+    static constexpr const char* symbol = UNIT_TABLE[Index].symbol;
+};
+
+namespace units {
+using Meter = Unit<unitIndex("m")>;
+using Foot = Unit<unitIndex("ft")>;
+using Kilometer = Unit<unitIndex("km")>;
+using Centimeter = Unit<unitIndex("cm")>;
+using Millimeter = Unit<unitIndex("mm")>;
+using Inch = Unit<unitIndex("in")>;
+using Yard = Unit<unitIndex("yd")>;
+using Mile = Unit<unitIndex("mi")>;
+using NauticalMile = Unit<unitIndex("nmi")>;
+using Kilogram = Unit<unitIndex("kg")>;
+using Gram = Unit<unitIndex("g")>;
+using Tonne = Unit<unitIndex("t")>;
+using Pound = Unit<unitIndex("lb")>;
+using Ounce = Unit<unitIndex("oz")>;
+using Celsius = Unit<unitIndex("C")>;
+using Fahrenheit = Unit<unitIndex("F")>;
+using Kelvin = Unit<unitIndex("K")>;
+using Rankine = Unit<unitIndex("R")>;
+using Pascal = Unit<unitIndex("Pa")>;
+using Kilopascal = Unit<unitIndex("kPa")>;
+using Bar = Unit<unitIndex("bar")>;
+using Atmosphere = Unit<unitIndex("atm")>;
+using Psi = Unit<unitIndex("psi")>;
+using Joule = Unit<unitIndex("J")>;
+using Kilojoule = Unit<unitIndex("kJ")>;
+using Calorie = Unit<unitIndex("cal")>;
+using Kilocalorie = Unit<unitIndex("kcal")>;
+using KilowattHour = Unit<unitIndex("kWh")>;
+using Btu = Unit<unitIndex("BTU")>;
+using Byte = Unit<unitIndex("B")>;
+using Bit = Unit<unitIndex("bit")>;
+using Kilobyte = Unit<unitIndex("kB")>;
+using Megabyte = Unit<unitIndex("MB")>;
+using Gigabyte = Unit<unitIndex("GB")>;
+using Kibibyte = Unit<unitIndex("KiB")>;
+using Mebibyte = Unit<unitIndex("MiB")>;
+using Gibibyte = Unit<unitIndex("GiB")>;
+}  // namespace units
+
+// A chain of units folded into one scale and offset, e.g. Conversion<Mile, Kilometer, Meter>.
+// Every step must stay inside one dimension; a mismatch is a compile error.
+template <typename From, typename... Rest>
+struct Conversion {
+    static_assert(sizeof...(Rest) > 0, "A conversion needs a target unit");
+};
+
+template <typename From, typename To>
+struct Conversion<From, To> {
+    static_assert(From::dimension == To::dimension, "Cannot convert between units of different dimensions");
+    static constexpr LinearFactors factors = UNIT_MATRIX[unitSlot(From::index, To::index)];
+
+    // Skips the add (and the multiply) when they would do nothing, so a pure scale costs one multiply
+    template <typename T>
+    static constexpr T apply(T value) {
+        if constexpr (factors.scale == 1.0 && factors.offset == 0.0) return value;
+        else if constexpr (factors.offset == 0.0) return value * static_cast<T>(factors.scale);
+        else return value * static_cast<T>(factors.scale) + static_cast<T>(factors.offset);
+    }
+};
+
+template <typename From, typename Via, typename Next, typename... Rest>
+struct Conversion<From, Via, Next, Rest...> {
+private:
+    using First = Conversion<From, Via>;
+    using Tail = Conversion<Via, Next, Rest...>;
+    // (x * s1 + o1) * s2 + o2 = x * (s1 * s2) + (o1 * s2 + o2)
+    static constexpr LinearFactors compose() {
+        return {First::factors.scale * Tail::factors.scale, First::factors.offset * Tail::factors.scale + Tail::factors.offset};
+    }
+
+public:
+    static constexpr LinearFactors factors = compose();
+
+    template <typename T>
+    static constexpr T apply(T value) {
+        if constexpr (factors.offset == 0.0) return value * static_cast<T>(factors.scale);
+        else return value * static_cast<T>(factors.scale) + static_cast<T>(factors.offset);
+    }
+};
+
+// A value tagged with its unit. Assigning or adding across units of one dimension converts at
+// compile-time cost; across dimensions it does not compile.
+template <typename T, typename U>
+class Quantity {
+private:
+    T amount;
+
+public:
+    using unit = U;
+    using value_type = T;
+
+    constexpr Quantity() : amount() {}
+    constexpr explicit Quantity(T value) : amount(value) {}
+
+    template <typename Other>
+    constexpr Quantity(Quantity<T, Other> other) : amount(Conversion<Other, U>::apply(other.value())) {}
+
+    constexpr T value() const { return amount; }
+    static constexpr const char* symbol() { return U::symbol; }
+
+    constexpr Quantity operator+(Quantity other) const { return Quantity(amount + other.amount); }
+    constexpr Quantity operator-(Quantity other) const { return Quantity(amount - other.amount); }
+    constexpr Quantity operator-() const { return Quantity(-amount); }
+    constexpr Quantity operator*(T factor) const { return Quantity(amount * factor); }
+    constexpr Quantity operator/(T divisor) const { return Quantity(amount / divisor); }
+    constexpr Quantity& operator+=(Quantity other) { amount += other.amount; return *this; }
+    constexpr Quantity& operator-=(Quantity other) { amount -= other.amount; return *this; }
+
+    friend constexpr Quantity operator*(T factor, Quantity q) { return q * factor; }
+    friend constexpr bool operator==(Quantity a, Quantity b) { return a.amount == b.amount; }
+    friend constexpr auto operator<=>(Quantity a, Quantity b) { return a.amount <=> b.amount; }
+};
+
+template <typename To, typename T, typename From>
+constexpr Quantity<T, To> quantityCast(Quantity<T, From> q) {
+    return Quantity<T, To>(Conversion<From, To>::apply(q.value()));
+}
+
+}  // namespace techneon
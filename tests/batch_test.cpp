@@ -0,0 +1,81 @@
+// The batch line parser on well-formed and malformed lines, and what a malformed line prints
+#include "techneon/batch.hpp"
+#include "check.hpp"
+
+using namespace std;
+using namespace techneon;
+
+static ParseStatus statusOf(string_view line, string_view* field = nullptr) {
+    Operation op;
+    string_view offending;
+    ParseStatus status = BatchProcessor::tryParse(line, op, offending);
+    if (field) *field = offending;
+    return status;
+}
+
+static void wellFormed() {
+    Operation op;
+    string_view field;
+    CHECK(BatchProcessor::tryParse("calc 2 * 3", op, field) == ParseStatus::Ok);
+    CHECK(op.kind == OpKind::Calculator && op.a == 2 && op.op == '*' && op.b == 3);
+    CHECK(BatchProcessor::tryParse("  temp 100 C F", op, field) == ParseStatus::Ok);
+    CHECK(op.kind == OpKind::Temperature && op.a == 100);
+    CHECK(BatchProcessor::tryParse("base ff H D", op, field) == ParseStatus::Ok && op.text == "ff");
+    CHECK(BatchProcessor::tryParse("base 1.5e3 D H", op, field) == ParseStatus::Ok);
+    CHECK(BatchProcessor::tryParse("unit 3 mi km", op, field) == ParseStatus::Ok && op.kind == OpKind::Unit);
+    CHECK(BatchProcessor::tryParse("expr 2 * (3 + 4)", op, field) == ParseStatus::Ok && op.text == "2 * (3 + 4)");
+    CHECK(BatchProcessor::tryParse("radix zz 36 10", op, field) == ParseStatus::Ok);
+    CHECK(BatchProcessor::evaluate(BatchProcessor::parse("calc 2 * 3")).number == 6);
+    CHECK(BatchProcessor::evaluate(BatchProcessor::parse("radix ff 16 10")).text == "255");
+}
+
+static void malformed() {
+    string_view field;
+    CHECK(statusOf("") == ParseStatus::UnknownCommand);
+    CHECK(statusOf("   \t ") == ParseStatus::UnknownCommand);
+    CHECK(statusOf("frobnicate 1 2 3", &field) == ParseStatus::UnknownCommand && field == "frobnicate");
+    CHECK(statusOf("calc 1 +") == ParseStatus::WrongOperands);
+    CHECK(statusOf("calc x + 1", &field) == ParseStatus::InvalidNumber && field == "x");
+    CHECK(statusOf("calc 1e999 + 1", &field) == ParseStatus::OutOfRange && field == "1e999");
+    CHECK(statusOf("calc 1 ++ 2", &field) == ParseStatus::InvalidCode && field == "++");
+    CHECK(statusOf("calc 30 S 2") == ParseStatus::WrongOperands);
+    CHECK(statusOf("calc 1 + 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18") == ParseStatus::TooManyFields);
+    CHECK(statusOf("temp abc C F", &field) == ParseStatus::InvalidNumber && field == "abc");
+    CHECK(statusOf("temp 1 C") == ParseStatus::UnknownCommand);
+    CHECK(statusOf("base 12 B D", &field) == ParseStatus::InvalidDigits && field == "12");
+    CHECK(statusOf("radix 9 8 10", &field) == ParseStatus::InvalidDigits && field == "9");
+    CHECK(statusOf("unit 3 mi parsecs", &field) == ParseStatus::UnknownUnit && field == "parsecs");
+    CHECK(statusOf("log - N", &field) == ParseStatus::InvalidNumber && field == "-");
+    CHECK(statusOf("log 10") == ParseStatus::UnknownCommand);
+
+    // What the batch output shows for a line that fails to parse
+    TextBuffer<192> message;
+    BatchProcessor::describe(ParseStatus::InvalidNumber, "x", message);
+    CHECK(message.view() == "Invalid number: x");
+
+    // parse() throws what tryParse reports
+    bool threw = false;
+    try {
+        BatchProcessor::parse("calc x + 1");
+    } catch (const runtime_error& e) {
+        threw = string(e.what()) == "Invalid number: x";
+    }
+    CHECK(threw);
+
+    // Out-of-range radix bases and non-finite decimal input to base are errors, not crashes
+    for (const char* line : {"radix ff 1e300 10", "radix ff 16 nan", "radix ff 16 1", "base nan D B", "base inf D H", "base -inf D O"}) {
+        threw = false;
+        try {
+            BatchProcessor::evaluate(BatchProcessor::parse(line));
+        } catch (const runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+}
+
+int main() {
+    wellFormed();
+    malformed();
+    return test::finish("batch_test");
+}
@@ -0,0 +1,48 @@
+// Minimal checks for the ctest programs: each failure is printed with its location and counted
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace techneon::test {
+
+using namespace std;
+
+inline size_t& failures() {
+    static size_t count = 0;
+    return count;
+}
+
+inline bool check(bool ok, const char* what, const char* file, int line) {
+    if (!ok) {
+        ++failures();
+        cerr << file << ":" << line << ": check failed: " << what << "\n";
+    }
+    return ok;
+}
+
+// |actual - expected| <= tolerance, with the values printed on failure
+inline bool near(double actual, double expected, double tolerance, const char* what, const char* file, int line) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        ++failures();
+        cerr.precision(17);
+        cerr << file << ":" << line << ": " << what << ": got " << actual << ", expected " << expected << " within "
+             << tolerance << "\n";
+    }
+    return ok;
+}
+
+// The exit status of a test program
+inline int finish(const char* name) {
+    if (failures()) cerr << name << ": " << failures() << " checks failed\n";
+    return failures() ? 1 : 0;
+}
+
+}  // namespace techneon::test
+
+#define CHECK(condition) ::techneon::test::check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_NEAR(actual, expected, tolerance) \
+    ::techneon::test::near((actual), (expected), (tolerance), #actual, __FILE__, __LINE__)
@@ -0,0 +1,71 @@
+// MatrixEngine::multiply against a naive triple loop, at sizes around the tile and block edges
+#include "techneon/matrix.hpp"
+#include "check.hpp"
+
+#include <random>
+
+using namespace std;
+using namespace techneon;
+
+static void multiplyAgainstNaive(MatrixEngine& engine, size_t m, size_t n, size_t k, mt19937_64& random) {
+    uniform_real_distribution<double> uniform(-1.0, 1.0);
+    MatrixArena arena;
+    Matrix a = Matrix::allocate(arena, m, k), b = Matrix::allocate(arena, k, n), c = Matrix::allocate(arena, m, n);
+    for (size_t r = 0; r < m; ++r) {
+        for (size_t j = 0; j < k; ++j) a.at(r, j) = uniform(random);
+    }
+    for (size_t r = 0; r < k; ++r) {
+        for (size_t j = 0; j < n; ++j) b.at(r, j) = uniform(random);
+    }
+    // Stale values in c must be overwritten, not accumulated
+    for (size_t r = 0; r < m; ++r) {
+        for (size_t j = 0; j < n; ++j) c.at(r, j) = 1e30;
+    }
+    engine.multiply(a, b, c);
+    // The standard bound for a sum of k products: k * eps * the sum of their magnitudes
+    double worst = 0.0;
+    for (size_t r = 0; r < m; ++r) {
+        for (size_t j = 0; j < n; ++j) {
+            long double expected = 0, magnitude = 0;
+            for (size_t p = 0; p < k; ++p) {
+                long double term = static_cast<long double>(a.at(r, p)) * b.at(p, j);
+                expected += term;
+                magnitude += fabsl(term);
+            }
+            double bound = static_cast<double>(k) * numeric_limits<double>::epsilon() * static_cast<double>(magnitude) + 1e-300;
+            worst = max(worst, fabs(c.at(r, j) - static_cast<double>(expected)) / bound);
+        }
+    }
+    if (!CHECK(worst <= 1.0)) {
+        cerr << "  " << m << "x" << k << " by " << k << "x" << n << ": error " << worst << " times the bound\n";
+    }
+}
+
+int main() {
+    mt19937_64 random(5);
+    const MatrixKernel::Kernels& kernels = MatrixKernel::get();
+    const size_t mr = kernels.mr, nr = kernels.nr;
+    const size_t rows[] = {1, mr - 1, mr, mr + 1, 2 * mr + 3, MatrixEngine::MC - 1, MatrixEngine::MC + 1};
+    const size_t cols[] = {1, nr - 1, nr, nr + 1, 3 * nr + 5};
+    const size_t inner[] = {1, 7, MatrixEngine::KC, MatrixEngine::KC + 1};
+    MatrixEngine single(1), parallel(4);
+    for (size_t m : rows) {
+        for (size_t n : cols) {
+            for (size_t k : inner) multiplyAgainstNaive(single, m, n, k, random);
+        }
+    }
+    // Wide enough for the NC block edge and the row blocks to go to the pool
+    multiplyAgainstNaive(parallel, 2 * MatrixEngine::MC + 5, MatrixEngine::NC + 3, 9, random);
+    multiplyAgainstNaive(parallel, MatrixEngine::MC + 1, 2 * nr + 1, MatrixEngine::KC + 3, random);
+
+    // Inner sizes must agree
+    MatrixArena arena;
+    bool threw = false;
+    try {
+        single.multiply(Matrix::allocate(arena, 2, 3), Matrix::allocate(arena, 2, 3), Matrix::allocate(arena, 2, 3));
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    return test::finish("matrix_test");
+}
@@ -0,0 +1,74 @@
+// MoneyKernel against MoneyRate::apply, the exact 128-bit conversion: every kernel this machine
+// can run, on ordinary amounts, exact halves and values on both sides of the kernel's fast-path limits
+#include "techneon/money.hpp"
+#include "check.hpp"
+
+#include <random>
+
+using namespace std;
+using namespace techneon;
+
+static void matchesApply(const char* kernel, MoneyKernel::KernelFn fn, const MoneyRate& rate, const vector<int64_t>& in) {
+    vector<int64_t> out(in.size());
+    __int128 total = fn(in.data(), out.data(), in.size(), rate);
+    __int128 expectedTotal = 0;
+    size_t wrong = 0;
+    for (size_t i = 0; i < in.size(); ++i) {
+        int64_t expected = rate.apply(in[i]);
+        expectedTotal += expected;
+        if (out[i] != expected && wrong++ < 5) {
+            cerr << "  " << kernel << ": " << in[i] << " * " << rate.numerator << " / " << rate.denominator << ": got "
+                 << out[i] << ", expected " << expected << "\n";
+        }
+    }
+    CHECK(wrong == 0);
+    CHECK(total == expectedTotal);
+}
+
+// Amounts around a limit, each sign: the limit itself and a few units either side
+static void around(vector<int64_t>& values, int64_t limit) {
+    for (int64_t d = -4; d <= 4; ++d) {
+        values.push_back(limit + d);
+        values.push_back(-(limit + d));
+    }
+}
+
+int main() {
+    const double resultLimit = bit_cast<double>(MoneyKernel::RESULT_LIMIT_BITS);
+    CHECK(resultLimit == 0x1p50);
+    mt19937_64 random(3);
+    uniform_int_distribution<int64_t> cents(-100000000000, 100000000000);
+    vector<int64_t> ordinary(100003);
+    for (int64_t& v : ordinary) v = cents(random);
+    // Exact halves, to exercise half-even rounding
+    for (int64_t v = -1000; v <= 1000; ++v) ordinary.push_back(v * 5);
+
+    const double quotes[] = {1.0, 83.12, 0.92, 0.79, 151.37, 1.0 / 3.0, 7.000001};
+    const pair<int, int> scales[] = {{2, 2}, {2, 0}, {0, 4}, {4, 2}};
+    for (auto [name, fn] : MoneyKernel::kernels()) {
+        for (double from : quotes) {
+            for (double to : quotes) {
+                for (auto [fromScale, toScale] : scales) {
+                    MoneyRate rate = MoneyRate::fromQuotes(from, to, fromScale, toScale);
+                    matchesApply(name, fn, rate, ordinary);
+
+                    // Inputs either side of 2^53 and results either side of 2^50, kept where the exact
+                    // result still fits in 64 bits
+                    vector<int64_t> edges;
+                    if (rate.approx < 512) around(edges, MoneyKernel::INPUT_LIMIT);
+                    if (resultLimit / rate.approx < 0x1p62) around(edges, static_cast<int64_t>(resultLimit / rate.approx));
+                    // Alone, so a whole block sits just inside or just outside the limits...
+                    for (size_t i = 0; i < edges.size(); ++i) matchesApply(name, fn, rate, vector<int64_t>(64, edges[i]));
+                    // ...and one at a time among ordinary amounts, which the fallback must redo with them
+                    for (size_t i = 0; i < edges.size(); i += 3) {
+                        vector<int64_t> mixed(ordinary.begin(), ordinary.begin() + 4099);
+                        mixed[(i * 977) % mixed.size()] = edges[i];
+                        matchesApply(name, fn, rate, mixed);
+                    }
+                }
+            }
+        }
+        cerr << name << " kernel checked\n";
+    }
+    return test::finish("money_test");
+}
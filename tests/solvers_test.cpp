@@ -0,0 +1,84 @@
+// RootFinder and AdaptiveIntegrator on roots and integrals with known values
+#include "techneon/solvers.hpp"
+#include "check.hpp"
+
+using namespace std;
+using namespace techneon;
+
+static constexpr double PI = 3.14159265358979323846;
+
+static void roots() {
+    struct Case {
+        const char* expression;
+        double a, b, root;
+    };
+    // Trig is in degrees, as everywhere else in the calculator
+    static constexpr Case CASES[] = {
+        {"x^2 - 2", 0, 2, 1.4142135623730951},
+        {"cos(x)", 0, 180, 90},
+        {"ln(x) - 1", 1, 5, 2.718281828459045},
+        {"x^3 - 2*x - 5", 2, 3, 2.0945514815423265},
+        {"x", -1, 1, 0},
+    };
+    for (const Case& c : CASES) {
+        RootFinder finder(c.expression);
+        RootFinder::Result bracketed = finder.brent(c.a, c.b);
+        CHECK(bracketed.converged);
+        CHECK_NEAR(bracketed.root, c.root, 1e-10 * max(1.0, fabs(c.root)));
+        RootFinder::Result started = finder.newton(c.a + (c.b - c.a) * 0.4);
+        CHECK(started.converged);
+        CHECK_NEAR(started.root, c.root, 1e-10 * max(1.0, fabs(c.root)));
+    }
+
+    // A bracket without a sign change is searched for one
+    RootFinder::Result scanned = RootFinder("x^2 - 2").brent(-3, 3);
+    CHECK(scanned.converged);
+    CHECK_NEAR(fabs(scanned.root), 1.4142135623730951, 1e-10);
+
+    // No root at all: an error, not an invented root
+    bool threw = false;
+    try {
+        RootFinder("x^2 + 1").brent(-3, 3);
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+static void integrals() {
+    struct Case {
+        const char* expression;
+        double a, b, integral, tolerance;
+    };
+    static constexpr Case CASES[] = {
+        {"x^2", 0, 3, 9, 1e-10},
+        {"4 / (1 + x^2)", 0, 1, PI, 1e-10},
+        {"1 / x", 1, 2, 0.69314718055994531, 1e-10},
+        {"sin(x)", 0, 180, 360 / PI, 1e-9},
+        {"x^-0.5", 0, 1, 2, 1e-6},                 // singular at 0
+        {"x^2", 3, 0, -9, 1e-10},                  // reversed limits
+    };
+    for (size_t threads : {size_t(1), size_t(4)}) {
+        AdaptiveIntegrator integrator(threads);
+        for (const Case& c : CASES) {
+            AdaptiveIntegrator::Result result = integrator.integrate(c.expression, c.a, c.b);
+            CHECK_NEAR(result.integral, c.integral, c.tolerance);
+            CHECK(result.error <= max(c.tolerance, 1e-10 * fabs(c.integral)));
+        }
+    }
+
+    // An integrand that is infinite inside the interval is an error
+    bool threw = false;
+    try {
+        AdaptiveIntegrator(1).integrate("1 / x", -1, 1);
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main() {
+    roots();
+    integrals();
+    return test::finish("solvers_test");
+}
@@ -0,0 +1,90 @@
+// StreamingStats and QuantileSketch against exact statistics of the same values
+#include "techneon/stats.hpp"
+#include "check.hpp"
+
+#include <random>
+
+using namespace std;
+using namespace techneon;
+
+// Rank of value in sorted, as a fraction of the count
+static double rankOf(const vector<double>& sorted, double value) {
+    return static_cast<double>(lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin()) / static_cast<double>(sorted.size());
+}
+
+static void moments() {
+    // Values far from zero, where a naive sum of squares loses the variance
+    mt19937_64 random(7);
+    normal_distribution<double> normal(1e9, 3.0);
+    vector<double> values(300000);
+    for (double& v : values) v = normal(random);
+    long double sum = 0;
+    for (double v : values) sum += v;
+    long double mean = sum / values.size(), squares = 0;
+    for (double v : values) squares += (v - mean) * (v - mean);
+    double variance = static_cast<double>(squares / (values.size() - 1));
+
+    StreamingStats bulk;
+    bulk.add(span<const double>(values));
+    StreamingStats single, left, right;
+    for (size_t i = 0; i < values.size(); ++i) {
+        single.add(values[i]);
+        (i < values.size() / 3 ? left : right).add(values[i]);
+    }
+    left.merge(right);
+    for (const StreamingStats* stats : {&bulk, &single, &left}) {
+        CHECK(stats->count() == values.size());
+        // Chunk means are rounded at 1e9, so a few ulps; E[x^2] - E[x]^2 would lose every digit here
+        CHECK_NEAR(stats->mean(), static_cast<double>(mean), 1e-5);
+        CHECK_NEAR(stats->variance(), variance, variance * 1e-6);
+        CHECK(stats->min() == *min_element(values.begin(), values.end()));
+        CHECK(stats->max() == *max_element(values.begin(), values.end()));
+        CHECK(stats->quantile(0.0) == stats->min());
+        CHECK(stats->quantile(1.0) == stats->max());
+    }
+
+    StreamingStats empty;
+    CHECK(empty.count() == 0);
+    CHECK(isnan(empty.mean()) && isnan(empty.min()) && isnan(empty.quantile(0.5)));
+}
+
+static void quantiles() {
+    // The sketch promises rank error under 0.5%; checked at 1% over sorted, reversed and random input
+    static constexpr double QS[] = {0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999};
+    mt19937_64 random(11);
+    exponential_distribution<double> exponential(1.0);
+    vector<double> randomValues(1000000);
+    for (double& v : randomValues) v = exponential(random);
+    vector<double> ascending(randomValues);
+    sort(ascending.begin(), ascending.end());
+    vector<double> descending(ascending.rbegin(), ascending.rend());
+
+    for (const vector<double>* input : {&randomValues, &ascending, &descending}) {
+        QuantileSketch sketch, halves[2];
+        for (size_t i = 0; i < input->size(); ++i) {
+            sketch.add((*input)[i]);
+            halves[i & 1].add((*input)[i]);
+        }
+        halves[0].merge(halves[1]);
+        double single[size(QS)], merged[size(QS)];
+        sketch.quantiles(QS, single);
+        halves[0].quantiles(QS, merged);
+        for (size_t i = 0; i < size(QS); ++i) {
+            CHECK_NEAR(rankOf(ascending, single[i]), QS[i], 0.01);
+            CHECK_NEAR(rankOf(ascending, merged[i]), QS[i], 0.01);
+        }
+    }
+
+    // Few values are kept exactly
+    QuantileSketch small;
+    for (int i = 1; i <= 100; ++i) small.add(i);
+    double median[1], half[] = {0.5};
+    small.quantiles(half, median);
+    CHECK(median[0] == 50.0);
+}
+
+int main() {
+    moments();
+    quantiles();
+    return test::finish("stats_test");
+}